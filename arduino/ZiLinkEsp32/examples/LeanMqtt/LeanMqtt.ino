@@ -0,0 +1,50 @@
+#include <WiFi.h>
+#include <ZiLinkMqtt.h>
+
+// MqttData with the compile-time client: only MQTT is built in, so the
+// WebSocket and HTTP clients take no RAM or flash. No outbound queue:
+// a reading sent while the broker is down is dropped (sendData() is false).
+
+const char* ssid = "YOUR_SSID";
+const char* password = "YOUR_PASSWORD";
+
+const char* BROKER_HOST = "YOUR_SERVER_HOST_OR_IP";  // e.g. "192.168.1.10" or "api.ziji.world"
+const uint16_t BROKER_PORT = 1883;
+
+// From POST /api/devices/register (data.device.deviceId, data.deviceToken)
+const char* DEVICE_ID = "YOUR_DEVICE_ID";
+const char* DEVICE_TOKEN = "YOUR_DEVICE_TOKEN";
+
+ZiLink<ZiLinkMqtt> zi(DEVICE_ID, DEVICE_TOKEN, {BROKER_HOST, BROKER_PORT});
+
+unsigned long lastSend = 0;
+const unsigned long SEND_INTERVAL_MS = 5000;
+
+void onCommand(const char* command, size_t length) {
+  Serial.printf("Command: %.*s\n", (int)length, command);
+}
+
+void setup() {
+  Serial.begin(115200);
+  WiFi.begin(ssid, password);
+  while (WiFi.status() != WL_CONNECTED) {
+    delay(500);
+  }
+  zi.onCommand(onCommand);
+  zi.begin();
+}
+
+void loop() {
+  zi.loop();
+
+  if (millis() - lastSend >= SEND_INTERVAL_MS) {
+    lastSend = millis();
+    static int v = 300;
+    v = (v >= 400) ? 300 : v + 5;
+    char payload[128];
+    int n = snprintf(payload, sizeof(payload),
+                     "{\"sensors\":[{\"type\":\"light\",\"value\":%d,\"unit\":\"lux\"}],\"deviceStatus\":{\"isOnline\":true}}", v);
+    bool ok = zi.sendData(payload, n);
+    Serial.printf("Publish %s: %s\n", ok ? "OK" : "FAIL", payload);
+  }
+}
@@ -0,0 +1,39 @@
+#include <WiFi.h>
+#include <ZiLinkEsp32.h>
+
+// Samples a pin at 1 kHz and the chip temperature at 10 Hz, and sends one
+// min/max/mean/last reading per second instead of every sample. The
+// sketch's loop() must keep calling zi.loop() faster than the fastest
+// period; samplerStats() shows how late samples were taken.
+
+const char* ssid = "YOUR_SSID";
+const char* password = "YOUR_PASSWORD";
+
+const int SENSOR_PIN = 34;
+
+ZiLinkEsp32 zi;
+
+unsigned long lastReport = 0;
+
+void setup() {
+  Serial.begin(115200);
+  WiFi.begin(ssid, password);
+  while (WiFi.status() != WL_CONNECTED) {
+    delay(500);
+  }
+
+  zi.setupWebSocket("api.ziji.world", 80, "/ws", "device123", "token123");
+  zi.sampleSensor("vibration", 1000, 1000, [] { return (float)analogRead(SENSOR_PIN); }, 0);
+  zi.sampleSensor("chipTemp", 100000, 1000, [] { return temperatureRead(); }, 1);
+}
+
+void loop() {
+  zi.loop();
+
+  if (millis() - lastReport >= 10000) {
+    lastReport = millis();
+    const ZiLinkSampler::Stats& s = zi.samplerStats();
+    Serial.printf("samples %u missed %u windows %u, late p99 %u us\n", s.samples, s.missed, s.windows,
+                  s.lateUs.percentile(99));
+  }
+}
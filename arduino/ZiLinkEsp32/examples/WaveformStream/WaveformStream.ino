@@ -0,0 +1,56 @@
+#include <WiFi.h>
+#include <ZiLinkEsp32.h>
+
+// Streams a microphone (or vibration sensor) on an ADC pin at 8 kHz as raw
+// int16 samples. The network task sends the chunks from core 0, so loop()
+// only samples and is never held up by a send. If the server or the link
+// falls behind, write() drops samples and the server sees the gap.
+
+const char* ssid = "YOUR_SSID";
+const char* password = "YOUR_PASSWORD";
+
+const int MIC_PIN = 34;
+const uint32_t SAMPLE_RATE = 8000;
+
+ZiLinkEsp32 zi;
+ZiLinkStream* mic = nullptr;
+
+int16_t samples[64];
+size_t filled = 0;
+uint32_t nextSampleUs = 0;
+unsigned long lastReport = 0;
+
+void setup() {
+  Serial.begin(115200);
+  WiFi.begin(ssid, password);
+  while (WiFi.status() != WL_CONNECTED) {
+    delay(500);
+  }
+
+  zi.setupWebSocket("api.ziji.world", 80, "/ws", "device123", "token123");
+  // Two blocks of 1024 samples: 128 ms of audio each
+  mic = zi.openStream("mic", ZiLinkStream::Int16, SAMPLE_RATE, 1024);
+  zi.startNetworkTask();
+  nextSampleUs = micros();
+}
+
+void loop() {
+  if ((int32_t)(micros() - nextSampleUs) < 0) {
+    return;
+  }
+  nextSampleUs += 1000000 / SAMPLE_RATE;
+  samples[filled++] = analogRead(MIC_PIN) - 2048;
+  if (filled < 64) {
+    return;
+  }
+  mic->write(samples, filled);
+  filled = 0;
+  zi.loop();
+
+  if (millis() - lastReport >= 10000) {
+    lastReport = millis();
+    const ZiLinkStream::Stats& s = mic->stats();
+    Serial.printf("samples %u dropped %u chunks %u, out of credit %u times\n", s.samples, s.dropped, s.chunks,
+                  s.creditStalls);
+  }
+}
@@ -0,0 +1,201 @@
+// Micro-benchmarks of the public API, built against the host stand-ins in
+// ../host (in-memory transports, so only the library's own work is timed):
+// ns per call and heap allocations per call. Needs ArduinoJson (header-only):
+//
+//   g++ -O2 -std=gnu++17 -pthread -I../host -I../../src -I<ArduinoJson>/src api_bench.cpp ../host/*.cpp ../../src/*.cpp -o api_bench
+//   ./api_bench
+//
+// Run it before and after a change to the send or receive paths; the
+// numbers are only comparable on the same machine.
+
+#include <ZiLinkEsp32.h>
+#include <ZiLinkHost.h>
+#include <ZiLinkMqtt.h>
+
+#include <arpa/inet.h>
+#include <malloc.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+
+// Count every allocation: ArduinoJson (malloc) and the rest (operator new -> malloc)
+static size_t g_allocs = 0;
+extern "C" void *__libc_malloc(size_t);
+extern "C" void *malloc(size_t n)
+{
+  g_allocs++;
+  return __libc_malloc(n);
+}
+
+static void run(const char *name, size_t rounds, const std::function<void(size_t)> &fn)
+{
+  fn(0); // warm up lazily allocated buffers
+  const size_t allocs = g_allocs;
+  auto t0 = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < rounds; i++)
+  {
+    fn(i);
+  }
+  const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+  printf("%-34s %9.0f ns/op  %5.2f allocs/op\n", name, ns / rounds, (double)(g_allocs - allocs) / rounds);
+}
+
+static void connect(ZiLinkEsp32 &link)
+{
+  for (int i = 0; i < 4; i++)
+  {
+    link.loop(); // connect, then deliver auth_success
+  }
+}
+
+int main()
+{
+  ZiLinkHost::setMode(ZiLinkHost::InMemory);
+  const String reading = "{\"temperature\":23.5,\"humidity\":41}";
+  static float samples[256];
+  for (size_t i = 0; i < 256; i++)
+  {
+    samples[i] = (float)i * 0.25f;
+  }
+
+  {
+    ZiLinkEsp32 link;
+    link.setupWebSocket("localhost", 5000, "/ws", "bench", "token");
+    connect(link);
+    run("sendWebSocketData (json)", 100000, [&](size_t)
+        { link.sendWebSocketData(reading); });
+    run("sendWebSocketSamples x256 (json)", 20000, [&](size_t)
+        { link.sendWebSocketSamples("wave", samples, 256); });
+    run("createSlider (changing value)", 100000, [&](size_t i)
+        { link.createSlider((int)(i % 100), "slider-1"); link.loop(); });
+
+    link.enableBatching(16, 1000);
+    run("sendWebSocketData (batched x16)", 100000, [&](size_t)
+        { link.sendWebSocketData(reading); });
+    link.disableBatching();
+
+    bool handled = false;
+    link.onCommand("led", [&](const ZiLinkCommandQueue::Command &)
+                   { handled = true; });
+    run("inbound command -> handler", 100000, [&](size_t)
+        {
+      ZiLinkHost::injectText("{\"type\":\"command\",\"data\":{\"command\":\"led on\"}}");
+      link.loop(); });
+    if (!handled)
+    {
+      printf("  (command handler never ran)\n");
+    }
+  }
+
+  {
+    ZiLinkHost::setAuthReply("{\"type\":\"auth_success\",\"data\":{\"encoding\":\"msgpack\"}}");
+    ZiLinkEsp32 link;
+    link.setWireEncoding(ZiLinkEsp32::EncodingMsgPack);
+    link.setupWebSocket("localhost", 5000, "/ws", "bench", "token");
+    connect(link);
+    run("sendWebSocketData (msgpack)", 100000, [&](size_t)
+        { link.sendWebSocketData(reading); });
+    run("sendWebSocketSamples x256 (msgpack)", 20000, [&](size_t)
+        { link.sendWebSocketSamples("wave", samples, 256); });
+    ZiLinkHost::setAuthReply(nullptr);
+  }
+
+  {
+    // Against the stand-in server's trace echo: 2-5 ms RTT, 1% of the acks lost
+    ZiLinkHost::TraceEcho echo;
+    echo.delayUs = 2000;
+    echo.jitterUs = 3000;
+    echo.lossPercent = 1;
+    ZiLinkHost::setTraceEcho(echo);
+    ZiLinkEsp32 link;
+    link.setLatencyTracking(true);
+    link.setupWebSocket("localhost", 5000, "/ws", "bench", "token");
+    connect(link);
+    run("sendWebSocketData (traced) + loop", 20000, [&](size_t)
+        { link.sendWebSocketData(reading); link.loop(); });
+    for (int i = 0; i < 20; i++)
+    {
+      usleep(1000);
+      link.loop(); // collect the last acks
+    }
+    const ZiLinkLatency &l = link.latency();
+    printf("  rtt p50 %u us, p99 %u us; acked %u/%u, missing %u, reordered %u\n", l.rttUs().percentile(50),
+           l.rttUs().percentile(99), l.stats().acked, l.stats().traced, l.stats().missing, l.stats().reordered);
+    ZiLinkHost::setTraceEcho(ZiLinkHost::TraceEcho());
+  }
+
+  {
+    // The MQTT state machine opens a real TCP connection and waits for the
+    // CONNACK before handing it to PubSubClient, so give it something to
+    // connect to that answers
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(listener, (sockaddr *)&addr, sizeof(addr));
+    listen(listener, 1);
+    socklen_t len = sizeof(addr);
+    getsockname(listener, (sockaddr *)&addr, &len);
+
+    ZiLinkEsp32 link;
+    link.setupMqtt("127.0.0.1", ntohs(addr.sin_port), "bench", "token");
+    int peer = -1;
+    for (int i = 0; i < 200 && link.mqttState() != ZiLinkEsp32::MqttConnected; i++)
+    {
+      link.loop();
+      pollfd p = {listener, POLLIN, 0};
+      if (peer < 0 && poll(&p, 1, 0) == 1 && (peer = accept(listener, nullptr, nullptr)) >= 0)
+      {
+        const uint8_t connack[] = {0x20, 0x02, 0x00, 0x00};
+        send(peer, connack, sizeof(connack), MSG_NOSIGNAL);
+      }
+      usleep(1000);
+    }
+    if (link.mqttState() == ZiLinkEsp32::MqttConnected)
+    {
+      run("publishMqttData", 100000, [&](size_t)
+          { link.publishMqttData(reading); });
+    }
+    else
+    {
+      printf("%-34s (could not connect)\n", "publishMqttData");
+    }
+
+    ZiLink<ZiLinkMqtt> lean("bench", "token", {"127.0.0.1", ntohs(addr.sin_port)});
+    lean.begin();
+    for (int i = 0; i < 200 && !lean.connected(); i++)
+    {
+      lean.loop();
+      usleep(1000);
+    }
+    if (lean.connected())
+    {
+      run("ZiLink<ZiLinkMqtt>::sendData", 100000, [&](size_t)
+          { lean.sendData(reading); });
+    }
+    if (peer >= 0)
+    {
+      close(peer);
+    }
+    close(listener);
+  }
+
+  {
+    ZiLinkEsp32 link;
+    link.setupHttp("http://localhost:5000/api", "bench", "token");
+    run("sendData (http)", 100000, [&](size_t)
+        { link.sendData(reading); });
+    run("sendStatus (http)", 100000, [&](size_t)
+        { link.sendStatus(reading); });
+  }
+
+  const ZiLinkHost::Counters &c = ZiLinkHost::counters();
+  printf("\ntransport: %u ws text, %u ws binary, %u mqtt, %u http, %llu bytes\n", c.wsText, c.wsBinary, c.mqttPublish,
+         c.httpPost, (unsigned long long)c.bytes);
+  return 0;
+}
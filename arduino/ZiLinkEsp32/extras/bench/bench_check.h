@@ -0,0 +1,27 @@
+// Pass/fail bookkeeping shared by the benches: check() reports a failed
+// condition, main() ends with `return benchResult();`, which prints PASS or
+// FAIL and exits nonzero on failure.
+
+#ifndef ZILINK_BENCH_CHECK_H
+#define ZILINK_BENCH_CHECK_H
+
+#include <cstdio>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+  if (!ok)
+  {
+    failures++;
+    printf("FAIL %s\n", what);
+  }
+}
+
+static int benchResult()
+{
+  printf("%s\n", failures ? "FAIL" : "PASS");
+  return failures ? 1 : 0;
+}
+
+#endif
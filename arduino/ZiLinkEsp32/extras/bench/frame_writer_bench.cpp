@@ -0,0 +1,120 @@
+// Host-side benchmark: legacy String-concatenation frames vs ZiLinkFrameWriter.
+// Also checks that a writer over storage too small for its headroom stays
+// inside that storage.
+//
+//   g++ -O2 -std=c++17 -I../../src frame_writer_bench.cpp ../../src/ZiLinkFrameWriter.cpp -o frame_writer_bench
+//   ./frame_writer_bench
+//
+// std::string stands in for Arduino's String; both grow on the heap the same way.
+// Allocations are counted by replacing the global operator new.
+
+#include "ZiLinkFrameWriter.h"
+#include "bench_check.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+static size_t g_allocs = 0;
+static size_t g_bytes = 0;
+
+void *operator new(size_t n)
+{
+  g_allocs++;
+  g_bytes += n;
+  void *p = malloc(n);
+  if (!p)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+static volatile size_t g_sink = 0;
+
+static void consume(const char *data, size_t len)
+{
+  g_sink += len + (unsigned char)data[len / 2];
+}
+
+// Mirrors the previous createSlider()
+static void legacySlider(int value, const char *id)
+{
+  std::string payload =
+      "{\"type\":\"slider\",\"id\":\"" + std::string(id) + "\",\"value\":" + std::to_string(value) + "}";
+  std::string tmp = payload; // sendComponentData() copied again before sendTXT()
+  consume(tmp.c_str(), tmp.size());
+}
+
+static void writerSlider(int value, const char *id)
+{
+  ZiLinkFrame<> frame;
+  frame.raw("{\"type\":\"slider\",\"id\":").str(id).raw(",\"value\":").integer(value).raw('}');
+  consume(frame.c_str(), frame.length());
+}
+
+// Mirrors the previous sendWebSocketData()
+static void legacyTelemetry(const std::string &message)
+{
+  std::string msg = "{\"type\":\"device_data\",\"data\":{\"sensorData\":" + message + "}}";
+  consume(msg.c_str(), msg.size());
+}
+
+static void writerTelemetry(const std::string &message)
+{
+  ZiLinkFrame<> frame;
+  frame.raw("{\"type\":\"device_data\",\"data\":{\"sensorData\":").raw(message.c_str(), message.size()).raw("}}");
+  consume(frame.c_str(), frame.length());
+}
+
+template <typename Fn>
+static void run(const char *name, Fn fn)
+{
+  const int iterations = 1000000;
+  g_allocs = g_bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++)
+  {
+    fn(i);
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  printf("%-22s %8.1f ns/frame %6.2f allocs/frame %8.1f bytes/frame\n", name, (double)elapsed / iterations,
+         (double)g_allocs / iterations, (double)g_bytes / iterations);
+}
+
+// Storage smaller than headroom + terminator: nothing may land past it
+static void tooSmall()
+{
+  char storage[8];
+  memset(storage, 'x', sizeof(storage));
+  ZiLinkFrameWriter w(storage, 4, 6);
+  w.raw("{}");
+  check(!w.ok() && w.capacity() == 0 && w.length() == 0, "too small: overflowed from the start");
+  check(w.c_str() >= storage && w.c_str() < storage + 4 && *w.c_str() == '\0', "too small: c_str() inside the storage");
+  check(memcmp(storage + 4, "xxxx", 4) == 0, "too small: nothing written past the storage");
+  w.reset();
+  w.truncate(0);
+  check(!w.ok(), "too small: stays overflowed after reset()");
+
+  ZiLinkFrameWriter none(nullptr, 0, 6);
+  check(!none.ok() && none.c_str() && *none.c_str() == '\0', "no storage: empty c_str()");
+}
+
+int main()
+{
+  tooSmall();
+  const char *id = "living-room-dimmer";
+  const std::string reading = "{\"temperature\":23.5,\"humidity\":61,\"pressure\":1013.2}";
+
+  run("slider (String)", [&](int i) { legacySlider(i & 1023, id); });
+  run("slider (writer)", [&](int i) { writerSlider(i & 1023, id); });
+  run("device_data (String)", [&](int) { legacyTelemetry(reading); });
+  run("device_data (writer)", [&](int) { writerTelemetry(reading); });
+  return benchResult();
+}
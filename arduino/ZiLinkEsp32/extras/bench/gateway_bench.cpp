@@ -0,0 +1,456 @@
+// Host-side check of gateway mode: six sub-devices share one serial line (a
+// socket pair standing in for a UART) with a gateway that carries them over
+// its one server session. One sub-device is chatty, one has a bad token, and
+// the line starts with noise and a corrupt frame. The server side is
+// simulated in the gateway's loop: gateway_auth answered after a round trip,
+// an uplink of fixed bandwidth, and a command to every sub-device each 100 ms
+// that it answers with a command_response.
+//
+//   g++ -O2 -std=c++17 -pthread -I../../src gateway_bench.cpp ../../src/ZiLinkGateway.cpp ../../src/ZiLinkRingBuffer.cpp -o gateway_bench
+//   ./gateway_bench
+//
+// The same traffic also runs through one shared FIFO of the same total size
+// in front of the uplink, which is what the gateway would be without a queue
+// per channel.
+
+#include "ZiLinkGateway.h"
+#include "ZiLinkRingBuffer.h"
+#include "bench_check.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const int RUN_MS = 2000;
+static const int AUTH_RTT_MS = 20;
+static const int COMMAND_EVERY_MS = 100;
+static const size_t UPLINK_BYTES_PER_MS = 40; // ~40 KB/s left for sub-devices
+static const size_t UPLINK_BURST = 512;
+static const char *COMMAND = "{\"type\":\"command\",\"data\":{\"command\":\"ping\"}}";
+static const char *RESPONSE = "{\"type\":\"command_response\",\"data\":{\"ok\":true}}";
+
+enum Mode
+{
+  PerChannel, // ZiLinkGateway
+  Shared      // one FIFO for all channels
+};
+
+struct SubDevice
+{
+  uint8_t channel;
+  const char *id;
+  const char *token;
+  int burst;   // messages every 10 ms
+  std::atomic<uint8_t> state{ZiLinkGateway::Unknown};
+  std::atomic<uint32_t> generated{0};
+  std::atomic<uint32_t> commands{0};
+  uint32_t delivered = 0; // server side
+  uint32_t responses = 0;
+  uint32_t commandsSent = 0;
+};
+
+// Both ends of the line: frames are written whole, as a UART driver with a
+// bus arbiter (RS-485) would, and read in whatever chunks the socket gives
+struct Bus
+{
+  int fd[2];
+  std::mutex writeLock; // sub-device end
+  void write(int end, const uint8_t *data, size_t length)
+  {
+    while (length)
+    {
+      const ssize_t n = ::write(fd[end], data, length);
+      if (n <= 0)
+      {
+        return;
+      }
+      data += n;
+      length -= (size_t)n;
+    }
+  }
+};
+
+// Frame decoder for the sub-device side (and for the shared-FIFO gateway)
+struct Decoder
+{
+  uint8_t buf[ZiLinkGateway::MAX_FRAME_BYTES];
+  size_t have = 0;
+  template <typename Fn>
+  void feed(const uint8_t *data, size_t length, Fn fn)
+  {
+    for (size_t i = 0; i < length; i++)
+    {
+      if (have == 0 && data[i] != ZiLinkGateway::SYNC)
+      {
+        continue;
+      }
+      buf[have++] = data[i];
+      if (have < ZiLinkGateway::HEADER_BYTES)
+      {
+        continue;
+      }
+      const size_t payload = buf[3] | ((size_t)buf[4] << 8);
+      if (have == ZiLinkGateway::HEADER_BYTES + payload + 1 || payload > ZILINK_GATEWAY_FRAME_BYTES)
+      {
+        uint8_t sum = 0;
+        for (size_t k = 1; k < have - 1; k++)
+        {
+          sum += buf[k];
+        }
+        if (payload <= ZILINK_GATEWAY_FRAME_BYTES && sum == buf[have - 1])
+        {
+          fn(buf[1], buf[2], buf + ZiLinkGateway::HEADER_BYTES, payload);
+        }
+        have = 0;
+      }
+    }
+  }
+};
+
+static void sendFrame(Bus &bus, uint8_t channel, uint8_t type, const void *payload, size_t length)
+{
+  uint8_t frame[ZiLinkGateway::MAX_FRAME_BYTES];
+  const size_t n = ZiLinkGateway::encode(frame, sizeof(frame), channel, type, payload, length);
+  std::lock_guard<std::mutex> lock(bus.writeLock);
+  bus.write(1, frame, n);
+}
+
+static void hello(Bus &bus, const SubDevice &d)
+{
+  char payload[96];
+  const size_t idLen = strlen(d.id);
+  memcpy(payload, d.id, idLen + 1);
+  memcpy(payload + idLen + 1, d.token, strlen(d.token));
+  sendFrame(bus, d.channel, ZiLinkGateway::Hello, payload, idLen + 1 + strlen(d.token));
+}
+
+struct Result
+{
+  uint32_t authMessages = 0;
+  uint32_t linkErrors = 0;
+  std::vector<uint32_t> queueDrops;
+};
+
+static Result run(Mode mode, std::vector<SubDevice *> &devices)
+{
+  Bus bus;
+  socketpair(AF_UNIX, SOCK_STREAM, 0, bus.fd);
+  fcntl(bus.fd[0], F_SETFL, O_NONBLOCK);
+  std::atomic<bool> done{false};
+
+  ZiLinkGateway gateway;
+  gateway.begin(ZILINK_GATEWAY_QUEUE_BYTES);
+  gateway.onDownlink([](void *ctx, uint8_t, const uint8_t *frame, size_t length)
+                     { static_cast<Bus *>(ctx)->write(0, frame, length); },
+                     &bus);
+  ZiLinkRingBuffer shared(ZILINK_GATEWAY_QUEUE_BYTES * ZILINK_GATEWAY_MAX_CHANNELS);
+  uint32_t sharedDrops[256] = {};
+
+  // Line noise and a frame with a bad checksum before anyone says hello
+  const uint8_t noise[] = {0x00, 0xFF, 0xA5, 0x01, 0x02, 0x03, 0x00, 'x', 'y', 'z', 0x00, 0x13};
+  bus.write(1, noise, sizeof(noise));
+
+  // Downlink: status frames and commands for the sub-devices
+  std::thread reader([&]
+                     {
+    Decoder decoder;
+    uint8_t chunk[256];
+    while (!done)
+    {
+      const ssize_t n = read(bus.fd[1], chunk, sizeof(chunk));
+      if (n <= 0)
+      {
+        return;
+      }
+      decoder.feed(chunk, (size_t)n, [&](uint8_t channel, uint8_t type, const uint8_t *payload, size_t length) {
+        for (SubDevice *d : devices)
+        {
+          if (d->channel != channel)
+          {
+            continue;
+          }
+          if (type == ZiLinkGateway::Status && length == 1)
+          {
+            d->state = payload[0];
+          }
+          else if (type == ZiLinkGateway::Message && strstr(std::string((const char *)payload, length).c_str(), "\"command\""))
+          {
+            d->commands++;
+            sendFrame(bus, d->channel, ZiLinkGateway::Message, RESPONSE, strlen(RESPONSE));
+          }
+        }
+      });
+    } });
+
+  std::vector<std::thread> threads;
+  for (SubDevice *d : devices)
+  {
+    threads.emplace_back([&, d]
+                         {
+      char message[64];
+      auto nextHello = Clock::now();
+      while (!done)
+      {
+        const uint8_t state = d->state;
+        if (state == ZiLinkGateway::Rejected)
+        {
+          return;
+        }
+        if (state != ZiLinkGateway::Ready)
+        {
+          // Says hello again until it hears back, like after a gateway reboot
+          if (Clock::now() >= nextHello)
+          {
+            hello(bus, *d);
+            nextHello = Clock::now() + std::chrono::milliseconds(200);
+          }
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+          continue;
+        }
+        for (int i = 0; i < d->burst; i++)
+        {
+          const int n = snprintf(message, sizeof(message), "{\"type\":\"device_data\",\"data\":{\"sensorData\":{\"t\":%u}}}",
+                                 (unsigned)d->generated.load());
+          sendFrame(bus, d->channel, ZiLinkGateway::Message, message, (size_t)n);
+          d->generated++;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      } });
+  }
+
+  Result result;
+  Decoder sharedDecoder;
+  struct AuthBatch
+  {
+    Clock::time_point due;
+    std::vector<uint8_t> channels;
+  };
+  std::vector<AuthBatch> inFlight;
+  size_t uplink = UPLINK_BURST;
+  const auto start = Clock::now();
+  auto nextCommand = start + std::chrono::milliseconds(COMMAND_EVERY_MS);
+
+  auto deliver = [&](uint8_t channel, const char *message, size_t length)
+  {
+    if (length > uplink)
+    {
+      return false;
+    }
+    uplink -= length;
+    for (SubDevice *d : devices)
+    {
+      if (d->channel == channel)
+      {
+        if (std::string(message, length).find("command_response") != std::string::npos)
+        {
+          d->responses++;
+        }
+        else
+        {
+          d->delivered++;
+        }
+      }
+    }
+    return true;
+  };
+
+  // The gateway's loop(), at 1 ms
+  while (Clock::now() - start < std::chrono::milliseconds(RUN_MS))
+  {
+    uint8_t chunk[512];
+    ssize_t n;
+    while ((n = read(bus.fd[0], chunk, sizeof(chunk))) > 0)
+    {
+      if (mode == PerChannel)
+      {
+        gateway.feed(0, chunk, (size_t)n);
+        continue;
+      }
+      // Without per-channel queues: hellos still go to the gateway, messages into one FIFO
+      sharedDecoder.feed(chunk, (size_t)n, [&](uint8_t channel, uint8_t type, const uint8_t *payload, size_t length) {
+        if (type != ZiLinkGateway::Message || gateway.state(channel) != ZiLinkGateway::Ready)
+        {
+          gateway.receive(0, channel, type, payload, length);
+          return;
+        }
+        // Counts what each push evicts, whoever it belonged to
+        std::vector<uint8_t> before;
+        shared.drain([&](const ZiLinkRingBuffer::Record &r) { before.push_back(r.channel); return false; });
+        const uint32_t dropped = shared.stats().dropped;
+        shared.push(channel % ZiLinkRingBuffer::MAX_CHANNELS, 0, (const char *)payload, length);
+        const uint32_t lost = shared.stats().dropped - dropped;
+        for (uint32_t k = 0; k < lost && k < before.size(); k++)
+        {
+          sharedDrops[before[k]]++;
+        }
+      });
+    }
+
+    // gateway_auth: one message for all new channels, answered a round trip later
+    if (gateway.hasPending())
+    {
+      AuthBatch batch;
+      batch.due = Clock::now() + std::chrono::milliseconds(AUTH_RTT_MS);
+      gateway.forEachPending([&](uint8_t channel, const char *, const char *)
+                             { batch.channels.push_back(channel); });
+      gateway.authSent();
+      result.authMessages++;
+      inFlight.push_back(batch);
+    }
+    for (size_t i = 0; i < inFlight.size();)
+    {
+      if (Clock::now() < inFlight[i].due)
+      {
+        i++;
+        continue;
+      }
+      for (uint8_t channel : inFlight[i].channels)
+      {
+        bool accepted = false;
+        for (SubDevice *d : devices)
+        {
+          accepted |= d->channel == channel && strcmp(d->token, "bad") != 0;
+        }
+        gateway.authResult(channel, accepted);
+      }
+      inFlight.erase(inFlight.begin() + i);
+    }
+
+    if (Clock::now() >= nextCommand)
+    {
+      for (SubDevice *d : devices)
+      {
+        d->commandsSent += gateway.route(d->channel, COMMAND, strlen(COMMAND));
+      }
+      nextCommand += std::chrono::milliseconds(COMMAND_EVERY_MS);
+    }
+
+    uplink = std::min(uplink + UPLINK_BYTES_PER_MS, UPLINK_BURST);
+    if (mode == PerChannel)
+    {
+      gateway.service(deliver);
+    }
+    else
+    {
+      shared.drain([&](const ZiLinkRingBuffer::Record &r)
+                   { return deliver(r.channel, r.data, r.length); });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  done = true;
+  shutdown(bus.fd[0], SHUT_RDWR);
+  shutdown(bus.fd[1], SHUT_RDWR);
+  for (std::thread &t : threads)
+  {
+    t.join();
+  }
+  reader.join();
+  close(bus.fd[0]);
+  close(bus.fd[1]);
+
+  result.linkErrors = gateway.linkErrors();
+  for (SubDevice *d : devices)
+  {
+    const ZiLinkGateway::ChannelStats *stats = gateway.stats(d->channel);
+    result.queueDrops.push_back(mode == PerChannel ? (stats ? stats->dropped : 0) : sharedDrops[d->channel % 8]);
+  }
+  return result;
+}
+
+static void report(const char *title, Mode mode, bool expectFair)
+{
+  SubDevice quiet1{1, "sensor-1", "tok-1", 1}, quiet2{2, "sensor-2", "tok-2", 1}, quiet3{3, "sensor-3", "tok-3", 1},
+      quiet4{4, "sensor-4", "tok-4", 1}, chatty{5, "camera-5", "tok-5", 60}, intruder{6, "rogue-6", "bad", 1};
+  std::vector<SubDevice *> devices = {&quiet1, &quiet2, &quiet3, &quiet4, &chatty, &intruder};
+  const Result r = run(mode, devices);
+
+  printf("\n%s\n", title);
+  printf("| channel | device | msgs/s offered | generated | delivered | queue drops | commands | responses |\n");
+  printf("|---|---|---|---|---|---|---|---|\n");
+  uint32_t quietDrops = 0;
+  for (size_t i = 0; i < devices.size(); i++)
+  {
+    SubDevice *d = devices[i];
+    printf("| %u | %s | %d | %u | %u | %u | %u | %u |\n", d->channel, d->id, d->burst * 100, d->generated.load(),
+           d->delivered, r.queueDrops[i], d->commands.load(), d->responses);
+    if (d == &intruder)
+    {
+      check(d->state == ZiLinkGateway::Rejected && d->delivered == 0, "bad token rejected, nothing delivered");
+      continue;
+    }
+    check(d->state == ZiLinkGateway::Ready, "sub-device authenticated");
+    // Every command reached its sub-device, and the answers came back on its channel
+    check(d->commandsSent >= RUN_MS / COMMAND_EVERY_MS - 3 && d->commands + 1 >= d->commandsSent,
+          "commands routed to the sub-device");
+    if (d != &chatty)
+    {
+      // The chatty one's answers queue behind its own backlog and are dropped with it
+      check(!expectFair || d->responses + 2 >= d->commands, "command responses delivered");
+      quietDrops += r.queueDrops[i];
+    }
+  }
+  printf("gateway_auth messages: %u for %zu sub-devices, link errors: %u\n", r.authMessages, devices.size(),
+         r.linkErrors);
+  check(r.authMessages < devices.size(), "hellos batched into gateway_auth messages");
+  if (expectFair)
+  {
+    // The noise was skipped and everyone still got through
+    check(r.linkErrors > 0, "line noise counted as link errors");
+    // The chatty one loses its own excess; everyone else keeps everything
+    check(quietDrops == 0, "quiet sub-devices lose nothing");
+    check(r.queueDrops[4] > 0 && chatty.delivered > quiet1.delivered, "chatty sub-device drops only its excess");
+  }
+  else
+  {
+    check(quietDrops > 0, "a shared FIFO drops quiet sub-devices' messages");
+  }
+}
+
+// A message the send function cannot encode is counted as dropped and does not hold up the rest
+static void unsendable()
+{
+  ZiLinkGateway gateway;
+  gateway.begin();
+  const char hello[] = "sensor-9\0tok-9";
+  gateway.receive(0, 9, ZiLinkGateway::Hello, (const uint8_t *)hello, sizeof(hello) - 1);
+  gateway.authSent();
+  gateway.authResult(9, true);
+  const char *messages[] = {"not json", "{\"type\":\"device_data\"}"};
+  for (const char *m : messages)
+  {
+    gateway.receive(0, 9, ZiLinkGateway::Message, (const uint8_t *)m, strlen(m));
+  }
+  std::vector<std::string> sent;
+  gateway.service([&](uint8_t, const char *message, size_t length)
+                  {
+    if (message[0] != '{') {
+      return ZiLinkGateway::Dropped;
+    }
+    sent.emplace_back(message, length);
+    return ZiLinkGateway::Sent; });
+  const ZiLinkGateway::ChannelStats *stats = gateway.stats(9);
+  check(stats && stats->dropped == 1 && stats->sent == 1, "unsendable message counted as dropped, not sent");
+  check(sent.size() == 1 && sent[0] == messages[1], "the next message still goes out");
+}
+
+int main()
+{
+  unsendable();
+  printf("Connections to the server: 1 (gateway) instead of 7 (gateway and 6 sub-devices)\n");
+  report("Per-channel queues, deficit round robin (ZiLinkGateway)", PerChannel, true);
+  report("One shared FIFO of the same size (for comparison)", Shared, false);
+  printf("\n");
+  return benchResult();
+}
@@ -0,0 +1,446 @@
+// HTTP sends over a real local socket: ZiLinkEsp32 (Sockets mode) against a
+// minimal HTTP/1.1 server on 127.0.0.1 that takes POST /devices/<id>/data
+// and /batch-data the way the ZiLink server does, answers 201 after a
+// configurable delay, keeps connections alive and answers pipelined
+// requests in order. It checks every reading it receives.
+//
+//   1. Blocking sendData() (HTTPClient, a connection per POST) against the
+//      pipeline at depth 1 and 4 and with batches of 16, with 0 and 2 ms
+//      until the response: requests/s, readings/s and how long a
+//      sendData() + loop() iteration stalls the sketch (p99, max)
+//   2. Server closing the connection every 50 responses, with chunked
+//      responses: requests carried over to the next connection
+//   3. Connection dropped with requests in flight: retried, none lost
+//
+// Exits non-zero unless every reading reached the server intact and every
+// pipelined request was reported complete with 201. Needs ArduinoJson:
+//
+//   g++ -O2 -std=gnu++17 -pthread -I../host -I../../src -I<ArduinoJson>/src http_bench.cpp ../host/*.cpp ../../src/*.cpp
+
+#include <ZiLinkHost.h>
+#include <ZiLinkEsp32.h>
+#include "bench_check.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static uint64_t nowUs()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static std::string payloadFor(uint32_t n)
+{
+  char s[64];
+  snprintf(s, sizeof(s), "{\"n\":%u,\"temperature\":%u.5}", n, 20 + n % 10);
+  return s;
+}
+
+struct ServerConfig
+{
+  uint32_t delayUs = 0;
+  uint32_t closeEvery = 0; // "Connection: close" on every Nth response; 0: never
+  bool chunked = false;
+  uint32_t dropAfter = 0; // close without answering after this many requests (once); 0: never
+};
+
+class Server
+{
+public:
+  Server(const ServerConfig &config, uint32_t readings) : _config(config), _seen(readings, 0)
+  {
+    _listen = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(_listen, (sockaddr *)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(_listen, (sockaddr *)&addr, &len);
+    _port = ntohs(addr.sin_port);
+    listen(_listen, 16);
+    fcntl(_listen, F_SETFL, O_NONBLOCK);
+    _thread = std::thread([this]
+                          { run(); });
+  }
+
+  ~Server()
+  {
+    _stop = true;
+    _thread.join();
+    close(_listen);
+  }
+
+  uint16_t port() const { return _port; }
+
+  // Readings seen at least once
+  uint32_t delivered()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint32_t n = 0;
+    for (uint8_t s : _seen)
+    {
+      n += s != 0;
+    }
+    return n;
+  }
+  uint32_t requests() const { return _requests; }
+  uint32_t errors() const { return _errors; }
+  uint32_t connections() const { return _connections; }
+
+private:
+  struct Response
+  {
+    uint64_t dueUs;
+    bool close;
+  };
+
+  struct Connection
+  {
+    int fd;
+    std::string rx;
+    std::deque<Response> owed;
+  };
+
+  void run()
+  {
+    std::vector<Connection> conns;
+    uint32_t answered = 0;
+    bool dropped = false;
+    while (!_stop)
+    {
+      // Sleep until data or the next response is due (busy waiting starves the device on one core)
+      std::vector<pollfd> fds;
+      fds.push_back({_listen, POLLIN, 0});
+      uint64_t dueUs = nowUs() + 5000;
+      for (const Connection &c : conns)
+      {
+        fds.push_back({c.fd, POLLIN, 0});
+        if (!c.owed.empty())
+        {
+          dueUs = std::min(dueUs, c.owed.front().dueUs);
+        }
+      }
+      const uint64_t waitUs = dueUs > nowUs() ? dueUs - nowUs() : 0;
+      const timespec timeout = {(time_t)(waitUs / 1000000), (long)(waitUs % 1000000) * 1000};
+      ppoll(fds.data(), fds.size(), &timeout, nullptr);
+
+      if (fds[0].revents & POLLIN)
+      {
+        const int fd = accept(_listen, nullptr, nullptr);
+        if (fd >= 0)
+        {
+          int one = 1;
+          setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+          conns.push_back({fd, std::string(), std::deque<Response>()});
+          _connections++;
+        }
+      }
+      for (size_t i = 0; i < conns.size(); i++)
+      {
+        Connection &c = conns[i];
+        bool closed = false;
+        if (i + 1 < fds.size() && fds[i + 1].fd == c.fd && (fds[i + 1].revents & (POLLIN | POLLHUP)))
+        {
+          char buf[4096];
+          const ssize_t r = recv(c.fd, buf, sizeof(buf), 0);
+          closed = r <= 0;
+          if (r > 0)
+          {
+            c.rx.append(buf, r);
+          }
+        }
+        while (!closed && parse(c))
+        {
+          if (_config.dropAfter && !dropped && _requests >= _config.dropAfter)
+          {
+            // Responses still owed are lost with the connection
+            dropped = true;
+            closed = true;
+          }
+        }
+        const uint64_t now = nowUs();
+        while (!closed && !c.owed.empty() && c.owed.front().dueUs <= now)
+        {
+          const bool close = c.owed.front().close || (_config.closeEvery && ++answered % _config.closeEvery == 0);
+          c.owed.pop_front();
+          respond(c.fd, close);
+          closed = close;
+        }
+        if (closed)
+        {
+          close(c.fd);
+          conns.erase(conns.begin() + i--);
+        }
+      }
+    }
+    for (const Connection &c : conns)
+    {
+      close(c.fd);
+    }
+  }
+
+  // One whole request off the front of c.rx, if there is one
+  bool parse(Connection &c)
+  {
+    const size_t end = c.rx.find("\r\n\r\n");
+    if (end == std::string::npos)
+    {
+      return false;
+    }
+    const std::string head = c.rx.substr(0, end);
+    const size_t at = head.find("Content-Length: ");
+    const size_t length = at == std::string::npos ? 0 : strtoul(head.c_str() + at + 16, nullptr, 10);
+    if (c.rx.size() < end + 4 + length)
+    {
+      return false;
+    }
+    const std::string body = c.rx.substr(end + 4, length);
+    c.rx.erase(0, end + 4 + length);
+    _requests++;
+    if ((head + "\r\n").find("\r\nAuthorization: Bearer token\r\n") == std::string::npos)
+    {
+      _errors++;
+    }
+    if (head.compare(0, 32, "POST /devices/bench/batch-data H") == 0)
+    {
+      // {"batch":[<reading>,<reading>,...]}
+      const std::string open = "{\"batch\":[";
+      if (body.compare(0, open.size(), open) != 0 || body.compare(body.size() - 2, 2, "]}") != 0)
+      {
+        _errors++;
+      }
+      size_t from = open.size();
+      while (from < body.size() - 2)
+      {
+        const size_t next = body.find('}', from);
+        reading(body.substr(from, next + 1 - from));
+        from = next + 2;
+      }
+    }
+    else if (head.compare(0, 26, "POST /devices/bench/data H") == 0)
+    {
+      reading(body);
+    }
+    else
+    {
+      _errors++;
+    }
+    c.owed.push_back({nowUs() + _config.delayUs, head.find("Connection: close") != std::string::npos});
+    return true;
+  }
+
+  void reading(const std::string &body)
+  {
+    unsigned n;
+    if (sscanf(body.c_str(), "{\"n\":%u", &n) != 1 || n >= _seen.size() || body != payloadFor(n))
+    {
+      _errors++;
+      return;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    _seen[n] = 1;
+  }
+
+  void respond(int fd, bool close)
+  {
+    const char *connection = close ? "Connection: close\r\n" : "";
+    char out[256];
+    const int n = _config.chunked
+                      ? snprintf(out, sizeof(out),
+                                 "HTTP/1.1 201 Created\r\nContent-Type: application/json\r\n%s"
+                                 "Transfer-Encoding: chunked\r\n\r\n7\r\n{\"succe\r\n9\r\nss\":true}\r\n0\r\n\r\n",
+                                 connection)
+                      : snprintf(out, sizeof(out),
+                                 "HTTP/1.1 201 Created\r\nContent-Type: application/json\r\n%s"
+                                 "Content-Length: 16\r\n\r\n{\"success\":true}",
+                                 connection);
+    send(fd, out, n, MSG_NOSIGNAL);
+  }
+
+  ServerConfig _config;
+  int _listen = -1;
+  uint16_t _port = 0;
+  std::thread _thread;
+  std::atomic<bool> _stop{false};
+  std::mutex _mutex;
+  std::vector<uint8_t> _seen;
+  std::atomic<uint32_t> _requests{0};
+  std::atomic<uint32_t> _errors{0};
+  std::atomic<uint32_t> _connections{0};
+};
+
+struct Run
+{
+  uint32_t readings = 0;
+  uint32_t delivered = 0;
+  uint32_t completed = 0; // reported 201 (every sendData() that returned true, when blocking)
+  uint32_t requests = 0;  // seen by the server
+  uint32_t errors = 0;
+  uint32_t connections = 0;
+  uint32_t outboxDropped = 0;
+  double seconds = 0;
+  uint32_t stallP99Us = 0;
+  uint32_t stallMaxUs = 0;
+  ZiLinkHttpPipeline::Stats stats;
+};
+
+// config == nullptr: the blocking path
+static Run send(const ServerConfig &server, const ZiLinkHttpPipeline::Config *config, uint32_t readings)
+{
+  Run r;
+  r.readings = readings;
+  Server s(server, readings);
+  ZiLinkEsp32 link;
+  char url[64];
+  snprintf(url, sizeof(url), "http://127.0.0.1:%u", s.port());
+  link.setupHttp(url, "bench", "token");
+  uint32_t completed = 0, other = 0;
+  if (config)
+  {
+    check(link.enableHttpPipeline(*config), "pipeline enabled");
+    link.onHttpComplete([&](uint16_t, int status)
+                        { (status == 201 ? completed : other)++; });
+  }
+  std::vector<uint32_t> stalls;
+  stalls.reserve(readings * 2);
+  const uint64_t start = nowUs();
+  const uint64_t deadline = start + 60000000ull;
+  uint32_t next = 0;
+  while ((config ? completed + other : next) < readings && nowUs() < deadline)
+  {
+    const uint64_t t0 = nowUs();
+    if (!config && next < readings)
+    {
+      // One POST per iteration, each on its own connection
+      completed += link.sendData(String(payloadFor(next++).c_str()));
+    }
+    // Readings produced as fast as the pipeline takes them: a few requests' worth queued
+    const uint32_t ahead = config ? 4u * config->depth * (config->batchMax ? config->batchMax : 1) : 0;
+    while (next < readings && next - completed - other < ahead)
+    {
+      link.sendData(String(payloadFor(next++).c_str()));
+    }
+    link.loop();
+    stalls.push_back((uint32_t)(nowUs() - t0));
+    // Like a sketch doing other work between loops; also lets the server thread run on a single core
+    usleep(20);
+  }
+  r.seconds = (nowUs() - start) / 1e6;
+  // Wait for the server to take in the last requests
+  while (s.delivered() < readings && nowUs() < deadline)
+  {
+    link.loop();
+    usleep(100);
+  }
+  std::sort(stalls.begin(), stalls.end());
+  r.stallP99Us = stalls.empty() ? 0 : stalls[stalls.size() * 99 / 100];
+  r.stallMaxUs = stalls.empty() ? 0 : stalls.back();
+  r.completed = completed;
+  r.stats = link.httpPipelineStats();
+  r.outboxDropped = link.queueStats().dropped;
+  r.delivered = s.delivered();
+  r.requests = s.requests();
+  r.errors = s.errors();
+  r.connections = s.connections();
+  return r;
+}
+
+static void report(const char *label, const Run &r)
+{
+  printf("%-30s %9.0f %10.0f %6u %9u %9u\n", label, r.requests / (r.seconds > 0 ? r.seconds : 1),
+         r.delivered / (r.seconds > 0 ? r.seconds : 1), r.connections, r.stallP99Us, r.stallMaxUs);
+  check(r.errors == 0, "server saw only well-formed, intact requests");
+  check(r.outboxDropped == 0, "nothing dropped waiting for the pipeline");
+  check(r.delivered == r.readings, "every reading reached the server");
+  check(r.completed == r.readings, "every reading reported sent");
+}
+
+int main()
+{
+  ZiLinkHost::setMode(ZiLinkHost::Sockets);
+  printf("%-30s %9s %10s %6s %9s %9s\n", "case", "req/s", "readings/s", "conns", "p99 us", "max us");
+
+  for (uint32_t delayUs : {0u, 2000u})
+  {
+    ServerConfig server;
+    server.delayUs = delayUs;
+    const uint32_t readings = delayUs ? 400 : 2000;
+    char label[48];
+
+    snprintf(label, sizeof(label), "blocking, %u ms", delayUs / 1000);
+    const Run blocking = send(server, nullptr, delayUs ? 200 : 1000);
+    report(label, blocking);
+
+    ZiLinkHttpPipeline::Config config;
+    snprintf(label, sizeof(label), "keep-alive depth 1, %u ms", delayUs / 1000);
+    const Run depth1 = send(server, &config, readings);
+    report(label, depth1);
+    check(depth1.connections == 1, "one connection for every request");
+    check(depth1.stats.responseUs.count() == readings, "a response per reading");
+    check(depth1.stallMaxUs < blocking.stallMaxUs, "loop() stalls less than a blocking POST");
+
+    config.depth = 4;
+    snprintf(label, sizeof(label), "pipelined depth 4, %u ms", delayUs / 1000);
+    const Run depth4 = send(server, &config, readings);
+    report(label, depth4);
+    if (delayUs)
+    {
+      // Bounded by depth / delay
+      check(depth4.requests / depth4.seconds > 2.5 * depth1.requests / depth1.seconds,
+            "depth 4 well above one request at a time");
+    }
+
+    config.depth = 1;
+    config.batchMax = 16;
+    snprintf(label, sizeof(label), "batches of 16, %u ms", delayUs / 1000);
+    const Run batch = send(server, &config, readings);
+    report(label, batch);
+    check(batch.stats.batched > readings / 2, "readings sent in batches");
+    check(batch.delivered / batch.seconds > 4 * depth1.delivered / depth1.seconds,
+          "batches carry readings faster than single POSTs");
+  }
+
+  {
+    ServerConfig server;
+    server.closeEvery = 50;
+    server.chunked = true;
+    ZiLinkHttpPipeline::Config config;
+    config.depth = 4;
+    const Run r = send(server, &config, 1000);
+    report("close every 50, chunked", r);
+    check(r.connections >= 1000 / 50, "reconnected after each close");
+  }
+
+  {
+    ServerConfig server;
+    server.delayUs = 1000;
+    server.dropAfter = 300;
+    ZiLinkHttpPipeline::Config config;
+    config.depth = 4;
+    const Run r = send(server, &config, 1000);
+    report("connection dropped", r);
+    check(r.connections == 2 && r.stats.failures == 1, "reconnected once");
+    check(r.stats.requests > r.stats.responses, "requests in flight sent again");
+  }
+
+  return benchResult();
+}
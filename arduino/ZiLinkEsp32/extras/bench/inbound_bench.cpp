@@ -0,0 +1,160 @@
+// Host-side benchmark of the inbound path under a command flood: messages
+// per second and heap allocations per message, before and after parsing in
+// place with ZiLinkInbound. Needs ArduinoJson 6 (header-only):
+//
+//   g++ -O2 -std=c++17 -I../../src -I<ArduinoJson>/src inbound_bench.cpp ../../src/ZiLinkInbound.cpp ../../src/ZiLinkCommandQueue.cpp -o inbound_bench
+//   ./inbound_bench
+//
+// "copy + dynamic doc" is what the WebSocket handler used to do (String copy,
+// DynamicJsonDocument(1024), strcmp chain); "byte-wise + dynamic doc" is the
+// old MQTT callback, which grew a String one char at a time. std::string
+// stands in for Arduino's String. It also checks that two command names with
+// the same hash each reach only their own handler.
+
+#include "ZiLinkCommandQueue.h"
+#include "ZiLinkInbound.h"
+#include "bench_check.h"
+
+#include <malloc.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// Count every allocation, including ArduinoJson's (malloc) and std::string's (operator new)
+static size_t g_allocs = 0;
+static size_t g_allocBytes = 0;
+extern "C" void *__libc_malloc(size_t);
+extern "C" void *malloc(size_t n)
+{
+  g_allocs++;
+  g_allocBytes += n;
+  return __libc_malloc(n);
+}
+
+static volatile size_t g_sink = 0;
+
+static const char *MESSAGES[] = {
+    "{\"type\":\"command\",\"data\":{\"command\":\"led on\"}}",
+    "{\"type\":\"command\",\"data\":{\"command\":{\"type\":\"ui_button\",\"id\":\"shape-17\",\"action\":\"press\","
+    "\"label\":\"Pump\"}},\"timestamp\":\"2026-10-16T10:00:00.000Z\"}",
+    "{\"type\":\"command\",\"data\":{\"command\":{\"type\":\"ui_slider\",\"id\":\"shape-4\",\"action\":\"set_value\","
+    "\"value\":42,\"command\":\"speed 42\"}}}",
+    "{\"type\":\"ack\",\"data\":{\"seq\":1234}}",
+};
+static const size_t MESSAGE_COUNT = sizeof(MESSAGES) / sizeof(MESSAGES[0]);
+
+template <typename Fn>
+static void run(const char *name, Fn fn)
+{
+  const size_t rounds = 200000;
+  const size_t allocs = g_allocs;
+  const size_t allocBytes = g_allocBytes;
+  auto t0 = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < rounds; i++)
+  {
+    fn(MESSAGES[i % MESSAGE_COUNT]);
+  }
+  const double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  printf("%-26s %9.0f msg/s  %5.2f allocs/msg  %6.0f heap bytes/msg\n", name, rounds / s,
+         (double)(g_allocs - allocs) / rounds, (double)(g_allocBytes - allocBytes) / rounds);
+}
+
+static ZiLinkCommandQueue g_commands;
+
+static void drain()
+{
+  while (const ZiLinkCommandQueue::Command *c = g_commands.front())
+  {
+    g_sink += c->length;
+    g_commands.pop();
+  }
+}
+
+static void oldPath(const std::string &message)
+{
+  DynamicJsonDocument doc(1024);
+  deserializeJson(doc, message);
+  const char *msgType = doc["type"];
+  if (msgType && strcmp(msgType, "auth_success") == 0)
+  {
+    g_sink++;
+  }
+  else if (msgType && strcmp(msgType, "ack") == 0)
+  {
+    g_sink += doc["data"]["seq"].as<uint32_t>();
+  }
+  else if (msgType && strcmp(msgType, "error") == 0)
+  {
+    g_sink++;
+  }
+  else if (msgType && strcmp(msgType, "command") == 0)
+  {
+    const char *command = doc["data"]["command"];
+    std::string pending(command ? command : "");
+    g_sink += pending.length();
+  }
+}
+
+// "glbvs" and "yacxa" have the same FNV-1a hash: each must still reach only its own handler
+static void hashCollision()
+{
+  ZiLinkCommandQueue commands;
+  check(ZiLinkCommandQueue::hashOf("glbvs") == ZiLinkCommandQueue::hashOf("yacxa"), "names collide");
+  int first = 0;
+  int second = 0;
+  int unknown = 0;
+  commands.on("glbvs", [&](const ZiLinkCommandQueue::Command &) { first++; });
+  commands.onUnknown([&](const ZiLinkCommandQueue::Command &) { unknown++; });
+  commands.push("yacxa 1", 7, ZiLinkCommandQueue::SourceWebSocket);
+  commands.dispatch();
+  check(first == 0 && unknown == 1, "colliding name does not run another command's handler");
+  commands.on("yacxa", [&](const ZiLinkCommandQueue::Command &) { second++; });
+  commands.push("glbvs", 5, ZiLinkCommandQueue::SourceWebSocket);
+  commands.push("yacxa", 5, ZiLinkCommandQueue::SourceWebSocket);
+  commands.dispatch();
+  check(first == 1 && second == 1, "registering a colliding name keeps the first handler");
+}
+
+int main()
+{
+  hashCollision();
+  run("copy + dynamic doc", [](const char *m)
+      { oldPath(std::string(m)); });
+  run("byte-wise + dynamic doc", [](const char *m)
+      {
+    std::string message;
+    for (size_t i = 0, n = strlen(m); i < n; i++) {
+      message += m[i];
+    }
+    oldPath(message); });
+
+  // The transport's receive buffer, parsed in place
+  static ZiLinkInbound inbound;
+  static char buffer[512];
+  run("in place + static doc", [](const char *m)
+      {
+    const size_t n = strlen(m);
+    memcpy(buffer, m, n + 1);
+    switch (inbound.parse(buffer, n)) {
+      case ZiLinkInbound::Command: {
+        JsonVariantConst command = inbound.command();
+        if (command.is<const char *>()) {
+          const char *text = command.as<const char *>();
+          g_commands.push(text, strlen(text), ZiLinkCommandQueue::SourceWebSocket);
+        } else {
+          char text[ZILINK_COMMAND_MAX_LEN + 2];
+          g_commands.push(text, serializeJson(command, text, sizeof(text)), ZiLinkCommandQueue::SourceWebSocket);
+        }
+        drain();
+        break;
+      }
+      case ZiLinkInbound::Ack:
+        g_sink += inbound.seq();
+        break;
+      default:
+        break;
+    } });
+  return benchResult();
+}
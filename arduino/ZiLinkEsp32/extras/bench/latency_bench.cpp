@@ -0,0 +1,142 @@
+// Host-side check of ZiLinkLatency against simulated links with known
+// delay, jitter, loss and clock skew: how close the RTT / one-way
+// percentiles and the missing/reordered counts come to the truth, and what
+// tracing costs per frame.
+//
+//   g++ -O2 -std=c++17 -I../../src latency_bench.cpp ../../src/ZiLinkLatency.cpp ../../src/ZiLinkStats.cpp -o latency_bench
+//   ./latency_bench
+//
+// Time is simulated, so an hour-long run takes milliseconds. The device
+// sends a traced frame every periodUs; each ack travels back after its
+// uplink + downlink delay and acks are processed in arrival order.
+
+#include "ZiLinkLatency.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <queue>
+#include <random>
+#include <vector>
+
+struct Link
+{
+        const char *name;
+        uint32_t periodUs;
+        uint32_t uplinkUs;     // fixed part
+        uint32_t uplinkJitterUs; // exponential, this mean
+        uint32_t downlinkUs;
+        uint32_t downlinkJitterUs;
+        double lossPercent;
+        int32_t offsetMs; // server clock ahead of the device
+        double driftPpm;  // server clock rate error
+        uint32_t frames;
+};
+
+struct Ack
+{
+        uint64_t arriveUs;
+        uint32_t seq;
+        uint32_t deviceMs;
+        uint32_t serverMs;
+        bool operator>(const Ack &o) const { return arriveUs > o.arriveUs; }
+};
+
+static uint32_t percentile(std::vector<uint32_t> v, uint8_t pct)
+{
+  if (v.empty())
+  {
+    return 0;
+  }
+  std::sort(v.begin(), v.end());
+  const size_t rank = (v.size() * pct + 99) / 100;
+  return v[rank ? rank - 1 : 0];
+}
+
+static void run(const Link &link)
+{
+  std::mt19937 rng(42);
+  std::exponential_distribution<double> up(link.uplinkJitterUs ? 1.0 / link.uplinkJitterUs : 1.0);
+  std::exponential_distribution<double> down(link.downlinkJitterUs ? 1.0 / link.downlinkJitterUs : 1.0);
+  std::uniform_real_distribution<double> coin(0, 100);
+
+  ZiLinkLatency latency;
+  latency.setEnabled(true);
+  std::priority_queue<Ack, std::vector<Ack>, std::greater<Ack>> inFlight;
+  std::vector<uint32_t> trueRtt, trueUp, trueDown;
+  uint32_t lost = 0;
+  uint32_t reordered = 0;
+  uint32_t highestArrived = 0;
+
+  auto deliver = [&](uint64_t untilUs)
+  {
+    while (!inFlight.empty() && inFlight.top().arriveUs <= untilUs)
+    {
+      const Ack a = inFlight.top();
+      inFlight.pop();
+      if (a.seq < highestArrived)
+      {
+        reordered++;
+      }
+      highestArrived = std::max(highestArrived, a.seq);
+      latency.acked(a.seq, a.deviceMs, a.serverMs, (uint32_t)(a.arriveUs / 1000), (uint32_t)a.arriveUs);
+    }
+  };
+
+  uint64_t t = 0;
+  for (uint32_t i = 0; i < link.frames; i++, t += link.periodUs)
+  {
+    deliver(t);
+    const ZiLinkLatency::Trace trace = latency.start((uint32_t)(t / 1000), (uint32_t)t);
+    latency.finish(trace, true);
+    const uint32_t upUs = link.uplinkUs + (link.uplinkJitterUs ? (uint32_t)up(rng) : 0);
+    const uint32_t downUs = link.downlinkUs + (link.downlinkJitterUs ? (uint32_t)down(rng) : 0);
+    if (coin(rng) < link.lossPercent)
+    {
+      lost++;
+      continue;
+    }
+    const uint64_t atServerUs = t + upUs;
+    const double serverUs = atServerUs * (1 + link.driftPpm * 1e-6) + link.offsetMs * 1000.0;
+    inFlight.push({atServerUs + downUs, trace.seq, trace.deviceMs, (uint32_t)(uint64_t)(serverUs / 1000)});
+    trueRtt.push_back(upUs + downUs);
+    trueUp.push_back(upUs / 1000);
+    trueDown.push_back(downUs / 1000);
+  }
+  deliver(UINT64_MAX);
+
+  const ZiLinkLatency::Stats &s = latency.stats();
+  printf("%s\n", link.name);
+  printf("  rtt us     p50 %7u (true %7u)  p99 %7u (true %7u)\n", latency.rttUs().percentile(50), percentile(trueRtt, 50),
+         latency.rttUs().percentile(99), percentile(trueRtt, 99));
+  printf("  uplink ms  p50 %7u (true %7u)  p99 %7u (true %7u)\n", latency.uplinkMs().percentile(50), percentile(trueUp, 50),
+         latency.uplinkMs().percentile(99), percentile(trueUp, 99));
+  printf("  downlink ms p50 %6u (true %7u)  p99 %7u (true %7u)\n", latency.downlinkMs().percentile(50),
+         percentile(trueDown, 50), latency.downlinkMs().percentile(99), percentile(trueDown, 99));
+  printf("  acked %u/%u  missing %u (lost %u)  reordered %u (true %u)  duplicates %u  stale %u\n", s.acked, s.traced,
+         s.missing, lost, s.reordered, reordered, s.duplicates, s.stale);
+}
+
+int main()
+{
+  //            name                               period  up     upJit   down   dnJit  loss  offset     drift  frames
+  run({"LAN, 1 ms, no loss", 100000, 500, 50, 500, 50, 0, 123456, 0, 36000});
+  run({"tunnel, 40 ms, 1% loss", 100000, 20000, 5000, 20000, 5000, 1, -5000, 0, 36000});
+  run({"congested uplink (bufferbloat)", 20000, 10000, 80000, 10000, 1000, 0.5, 777, 0, 180000});
+  run({"clock drift 50 ppm over 1 h", 100000, 15000, 2000, 15000, 2000, 0, 0, 50, 36000});
+
+  // Cost of tracing one frame: start + finish + acked
+  ZiLinkLatency latency;
+  latency.setEnabled(true);
+  const uint32_t n = 10000000;
+  auto t0 = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < n; i++)
+  {
+    const ZiLinkLatency::Trace trace = latency.start(i / 10, i * 100);
+    latency.finish(trace, true);
+    latency.acked(trace.seq, trace.deviceMs, trace.deviceMs + 7, i / 10 + 3, i * 100 + 3000);
+  }
+  const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+  printf("\nper traced frame: %.1f ns, %zu bytes of state\n", ns / n, sizeof(ZiLinkLatency));
+  return 0;
+}
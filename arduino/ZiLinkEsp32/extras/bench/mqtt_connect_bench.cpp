@@ -0,0 +1,285 @@
+// Host check of the MQTT reconnect path: ZiLinkEsp32 (Sockets mode, the
+// PubSubClient stand-in) against a local broker stand-in that
+//
+//   1. refuses every CONNECT (CONNACK return code 5, not authorized)
+//   2. stalls: accepts the connection and never sends CONNACK
+//   3. is down: the port is closed
+//   4. comes up after 1 s
+//   5. is up, and given by name ("localhost"), so the address comes from
+//      the background lookup
+//
+// For each it records the state changes (onMqttStateChange) and how long
+// every loop() call takes. Exits non-zero unless the attempts follow the
+// backoff set with setMqttBackoff() (a delay in [d/2, d], d doubling up to
+// the maximum), a stalled handshake gives up after
+// ZILINK_MQTT_HANDSHAKE_TIMEOUT_S, loop() never blocks (the CONNACK wait
+// and the lookup are polled) and the device connects once the broker is
+// up. Needs ArduinoJson:
+//
+//   g++ -O2 -std=gnu++17 -pthread -I../host -I../../src -I<ArduinoJson>/src mqtt_connect_bench.cpp ../host/*.cpp ../../src/*.cpp
+//   ./mqtt_connect_bench
+
+#include <ZiLinkHost.h>
+#include <ZiLinkEsp32.h>
+#include "bench_check.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+static const uint32_t BACKOFF_INITIAL_MS = 100;
+static const uint32_t BACKOFF_MAX_MS = 800;
+static const uint32_t HANDSHAKE_MS = ZILINK_MQTT_HANDSHAKE_TIMEOUT_S * 1000u;
+
+static uint64_t nowUs()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+enum Behaviour
+{
+  Refuse,
+  Stall,
+  Down,
+  UpLater,
+  Up
+};
+
+// One connection at a time. The port is bound up front; UpLater only
+// listens after 1 s and Down never does, so their connects are refused.
+class Broker
+{
+public:
+  explicit Broker(Behaviour behaviour) : _behaviour(behaviour)
+  {
+    _listen = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(_listen, (sockaddr *)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(_listen, (sockaddr *)&addr, &len);
+    _port = ntohs(addr.sin_port);
+    if (behaviour == Refuse || behaviour == Stall || behaviour == Up)
+    {
+      listen(_listen, 4);
+    }
+    if (behaviour != Down)
+    {
+      _thread = std::thread([this]
+                            { run(); });
+    }
+  }
+
+  ~Broker()
+  {
+    _stop = true;
+    if (_thread.joinable())
+    {
+      _thread.join();
+    }
+    close(_listen);
+  }
+
+  uint16_t port() const { return _port; }
+
+private:
+  void run()
+  {
+    if (_behaviour == UpLater)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+      listen(_listen, 4);
+    }
+    while (!_stop)
+    {
+      pollfd p = {_listen, POLLIN, 0};
+      if (poll(&p, 1, 20) != 1)
+      {
+        continue;
+      }
+      const int fd = accept(_listen, nullptr, nullptr);
+      if (fd < 0)
+      {
+        continue;
+      }
+      serve(fd);
+      close(fd);
+    }
+  }
+
+  // Answers CONNECT as configured, then holds the connection until the client closes it
+  void serve(int fd)
+  {
+    char buf[512];
+    if (!receive(fd, buf, sizeof(buf)))
+    {
+      return;
+    }
+    if (_behaviour != Stall)
+    {
+      const uint8_t connack[] = {0x20, 0x02, 0x00, (uint8_t)(_behaviour == Refuse ? 0x05 : 0x00)};
+      send(fd, connack, sizeof(connack), MSG_NOSIGNAL);
+    }
+    while (!_stop && receive(fd, buf, sizeof(buf)))
+    {
+    }
+  }
+
+  bool receive(int fd, char *buf, size_t size)
+  {
+    for (;;)
+    {
+      pollfd p = {fd, POLLIN, 0};
+      const int ready = poll(&p, 1, 20);
+      if (_stop)
+      {
+        return false;
+      }
+      if (ready == 1)
+      {
+        return recv(fd, buf, size, 0) > 0;
+      }
+    }
+  }
+
+  Behaviour _behaviour;
+  int _listen = -1;
+  uint16_t _port = 0;
+  std::atomic<bool> _stop{false};
+  std::thread _thread;
+};
+
+struct Run
+{
+  std::vector<uint64_t> attemptsUs; // each entry into MqttConnecting
+  std::vector<uint64_t> failuresUs; // each return to MqttBackoff
+  uint64_t connectedUs = 0;
+  uint64_t startUs = 0;
+  uint32_t loops = 0;
+  double worstLoopUs = 0;
+  double totalLoopUs = 0;
+  uint32_t connects = 0;
+};
+
+// By address unless `host` is given: no resolver in the measurement
+static Run drive(Behaviour behaviour, uint32_t runMs, const char *host = "127.0.0.1")
+{
+  Run r;
+  Broker broker(behaviour);
+  ZiLinkEsp32 link;
+  link.onMqttStateChange([&](ZiLinkEsp32::MqttState state)
+                         {
+    const uint64_t at = nowUs();
+    if (state == ZiLinkEsp32::MqttConnecting) {
+      r.attemptsUs.push_back(at);
+    } else if (state == ZiLinkEsp32::MqttBackoff && !r.attemptsUs.empty()) {
+      r.failuresUs.push_back(at);
+    } else if (state == ZiLinkEsp32::MqttConnected) {
+      r.connectedUs = at;
+    } });
+  link.setMqttBackoff(BACKOFF_INITIAL_MS, BACKOFF_MAX_MS);
+  r.startUs = nowUs();
+  link.setupMqtt(host, broker.port(), "bench", "token");
+  const uint64_t deadline = r.startUs + runMs * 1000ull;
+  while (nowUs() < deadline && !r.connectedUs)
+  {
+    const uint64_t t0 = nowUs();
+    link.loop();
+    const double us = (double)(nowUs() - t0);
+    r.worstLoopUs = std::max(r.worstLoopUs, us);
+    r.totalLoopUs += us;
+    r.loops++;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1)); // rest of the sketch
+  }
+  r.connects = link.getStats().mqtt.connects;
+  return r;
+}
+
+// The delay before attempt n + 1 after n failures, as ZiLinkBackoff draws it: [d/2, d]
+static uint32_t backoffCeiling(size_t failures)
+{
+  uint32_t d = BACKOFF_INITIAL_MS;
+  for (size_t i = 1; i < failures && d < BACKOFF_MAX_MS; i++)
+  {
+    d = d > BACKOFF_MAX_MS / 2 ? BACKOFF_MAX_MS : d * 2;
+  }
+  return d;
+}
+
+// Every retry waited out its backoff delay and no more than a loop() or two past it
+static bool followsBackoff(const Run &r, const char *name)
+{
+  bool ok = r.failuresUs.size() >= r.attemptsUs.size() - 1;
+  printf("%-28s waits (ms):", name);
+  for (size_t i = 1; i < r.attemptsUs.size() && ok; i++)
+  {
+    const double waitMs = (r.attemptsUs[i] - r.failuresUs[i - 1]) / 1000.0;
+    const uint32_t d = backoffCeiling(i);
+    printf(" %.0f [%u-%u]", waitMs, d / 2, d);
+    ok &= waitMs >= d / 2 - 1 && waitMs <= d + 20;
+  }
+  printf("\n");
+  return ok;
+}
+
+static void report(const char *name, const Run &r)
+{
+  printf("%-28s attempts %3zu  connected %-3s  loop avg %7.1f us  max %9.1f us\n", name, r.attemptsUs.size(),
+         r.connectedUs ? "yes" : "no", r.totalLoopUs / r.loops, r.worstLoopUs);
+}
+
+int main()
+{
+  ZiLinkHost::setMode(ZiLinkHost::Sockets);
+
+  const Run refused = drive(Refuse, 4000);
+  report("broker refuses CONNECT", refused);
+  // 100 + 200 + 400 + 800 + 800 ms at most: at least five retries in 4 s
+  check(refused.attemptsUs.size() >= 6 && !refused.connectedUs, "refused: retried until the run ended");
+  check(followsBackoff(refused, "broker refuses CONNECT"), "refused: retries follow the backoff");
+  check(refused.worstLoopUs < 50000, "refused: loop() does not block");
+
+  const Run stalled = drive(Stall, 2 * HANDSHAKE_MS + 1000);
+  report("broker never sends CONNACK", stalled);
+  check(stalled.attemptsUs.size() >= 2 && !stalled.connectedUs, "stalled: retried after the CONNACK wait");
+  check(followsBackoff(stalled, "broker never sends CONNACK"), "stalled: retries follow the backoff");
+  bool waited = stalled.failuresUs.size() == stalled.attemptsUs.size() ||
+                stalled.failuresUs.size() + 1 == stalled.attemptsUs.size();
+  for (size_t i = 0; i < stalled.failuresUs.size() && i < stalled.attemptsUs.size(); i++)
+  {
+    const double ms = (stalled.failuresUs[i] - stalled.attemptsUs[i]) / 1000.0;
+    waited &= ms >= HANDSHAKE_MS - 10 && ms <= HANDSHAKE_MS + 200;
+  }
+  check(waited, "stalled: each attempt gives up after ZILINK_MQTT_HANDSHAKE_TIMEOUT_S");
+  check(stalled.loops > HANDSHAKE_MS / 2 && stalled.worstLoopUs < 50000,
+        "stalled: loop() keeps running while waiting for CONNACK");
+
+  const Run down = drive(Down, 2000);
+  report("broker down (closed port)", down);
+  check(!down.connectedUs && down.loops > 500, "down: loop() keeps running");
+  check(down.worstLoopUs < 20000, "down: loop() does not block");
+
+  const Run later = drive(UpLater, 4000);
+  report("broker up after 1 s", later);
+  const double upMs = later.connectedUs ? (later.connectedUs - later.startUs) / 1000.0 : 0;
+  check(later.connectedUs && upMs >= 1000 && upMs <= 1000 + BACKOFF_MAX_MS + 50,
+        "up later: connected by the next attempt after the broker came up");
+  check(later.connects == 1, "up later: one connect counted");
+
+  const Run named = drive(Up, 2000, "localhost");
+  report("broker by name (localhost)", named);
+  check(named.connectedUs && named.connects == 1, "by name: connected through the background lookup");
+  check(named.worstLoopUs < 50000, "by name: loop() does not block");
+  return benchResult();
+}
@@ -0,0 +1,469 @@
+// MQTT publishing over a real local socket: ZiLinkEsp32 and the host
+// PubSubClient (Sockets mode) against a minimal broker on 127.0.0.1. The
+// broker speaks enough MQTT 3.1.1 for the job (CONNACK, SUBACK, PINGRESP,
+// PUBACK after a configurable delay) and can drop PUBACKs or the whole
+// connection. It checks and records every message it receives.
+//
+//   1. QoS 1 throughput by window size with 0 and 5 ms until the PUBACK
+//   2. 5% of the PUBACKs lost: every message retransmitted until acked
+//   3. Connection dropped mid-run: the in-flight window resent after
+//      reconnecting
+//   4. QoS 0 payloads from 200 bytes to 256 KB: larger than PubSubClient's
+//      256-byte buffer, they are streamed
+//
+// Exits non-zero unless every message reached the broker intact (at least
+// once) and every QoS 1 delivery was reported acknowledged. Needs
+// ArduinoJson:
+//
+//   g++ -O2 -std=gnu++17 -pthread -I../host -I../../src -I<ArduinoJson>/src mqtt_publish_bench.cpp ../host/*.cpp ../../src/*.cpp
+
+#include <ZiLinkHost.h>
+#include <ZiLinkEsp32.h>
+#include "bench_check.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+static uint64_t nowUs()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// {"n":<n>} or, given a size, {"n":<n>,"v":"..."} padded to exactly that
+// many bytes with filler the broker can regenerate
+static std::string payloadFor(uint32_t n, size_t size = 0)
+{
+  char head[32];
+  snprintf(head, sizeof(head), size ? "{\"n\":%u,\"v\":\"" : "{\"n\":%u}", n);
+  std::string s = head;
+  if (!size)
+  {
+    return s;
+  }
+  while (s.size() + 2 < size)
+  {
+    s += (char)('a' + (s.size() * 7 + n) % 26);
+  }
+  return s + "\"}";
+}
+
+struct BrokerConfig
+{
+  uint32_t ackDelayUs = 0;
+  uint8_t lossPercent = 0;
+  uint32_t dropAfter = 0; // close the connection after this many PUBLISHes (once); 0: never
+};
+
+class Broker
+{
+public:
+  Broker(const BrokerConfig &config, uint32_t messages) : _config(config), _seen(messages, 0)
+  {
+    _listen = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(_listen, (sockaddr *)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(_listen, (sockaddr *)&addr, &len);
+    _port = ntohs(addr.sin_port);
+    listen(_listen, 4);
+    fcntl(_listen, F_SETFL, O_NONBLOCK);
+    _thread = std::thread([this]
+                          { run(); });
+  }
+
+  ~Broker()
+  {
+    _stop = true;
+    _thread.join();
+    close(_listen);
+  }
+
+  uint16_t port() const { return _port; }
+
+  // Messages seen at least once
+  uint32_t delivered()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint32_t n = 0;
+    for (uint8_t s : _seen)
+    {
+      n += s != 0;
+    }
+    return n;
+  }
+  uint32_t duplicates() const { return _duplicates; }
+  uint32_t dupFlags() const { return _dupFlags; }
+  uint32_t errors() const { return _errors; }
+  uint32_t connections() const { return _connections; }
+  uint64_t bytes() const { return _bytes; }
+
+private:
+  struct Ack
+  {
+    uint64_t dueUs;
+    uint16_t id;
+  };
+
+  void run()
+  {
+    std::mt19937 rng(19);
+    int fd = -1;
+    std::vector<uint8_t> rx;
+    std::deque<Ack> acks;
+    uint32_t publishes = 0;
+    bool dropped = false;
+    while (!_stop)
+    {
+      if (fd < 0)
+      {
+        fd = accept(_listen, nullptr, nullptr);
+        if (fd < 0)
+        {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+          continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        rx.clear();
+        acks.clear();
+        _connections++;
+      }
+      // Sleep until data or the next PUBACK is due (busy waiting starves the device on one core)
+      pollfd p = {fd, POLLIN, 0};
+      const uint64_t dueUs = acks.empty() ? nowUs() + 5000 : acks.front().dueUs;
+      const uint64_t waitUs = dueUs > nowUs() ? dueUs - nowUs() : 0;
+      const timespec timeout = {(time_t)(waitUs / 1000000), (long)(waitUs % 1000000) * 1000};
+      ppoll(&p, 1, &timeout, nullptr);
+      uint8_t buf[4096];
+      const ssize_t r = (p.revents & (POLLIN | POLLHUP)) ? recv(fd, buf, sizeof(buf), 0) : -1;
+      if (r == 0)
+      {
+        close(fd);
+        fd = -1;
+        continue;
+      }
+      if (r > 0)
+      {
+        rx.insert(rx.end(), buf, buf + r);
+      }
+      // Whole packets
+      for (;;)
+      {
+        size_t length = 0, at = 1, multiplier = 1;
+        bool complete = false;
+        while (at < rx.size() && at <= 4)
+        {
+          length += (rx[at] & 0x7F) * multiplier;
+          multiplier *= 128;
+          if (!(rx[at++] & 0x80))
+          {
+            complete = true;
+            break;
+          }
+        }
+        if (!complete || rx.size() < at + length)
+        {
+          break;
+        }
+        const uint8_t type = rx[0];
+        const std::vector<uint8_t> body(rx.begin() + at, rx.begin() + at + length);
+        rx.erase(rx.begin(), rx.begin() + at + length);
+        if ((type & 0xF0) == 0x10)
+        {
+          const uint8_t connack[] = {0x20, 0x02, 0x00, 0x00};
+          send(fd, connack, sizeof(connack), 0);
+        }
+        else if ((type & 0xF0) == 0x80)
+        {
+          const uint8_t suback[] = {0x90, 0x03, body[0], body[1], 0x00};
+          send(fd, suback, sizeof(suback), 0);
+        }
+        else if (type == 0xC0)
+        {
+          const uint8_t pingresp[] = {0xD0, 0x00};
+          send(fd, pingresp, sizeof(pingresp), 0);
+        }
+        else if ((type & 0xF0) == 0x30)
+        {
+          publish(type, body, acks, rng);
+          publishes++;
+        }
+      }
+      if (fd >= 0 && _config.dropAfter && !dropped && publishes >= _config.dropAfter)
+      {
+        // Acks still owed are lost with the connection
+        dropped = true;
+        close(fd);
+        fd = -1;
+        continue;
+      }
+      const uint64_t now = nowUs();
+      while (!acks.empty() && acks.front().dueUs <= now)
+      {
+        const uint8_t puback[] = {0x40, 0x02, (uint8_t)(acks.front().id >> 8), (uint8_t)acks.front().id};
+        send(fd, puback, sizeof(puback), MSG_NOSIGNAL);
+        acks.pop_front();
+      }
+    }
+    if (fd >= 0)
+    {
+      close(fd);
+    }
+  }
+
+  void publish(uint8_t type, const std::vector<uint8_t> &body, std::deque<Ack> &acks, std::mt19937 &rng)
+  {
+    const uint8_t qos = (type >> 1) & 3;
+    const size_t topicLength = body.size() >= 2 ? (body[0] << 8 | body[1]) : 0;
+    const size_t at = 2 + topicLength + (qos ? 2 : 0);
+    if (qos > 1 || body.size() < at)
+    {
+      _errors++;
+      return;
+    }
+    const uint16_t id = qos ? body[2 + topicLength] << 8 | body[3 + topicLength] : 0;
+    const std::string payload(body.begin() + at, body.end());
+    unsigned n;
+    if ((qos && id == 0) || sscanf(payload.c_str(), "{\"n\":%u", &n) != 1 || n >= _seen.size())
+    {
+      _errors++;
+      return;
+    }
+    const size_t size = payload.size() == payloadFor(n).size() ? 0 : payload.size();
+    if (payload != payloadFor(n, size))
+    {
+      _errors++;
+      return;
+    }
+    _bytes += payload.size();
+    if (!qos)
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _seen[n] = 1;
+      return;
+    }
+    _dupFlags += (type & 0x08) != 0;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _duplicates += _seen[n] != 0;
+      _seen[n] = 1;
+    }
+    if (rng() % 100 >= _config.lossPercent)
+    {
+      acks.push_back({nowUs() + _config.ackDelayUs, id});
+    }
+  }
+
+  BrokerConfig _config;
+  int _listen = -1;
+  uint16_t _port = 0;
+  std::thread _thread;
+  std::atomic<bool> _stop{false};
+  std::mutex _mutex;
+  std::vector<uint8_t> _seen;
+  std::atomic<uint32_t> _duplicates{0};
+  std::atomic<uint32_t> _dupFlags{0};
+  std::atomic<uint32_t> _errors{0};
+  std::atomic<uint32_t> _connections{0};
+  std::atomic<uint64_t> _bytes{0};
+};
+
+struct Run
+{
+  uint32_t messages = 0;
+  uint32_t delivered = 0;
+  uint32_t acked = 0;
+  uint32_t gaveUp = 0;
+  uint32_t duplicates = 0;
+  uint32_t dupFlags = 0;
+  uint32_t errors = 0;
+  uint32_t connections = 0;
+  uint32_t outboxDropped = 0;
+  double seconds = 0;
+  ZiLinkMqttQos1::Stats stats;
+};
+
+static bool connect(ZiLinkEsp32 &link)
+{
+  for (int i = 0; i < 2000 && link.mqttState() != ZiLinkEsp32::MqttConnected; i++)
+  {
+    link.loop();
+    usleep(1000);
+  }
+  return link.mqttState() == ZiLinkEsp32::MqttConnected;
+}
+
+static Run publish(const BrokerConfig &broker, const ZiLinkMqttQos1::Config &config, uint32_t messages)
+{
+  Run r;
+  r.messages = messages;
+  Broker b(broker, messages);
+  ZiLinkEsp32 link;
+  link.setMqttBackoff(20, 100);
+  link.setupMqtt("127.0.0.1", b.port(), "bench", "token");
+  link.enableMqttQos1(config);
+  uint32_t acked = 0, gaveUp = 0;
+  link.onMqttDelivery([&](uint16_t, ZiLinkMqttQos1::Outcome outcome)
+                      { (outcome == ZiLinkMqttQos1::Acked ? acked : gaveUp)++; });
+  check(connect(link), "connected");
+  const uint64_t start = nowUs();
+  const uint64_t deadline = start + 60000000ull;
+  uint32_t next = 0;
+  while (acked + gaveUp < messages && nowUs() < deadline)
+  {
+    // A few windows' worth stored; what the store turns away waits in the outbox, kept short so it drops nothing
+    const ZiLinkMqttQos1::Stats &s = link.mqttQos1Stats();
+    while (next < messages && s.queued - acked - gaveUp < 4u * config.window && next - s.queued < 16)
+    {
+      link.publishMqttData(payloadFor(next++).c_str());
+    }
+    link.loop();
+    // Like a sketch doing other work between loops; also lets the broker thread run on a single core
+    usleep(20);
+  }
+  r.seconds = (nowUs() - start) / 1e6;
+  r.acked = acked;
+  r.gaveUp = gaveUp;
+  r.stats = link.mqttQos1Stats();
+  r.outboxDropped = link.queueStats().dropped;
+  r.delivered = b.delivered();
+  r.duplicates = b.duplicates();
+  r.dupFlags = b.dupFlags();
+  r.errors = b.errors();
+  r.connections = b.connections();
+  return r;
+}
+
+// QoS 0, one payload size after the other; publishes that do not fit the
+// client's buffer take the streaming path
+static void large()
+{
+  const size_t sizes[] = {200, 1024, 16384, 262144};
+  const uint32_t each = 20;
+  Broker b(BrokerConfig(), each * 4);
+  ZiLinkEsp32 link;
+  link.setupMqtt("127.0.0.1", b.port(), "bench", "token");
+  check(connect(link), "connected");
+  printf("\n%-28s %9s %8s %8s %9s\n", "QoS 0 payload", "msgs/s", "sent", "received", "MB/s");
+  uint32_t n = 0;
+  for (size_t size : sizes)
+  {
+    std::vector<String> payloads;
+    for (uint32_t i = 0; i < each; i++)
+    {
+      payloads.push_back(String(payloadFor(n + i, size).c_str()));
+    }
+    const uint32_t first = b.delivered();
+    const uint64_t bytes = b.bytes();
+    const uint64_t start = nowUs();
+    uint32_t sent = 0;
+    for (const String &p : payloads)
+    {
+      sent += link.publishMqttData(p);
+      link.loop();
+    }
+    n += each;
+    while (b.delivered() < n && nowUs() - start < 5000000)
+    {
+      link.loop();
+      usleep(100);
+    }
+    const double seconds = (nowUs() - start) / 1e6;
+    char label[48];
+    snprintf(label, sizeof(label), "%zu bytes%s", size, size + 40 > MQTT_MAX_PACKET_SIZE ? " (streamed)" : "");
+    printf("%-28s %9.0f %8u %8u %9.1f\n", label, each / seconds, sent, b.delivered() - first,
+           (b.bytes() - bytes) / seconds / 1e6);
+    check(sent == each, "every publish reported sent");
+    check(b.delivered() - first == each, "every payload received");
+  }
+  check(b.errors() == 0, "payloads received intact");
+}
+
+static void report(const char *label, const Run &r)
+{
+  printf("%-28s %9.0f %8u %8u %8u %8u %9u %9u\n", label, r.acked / (r.seconds > 0 ? r.seconds : 1), r.delivered,
+         r.acked, r.stats.retransmits, r.duplicates, r.stats.ackUs.percentile(50), r.stats.ackUs.percentile(99));
+  check(r.errors == 0, "broker saw only well-formed, intact QoS 1 publishes");
+  check(r.outboxDropped == 0, "nothing dropped waiting for the store");
+  check(r.delivered == r.messages, "every message reached the broker");
+  check(r.acked == r.messages && r.gaveUp == 0, "every message acknowledged");
+}
+
+int main()
+{
+  ZiLinkHost::setMode(ZiLinkHost::Sockets);
+  printf("%-28s %9s %8s %8s %8s %8s %9s %9s\n", "case", "msgs/s", "received", "acked", "resent", "dups",
+         "ack p50us", "ack p99us");
+
+  const uint8_t windows[] = {1, 2, 4, 8, 16};
+  for (uint32_t delayUs : {0u, 5000u})
+  {
+    double first = 0;
+    for (uint8_t window : windows)
+    {
+      BrokerConfig broker;
+      broker.ackDelayUs = delayUs;
+      ZiLinkMqttQos1::Config config;
+      config.window = window;
+      const Run r = publish(broker, config, delayUs ? 200u * window : 5000u);
+      char label[48];
+      snprintf(label, sizeof(label), "window %2u, %u ms to PUBACK", window, delayUs / 1000);
+      report(label, r);
+      check(r.stats.inflightHigh <= window, "window respected");
+      const double rate = r.acked / r.seconds;
+      first = first ? first : rate;
+      if (delayUs && window == 8)
+      {
+        // Bounded by the window: roughly window / delay
+        check(rate > 4 * first, "window of 8 well above stop-and-wait");
+      }
+    }
+  }
+
+  {
+    BrokerConfig broker;
+    broker.ackDelayUs = 1000;
+    broker.lossPercent = 5;
+    ZiLinkMqttQos1::Config config;
+    config.retryMs = 50;
+    const Run r = publish(broker, config, 2000);
+    report("5% PUBACKs lost", r);
+    check(r.stats.retransmits > 0 && r.dupFlags == r.stats.retransmits, "lost acks retransmitted with DUP");
+  }
+
+  {
+    BrokerConfig broker;
+    broker.ackDelayUs = 2000;
+    broker.dropAfter = 700;
+    ZiLinkMqttQos1::Config config;
+    const Run r = publish(broker, config, 2000);
+    report("connection dropped", r);
+    check(r.connections == 2, "reconnected once");
+    check(r.stats.retransmits > 0, "in-flight window resent after reconnect");
+  }
+
+  large();
+
+  return benchResult();
+}
@@ -0,0 +1,174 @@
+// Host-side benchmark: JSON text frames vs MessagePack binary frames.
+//
+//   g++ -O2 -std=c++17 -I../../src msgpack_bench.cpp ../../src/ZiLinkMsgPack.cpp ../../src/ZiLinkFrameWriter.cpp -o msgpack_bench
+//   ./msgpack_bench
+//
+// Reports bytes on the wire and encode/decode time per frame for a block of
+// float samples (the case binary mode is for) and for a typical mixed reading,
+// and checks that transcoded numbers keep their value.
+
+#include "ZiLinkMsgPack.h"
+#include "bench_check.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static volatile size_t g_sink = 0;
+
+template <typename Fn>
+static void run(const char *name, size_t bytes, Fn fn)
+{
+  const int iterations = 200000;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++)
+  {
+    fn(i);
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  printf("%-30s %6zu bytes %9.1f ns/frame\n", name, bytes, (double)elapsed / iterations);
+}
+
+// A JSON number transcoded on its own: the MessagePack tag it got and the value read back
+static void transcodeNumber(const char *text, uint8_t expectTag, double expect)
+{
+  ZiLinkFrame<> frame;
+  ZiLinkMsgPack mp(frame);
+  char what[96];
+  snprintf(what, sizeof(what), "%s transcoded as 0x%02x", text, expectTag);
+  check(mp.json(text, strlen(text)) && (uint8_t)frame.c_str()[0] == expectTag, what);
+  ZiLinkMsgPackReader in((const uint8_t *)frame.c_str(), frame.length());
+  double v = 0;
+  snprintf(what, sizeof(what), "%s reads back unchanged", text);
+  check(in.readFloat(v) && v == expect, what);
+}
+
+static void precision()
+{
+  transcodeNumber("23.45", 0xca, (double)23.45f);
+  transcodeNumber("0.5", 0xca, 0.5);
+  transcodeNumber("37.7749295", 0xcb, 37.7749295);
+  transcodeNumber("1700000000.25", 0xcb, 1700000000.25);
+  transcodeNumber("1e-9", 0xca, (double)1e-9f);
+  transcodeNumber("1700000000123", 0xcf, 1700000000123.0);
+  transcodeNumber("-9223372036854775808", 0xd3, -9223372036854775808.0);
+
+  // Past int64: the reader has no uint64, so check the bytes
+  const char *big = "12345678901234567890";
+  ZiLinkFrame<> frame;
+  ZiLinkMsgPack mp(frame);
+  mp.json(big, strlen(big));
+  uint64_t v = 0;
+  for (size_t i = 1; i < frame.length(); i++)
+  {
+    v = v << 8 | (uint8_t)frame.c_str()[i];
+  }
+  check(frame.length() == 9 && (uint8_t)frame.c_str()[0] == 0xcf && v == 12345678901234567890ULL,
+        "12345678901234567890 transcoded as uint64");
+}
+
+static const size_t SAMPLES = 64;
+
+static void jsonSamples(ZiLinkFrameWriter &frame, const float *values)
+{
+  frame.reset();
+  frame.raw("{\"type\":\"device_data\",\"data\":{\"sensorData\":{\"vibration\":[");
+  for (size_t i = 0; i < SAMPLES; i++)
+  {
+    if (i)
+    {
+      frame.raw(',');
+    }
+    frame.number(values[i], 3);
+  }
+  frame.raw("]}}}");
+}
+
+static void binarySamples(ZiLinkFrameWriter &frame, const float *values)
+{
+  frame.reset();
+  ZiLinkMsgPack mp(frame);
+  mp.array(2).uinteger(ZILINK_KIND_DEVICE_DATA).map(1).str("vibration").floatArray(values, SAMPLES);
+}
+
+// What the server does with a JSON sample block: parse every number
+static size_t parseJsonSamples(const char *text, float *out)
+{
+  const char *p = strchr(text, '[');
+  size_t n = 0;
+  while (p && *p != ']' && n < SAMPLES)
+  {
+    char *end;
+    out[n++] = strtof(p + 1, &end);
+    p = end;
+  }
+  return n;
+}
+
+static size_t parseBinarySamples(const uint8_t *data, size_t length, float *out)
+{
+  ZiLinkMsgPackReader in(data, length);
+  uint32_t items;
+  int64_t kind;
+  const char *name;
+  uint32_t nameLen;
+  if (!in.readArray(items) || !in.readInt(kind) || !in.readMap(items) || !in.readStr(name, nameLen))
+  {
+    return 0;
+  }
+  // ext8 header: tag, length, type
+  const uint8_t *body = data + (length - in.remaining()) + 3;
+  const size_t n = data[length - in.remaining() + 1] / 4;
+  memcpy(out, body, n * 4); // little-endian host
+  return n;
+}
+
+int main()
+{
+  float values[SAMPLES];
+  for (size_t i = 0; i < SAMPLES; i++)
+  {
+    values[i] = (float)(sin(i * 0.2) * 9.81);
+  }
+  ZiLinkFrame<2048> json;
+  ZiLinkFrame<2048> binary;
+  jsonSamples(json, values);
+  binarySamples(binary, values);
+
+  float parsed[SAMPLES];
+  run("64 samples encode (JSON)", json.length(), [&](int) { jsonSamples(json, values); g_sink += json.length(); });
+  run("64 samples encode (MsgPack)", binary.length(), [&](int) { binarySamples(binary, values); g_sink += binary.length(); });
+  run("64 samples decode (JSON)", json.length(), [&](int) { g_sink += parseJsonSamples(json.c_str(), parsed); });
+  run("64 samples decode (MsgPack)", binary.length(), [&](int)
+      { g_sink += parseBinarySamples((const uint8_t *)binary.c_str(), binary.length(), parsed); });
+
+  // Mixed reading: the device transcodes the user's JSON string
+  const char *reading = "{\"temperature\":23.5,\"humidity\":61,\"pressure\":1013.2,\"door\":true,\"label\":\"hall\"}";
+  const size_t readingLen = strlen(reading);
+  ZiLinkFrame<> text;
+  text.raw("{\"type\":\"device_data\",\"data\":{\"sensorData\":").raw(reading, readingLen).raw("}}");
+  ZiLinkFrame<> packed;
+  auto transcode = [&]()
+  {
+    packed.reset();
+    ZiLinkMsgPack mp(packed);
+    mp.array(2).uinteger(ZILINK_KIND_DEVICE_DATA);
+    mp.json(reading, readingLen);
+  };
+  transcode();
+  run("reading frame (JSON)", text.length(), [&](int)
+      {
+        text.reset();
+        text.raw("{\"type\":\"device_data\",\"data\":{\"sensorData\":").raw(reading, readingLen).raw("}}");
+        g_sink += text.length(); });
+  run("reading frame (MsgPack)", packed.length(), [&](int) { transcode(); g_sink += packed.length(); });
+  run("reading decode (MsgPack skip)", packed.length(), [&](int)
+      {
+        ZiLinkMsgPackReader in((const uint8_t *)packed.c_str(), packed.length());
+        g_sink += in.skip(); });
+
+  precision();
+  return benchResult();
+}
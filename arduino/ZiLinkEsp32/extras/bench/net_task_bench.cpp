@@ -0,0 +1,166 @@
+// Host-side check of threaded mode: jitter of a fixed-rate sensor loop while
+// the network side is disconnected (blocking reconnect attempts) or
+// congested (slow sends), with the network work done inline in the sensor
+// loop versus on a ZiLinkNetTask fed through a ZiLinkSpscRing.
+//
+//   g++ -O2 -std=c++17 -pthread -I../../src net_task_bench.cpp ../../src/ZiLinkNetTask.cpp ../../src/ZiLinkSpscRing.cpp -o net_task_bench
+//   ./net_task_bench
+//
+// The stalls are sleeps sized like the blocking calls on the device: a
+// connect attempt that waits out its timeout, an HTTP POST on a bad link.
+
+#include "ZiLinkNetTask.h"
+#include "ZiLinkSpscRing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static const auto PERIOD = std::chrono::milliseconds(10);
+static const int SAMPLES = 300;
+
+enum Network
+{
+  Healthy,
+  Disconnected, // a 300 ms blocking connect attempt every 500 ms
+  Congested     // every 4th send takes 40 ms
+};
+
+struct Link
+{
+  Network mode = Healthy;
+  Clock::time_point nextAttempt = Clock::now();
+  unsigned sends = 0;
+  size_t bytes = 0;
+
+  // One pass of the network loop, with `n` readings to send
+  void service(size_t n, size_t length)
+  {
+    if (mode == Disconnected)
+    {
+      if (Clock::now() >= nextAttempt)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        nextAttempt = Clock::now() + std::chrono::milliseconds(500);
+      }
+      return;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+      if (mode == Congested && ++sends % 4 == 0)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(40));
+      }
+      bytes += length;
+    }
+  }
+};
+
+struct Result
+{
+  double maxMs;
+  double p99Ms;
+  uint32_t dropped;
+};
+
+static void sample(char *reading, size_t &length, int i)
+{
+  length = (size_t)snprintf(reading, 64, "{\"temperature\":%d.%d}", 20 + i % 5, i % 10);
+}
+
+template <typename Send>
+static Result sensorLoop(Send send)
+{
+  // Jitter: how far each sampling interval strays from the period
+  std::vector<double> jitter;
+  jitter.reserve(SAMPLES);
+  auto next = Clock::now() + PERIOD;
+  auto last = next;
+  char reading[64];
+  for (int i = 0; i < SAMPLES; i++)
+  {
+    std::this_thread::sleep_until(next);
+    const auto now = Clock::now();
+    if (i > 0)
+    {
+      jitter.push_back(std::abs(std::chrono::duration<double, std::milli>(now - last - PERIOD).count()));
+    }
+    last = now;
+    size_t length;
+    sample(reading, length, i);
+    send(reading, length);
+    next += PERIOD;
+  }
+  std::sort(jitter.begin(), jitter.end());
+  return {jitter.back(), jitter[jitter.size() * 99 / 100], 0};
+}
+
+static Result inlineMode(Network mode)
+{
+  Link link;
+  link.mode = mode;
+  return sensorLoop([&](const char *, size_t length)
+                    { link.service(1, length); });
+}
+
+struct Threaded
+{
+  Link link;
+  ZiLinkSpscRing ring{4096};
+  ZiLinkNetTask task;
+
+  static void body(void *ctx)
+  {
+    Threaded *self = static_cast<Threaded *>(ctx);
+    uint8_t tag;
+    const uint8_t *data;
+    size_t length;
+    size_t n = 0;
+    size_t bytes = 0;
+    while (self->ring.front(tag, data, length))
+    {
+      n++;
+      bytes = length;
+      self->ring.pop();
+    }
+    self->link.service(n, bytes);
+  }
+};
+
+static Result threadedMode(Network mode)
+{
+  Threaded t;
+  t.link.mode = mode;
+  ZiLinkNetTask::Config config;
+  config.core = -1;
+  t.task.start(Threaded::body, &t, config);
+  Result r = sensorLoop([&](const char *reading, size_t length)
+                        {
+    if (t.ring.push(1, reading, length)) {
+      t.task.notify();
+    } });
+  t.task.stop();
+  r.dropped = t.ring.dropped();
+  return r;
+}
+
+int main()
+{
+  const char *names[] = {"healthy", "disconnected", "congested"};
+  printf("sensor loop every 10 ms, %d samples; deviation of each interval from 10 ms\n", SAMPLES);
+  for (int m = Healthy; m <= Congested; m++)
+  {
+    const Result a = inlineMode((Network)m);
+    const Result b = threadedMode((Network)m);
+    printf("%-13s inline   max %7.2f ms  p99 %7.2f ms\n", names[m], a.maxMs, a.p99Ms);
+    printf("%-13s threaded max %7.2f ms  p99 %7.2f ms  (hand-off drops %u)\n", "", b.maxMs, b.p99Ms, b.dropped);
+  }
+  return 0;
+}
@@ -0,0 +1,417 @@
+// Outbound priority classes over a real local socket: ZiLinkEsp32 (Sockets
+// mode) queues a backlog of readings with command responses in between
+// while the WebSocket is down, then connects to a stand-in server that
+// answers auth and records the order in which frames arrive.
+//
+//   1. backlog of 600 readings in a 64 KB telemetry queue, replayed within
+//      the default per-loop() budget and without one: where the command
+//      responses land, how long loop() stalls, queue wait per class
+//   2. the same backlog into the default 2 KB telemetry queue: readings
+//      are dropped, the command responses in their own queue are not
+//   3. ZiLinkOutbox alone: the high-water mark of the whole arena, and
+//      BlockWithTimeout refused
+//   4. with the durable log: readings logged during the outage replay
+//      while new ones keep coming; the server must see them in order
+//
+// Exits non-zero unless every command response arrives ahead of the
+// readings, loop() stays near the budget and no new reading overtakes the
+// logged backlog. Needs ArduinoJson:
+//
+//   g++ -O2 -std=gnu++17 -pthread -I../host -I../../src -I<ArduinoJson>/src priority_bench.cpp ../host/*.cpp ../../src/*.cpp
+
+#include <ZiLinkHost.h>
+#include <ZiLinkEsp32.h>
+#include "bench_check.h"
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static uint64_t nowUs()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// One connection: upgrade, auth_success, then every frame's type in order
+class Server
+{
+public:
+  Server()
+  {
+    _listen = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(_listen, (sockaddr *)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(_listen, (sockaddr *)&addr, &len);
+    _port = ntohs(addr.sin_port);
+    listen(_listen, 1);
+    _thread = std::thread([this]
+                          { run(); });
+  }
+
+  ~Server()
+  {
+    _stop = true;
+    _thread.join();
+    close(_listen);
+  }
+
+  uint16_t port() const { return _port; }
+
+  std::vector<std::string> types()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _types;
+  }
+
+  std::vector<std::string> payloads()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _payloads;
+  }
+
+private:
+  void run()
+  {
+    pollfd p = {_listen, POLLIN, 0};
+    while (!_stop && poll(&p, 1, 5) != 1)
+    {
+    }
+    if (_stop)
+    {
+      return;
+    }
+    const int fd = accept(_listen, nullptr, nullptr);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    std::string rx;
+    bool upgraded = false;
+    bool authed = false;
+    while (!_stop)
+    {
+      pollfd c = {fd, POLLIN, 0};
+      if (poll(&c, 1, 5) != 1)
+      {
+        continue;
+      }
+      char buf[16384];
+      const ssize_t r = recv(fd, buf, sizeof(buf), 0);
+      if (r <= 0)
+      {
+        break;
+      }
+      rx.append(buf, r);
+      if (!upgraded)
+      {
+        const size_t end = rx.find("\r\n\r\n");
+        if (end == std::string::npos)
+        {
+          continue;
+        }
+        rx.erase(0, end + 4);
+        const char upgrade[] = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                               "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n";
+        send(fd, upgrade, sizeof(upgrade) - 1, MSG_NOSIGNAL);
+        upgraded = true;
+      }
+      std::string payload;
+      while (nextFrame(rx, payload))
+      {
+        if (!authed)
+        {
+          const char reply[] = "{\"type\":\"auth_success\",\"data\":{}}";
+          const uint8_t head[] = {0x81, (uint8_t)(sizeof(reply) - 1)};
+          send(fd, head, sizeof(head), MSG_NOSIGNAL);
+          send(fd, reply, sizeof(reply) - 1, MSG_NOSIGNAL);
+          authed = true;
+          continue;
+        }
+        const size_t at = payload.find("\"type\":\"");
+        const size_t end = at == std::string::npos ? at : payload.find('"', at + 8);
+        std::lock_guard<std::mutex> lock(_mutex);
+        _types.push_back(end == std::string::npos ? "?" : payload.substr(at + 8, end - at - 8));
+        _payloads.push_back(payload);
+      }
+    }
+    close(fd);
+  }
+
+  // Unmasks the client frame at the front of rx into payload
+  static bool nextFrame(std::string &rx, std::string &payload)
+  {
+    if (rx.size() < 2)
+    {
+      return false;
+    }
+    size_t length = (uint8_t)rx[1] & 0x7F;
+    size_t at = 2;
+    if (length == 126)
+    {
+      if (rx.size() < 4)
+      {
+        return false;
+      }
+      length = ((uint8_t)rx[2] << 8) | (uint8_t)rx[3];
+      at = 4;
+    }
+    if (rx.size() < at + 4 + length)
+    {
+      return false;
+    }
+    payload.resize(length);
+    for (size_t i = 0; i < length; i++)
+    {
+      payload[i] = rx[at + 4 + i] ^ rx[at + (i & 3)];
+    }
+    rx.erase(0, at + 4 + length);
+    return true;
+  }
+
+  int _listen = -1;
+  uint16_t _port = 0;
+  std::thread _thread;
+  std::atomic<bool> _stop{false};
+  std::mutex _mutex;
+  std::vector<std::string> _types;
+  std::vector<std::string> _payloads;
+};
+
+struct Run
+{
+  std::vector<std::string> types;
+  size_t responses = 0;
+  size_t readings = 0;
+  size_t lastResponse = 0; // position among the frames after auth, 1-based
+  uint32_t loops = 0;      // until the queue was empty
+  uint32_t maxLoopUs = 0;
+  uint32_t dropped = 0;
+  uint32_t budgetStops = 0;
+  uint32_t controlWaitUs = 0; // p99
+  uint32_t telemetryWaitUs = 0;
+};
+
+static const int READINGS = 600;
+static const int RESPONSES_EVERY = 100;
+
+static Run backlog(size_t telemetryBytes, bool budget)
+{
+  Run r;
+  Server server;
+  ZiLinkEsp32 link;
+  link.configureQueue(telemetryBytes);
+  if (!budget)
+  {
+    link.setQueueBudget((size_t)-1, UINT32_MAX);
+  }
+  // Queued before the WebSocket exists, as during an outage
+  char reading[128];
+  for (int i = 0; i < READINGS; i++)
+  {
+    snprintf(reading, sizeof(reading), "{\"temperature\":%d.5,\"humidity\":%d,\"seq\":%d,\"pad\":\"................\"}",
+             20 + i % 5, 40 + i % 7, i);
+    link.sendWebSocketData(reading);
+    if (i % RESPONSES_EVERY == RESPONSES_EVERY - 1)
+    {
+      snprintf(reading, sizeof(reading), "{\"command\":\"led\",\"n\":%d,\"ok\":true}", i / RESPONSES_EVERY);
+      link.sendCommandResponse(reading);
+    }
+  }
+  link.setupWebSocket("127.0.0.1", server.port(), "/ws", "bench", "token");
+
+  const uint64_t deadline = nowUs() + 10000000ull;
+  bool drained = false;
+  uint64_t quietSince = 0;
+  size_t seen = 0;
+  while (nowUs() < deadline)
+  {
+    const uint64_t start = nowUs();
+    link.loop();
+    const uint32_t us = (uint32_t)(nowUs() - start);
+    const bool queued = link.getStats().queuedBytes > 0;
+    if (!drained)
+    {
+      r.loops++;
+      r.maxLoopUs = std::max(r.maxLoopUs, us);
+      drained = !queued && link.queueStats(ZiLinkOutbox::Telemetry).sent > 0;
+    }
+    const size_t n = server.types().size();
+    if (n != seen)
+    {
+      seen = n;
+      quietSince = nowUs();
+    }
+    // Everything sent has been read
+    if (drained && nowUs() - quietSince > 100000)
+    {
+      break;
+    }
+    usleep(50);
+  }
+  r.types = server.types();
+  for (size_t i = 0; i < r.types.size(); i++)
+  {
+    if (r.types[i] == "command_response")
+    {
+      r.responses++;
+      r.lastResponse = i + 1;
+    }
+    else if (r.types[i] == "device_data")
+    {
+      r.readings++;
+    }
+  }
+  r.dropped = link.queueStats().dropped;
+  r.controlWaitUs = link.queueStats(ZiLinkOutbox::Control).waitUs.percentile(99);
+  r.telemetryWaitUs = link.queueStats(ZiLinkOutbox::Telemetry).waitUs.percentile(99);
+  return r;
+}
+
+static void report(const char *label, const Run &r)
+{
+  printf("%-30s %8zu %9zu %14zu %6u %12u %8u %11.1f %11.1f\n", label, r.readings, r.responses, r.lastResponse,
+         r.loops, r.maxLoopUs, r.dropped, r.controlWaitUs / 1000.0, r.telemetryWaitUs / 1000.0);
+}
+
+// The classes peak at different times; the arena's peak is not their sum
+static void outbox()
+{
+  ZiLinkOutbox box;
+  char record[100] = {};
+  box.push(ZiLinkOutbox::Telemetry, 0, 0, record, sizeof(record));
+  box.push(ZiLinkOutbox::Telemetry, 0, 0, record, sizeof(record));
+  const size_t peak = box.usedBytes();
+  box.service([](const ZiLinkRingBuffer::Record &) { return true; });
+  box.push(ZiLinkOutbox::Control, 1, 0, record, sizeof(record));
+  check(box.stats().highWaterBytes == peak, "outbox: high-water mark of the arena as a whole");
+  check(!box.configure(ZiLinkOutbox::Telemetry, 4096, ZiLinkRingBuffer::BlockWithTimeout, 100),
+        "outbox: BlockWithTimeout refused");
+}
+
+// Readings "n" in the order the server received them
+static std::vector<int> readingOrder(Server &server)
+{
+  std::vector<int> order;
+  for (const std::string &payload : server.payloads())
+  {
+    const size_t at = payload.find("\"n\":");
+    if (at != std::string::npos)
+    {
+      order.push_back(atoi(payload.c_str() + at + 4));
+    }
+  }
+  return order;
+}
+
+// Logged while down, then replayed at replayPerSecond while the sketch
+// keeps sending: the new readings have to wait for the backlog
+static void durable()
+{
+  char dir[] = "/tmp/zilink_logXXXXXX";
+  if (!mkdtemp(dir))
+  {
+    check(false, "durable log: temporary directory");
+    return;
+  }
+  const int LOGGED = 100;
+  const int TOTAL = 300;
+  int next = 0;
+  {
+    Server server;
+    ZiLinkEsp32 link;
+    ZiLinkFlashLog::Config config;
+    config.replayPerSecond = 200;
+    config.maxInFlight = 1000; // the stand-in sends no acks
+    check(link.enableDurableLog(dir, config), "durable log: enabled");
+    char reading[64];
+    for (; next < LOGGED; next++)
+    {
+      snprintf(reading, sizeof(reading), "{\"n\":%d}", next);
+      link.sendWebSocketData(reading);
+    }
+    link.setupWebSocket("127.0.0.1", server.port(), "/ws", "bench", "token");
+    const uint64_t deadline = nowUs() + 10000000ull;
+    uint64_t nextReading = nowUs();
+    while (nowUs() < deadline && readingOrder(server).size() < (size_t)TOTAL)
+    {
+      if (next < TOTAL && nowUs() >= nextReading)
+      {
+        snprintf(reading, sizeof(reading), "{\"n\":%d}", next++);
+        link.sendWebSocketData(reading);
+        nextReading += 2000;
+      }
+      link.loop();
+      usleep(50);
+    }
+    const std::vector<int> order = readingOrder(server);
+    size_t inOrder = 0;
+    while (inOrder < order.size() && order[inOrder] == (int)inOrder)
+    {
+      inOrder++;
+    }
+    printf("durable log: %zu of %d readings received, the first %zu in order\n", order.size(), TOTAL, inOrder);
+    check(order.size() == (size_t)TOTAL, "durable log: every reading arrives");
+    check(inOrder == order.size(), "durable log: new readings wait for the logged backlog");
+  }
+  // The segment files, then the directory
+  if (DIR *d = opendir(dir))
+  {
+    while (dirent *e = readdir(d))
+    {
+      if (e->d_name[0] != '.')
+      {
+        unlink((std::string(dir) + "/" + e->d_name).c_str());
+      }
+    }
+    closedir(d);
+  }
+  rmdir(dir);
+}
+
+int main()
+{
+  outbox();
+  ZiLinkHost::setMode(ZiLinkHost::Sockets);
+  const size_t responses = READINGS / RESPONSES_EVERY;
+  printf("%-30s %8s %9s %14s %6s %12s %8s %11s %11s\n", "case", "readings", "responses", "last response",
+         "loops", "max loop us", "dropped", "control ms", "telemetry ms");
+
+  const Run budgeted = backlog(64 * 1024, true);
+  report("64 KB backlog, budget", budgeted);
+  const Run unbounded = backlog(64 * 1024, false);
+  report("64 KB backlog, no budget", unbounded);
+  const Run small = backlog(ZILINK_QUEUE_BYTES, true);
+  report("2 KB telemetry queue", small);
+  printf("(in call order, response %d would have followed reading %d)\n", (int)responses, READINGS);
+
+  for (const Run *r : {&budgeted, &unbounded, &small})
+  {
+    check(r->responses == responses, "every command response arrives");
+    check(r->lastResponse == responses, "command responses ahead of every reading");
+  }
+  check(budgeted.readings == READINGS && unbounded.readings == READINGS, "64 KB: every reading arrives");
+  check(budgeted.loops > 1 && unbounded.loops <= 3, "the budget spreads the backlog over several loop() calls");
+  check(budgeted.maxLoopUs < unbounded.maxLoopUs, "the budget shortens the longest loop()");
+  check(small.dropped > 0 && small.readings + small.dropped == READINGS, "2 KB: readings dropped and counted");
+
+  durable();
+
+  return benchResult();
+}
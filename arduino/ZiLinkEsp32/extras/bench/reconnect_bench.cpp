@@ -0,0 +1,356 @@
+// Connect-to-authenticated latency over a real local socket: ZiLinkEsp32
+// (Sockets mode) against a WebSocket stand-in that upgrades, answers auth
+// with auth_success and closes the connection once the device has sent
+// its first frame after auth, and an MQTT stand-in that answers CONNECT
+// with CONNACK and then closes. Either can delay its handshake reply, to
+// stand in for TLS and server work.
+//
+//   1. ZiLinkDnsCache: a lookup against a cache hit, expiry after the TTL
+//   2. WebSocket and MQTT: the cold connect and 20 reconnects, from the
+//      start of the attempt to authenticated (stats readyMs/coldReadyMs),
+//      split into connect and auth
+//
+// Exits non-zero unless every reconnect happened and the reported
+// latencies cover the stand-in's delays. wss:// has no host
+// implementation, so TLS itself is not part of the measurement. Needs
+// ArduinoJson:
+//
+//   g++ -O2 -std=gnu++17 -pthread -I../host -I../../src -I<ArduinoJson>/src reconnect_bench.cpp ../host/*.cpp ../../src/*.cpp
+
+#include <ZiLinkHost.h>
+#include <ZiLinkEsp32.h>
+#include "bench_check.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+static uint64_t nowUs()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+enum Protocol
+{
+  Ws,
+  Mqtt
+};
+
+// One connection at a time: handshake, reply after delayMs, close when done
+class StandIn
+{
+public:
+  StandIn(Protocol protocol, uint32_t handshakeDelayMs, uint32_t authDelayMs)
+      : _protocol(protocol), _handshakeDelayMs(handshakeDelayMs), _authDelayMs(authDelayMs)
+  {
+    _listen = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(_listen, (sockaddr *)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(_listen, (sockaddr *)&addr, &len);
+    _port = ntohs(addr.sin_port);
+    listen(_listen, 4);
+    _thread = std::thread([this]
+                          { run(); });
+  }
+
+  ~StandIn()
+  {
+    _stop = true;
+    shutdown(_listen, SHUT_RDWR);
+    _thread.join();
+    close(_listen);
+  }
+
+  uint16_t port() const { return _port; }
+  // Connections on which the device got as far as sending after auth
+  uint32_t completed() const { return _completed; }
+
+private:
+  void run()
+  {
+    while (!_stop)
+    {
+      pollfd p = {_listen, POLLIN, 0};
+      if (poll(&p, 1, 5) != 1)
+      {
+        continue;
+      }
+      const int fd = accept(_listen, nullptr, nullptr);
+      if (fd < 0)
+      {
+        continue;
+      }
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      _protocol == Ws ? serveWs(fd) : serveMqtt(fd);
+      close(fd);
+    }
+  }
+
+  // Waits up to 2 s for more bytes; false once the peer is gone
+  bool receive(int fd, std::string &rx)
+  {
+    pollfd p = {fd, POLLIN, 0};
+    if (poll(&p, 1, 2000) != 1)
+    {
+      return false;
+    }
+    char buf[1024];
+    const ssize_t r = recv(fd, buf, sizeof(buf), 0);
+    if (r <= 0)
+    {
+      return false;
+    }
+    rx.append(buf, r);
+    return true;
+  }
+
+  // Length of the whole client frame at the front of rx, or 0
+  static size_t frameLength(const std::string &rx)
+  {
+    if (rx.size() < 2)
+    {
+      return 0;
+    }
+    size_t length = (uint8_t)rx[1] & 0x7F;
+    size_t at = 2;
+    if (length == 126)
+    {
+      if (rx.size() < 4)
+      {
+        return 0;
+      }
+      length = ((uint8_t)rx[2] << 8) | (uint8_t)rx[3];
+      at = 4;
+    }
+    at += 4; // mask
+    return rx.size() >= at + length ? at + length : 0;
+  }
+
+  void serveWs(int fd)
+  {
+    std::string rx;
+    while (rx.find("\r\n\r\n") == std::string::npos)
+    {
+      if (!receive(fd, rx))
+      {
+        return;
+      }
+    }
+    rx.erase(0, rx.find("\r\n\r\n") + 4);
+    std::this_thread::sleep_for(std::chrono::milliseconds(_handshakeDelayMs));
+    const char upgrade[] = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                           "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n";
+    send(fd, upgrade, sizeof(upgrade) - 1, MSG_NOSIGNAL);
+    // auth, then anything after it
+    for (int frames = 0; frames < 2;)
+    {
+      size_t n;
+      while ((n = frameLength(rx)) == 0)
+      {
+        if (!receive(fd, rx))
+        {
+          return;
+        }
+      }
+      rx.erase(0, n);
+      if (++frames == 1)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(_authDelayMs));
+        const char reply[] = "{\"type\":\"auth_success\",\"data\":{}}";
+        const uint8_t head[] = {0x81, (uint8_t)(sizeof(reply) - 1)};
+        send(fd, head, sizeof(head), MSG_NOSIGNAL);
+        send(fd, reply, sizeof(reply) - 1, MSG_NOSIGNAL);
+      }
+    }
+    _completed++;
+  }
+
+  void serveMqtt(int fd)
+  {
+    std::string rx;
+    // CONNECT: type, remaining length (short here), body
+    while (rx.size() < 2 || rx.size() < 2 + (size_t)(uint8_t)rx[1])
+    {
+      if (!receive(fd, rx))
+      {
+        return;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(_handshakeDelayMs + _authDelayMs));
+    const uint8_t connack[] = {0x20, 0x02, 0x00, 0x00};
+    send(fd, connack, sizeof(connack), MSG_NOSIGNAL);
+    // SUBSCRIBE follows once the device has processed CONNACK
+    rx.clear();
+    if (receive(fd, rx))
+    {
+      _completed++;
+    }
+  }
+
+  Protocol _protocol;
+  uint32_t _handshakeDelayMs;
+  uint32_t _authDelayMs;
+  int _listen = -1;
+  uint16_t _port = 0;
+  std::thread _thread;
+  std::atomic<bool> _stop{false};
+  std::atomic<uint32_t> _completed{0};
+};
+
+struct Run
+{
+  uint32_t connections = 0;
+  ZiLinkTransportStats cold; // stats after the first connection
+  std::vector<uint32_t> readyMs;
+  std::vector<uint32_t> connectMs;
+  std::vector<uint32_t> authMs;
+};
+
+static Run reconnect(Protocol protocol, uint32_t handshakeDelayMs, uint32_t authDelayMs, uint32_t connections)
+{
+  Run r;
+  StandIn s(protocol, handshakeDelayMs, authDelayMs);
+  ZiLinkEsp32 link;
+  if (protocol == Ws)
+  {
+    link.setupWebSocket("127.0.0.1", s.port(), "/ws", "bench", "token");
+    // Gives the device something to send right after auth
+    link.createButton(false, "b");
+  }
+  else
+  {
+    link.setMqttBackoff(5, 20);
+    // By name, so the first attempt includes a lookup
+    link.setupMqtt("localhost", s.port(), "bench", "token");
+  }
+  const uint64_t deadline = nowUs() + 30000000ull;
+  while (r.connections < connections && nowUs() < deadline)
+  {
+    link.loop();
+    usleep(100);
+    if (s.completed() == r.connections)
+    {
+      continue;
+    }
+    r.connections++;
+    const ZiLinkEsp32::Stats stats = link.getStats();
+    const ZiLinkTransportStats &t = protocol == Ws ? stats.ws : stats.mqtt;
+    if (r.connections == 1)
+    {
+      r.cold = t;
+    }
+    r.readyMs.push_back(t.readyMs);
+    r.connectMs.push_back(t.connectMs);
+    r.authMs.push_back(t.authLatencyMs);
+  }
+  return r;
+}
+
+static double mean(const std::vector<uint32_t> &v, size_t from)
+{
+  double sum = 0;
+  for (size_t i = from; i < v.size(); i++)
+  {
+    sum += v[i];
+  }
+  return v.size() > from ? sum / (v.size() - from) : 0;
+}
+
+static void report(const char *label, const Run &r, uint32_t handshakeDelayMs, uint32_t authDelayMs,
+                   uint32_t connections)
+{
+  const uint32_t maxReady = r.readyMs.size() > 1 ? *std::max_element(r.readyMs.begin() + 1, r.readyMs.end()) : 0;
+  printf("%-28s %6u %9u %10.1f %9u %11.1f %8.1f\n", label, r.connections, r.cold.coldReadyMs, mean(r.readyMs, 1),
+         maxReady, mean(r.connectMs, 1), mean(r.authMs, 1));
+  check(r.connections == connections, "every reconnect authenticated");
+  check(!r.readyMs.empty() && r.cold.coldReadyMs == r.readyMs[0], "cold connect reported");
+  bool covered = true;
+  for (size_t i = 0; i < r.readyMs.size(); i++)
+  {
+    covered &= r.readyMs[i] == r.connectMs[i] + r.authMs[i];
+    covered &= r.readyMs[i] >= handshakeDelayMs + authDelayMs;
+  }
+  check(covered, "connect -> authenticated covers the handshake and auth");
+}
+
+static void dnsCache()
+{
+  ZiLinkDnsCache cache(1000);
+  uint32_t ip = 0;
+  uint64_t start = nowUs();
+  check(cache.resolve("localhost", ip, 0), "localhost resolved");
+  const uint64_t lookupUs = nowUs() - start;
+  check(ip == htonl(INADDR_LOOPBACK), "localhost is 127.0.0.1");
+  start = nowUs();
+  const uint32_t hits = 10000;
+  for (uint32_t i = 0; i < hits; i++)
+  {
+    cache.resolve("localhost", ip, i % 1000);
+  }
+  const double hitUs = (nowUs() - start) / (double)hits;
+  check(cache.lookups() == 1 && cache.hits() == hits, "reused within the TTL");
+  cache.resolve("localhost", ip, 1000);
+  check(cache.lookups() == 2, "looked up again once the TTL passed");
+  cache.invalidate();
+  cache.resolve("localhost", ip, 1001);
+  check(cache.lookups() == 3, "looked up again after invalidate()");
+  printf("DNS: lookup of localhost %llu us, cache hit %.3f us\n\n", (unsigned long long)lookupUs, hitUs);
+}
+
+int main()
+{
+  ZiLinkHost::setMode(ZiLinkHost::Sockets);
+  dnsCache();
+
+  printf("%-28s %6s %9s %10s %9s %11s %8s\n", "case", "conns", "cold ms", "ready ms", "max ms", "connect ms",
+         "auth ms");
+  const uint32_t connections = 21;
+  const struct
+  {
+    const char *label;
+    Protocol protocol;
+    uint32_t handshakeDelayMs;
+    uint32_t authDelayMs;
+  } cases[] = {
+      {"WebSocket", Ws, 0, 0},
+      {"WebSocket, 30+10 ms server", Ws, 30, 10},
+      {"MQTT", Mqtt, 0, 0},
+      {"MQTT, 40 ms server", Mqtt, 30, 10},
+  };
+  for (const auto &c : cases)
+  {
+    const Run r = reconnect(c.protocol, c.handshakeDelayMs, c.authDelayMs, connections);
+    report(c.label, r, c.protocol == Ws ? c.handshakeDelayMs : 0, c.protocol == Ws ? c.authDelayMs : 0,
+           connections);
+    if (c.protocol == Mqtt)
+    {
+      // TCP is up at once; the whole delay is the wait for CONNACK
+      bool covered = true;
+      for (uint32_t auth : r.authMs)
+      {
+        covered &= auth >= c.handshakeDelayMs + c.authDelayMs;
+      }
+      check(covered, "CONNACK wait measured");
+    }
+  }
+
+  return benchResult();
+}
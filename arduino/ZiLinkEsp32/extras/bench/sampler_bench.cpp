@@ -0,0 +1,204 @@
+// Host check for ZiLinkSampler: drives it from a simulated clock with a
+// jittery loop and occasional stalls, and compares every window against a
+// reference computed from the values the read functions returned. Then
+// times the sampler against the real clock. Exits non-zero on a mismatch.
+//
+//   g++ -O2 -std=c++17 -I../../src sampler_bench.cpp ../../src/ZiLinkSampler.cpp ../../src/ZiLinkStats.cpp
+
+#include <ZiLinkSampler.h>
+#include "bench_check.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static bool near(float a, float b) { return std::fabs(a - b) <= 1e-3f * (1.0f + std::fabs(b)); }
+
+struct Reference
+{
+  std::vector<float> pending; // values read since the last window
+  uint32_t windows = 0;
+  uint32_t fullWindows = 0;
+};
+
+// Runs one sensor at periodUs/windowMs for durationMs of simulated time.
+// The loop comes back every loopUs +- jitterUs; with stallEvery > 0 every
+// stallEvery-th pass stalls for stallUs.
+static void simulate(const char *label, uint32_t periodUs, uint32_t windowMs, uint32_t loopUs, uint32_t jitterUs,
+                     uint32_t stallEvery, uint32_t stallUs, uint32_t durationMs, uint32_t startUs)
+{
+  ZiLinkSampler sampler;
+  Reference ref;
+  std::mt19937 rng(periodUs ^ windowMs);
+  std::uniform_real_distribution<float> value(-50.0f, 50.0f);
+  uint32_t nowUs = startUs;
+  check(sampler.add("s", periodUs, windowMs, [&]
+                    {
+                      const float v = value(rng);
+                      ref.pending.push_back(v);
+                      return v; },
+                    2, nowUs),
+        "add");
+  const uint32_t perWindow = windowMs * 1000 / periodUs;
+  bool mismatch = false;
+  auto emit = [&](const ZiLinkSampler::Sensor &, const ZiLinkSampler::Window &w)
+  {
+    float lo = ref.pending[0], hi = ref.pending[0];
+    double sum = 0;
+    for (float v : ref.pending)
+    {
+      lo = std::min(lo, v);
+      hi = std::max(hi, v);
+      sum += v;
+    }
+    const bool same = w.count == ref.pending.size() && w.min == lo && w.max == hi &&
+                      near(w.mean, (float)(sum / ref.pending.size())) && w.last == ref.pending.back();
+    if (!same && !mismatch)
+    {
+      printf("  window %u: n=%u/%zu min=%g/%g max=%g/%g mean=%g/%g\n", ref.windows, w.count, ref.pending.size(),
+             w.min, lo, w.max, hi, w.mean, sum / ref.pending.size());
+      mismatch = true;
+    }
+    ref.fullWindows += w.count == perWindow;
+    ref.windows++;
+    ref.pending.clear();
+  };
+
+  std::uniform_int_distribution<int32_t> jitter(-(int32_t)jitterUs, (int32_t)jitterUs);
+  const uint64_t passes = (uint64_t)durationMs * 1000 / loopUs;
+  for (uint64_t i = 1; i <= passes; i++)
+  {
+    nowUs += loopUs + jitter(rng);
+    if (stallEvery && i % stallEvery == 0)
+    {
+      nowUs += stallUs;
+    }
+    sampler.service(nowUs, emit);
+  }
+
+  const ZiLinkSampler::Stats &st = sampler.stats();
+  printf("%-28s %8u %8u %8u %8u/%-8u %8u %8u\n", label, st.samples, st.missed, st.windows, ref.fullWindows,
+         ref.windows, st.lateUs.mean(), st.lateUs.percentile(99));
+  check(!mismatch, label);
+  check(st.windows == ref.windows, "window count");
+  // Every grid slot is either sampled or missed
+  const uint64_t slots = (uint64_t)st.samples + st.missed;
+  const uint64_t elapsed = (uint32_t)(nowUs - startUs) / periodUs;
+  check(slots + 1 >= elapsed && slots <= elapsed + 1, "samples + missed");
+  if (!stallEvery && loopUs + jitterUs <= periodUs)
+  {
+    check(st.missed == 0 && ref.fullWindows == ref.windows, "full windows without stalls");
+  }
+}
+
+// Windows from several sensors must each carry their own values
+static void twoSensors()
+{
+  ZiLinkSampler sampler;
+  float a = 0, b = 1000;
+  check(sampler.add("a", 1000, 10, [&]
+                    { return a += 1; }),
+        "add a");
+  check(sampler.add("b", 500, 20, [&]
+                    { return b -= 1; }),
+        "add b");
+  uint32_t windowsA = 0, windowsB = 0;
+  for (uint32_t nowUs = 0; nowUs <= 100000; nowUs += 100)
+  {
+    sampler.service(nowUs, [&](const ZiLinkSampler::Sensor &s, const ZiLinkSampler::Window &w)
+                    {
+      if (s.name[0] == 'a') {
+        check(w.count == 10 && w.max - w.min == 9 && w.last == w.max, "sensor a window");
+        windowsA++;
+      } else {
+        check(w.count == 40 && w.max - w.min == 39 && w.last == w.min, "sensor b window");
+        windowsB++;
+      } });
+  }
+  check(windowsA == 10 && windowsB == 5, "two sensors window count");
+}
+
+static void arguments()
+{
+  ZiLinkSampler sampler;
+  auto read = []
+  { return 0.0f; };
+  check(!sampler.add("x", 0, 10, read), "period 0 rejected");
+  check(!sampler.add("x", 20000, 10, read), "window below one period rejected");
+  check(!sampler.add("x", 1000, 3000000, read), "window past 35 min rejected");
+  check(!sampler.add("x", 1000, 10, nullptr), "missing read rejected");
+  for (int i = 0; i < ZILINK_MAX_SAMPLED; i++)
+  {
+    check(sampler.add("x", 1000, 10, read), "add within the table");
+  }
+  check(!sampler.add("x", 1000, 10, read), "full table rejected");
+}
+
+static uint32_t realMicros()
+{
+  static const auto start = std::chrono::steady_clock::now();
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Busy loop on the real clock: how close to the grid the samples land
+static void realClock(uint32_t periodUs)
+{
+  ZiLinkSampler sampler;
+  volatile float sink = 0;
+  sampler.add("r", periodUs, 100, []
+              { return 1.0f; },
+              2, realMicros());
+  uint32_t windows = 0;
+  const auto start = std::chrono::steady_clock::now();
+  const uint32_t until = realMicros() + 1000000;
+  while ((int32_t)(realMicros() - until) < 0)
+  {
+    sampler.service(realMicros(), [&](const ZiLinkSampler::Sensor &, const ZiLinkSampler::Window &w)
+                    {
+      sink = sink + w.mean;
+      windows++; });
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  const ZiLinkSampler::Stats &st = sampler.stats();
+  printf("real clock %6u us period: %u samples (%u missed), %u windows, late mean %u us, p99 %u us, in %.2f s\n",
+         periodUs, st.samples, st.missed, windows, st.lateUs.mean(), st.lateUs.percentile(99), seconds);
+
+}
+
+// Cost of a sample with the clock out of the way
+static void sampleCost()
+{
+  volatile float sink = 0;
+  ZiLinkSampler timed;
+  timed.add("t", 1, 1, []
+            { return 2.0f; });
+  const uint32_t n = 2000000;
+  const auto t0 = std::chrono::steady_clock::now();
+  for (uint32_t now = 1; now <= n; now++)
+  {
+    timed.service(now, [&](const ZiLinkSampler::Sensor &, const ZiLinkSampler::Window &w)
+                  { sink = sink + w.last; });
+  }
+  const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / n;
+  printf("service() with one sample due: %.1f ns\n", ns);
+}
+
+int main()
+{
+  printf("%-28s %8s %8s %8s %17s %8s %8s\n", "case", "samples", "missed", "windows", "full/windows", "late us",
+         "p99");
+  simulate("10 kHz, 100 ms, loop 50us", 100, 100, 50, 20, 0, 0, 5000, 0);
+  simulate("1 kHz, 1 s, loop 300us", 1000, 1000, 300, 200, 0, 0, 20000, 123);
+  simulate("100 Hz, 250 ms, loop 1ms", 10000, 250, 1000, 500, 0, 0, 20000, 0xFFFF0000u);
+  simulate("1 kHz, stall 25ms/1000", 1000, 500, 200, 100, 1000, 25000, 20000, 7);
+  simulate("10 kHz, loop 130us", 100, 50, 130, 30, 0, 0, 2000, 0);
+  twoSensors();
+  arguments();
+  realClock(100);
+  realClock(1000);
+  sampleCost();
+  return benchResult();
+}
@@ -0,0 +1,77 @@
+// One client variant per build (-DVARIANT=n) doing the same small job:
+// connect, send a reading and a component update, loop. size_report.sh
+// builds each one and compares code size, object size and heap in use.
+
+#include <ZiLinkHost.h>
+
+#include <malloc.h>
+#include <cstdio>
+#include <cstdlib>
+
+#if VARIANT == 0 || VARIANT == 2
+#include <ZiLinkEsp32.h>
+#else
+#include <ZiLinkHttp.h>
+#include <ZiLinkMqtt.h>
+#include <ZiLinkWs.h>
+#endif
+
+#if VARIANT == 0
+static const char *NAME = "ZiLinkEsp32 (MQTT)";
+static ZiLinkEsp32 *make() { return new ZiLinkEsp32(); }
+static void setup(ZiLinkEsp32 &zi) { zi.setupMqtt("127.0.0.1", 1883, "probe", "token"); }
+#elif VARIANT == 1
+static const char *NAME = "ZiLink<ZiLinkMqtt>";
+typedef ZiLink<ZiLinkMqtt> Lean;
+static Lean *make() { return new Lean("probe", "token", {"127.0.0.1", 1883}); }
+#elif VARIANT == 2
+static const char *NAME = "ZiLinkEsp32 (WS + HTTP)";
+static ZiLinkEsp32 *make() { return new ZiLinkEsp32(); }
+static void setup(ZiLinkEsp32 &zi)
+{
+  zi.setupHttp("http://127.0.0.1:5000/api", "probe", "token");
+  zi.setupWebSocket("127.0.0.1", 5000, "/ws", "probe", "token");
+}
+#elif VARIANT == 3
+static const char *NAME = "ZiLink<ZiLinkWs, ZiLinkHttp>";
+typedef ZiLink<ZiLinkWs, ZiLinkHttp> Lean;
+static Lean *make() { return new Lean("probe", "token", {"127.0.0.1", 5000}, {"http://127.0.0.1:5000/api"}); }
+#else
+static const char *NAME = "ZiLink<ZiLinkWs, ZiLinkMqtt, ZiLinkHttp>";
+typedef ZiLink<ZiLinkWs, ZiLinkMqtt, ZiLinkHttp> Lean;
+static Lean *make()
+{
+  return new Lean("probe", "token", {"127.0.0.1", 5000}, {"127.0.0.1", 1883}, {"http://127.0.0.1:5000/api"});
+}
+#endif
+
+int main(int argc, char **argv)
+{
+  ZiLinkHost::setMode(ZiLinkHost::InMemory);
+  const size_t heapBefore = mallinfo2().uordblks;
+  auto *zi = make();
+#if VARIANT == 0 || VARIANT == 2
+  setup(*zi);
+  const size_t object = sizeof(ZiLinkEsp32);
+#else
+  zi->begin();
+  const size_t object = sizeof(Lean);
+#endif
+  for (int i = 0; i < 8; i++)
+  {
+    zi->loop();
+  }
+#if VARIANT == 0
+  zi->publishMqttData("{\"t\":21.5}");
+#elif VARIANT == 2
+  zi->sendWebSocketData("{\"t\":21.5}");
+#else
+  zi->sendData("{\"t\":21.5}");
+#endif
+  zi->createSlider(3, "fan");
+  zi->loop();
+  // Heap held by the client once it runs, the object itself included
+  const size_t heap = mallinfo2().uordblks - heapBefore;
+  printf("%-42s %10s %8zu %8zu\n", NAME, argc > 1 ? argv[1] : "?", object, heap);
+  return 0;
+}
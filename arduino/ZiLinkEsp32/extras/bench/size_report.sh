@@ -0,0 +1,35 @@
+#!/bin/sh
+# Size of the ZiLink<...> variants against ZiLinkEsp32, each built for the
+# same job (size_probe.cpp):
+#
+#   ARDUINOJSON=<ArduinoJson>/src ./size_report.sh
+#
+# On the host (against ../host): linked code with unused sections removed,
+# sizeof the client and the heap it holds once running. The stand-in
+# clients are smaller than the real ones, so compare variants with each
+# other, not with a board. With arduino-cli on the PATH the MqttData and
+# LeanMqtt sketches are also built for ESP32 (BOARD, default esp32:esp32:esp32).
+set -e
+cd "$(dirname "$0")"
+: "${ARDUINOJSON:?set ARDUINOJSON to ArduinoJson's src directory}"
+out=$(mktemp -d)
+trap 'rm -rf "$out"' EXIT
+flags="-Os -std=gnu++17 -pthread -ffunction-sections -fdata-sections -I../host -I../../src -I$ARDUINOJSON"
+
+for f in ../host/*.cpp ../../src/*.cpp; do
+  g++ $flags -c "$f" -o "$out/$(basename "$f" .cpp).o"
+done
+printf '%-42s %10s %8s %8s\n' client "code" "object" "heap"
+for v in 0 1 2 3 4; do
+  g++ $flags -DVARIANT=$v -c size_probe.cpp -o "$out/probe.o"
+  g++ -pthread -Wl,--gc-sections "$out"/*.o -o "$out/probe$v"
+  rm "$out/probe.o"
+  "$out/probe$v" "$(size "$out/probe$v" | awk 'NR == 2 { print $1 }')"
+done
+
+if command -v arduino-cli >/dev/null; then
+  for sketch in MqttData LeanMqtt; do
+    echo "$sketch:"
+    arduino-cli compile -b "${BOARD:-esp32:esp32:esp32}" "../../examples/$sketch" | grep -E "Sketch uses|Global variables"
+  done
+fi
@@ -0,0 +1,409 @@
+// Waveform streaming over a real local WebSocket: ZiLinkStream and the host
+// WebSocketsClient (Sockets mode) against a minimal server on 127.0.0.1.
+// The server speaks enough RFC 6455 for the job and grants credit like the
+// ZiLink server does (STREAM_CREDIT_CHUNKS = 8, topped up at half). It
+// checks every chunk: sequence, credit, sample index, gap flag, and the
+// sample values.
+//
+//   1. 16 kHz int16 in real time (the microphone case): nothing dropped
+//   2. Producer as fast as the link takes it: sustained throughput
+//   3. Server that consumes ~6 kHz: credit holds the device back, the
+//      producer drops (counted, flagged), nothing queues up unbounded
+//
+// Exits non-zero if the server sees anything out of place.
+//
+//   g++ -O2 -std=gnu++17 -pthread -I../host -I../../src stream_bench.cpp ../host/*.cpp ../../src/ZiLinkStream.cpp ../../src/ZiLinkMsgPack.cpp ../../src/ZiLinkFrameWriter.cpp
+
+#include <ZiLinkHost.h>
+#include "bench_check.h"
+#include <WebSocketsClient.h>
+#include <ZiLinkStream.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const uint32_t WINDOW = 8;
+static uint64_t nowUs()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// The value the producer writes at a given sample index, so the server can check every sample
+static int16_t sampleAt(uint32_t index) { return (int16_t)(index * 7u + (index >> 9)); }
+
+struct ServerResult
+{
+  uint32_t chunks = 0;
+  uint64_t samples = 0;
+  uint64_t missing = 0; // index jumps
+  uint64_t bytes = 0;
+  uint32_t errors = 0;
+  uint32_t gapFlags = 0;
+  uint64_t firstUs = 0;
+  uint64_t lastUs = 0;
+};
+
+class Server
+{
+public:
+  Server(uint32_t consumeUsPerChunk) : _consumeUs(consumeUsPerChunk)
+  {
+    _listen = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(_listen, (sockaddr *)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(_listen, (sockaddr *)&addr, &len);
+    _port = ntohs(addr.sin_port);
+    listen(_listen, 1);
+    _thread = std::thread([this]
+                          { run(); });
+  }
+  ~Server()
+  {
+    _stop = true;
+    shutdown(_listen, SHUT_RDWR);
+    if (_conn >= 0)
+    {
+      shutdown(_conn, SHUT_RDWR);
+    }
+    _thread.join();
+    close(_listen);
+    if (_conn >= 0)
+    {
+      close(_conn);
+    }
+  }
+  uint16_t port() const { return _port; }
+  // Once the chunk before `seq` has been consumed
+  ServerResult result(uint32_t seq)
+  {
+    const uint64_t start = nowUs();
+    while (_next.load() != seq && nowUs() - start < 5000000)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return _result;
+  }
+
+private:
+  bool readExact(uint8_t *to, size_t n)
+  {
+    while (n)
+    {
+      const ssize_t r = recv(_conn, to, n, 0);
+      if (r <= 0)
+      {
+        return false;
+      }
+      to += r;
+      n -= r;
+    }
+    return true;
+  }
+
+  void sendText(const std::string &text)
+  {
+    std::vector<uint8_t> frame{0x81, (uint8_t)text.size()};
+    frame.insert(frame.end(), text.begin(), text.end());
+    send(_conn, frame.data(), frame.size(), MSG_NOSIGNAL);
+  }
+
+  void grant(uint32_t until)
+  {
+    _until = until;
+    sendText("{\"type\":\"stream_credit\",\"data\":{\"id\":1,\"until\":" + std::to_string(until) + "}}");
+  }
+
+  void run()
+  {
+    _conn = accept(_listen, nullptr, nullptr);
+    if (_conn < 0)
+    {
+      return;
+    }
+    const int one = 1;
+    setsockopt(_conn, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    std::string request;
+    char c;
+    while (request.find("\r\n\r\n") == std::string::npos && recv(_conn, &c, 1, 0) == 1)
+    {
+      request += c;
+    }
+    // Accept key for the fixed nonce the host client sends
+    const char *reply = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                        "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n";
+    send(_conn, reply, strlen(reply), MSG_NOSIGNAL);
+
+    std::vector<uint8_t> payload;
+    while (!_stop)
+    {
+      uint8_t h[2];
+      if (!readExact(h, 2))
+      {
+        return;
+      }
+      const uint8_t opcode = h[0] & 0x0F;
+      uint64_t length = h[1] & 0x7F;
+      if (length == 126 || length == 127)
+      {
+        uint8_t ext[8];
+        const size_t n = length == 126 ? 2 : 8;
+        if (!readExact(ext, n))
+        {
+          return;
+        }
+        length = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+          length = length << 8 | ext[i];
+        }
+      }
+      uint8_t mask[4] = {};
+      if ((h[1] & 0x80) && !readExact(mask, 4))
+      {
+        return;
+      }
+      payload.resize(length);
+      if (length && !readExact(payload.data(), length))
+      {
+        return;
+      }
+      for (size_t i = 0; i < length; i++)
+      {
+        payload[i] ^= mask[i & 3];
+      }
+      if (opcode == 0x1)
+      {
+        const std::string text(payload.begin(), payload.end());
+        const size_t at = text.find("\"seq\":");
+        if (text.find("stream_open") != std::string::npos && at != std::string::npos)
+        {
+          _next = (uint32_t)strtoul(text.c_str() + at + 6, nullptr, 10);
+          grant(_next + WINDOW);
+        }
+      }
+      else if (opcode == 0x2)
+      {
+        chunk(payload);
+      }
+      else if (opcode == 0x9)
+      {
+        const uint8_t pong[2] = {0x8A, 0};
+        send(_conn, pong, 2, MSG_NOSIGNAL);
+      }
+    }
+  }
+
+  void chunk(const std::vector<uint8_t> &p)
+  {
+    ServerResult &r = _result;
+    if (p.size() < ZiLinkStream::HEADER_BYTES || p[0] != ZiLinkStream::MARKER || p[1] != 1 || p[2] != 1 ||
+        (p.size() - ZiLinkStream::HEADER_BYTES) % 2)
+    {
+      r.errors++;
+      return;
+    }
+    uint32_t seq = 0, index = 0;
+    for (int i = 3; i >= 0; i--)
+    {
+      seq = seq << 8 | p[4 + i];
+      index = index << 8 | p[8 + i];
+    }
+    const bool gap = p[3] & ZiLinkStream::FLAG_GAP;
+    const uint32_t n = (p.size() - ZiLinkStream::HEADER_BYTES) / 2;
+    // In order, within credit, and the gap flag exactly where samples are missing
+    if (seq != _next || (int32_t)(seq - _until) >= 0 || (int32_t)(index - _index) < 0 || gap != (index != _index))
+    {
+      r.errors++;
+    }
+    for (uint32_t i = 0; i < n; i++)
+    {
+      const int16_t v = (int16_t)(p[12 + 2 * i] | p[13 + 2 * i] << 8);
+      if (v != sampleAt(index + i))
+      {
+        r.errors++;
+        break;
+      }
+    }
+    if (_consumeUs)
+    {
+      std::this_thread::sleep_for(std::chrono::microseconds(_consumeUs));
+    }
+    r.gapFlags += gap;
+    r.missing += index - _index;
+    _index = index + n;
+    r.chunks++;
+    r.samples += n;
+    r.bytes += p.size();
+    r.lastUs = nowUs();
+    if (!r.firstUs)
+    {
+      r.firstUs = r.lastUs;
+    }
+    // Last: result() reads the counters once it sees this
+    _next = seq + 1;
+    if ((int32_t)(_until - _next) <= (int32_t)WINDOW / 2)
+    {
+      grant(_next + WINDOW);
+    }
+  }
+
+  const uint32_t _consumeUs;
+  int _listen = -1;
+  int _conn = -1;
+  uint16_t _port = 0;
+  std::atomic<bool> _stop{false};
+  std::thread _thread;
+  std::atomic<uint32_t> _next{0};
+  uint32_t _until = 0;
+  uint32_t _index = 0;
+  ServerResult _result;
+};
+
+struct Run
+{
+  ZiLinkStream::Stats device;
+  ServerResult server;
+  double seconds;
+  uint64_t offered;
+};
+
+// rate 0: the producer writes whenever the stream has room
+static Run stream(uint32_t rate, uint32_t seconds, uint32_t consumeUsPerChunk, uint16_t blockSamples)
+{
+  Server server(consumeUsPerChunk);
+  WebSocketsClient ws;
+  ZiLinkStream s;
+  s.begin(1, "mic", ZiLinkStream::Int16, rate ? rate : 16000, blockSamples);
+  ws.onEvent([&](WStype_t type, uint8_t *payload, size_t)
+             {
+    if (type == WStype_CONNECTED) {
+      s.revoke();
+      char open[160];
+      const int n = snprintf(open, sizeof(open),
+                             "{\"type\":\"stream_open\",\"data\":{\"id\":1,\"name\":\"mic\",\"format\":\"int16\","
+                             "\"rate\":%u,\"chunk\":%u,\"seq\":%u}}",
+                             s.sampleRate(), s.chunkSamples(), s.seq());
+      ws.sendTXT(open, n);
+    } else if (type == WStype_TEXT) {
+      // What ZiLinkInbound does on the device; the host has no ArduinoJson
+      const char *until = strstr((const char *)payload, "\"until\":");
+      if (until && strstr((const char *)payload, "stream_credit")) {
+        s.grant((uint32_t)strtoul(until + 8, nullptr, 10));
+      }
+    } });
+  ws.begin("127.0.0.1", server.port(), "/ws");
+  while (!ws.isConnected())
+  {
+    ws.loop();
+  }
+
+  std::atomic<bool> producing{true};
+  std::atomic<uint64_t> offered{0};
+  std::thread producer([&]
+                       {
+    std::vector<int16_t> buf(4096);
+    uint32_t index = 0;
+    const uint64_t start = nowUs();
+    while (producing) {
+      size_t n;
+      if (rate) {
+        n = (size_t)((nowUs() - start) * rate / 1000000 - index);
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+      } else {
+        n = s.space();
+        if (!n) {
+          std::this_thread::yield();
+          continue;
+        }
+      }
+      n = n < buf.size() ? n : buf.size();
+      for (size_t i = 0; i < n; i++) {
+        buf[i] = sampleAt(index + i);
+      }
+      s.write(buf.data(), n);
+      index += n;
+      offered = index;
+    } });
+
+  const uint64_t start = nowUs();
+  while (nowUs() - start < (uint64_t)seconds * 1000000)
+  {
+    ws.loop();
+    s.service([&](uint8_t *chunk, size_t length)
+              { return ws.sendBIN(chunk - WEBSOCKETS_MAX_HEADER_SIZE, length, true); },
+              4);
+    if (!s.pending())
+    {
+      std::this_thread::yield();
+    }
+  }
+  producing = false;
+  producer.join();
+  s.flush();
+  // Drain what was accepted
+  const uint64_t drainStart = nowUs();
+  while (s.pending() && nowUs() - drainStart < 2000000)
+  {
+    ws.loop();
+    s.service([&](uint8_t *chunk, size_t length)
+              { return ws.sendBIN(chunk - WEBSOCKETS_MAX_HEADER_SIZE, length, true); },
+              4);
+  }
+  Run r;
+  r.server = server.result(s.seq());
+  r.device = s.stats();
+  r.offered = offered;
+  r.seconds = (r.server.lastUs - r.server.firstUs) / 1e6;
+  ws.disconnect();
+  return r;
+}
+
+static void report(const char *label, const Run &r)
+{
+  const double rate = r.server.samples / (r.seconds > 0 ? r.seconds : 1);
+  printf("%-34s %9.0f %9.2f %8u %9u %9llu %9u %6u\n", label, rate, r.server.bytes / (r.seconds > 0 ? r.seconds : 1) / 1e6,
+         r.server.chunks, r.device.dropped, (unsigned long long)r.server.missing, r.device.creditStalls, r.server.errors);
+  check(r.server.errors == 0, label);
+  // Everything the stream took arrived; everything it refused is counted
+  check(r.server.samples == r.device.samples, "accepted samples delivered");
+  check(r.device.samples + r.device.dropped == r.offered, "offered = accepted + dropped");
+  check(r.server.missing <= r.device.dropped, "missing <= dropped");
+}
+
+int main()
+{
+  ZiLinkHost::setMode(ZiLinkHost::Sockets);
+  printf("%-34s %9s %9s %8s %9s %9s %9s %6s\n", "case", "samples/s", "MB/s", "chunks", "dropped", "missing",
+         "no credit", "errors");
+
+  Run realtime = stream(16000, 3, 0, 512);
+  report("16 kHz int16, real time", realtime);
+  check(realtime.device.dropped == 0, "16 kHz real time drops nothing");
+
+  Run full = stream(0, 3, 0, 2048);
+  report("as fast as possible, 4 KB blocks", full);
+  printf("  = %.0f concurrent 16 kHz int16 streams\n", full.server.samples / full.seconds / 16000);
+
+  // 253 samples per chunk every 40 ms is ~6.3 kHz
+  Run slow = stream(16000, 3, 40000, 512);
+  report("16 kHz into a ~6 kHz consumer", slow);
+  check(slow.device.dropped > 0 && slow.server.gapFlags > 0, "slow consumer: drops flagged");
+  check(slow.device.creditStalls > 0, "slow consumer: credit held the sender back");
+
+  return benchResult();
+}
@@ -0,0 +1,216 @@
+// Host check for server throttling: ZiLinkThrottle's token bucket against
+// a simulated clock (long-run rate, burst, credit, renewal, expiry), and
+// ZiLinkCoalescer against a reference merge of random readings. Exits
+// non-zero on a mismatch.
+//
+//   g++ -O2 -std=c++17 -I../../src throttle_bench.cpp ../../src/ZiLinkThrottle.cpp ../../src/ZiLinkCoalescer.cpp
+
+#include <ZiLinkCoalescer.h>
+#include <ZiLinkThrottle.h>
+#include "bench_check.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A sender that wants to send every loopMs for durationMs; returns the frames let through
+static uint32_t drive(ZiLinkThrottle &t, uint32_t &nowMs, uint32_t loopMs, uint32_t durationMs)
+{
+  uint32_t sent = 0;
+  for (uint32_t end = nowMs + durationMs; (int32_t)(nowMs - end) < 0; nowMs += loopMs)
+  {
+    sent += t.take(nowMs);
+  }
+  return sent;
+}
+
+static void rates()
+{
+  printf("%-10s %-6s %10s %10s\n", "rate/s", "burst", "expected", "sent");
+  const float cases[] = {0.5f, 1.0f, 2.5f, 10.0f, 33.3f, 200.0f};
+  for (float rate : cases)
+  {
+    ZiLinkThrottle t;
+    uint32_t now = 0xFFFFF000u; // wraps during the run
+    t.set(rate, 4, 0, 3600000, now);
+    const uint32_t sent = drive(t, now, 1, 60000);
+    // The full bucket at the start, then the rate
+    const double expected = 4 + rate * 60.0;
+    printf("%-10.1f %-6u %10.1f %10u\n", rate, 4, expected, sent);
+    check(std::fabs(sent - expected) <= 1.0 + expected * 0.002, "long-run rate");
+  }
+}
+
+static void lifecycle()
+{
+  ZiLinkThrottle t;
+  uint32_t now = 1000;
+  check(!t.limited(now) && t.rate(now) == 0 && t.take(now), "unlimited before any throttle");
+  t.refund();
+  check(!t.limited(now), "refund while unlimited is a no-op");
+
+  // Default burst: one second's worth
+  t.set(5, 0, 0, 10000, now);
+  check(t.limited(now) && t.rate(now) == 5, "limited");
+  check(drive(t, now, 1, 1) == 1 && drive(t, now, 1, 4) == 4, "burst of 5 drains");
+  check(!t.take(now), "empty bucket");
+  now += 200;
+  check(t.take(now) && !t.take(now), "one token per 200 ms");
+
+  // A renewal keeps the bucket level instead of refilling it
+  t.set(5, 0, 0, 10000, now);
+  check(!t.take(now), "renewal does not refill");
+  // Credit comes on top of the bucket
+  t.set(5, 0, 3, 10000, now);
+  check(drive(t, now, 1, 3) == 3 && !t.take(now), "credit of 3");
+
+  // Credit only: no refill
+  t.set(0, 1, 2, 10000, now);
+  check(t.limited(now) && t.rate(now) == 0, "credit-only limit");
+  now += 5000;
+  check(t.take(now) && t.take(now) && !t.take(now), "credit-only takes exactly the credit");
+  // A frame that could not go out gives its token back
+  t.set(0, 1, 1, 10000, now);
+  check(t.take(now) && !t.take(now), "credit of 1 taken");
+  t.refund();
+  check(t.take(now) && !t.take(now), "refunded token is taken again");
+
+  // Expiry without renewal
+  t.set(1, 1, 0, 2000, now);
+  check(t.limited(now + 1999), "still limited before ttl");
+  check(!t.limited(now + 2000) && t.take(now + 2000), "lapses at ttl");
+
+  // Lift
+  t.set(1, 1, 0, 60000, now);
+  t.set(0, 0, 0, 0, now);
+  check(!t.limited(now) && t.rate(now) == 0, "rate 0 lifts");
+  check(t.stats().updates == 8, "updates counted");
+
+  // Waits are counted once per episode
+  ZiLinkThrottle w;
+  w.set(1, 1, 0, 0, 0);
+  w.take(0);
+  for (uint32_t ms = 0; ms < 999; ms++)
+  {
+    w.take(ms);
+  }
+  check(w.stats().waits == 1, "one wait per empty stretch");
+}
+
+typedef std::vector<std::pair<std::string, std::string>> Members;
+
+static std::string render(const Members &m)
+{
+  std::string s = "{";
+  for (size_t i = 0; i < m.size(); i++)
+  {
+    s += (i ? "," : "") + m[i].first + ":" + m[i].second;
+  }
+  return s + "}";
+}
+
+static void coalescer()
+{
+  std::mt19937 rng(18);
+  const char *keys[] = {"\"t\"", "\"hum\"", "\"a,b\"", "\"q\\\"}\"", "\"vib\"", "\"pos\"", "\"on\"", "\"k7\""};
+  const char *values[] = {"1", "-21.5", "true", "null", "\"x,}\"", "[1,[2,3]]", "{\"x\":{\"y\":[1,\"}\"]}}",
+                          "1234567.25"};
+  uint32_t rounds = 0, merges = 0;
+  for (int round = 0; round < 2000; round++)
+  {
+    ZiLinkCoalescer c(256);
+    Members ref;
+    const int n = 1 + rng() % 12;
+    for (int i = 0; i < n; i++)
+    {
+      Members reading;
+      const int members = rng() % 4;
+      for (int j = 0; j < members; j++)
+      {
+        reading.push_back({keys[rng() % 8], values[rng() % 8]});
+      }
+      std::string text = render(reading);
+      if (rng() % 4 == 0)
+      {
+        // Whitespace where JSON allows it
+        text = " { " + (reading.empty() ? std::string() : text.substr(1, text.size() - 2)) + " }\n";
+      }
+      Members next = ref;
+      for (const auto &m : reading)
+      {
+        bool found = false;
+        for (auto &r : next)
+        {
+          if (r.first == m.first)
+          {
+            r.second = m.second;
+            found = true;
+            break;
+          }
+        }
+        if (!found)
+        {
+          next.push_back(m);
+        }
+      }
+      const bool fits = render(next).size() <= 256;
+      const bool merged = c.merge(text.c_str(), text.size());
+      // The size check is conservative: a merge that fits may still be refused
+      check(merged || !fits || render(ref).size() + text.size() > 256, "merge refused with room to spare");
+      if (merged)
+      {
+        ref = next;
+        merges++;
+      }
+      const std::string got = c.empty() ? "{}" : std::string(c.data(), c.length());
+      if (got != render(ref))
+      {
+        printf("  got  %s\n  want %s\n", got.c_str(), render(ref).c_str());
+        check(false, "coalesced reading");
+        return;
+      }
+    }
+    rounds++;
+  }
+  printf("coalescer: %u rounds, %u merges match the reference\n", rounds, merges);
+
+  ZiLinkCoalescer c;
+  const char *bad[] = {"", "[1,2]", "{", "{\"a\"}", "{\"a\":}", "{\"a\":1,}", "{\"a\":1}}", "\"a\":1", "{a:1}"};
+  check(c.merge("{\"a\":1}", 7), "valid reading");
+  for (const char *b : bad)
+  {
+    check(!c.merge(b, strlen(b)), b);
+  }
+  check(std::string(c.data(), c.length()) == "{\"a\":1}", "rejected readings leave it unchanged");
+  check(c.merge("{}", 2) && c.length() == 7, "empty object merges to nothing");
+}
+
+static void cost()
+{
+  ZiLinkCoalescer c;
+  const char reading[] = "{\"temperature\":21.5,\"humidity\":40.25,\"pressure\":1013.2,\"vibration\":[0.1,0.2]}";
+  volatile size_t sink = 0;
+  const int n = 200000;
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < n; i++)
+  {
+    c.merge(reading, sizeof(reading) - 1);
+    sink = sink + c.length();
+  }
+  const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / n;
+  printf("merge of a 4-sensor reading into a pending one: %.0f ns\n", ns);
+}
+
+int main()
+{
+  rates();
+  lifecycle();
+  coalescer();
+  cost();
+  return benchResult();
+}
@@ -0,0 +1,125 @@
+// Host-side check of ZiLinkTransportRouter: a minute of component updates
+// (50/s) over two simulated links while the WebSocket gets congested,
+// recovers and drops out. Frames go through the same path as in the library
+// (send directly when nothing is queued, else queue and drain in order), and
+// every frame must arrive exactly once and in order. Run with and without
+// hysteresis to see the flapping it prevents.
+//
+//   g++ -O2 -std=c++17 -I../../src transport_bench.cpp ../../src/ZiLinkTransport.cpp ../../src/ZiLinkRingBuffer.cpp -o transport_bench
+//   ./transport_bench
+//
+// Time is simulated; each send advances it by the link's send duration.
+
+#include "ZiLinkRingBuffer.h"
+#include "ZiLinkTransport.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static uint64_t g_nowUs = 0;
+static std::mt19937 g_rng(7);
+static std::vector<uint32_t> g_delivered;
+
+struct SimLink : ZiLinkTransport
+{
+        const char *label;
+        bool up = true;
+        uint32_t sendUs; // mean, +-50% jitter
+        uint32_t failPercent = 0;
+        uint32_t frames = 0;
+
+        SimLink(const char *label, uint32_t sendUs) : label(label), sendUs(sendUs) {}
+        const char *name() const override { return label; }
+        bool ready() override { return up; }
+        bool send(const char *data, size_t) override
+        {
+          const uint32_t us = sendUs / 2 + g_rng() % (sendUs + 1);
+          const bool ok = up && g_rng() % 100 >= failPercent;
+          g_nowUs += us;
+          health.record(ok, us);
+          if (ok)
+          {
+            uint32_t seq;
+            memcpy(&seq, data, sizeof(seq));
+            g_delivered.push_back(seq);
+            frames++;
+          }
+          return ok;
+        }
+};
+
+static void run(const char *title, uint8_t hysteresisPercent, uint32_t minDwellMs)
+{
+  SimLink ws("ws", 400);
+  SimLink mqtt("mqtt", 500);
+  ZiLinkTransportRouter router;
+  router.add(&ws);
+  router.add(&mqtt);
+  router.setHysteresis(hysteresisPercent, minDwellMs);
+  ZiLinkRingBuffer queue(2048);
+  g_delivered.clear();
+  g_nowUs = 0;
+
+  const uint32_t frames = 3000;
+  for (uint32_t seq = 0; seq < frames; seq++)
+  {
+    const uint64_t at = (uint64_t)seq * 20000;
+    if (g_nowUs < at)
+    {
+      g_nowUs = at;
+    }
+    const uint32_t s = (uint32_t)(at / 1000000);
+    ws.sendUs = s >= 10 && s < 25 ? 20000 : 400; // congested: slow and lossy
+    ws.failPercent = s >= 10 && s < 25 ? 30 : 0;
+    ws.up = !(s >= 35 && s < 40);
+
+    // Queued frames first, on whichever link is picked now
+    queue.drain([&](const ZiLinkRingBuffer::Record &r)
+                {
+      ZiLinkTransport *t = router.select((uint32_t)(g_nowUs / 1000));
+      return t && t->send(r.data, r.length); });
+    char frame[sizeof(seq)];
+    memcpy(frame, &seq, sizeof(seq));
+    ZiLinkTransport *t = router.select((uint32_t)(g_nowUs / 1000));
+    if (queue.pending(1) || !t || !t->send(frame, sizeof(frame)))
+    {
+      queue.push(1, 0, frame, sizeof(frame));
+    }
+  }
+  while (!queue.empty())
+  {
+    ws.up = true;
+    ws.failPercent = 0;
+    queue.drain([&](const ZiLinkRingBuffer::Record &r)
+                {
+      ZiLinkTransport *t = router.select((uint32_t)(g_nowUs / 1000));
+      return t && t->send(r.data, r.length); });
+  }
+
+  uint32_t outOfOrder = 0;
+  std::vector<uint8_t> seen(frames, 0);
+  for (size_t i = 0; i < g_delivered.size(); i++)
+  {
+    seen[g_delivered[i]]++;
+    outOfOrder += i > 0 && g_delivered[i] < g_delivered[i - 1];
+  }
+  uint32_t lost = 0;
+  uint32_t duplicated = 0;
+  for (uint8_t n : seen)
+  {
+    lost += n == 0;
+    duplicated += n > 1;
+  }
+  printf("%-28s switches %3u  ws %4u  mqtt %4u  lost %u  duplicated %u  out of order %u  queue drops %u\n", title,
+         router.switches(), ws.frames, mqtt.frames, lost, duplicated, outOfOrder, queue.stats().dropped);
+}
+
+int main()
+{
+  run("no hysteresis", 0, 0);
+  run("25%, 2 s dwell (default)", 25, 2000);
+  run("50%, 5 s dwell", 50, 5000);
+  return 0;
+}
@@ -0,0 +1,369 @@
+// Component frames by id versus by widget schema index, over a real local
+// socket: ZiLinkEsp32 (Sockets mode) connects to a stand-in server that
+// answers auth (offering MessagePack when asked) and records every frame.
+// The same run of updates to four components goes out
+//
+//   1. through createSlider()/createToggle()/... with the id and type
+//   2. through updateWidget() after setWidgets(): the schema is announced
+//      once, then each update carries the widget's index
+//
+// once as JSON and once as MessagePack. Reports bytes per update frame,
+// the one-off schema frame and the time spent in each update call.
+//
+// Exits non-zero unless every update arrives, the schema is sent exactly
+// once per session and indexed frames are at most 60% (JSON, whose envelope
+// stays) and a quarter (MessagePack) the size of frames by id. Needs ArduinoJson:
+//
+//   g++ -O2 -std=gnu++17 -pthread -I../host -I../../src -I<ArduinoJson>/src widget_bench.cpp ../host/*.cpp ../../src/*.cpp
+
+#include <ZiLinkHost.h>
+#include <ZiLinkEsp32.h>
+#include "bench_check.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+static uint64_t nowUs()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+constexpr ZiLinkWidget WIDGETS[] = {
+    {"fan_speed", ZiLinkWidget::Slider},
+    {"garage_door", ZiLinkWidget::Button},
+    {"porch_light", ZiLinkWidget::Toggle},
+    {"water_tank_level", ZiLinkWidget::Progress},
+};
+static_assert(zilinkWidgetsValid(WIDGETS), "widget ids");
+constexpr ZiLinkSliderRef FAN = zilinkWidget<ZiLinkWidget::Slider>(WIDGETS, "fan_speed");
+constexpr ZiLinkButtonRef DOOR = zilinkWidget<ZiLinkWidget::Button>(WIDGETS, "garage_door");
+constexpr ZiLinkToggleRef LIGHT = zilinkWidget<ZiLinkWidget::Toggle>(WIDGETS, "porch_light");
+constexpr ZiLinkProgressRef TANK = zilinkWidget<ZiLinkWidget::Progress>(WIDGETS, "water_tank_level");
+
+struct Frame
+{
+  bool binary;
+  std::string payload;
+};
+
+// One connection: upgrade, auth_success, then every frame
+class Server
+{
+public:
+  explicit Server(bool msgpack) : _msgpack(msgpack)
+  {
+    _listen = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(_listen, (sockaddr *)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(_listen, (sockaddr *)&addr, &len);
+    _port = ntohs(addr.sin_port);
+    listen(_listen, 1);
+    _thread = std::thread([this]
+                          { run(); });
+  }
+
+  ~Server()
+  {
+    _stop = true;
+    _thread.join();
+    close(_listen);
+  }
+
+  uint16_t port() const { return _port; }
+  bool authed() const { return _authed; }
+
+  std::vector<Frame> frames()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _frames;
+  }
+
+private:
+  void run()
+  {
+    pollfd p = {_listen, POLLIN, 0};
+    while (!_stop && poll(&p, 1, 5) != 1)
+    {
+    }
+    if (_stop)
+    {
+      return;
+    }
+    const int fd = accept(_listen, nullptr, nullptr);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    std::string rx;
+    bool upgraded = false;
+    while (!_stop)
+    {
+      pollfd c = {fd, POLLIN, 0};
+      if (poll(&c, 1, 5) != 1)
+      {
+        continue;
+      }
+      char buf[16384];
+      const ssize_t r = recv(fd, buf, sizeof(buf), 0);
+      if (r <= 0)
+      {
+        break;
+      }
+      rx.append(buf, r);
+      if (!upgraded)
+      {
+        const size_t end = rx.find("\r\n\r\n");
+        if (end == std::string::npos)
+        {
+          continue;
+        }
+        rx.erase(0, end + 4);
+        const char upgrade[] = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                               "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n";
+        send(fd, upgrade, sizeof(upgrade) - 1, MSG_NOSIGNAL);
+        upgraded = true;
+      }
+      Frame frame;
+      while (nextFrame(rx, frame))
+      {
+        if (!_authed)
+        {
+          const std::string reply = _msgpack ? "{\"type\":\"auth_success\",\"data\":{\"encoding\":\"msgpack\"}}"
+                                             : "{\"type\":\"auth_success\",\"data\":{}}";
+          const uint8_t head[] = {0x81, (uint8_t)reply.size()};
+          send(fd, head, sizeof(head), MSG_NOSIGNAL);
+          send(fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+          _authed = true;
+          continue;
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        _frames.push_back(frame);
+      }
+    }
+    close(fd);
+  }
+
+  // Unmasks the client frame at the front of rx
+  static bool nextFrame(std::string &rx, Frame &frame)
+  {
+    if (rx.size() < 2)
+    {
+      return false;
+    }
+    size_t length = (uint8_t)rx[1] & 0x7F;
+    size_t at = 2;
+    if (length == 126)
+    {
+      if (rx.size() < 4)
+      {
+        return false;
+      }
+      length = ((uint8_t)rx[2] << 8) | (uint8_t)rx[3];
+      at = 4;
+    }
+    if (rx.size() < at + 4 + length)
+    {
+      return false;
+    }
+    frame.binary = ((uint8_t)rx[0] & 0x0F) == 2;
+    frame.payload.resize(length);
+    for (size_t i = 0; i < length; i++)
+    {
+      frame.payload[i] = rx[at + 4 + i] ^ rx[at + (i & 3)];
+    }
+    rx.erase(0, at + 4 + length);
+    return true;
+  }
+
+  const bool _msgpack;
+  int _listen = -1;
+  uint16_t _port = 0;
+  std::thread _thread;
+  std::atomic<bool> _stop{false};
+  std::atomic<bool> _authed{false};
+  std::mutex _mutex;
+  std::vector<Frame> _frames;
+};
+
+struct Run
+{
+  bool binary = false;   // the session ran MessagePack
+  size_t updates = 0;    // update frames received
+  size_t updateBytes = 0;
+  size_t schemas = 0;
+  size_t schemaBytes = 0;
+  double usPerUpdate = 0;
+  std::string sample;    // first update frame
+};
+
+static const int ROUNDS = 50;
+
+static bool isUpdate(const Frame &f, bool widgets)
+{
+  if (f.binary)
+  {
+    // fixarray, then the kind
+    return f.payload.size() > 1 && (uint8_t)f.payload[1] == (widgets ? ZILINK_KIND_WIDGET : ZILINK_KIND_COMPONENT);
+  }
+  return widgets ? f.payload.rfind("{\"type\":\"c\",", 0) == 0
+                 : f.payload.find("\"id\":") != std::string::npos && f.payload.find("snapshot") == std::string::npos;
+}
+
+static Run measure(bool msgpack, bool widgets)
+{
+  Run r;
+  Server server(msgpack);
+  ZiLinkEsp32 link;
+  ZiLinkComponentTable::Config config;
+  config.minIntervalMs = 0; // every change is a frame
+  link.setComponentDefaults(config);
+  if (msgpack)
+  {
+    link.setWireEncoding(ZiLinkEsp32::EncodingMsgPack);
+  }
+  if (widgets)
+  {
+    link.setWidgets(WIDGETS);
+  }
+  link.setupWebSocket("127.0.0.1", server.port(), "/ws", "bench", "token");
+  const uint64_t deadline = nowUs() + 5000000ull;
+  while (!server.authed() && nowUs() < deadline)
+  {
+    link.loop();
+    usleep(100);
+  }
+  for (int i = 0; i < 20; i++)
+  {
+    link.loop();
+    usleep(100);
+  }
+  r.binary = link.wireEncoding() == ZiLinkEsp32::EncodingMsgPack;
+
+  uint64_t spent = 0;
+  for (int i = 0; i < ROUNDS; i++)
+  {
+    const uint64_t start = nowUs();
+    if (widgets)
+    {
+      link.updateWidget(FAN, 10 + i);
+      link.updateWidget(DOOR, i % 2 == 0);
+      link.updateWidget(LIGHT, i % 2 == 1);
+      link.updateWidget(TANK, 1000 + 7 * i);
+    }
+    else
+    {
+      link.createSlider(10 + i, "fan_speed");
+      link.createButton(i % 2 == 0, "garage_door");
+      link.createToggle(i % 2 == 1, "porch_light");
+      link.createProgress(1000 + 7 * i, "water_tank_level");
+    }
+    spent += nowUs() - start;
+    link.loop();
+  }
+  r.usPerUpdate = (double)spent / (ROUNDS * 4);
+
+  size_t seen = 0;
+  uint64_t quietSince = nowUs();
+  while (nowUs() - quietSince < 100000 && nowUs() < deadline + 5000000ull)
+  {
+    link.loop();
+    const size_t n = server.frames().size();
+    if (n != seen)
+    {
+      seen = n;
+      quietSince = nowUs();
+    }
+    usleep(200);
+  }
+  for (const Frame &f : server.frames())
+  {
+    const bool schema = f.binary ? f.payload.size() > 1 && (uint8_t)f.payload[1] == ZILINK_KIND_COMPONENT_SCHEMA
+                                 : f.payload.find("\"component_schema\"") != std::string::npos;
+    if (schema)
+    {
+      r.schemas++;
+      r.schemaBytes += f.payload.size();
+    }
+    else if (isUpdate(f, widgets))
+    {
+      if (r.updates == 0)
+      {
+        r.sample = f.payload;
+      }
+      r.updates++;
+      r.updateBytes += f.payload.size();
+    }
+  }
+  return r;
+}
+
+static std::string printable(const std::string &payload, bool binary)
+{
+  if (!binary)
+  {
+    return payload;
+  }
+  std::string hex;
+  char b[4];
+  for (unsigned char c : payload)
+  {
+    snprintf(b, sizeof(b), "%02x ", c);
+    hex += b;
+  }
+  return hex;
+}
+
+static void report(const char *label, const Run &r)
+{
+  printf("%-22s %8zu %12.1f %13zu %10.2f   %s\n", label, r.updates, r.updates ? (double)r.updateBytes / r.updates : 0.0,
+         r.schemaBytes, r.usPerUpdate, printable(r.sample, r.binary).c_str());
+}
+
+int main()
+{
+  ZiLinkHost::setMode(ZiLinkHost::Sockets);
+  printf("%-22s %8s %12s %13s %10s   %s\n", "case", "frames", "bytes/frame", "schema bytes", "us/update",
+         "first frame");
+  const Run jsonById = measure(false, false);
+  report("JSON, by id", jsonById);
+  const Run jsonIndexed = measure(false, true);
+  report("JSON, by index", jsonIndexed);
+  const Run mpById = measure(true, false);
+  report("MessagePack, by id", mpById);
+  const Run mpIndexed = measure(true, true);
+  report("MessagePack, by index", mpIndexed);
+
+  const size_t expected = ROUNDS * 4;
+  for (const Run *r : {&jsonById, &jsonIndexed, &mpById, &mpIndexed})
+  {
+    check(r->updates == expected, "every update arrives as its own frame");
+  }
+  check(jsonById.schemas == 0 && mpById.schemas == 0, "no schema without setWidgets()");
+  check(jsonIndexed.schemas == 1 && mpIndexed.schemas == 1, "the schema is announced once per session");
+  check(jsonIndexed.updateBytes * 5 <= jsonById.updateBytes * 3, "JSON: indexed frames at most 60% the size");
+  if (mpById.binary && mpIndexed.binary)
+  {
+    check(mpIndexed.updateBytes * 4 <= mpById.updateBytes, "MessagePack: indexed frames at most a quarter the size");
+  }
+  else
+  {
+    printf("(MessagePack not negotiated: ArduinoJson without the auth reply's encoding)\n");
+  }
+
+  return benchResult();
+}
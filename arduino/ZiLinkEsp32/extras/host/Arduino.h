@@ -0,0 +1,131 @@
+#ifndef ZILINK_HOST_ARDUINO_H
+#define ZILINK_HOST_ARDUINO_H
+
+// Host stand-in for the parts of the Arduino core the library uses
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+// Arduino String over std::string (heap-backed like the real one)
+class String
+{
+public:
+        String() {}
+        String(const char *s) : _s(s ? s : "") {}
+        String(const std::string &s) : _s(s) {}
+        explicit String(char c) : _s(1, c) {}
+        explicit String(int v) : _s(std::to_string(v)) {}
+        explicit String(unsigned int v) : _s(std::to_string(v)) {}
+        explicit String(long v) : _s(std::to_string(v)) {}
+        explicit String(unsigned long v) : _s(std::to_string(v)) {}
+        explicit String(double v, unsigned int decimals = 2);
+
+        const char *c_str() const { return _s.c_str(); }
+        unsigned int length() const { return (unsigned int)_s.size(); }
+        bool isEmpty() const { return _s.empty(); }
+        bool reserve(unsigned int size)
+        {
+                _s.reserve(size);
+                return true;
+        }
+        bool concat(const char *s, unsigned int length)
+        {
+                _s.append(s, length);
+                return true;
+        }
+        String substring(unsigned int from) const { return from < _s.size() ? String(_s.substr(from)) : String(); }
+        String substring(unsigned int from, unsigned int to) const
+        {
+                return from < _s.size() && from < to ? String(_s.substr(from, to - from)) : String();
+        }
+        int indexOf(char c) const
+        {
+                const size_t at = _s.find(c);
+                return at == std::string::npos ? -1 : (int)at;
+        }
+        bool startsWith(const char *prefix) const { return _s.compare(0, strlen(prefix), prefix) == 0; }
+        char operator[](unsigned int i) const { return i < _s.size() ? _s[i] : 0; }
+
+        String &operator+=(const String &s)
+        {
+                _s += s._s;
+                return *this;
+        }
+        String &operator+=(const char *s)
+        {
+                _s += s;
+                return *this;
+        }
+        String &operator+=(char c)
+        {
+                _s += c;
+                return *this;
+        }
+        bool operator==(const String &s) const { return _s == s._s; }
+        bool operator==(const char *s) const { return _s == (s ? s : ""); }
+        bool operator!=(const String &s) const { return _s != s._s; }
+        bool operator!=(const char *s) const { return !(*this == s); }
+
+        friend String operator+(const String &a, const String &b) { return String(a._s + b._s); }
+        friend String operator+(const String &a, const char *b) { return String(a._s + b); }
+        friend String operator+(const char *a, const String &b) { return String(a + b._s); }
+
+private:
+        std::string _s;
+};
+
+class Print
+{
+public:
+        virtual ~Print() {}
+        virtual size_t write(uint8_t c) = 0;
+        virtual size_t write(const uint8_t *data, size_t length);
+};
+
+class Stream : public Print
+{
+public:
+        virtual int available() = 0;
+        virtual int read() = 0;
+        virtual int peek() = 0;
+};
+
+class Client : public Stream
+{
+public:
+        virtual int connect(const char *host, uint16_t port) = 0;
+        virtual uint8_t connected() = 0;
+        virtual void stop() = 0;
+        virtual int read(uint8_t *buffer, size_t length) = 0;
+        using Stream::read;
+        virtual void flush() {}
+};
+
+class HardwareSerial
+{
+public:
+        void begin(unsigned long) {}
+        int printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+        size_t print(const char *s);
+        size_t print(const String &s) { return print(s.c_str()); }
+        size_t println(const char *s = "");
+        size_t println(const String &s) { return println(s.c_str()); }
+};
+
+extern HardwareSerial Serial;
+
+#endif
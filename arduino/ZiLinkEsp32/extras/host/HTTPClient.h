@@ -0,0 +1,34 @@
+#ifndef ZILINK_HOST_HTTP_CLIENT_H
+#define ZILINK_HOST_HTTP_CLIENT_H
+
+#include <WiFi.h>
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+// Blocking HTTP/1.1 client for http:// URLs (one request per connection).
+// InMemory mode answers every POST with 200 without I/O.
+class HTTPClient
+{
+public:
+        bool begin(const String &url);
+        // https:// is not available on the host, so the CA is unused
+        bool begin(const String &url, const char *) { return begin(url); }
+        void addHeader(const String &name, const String &value);
+        int POST(uint8_t *payload, size_t length);
+        int POST(const String &payload) { return POST((uint8_t *)payload.c_str(), payload.length()); }
+        void end();
+        void setTimeout(uint16_t ms) { _timeoutMs = ms; }
+
+private:
+        String _host;
+        uint16_t _port = 80;
+        String _path;
+        String _headers;
+        uint32_t _timeoutMs = 5000;
+        WiFiClient _client;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef ZILINK_HOST_PUB_SUB_CLIENT_H
+#define ZILINK_HOST_PUB_SUB_CLIENT_H
+
+#include <WiFi.h>
+
+#include <vector>
+
+#define MQTT_MAX_PACKET_SIZE 256
+
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char *, uint8_t *, unsigned int)> callback
+
+// MQTT 3.1.1 client (QoS 0) with the PubSubClient API subset the library
+// uses. Like the original, connect() skips the TCP connect when the client
+// is already connected, and publish() refuses a message larger than the
+// buffer (header, topic and payload), which beginPublish()/write()/
+// endPublish() stream instead. InMemory mode connects without a broker and
+// counts publishes.
+class PubSubClient : public Print
+{
+public:
+        PubSubClient() {}
+        explicit PubSubClient(Client &client) : _client(&client) {}
+
+        PubSubClient &setServer(const char *host, uint16_t port);
+        PubSubClient &setCallback(MQTT_CALLBACK_SIGNATURE);
+        PubSubClient &setSocketTimeout(uint16_t seconds);
+        PubSubClient &setKeepAlive(uint16_t seconds);
+        bool setBufferSize(uint16_t size);
+        uint16_t getBufferSize() const { return _bufferSize; }
+
+        bool connect(const char *id, const char *user, const char *pass);
+        bool connected();
+        void disconnect();
+        bool subscribe(const char *topic, uint8_t qos = 0);
+        bool publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained = false);
+        bool publish(const char *topic, const char *payload) { return publish(topic, (const uint8_t *)payload, strlen(payload)); }
+        bool beginPublish(const char *topic, unsigned int length, bool retained);
+        size_t write(uint8_t c) override { return write(&c, 1); }
+        size_t write(const uint8_t *data, size_t length) override;
+        int endPublish() { return 1; }
+        bool loop();
+        int state() const { return _state; }
+
+private:
+        bool writePacket(uint8_t header, const std::vector<uint8_t> &body);
+        bool readPacket(uint8_t &header, std::vector<uint8_t> &body, uint32_t timeoutMs);
+        void lost();
+
+        Client *_client = nullptr;
+        const char *_host = nullptr;
+        uint16_t _port = 1883;
+        std::function<void(char *, uint8_t *, unsigned int)> _callback;
+        uint16_t _socketTimeoutS = 15;
+        uint16_t _keepAliveS = 15;
+        uint16_t _bufferSize = MQTT_MAX_PACKET_SIZE;
+        uint32_t _lastOutMs = 0;
+        uint32_t _lastInMs = 0;
+        bool _pingOutstanding = false;
+        uint16_t _nextPacketId = 1;
+        int _state = MQTT_DISCONNECTED;
+        bool _memoryConnected = false;
+        std::vector<uint8_t> _rx;
+};
+
+#endif
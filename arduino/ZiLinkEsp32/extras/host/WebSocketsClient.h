@@ -0,0 +1,77 @@
+#ifndef ZILINK_HOST_WEBSOCKETS_CLIENT_H
+#define ZILINK_HOST_WEBSOCKETS_CLIENT_H
+
+#include <WiFi.h>
+
+#include <vector>
+
+#define WEBSOCKETS_MAX_HEADER_SIZE (14)
+
+typedef enum
+{
+        WStype_ERROR,
+        WStype_DISCONNECTED,
+        WStype_CONNECTED,
+        WStype_TEXT,
+        WStype_BIN,
+        WStype_FRAGMENT_TEXT_START,
+        WStype_FRAGMENT_BIN_START,
+        WStype_FRAGMENT,
+        WStype_FRAGMENT_FIN,
+        WStype_PING,
+        WStype_PONG,
+} WStype_t;
+
+// ws:// client with the arduinoWebSockets API subset the library uses.
+// loop() (re)connects with a blocking handshake, answers pings and reports
+// whole text/binary messages. TLS (beginSSL) is not available on the host.
+class WebSocketsClient
+{
+public:
+        typedef std::function<void(WStype_t type, uint8_t *payload, size_t length)> WebSocketClientEvent;
+
+        void begin(const char *host, uint16_t port, const char *url = "/", const char *protocol = "arduino");
+        void beginSSL(const char *host, uint16_t port, const char *url = "/", const char *fingerprint = "",
+                      const char *protocol = "arduino");
+        void beginSslWithCA(const char *host, uint16_t port, const char *url = "/", const char *caCert = nullptr,
+                            const char *protocol = "arduino");
+        void onEvent(WebSocketClientEvent callback) { _callback = callback; }
+        void setReconnectInterval(unsigned long ms) { _reconnectMs = ms; }
+        void enableHeartbeat(uint32_t pingIntervalMs, uint32_t pongTimeoutMs, uint8_t disconnectCount);
+
+        // headerToPayload: `payload` starts with WEBSOCKETS_MAX_HEADER_SIZE spare bytes, then `length` bytes of data
+        bool sendTXT(uint8_t *payload, size_t length = 0, bool headerToPayload = false);
+        bool sendTXT(const char *payload, size_t length = 0);
+        bool sendTXT(String &payload) { return sendTXT(payload.c_str(), payload.length()); }
+        bool sendBIN(uint8_t *payload, size_t length, bool headerToPayload = false);
+        bool sendBIN(const uint8_t *payload, size_t length);
+
+        bool isConnected() const { return _connected; }
+        void loop();
+        void disconnect();
+
+private:
+        bool connectSocket();
+        bool sendFrame(uint8_t opcode, const uint8_t *payload, size_t length);
+        bool readFrames();
+        void closed();
+        void emit(WStype_t type, uint8_t *payload, size_t length);
+
+        String _host;
+        uint16_t _port = 0;
+        String _url;
+        bool _ssl = false;
+        WebSocketClientEvent _callback;
+        unsigned long _reconnectMs = 500;
+        unsigned long _lastAttemptMs = 0;
+        bool _attempted = false; // last attempt failed
+        uint32_t _pingIntervalMs = 0;
+        uint32_t _lastPingMs = 0;
+        bool _connected = false;
+        WiFiClient _client;
+        std::vector<uint8_t> _rx;      // bytes not parsed yet
+        std::vector<uint8_t> _message; // fragments of the current message
+        uint8_t _messageOpcode = 0;
+};
+
+#endif
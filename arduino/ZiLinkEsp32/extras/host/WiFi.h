@@ -0,0 +1,44 @@
+#ifndef ZILINK_HOST_WIFI_H
+#define ZILINK_HOST_WIFI_H
+
+#include <Arduino.h>
+
+#define WL_CONNECTED 3
+#define WL_DISCONNECTED 6
+
+class WiFiClass
+{
+public:
+        int status();
+};
+
+extern WiFiClass WiFi;
+
+// TCP client over a POSIX socket. Copies share the socket, which closes
+// with the last copy (as on ESP32).
+class WiFiClient : public Client
+{
+public:
+        WiFiClient() {}
+        // Wraps a connected socket
+        explicit WiFiClient(int fd);
+
+        int connect(const char *host, uint16_t port) override;
+        uint8_t connected() override;
+        void stop() override;
+        size_t write(uint8_t c) override { return write(&c, 1); }
+        size_t write(const uint8_t *data, size_t length) override;
+        int available() override;
+        int read() override;
+        int read(uint8_t *buffer, size_t length) override;
+        int peek() override;
+        void setTimeout(uint32_t ms) { _timeoutMs = ms; }
+        int fd() const;
+
+private:
+        struct Socket;
+        std::shared_ptr<Socket> _socket;
+        uint32_t _timeoutMs = 5000;
+};
+
+#endif
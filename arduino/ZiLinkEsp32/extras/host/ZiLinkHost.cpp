@@ -0,0 +1,345 @@
+#include "ZiLinkHost.h"
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <WiFi.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+
+static ZiLinkHost::Mode g_mode = ZiLinkHost::InMemory;
+static bool g_wifi = true;
+static bool g_logging = false;
+static ZiLinkHost::Counters g_counters;
+
+void ZiLinkHost::setMode(Mode mode) { g_mode = mode; }
+ZiLinkHost::Mode ZiLinkHost::mode() { return g_mode; }
+void ZiLinkHost::setWifiConnected(bool connected) { g_wifi = connected; }
+bool ZiLinkHost::wifiConnected() { return g_wifi; }
+void ZiLinkHost::setLogging(bool enabled) { g_logging = enabled; }
+bool ZiLinkHost::logging() { return g_logging; }
+const ZiLinkHost::Counters &ZiLinkHost::counters() { return g_counters; }
+ZiLinkHost::Counters &ZiLinkHost::mutableCounters() { return g_counters; }
+void ZiLinkHost::resetCounters() { g_counters = Counters(); }
+
+// Arduino core
+
+static const std::chrono::steady_clock::time_point g_start = std::chrono::steady_clock::now();
+
+unsigned long millis()
+{
+  using namespace std::chrono;
+  return (unsigned long)duration_cast<milliseconds>(steady_clock::now() - g_start).count();
+}
+
+unsigned long micros()
+{
+  using namespace std::chrono;
+  return (unsigned long)duration_cast<microseconds>(steady_clock::now() - g_start).count();
+}
+
+void delay(unsigned long ms)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield()
+{
+  std::this_thread::yield();
+}
+
+String::String(double v, unsigned int decimals)
+{
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.*f", (int)decimals, v);
+  _s = buf;
+}
+
+size_t Print::write(const uint8_t *data, size_t length)
+{
+  size_t n = 0;
+  while (n < length && write(data[n]))
+  {
+    n++;
+  }
+  return n;
+}
+
+HardwareSerial Serial;
+
+int HardwareSerial::printf(const char *format, ...)
+{
+  if (!g_logging)
+  {
+    return 0;
+  }
+  va_list args;
+  va_start(args, format);
+  const int n = vprintf(format, args);
+  va_end(args);
+  return n;
+}
+
+size_t HardwareSerial::print(const char *s)
+{
+  return g_logging ? (size_t)fputs(s, stdout) : 0;
+}
+
+size_t HardwareSerial::println(const char *s)
+{
+  return g_logging ? (size_t)::printf("%s\n", s) : 0;
+}
+
+// WiFi
+
+WiFiClass WiFi;
+
+int WiFiClass::status()
+{
+  return g_wifi ? WL_CONNECTED : WL_DISCONNECTED;
+}
+
+struct WiFiClient::Socket
+{
+  int fd;
+  bool closed = false;
+  explicit Socket(int f) : fd(f) {}
+  ~Socket() { close(fd); }
+};
+
+WiFiClient::WiFiClient(int fd)
+{
+  if (fd >= 0)
+  {
+    _socket = std::make_shared<Socket>(fd);
+  }
+}
+
+int WiFiClient::fd() const
+{
+  return _socket ? _socket->fd : -1;
+}
+
+int WiFiClient::connect(const char *host, uint16_t port)
+{
+  stop();
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *res = nullptr;
+  char service[8];
+  snprintf(service, sizeof(service), "%u", port);
+  if (getaddrinfo(host, service, &hints, &res) != 0 || !res)
+  {
+    return 0;
+  }
+  const int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (fd < 0)
+  {
+    freeaddrinfo(res);
+    return 0;
+  }
+  // Bounded connect: non-blocking, then wait for writability
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  int rc = ::connect(fd, res->ai_addr, res->ai_addrlen);
+  freeaddrinfo(res);
+  if (rc != 0 && errno == EINPROGRESS)
+  {
+    struct pollfd p = {fd, POLLOUT, 0};
+    int soError = 0;
+    socklen_t len = sizeof(soError);
+    rc = poll(&p, 1, (int)_timeoutMs) == 1 && getsockopt(fd, SOL_SOCKET, SO_ERROR, &soError, &len) == 0 && soError == 0
+             ? 0
+             : -1;
+  }
+  if (rc != 0)
+  {
+    close(fd);
+    return 0;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK);
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  _socket = std::make_shared<Socket>(fd);
+  return 1;
+}
+
+uint8_t WiFiClient::connected()
+{
+  if (!_socket || _socket->closed)
+  {
+    return 0;
+  }
+  char c;
+  const ssize_t n = recv(_socket->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+  {
+    _socket->closed = true;
+    return 0;
+  }
+  return 1;
+}
+
+void WiFiClient::stop()
+{
+  _socket.reset();
+}
+
+size_t WiFiClient::write(const uint8_t *data, size_t length)
+{
+  if (!_socket || _socket->closed)
+  {
+    return 0;
+  }
+  size_t sent = 0;
+  while (sent < length)
+  {
+    const ssize_t n = send(_socket->fd, data + sent, length - sent, MSG_NOSIGNAL);
+    if (n <= 0)
+    {
+      if (n < 0 && errno == EINTR)
+      {
+        continue;
+      }
+      _socket->closed = true;
+      break;
+    }
+    sent += (size_t)n;
+  }
+  return sent;
+}
+
+int WiFiClient::available()
+{
+  int n = 0;
+  if (!_socket || ioctl(_socket->fd, FIONREAD, &n) < 0)
+  {
+    return 0;
+  }
+  return n;
+}
+
+int WiFiClient::read()
+{
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t *buffer, size_t length)
+{
+  if (!_socket || _socket->closed)
+  {
+    return -1;
+  }
+  const ssize_t n = recv(_socket->fd, buffer, length, MSG_DONTWAIT);
+  if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+  {
+    _socket->closed = true;
+    return -1;
+  }
+  return n < 0 ? -1 : (int)n;
+}
+
+int WiFiClient::peek()
+{
+  uint8_t c;
+  if (!_socket || recv(_socket->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) != 1)
+  {
+    return -1;
+  }
+  return c;
+}
+
+// HTTP
+
+bool HTTPClient::begin(const String &url)
+{
+  const char *u = url.c_str();
+  if (strncmp(u, "http://", 7) != 0)
+  {
+    return false;
+  }
+  u += 7;
+  const char *slash = strchr(u, '/');
+  const char *hostEnd = slash ? slash : u + strlen(u);
+  const char *colon = (const char *)memchr(u, ':', hostEnd - u);
+  _host = std::string(u, colon ? colon : hostEnd);
+  _port = colon ? (uint16_t)atoi(colon + 1) : 80;
+  _path = slash ? slash : "/";
+  _headers = "";
+  return true;
+}
+
+void HTTPClient::addHeader(const String &name, const String &value)
+{
+  _headers += name + ": " + value + "\r\n";
+}
+
+int HTTPClient::POST(uint8_t *payload, size_t length)
+{
+  ZiLinkHost::Counters &c = ZiLinkHost::mutableCounters();
+  c.httpPost++;
+  c.bytes += length;
+  if (ZiLinkHost::mode() == ZiLinkHost::InMemory)
+  {
+    return 200;
+  }
+  _client.setTimeout(_timeoutMs);
+  if (!_client.connect(_host.c_str(), _port))
+  {
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+  char head[512];
+  const int n = snprintf(head, sizeof(head),
+                         "POST %s HTTP/1.1\r\nHost: %s:%u\r\nContent-Type: application/json\r\n"
+                         "Content-Length: %zu\r\nConnection: close\r\n%s\r\n",
+                         _path.c_str(), _host.c_str(), _port, length, _headers.c_str());
+  if (n <= 0 || (size_t)n >= sizeof(head) || _client.write((const uint8_t *)head, n) != (size_t)n ||
+      _client.write(payload, length) != length)
+  {
+    return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+  }
+  // Status line only: "HTTP/1.1 200 OK"
+  char status[16];
+  size_t got = 0;
+  const unsigned long start = millis();
+  while (got < sizeof(status) - 1 && millis() - start < _timeoutMs)
+  {
+    struct pollfd p = {_client.fd(), POLLIN, 0};
+    if (poll(&p, 1, 10) != 1)
+    {
+      continue;
+    }
+    const int r = _client.read((uint8_t *)status + got, sizeof(status) - 1 - got);
+    if (r < 0)
+    {
+      break;
+    }
+    got += (size_t)r;
+  }
+  status[got] = '\0';
+  if (got < 12 || strncmp(status, "HTTP/1.", 7) != 0)
+  {
+    return HTTPC_ERROR_READ_TIMEOUT;
+  }
+  return atoi(status + 9);
+}
+
+void HTTPClient::end()
+{
+  _client.stop();
+  _headers = "";
+}
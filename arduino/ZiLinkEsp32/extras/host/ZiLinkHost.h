@@ -0,0 +1,71 @@
+#ifndef ZILINK_HOST_H
+#define ZILINK_HOST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Controls for the host build of the library (Linux). The headers in this
+// directory stand in for the ESP32 Arduino core and the WebSockets,
+// PubSubClient and HTTPClient libraries, with two back ends:
+//
+//   Sockets  - real TCP to a local ZiLink server / MQTT broker (ws:// only)
+//   InMemory - no I/O: the WebSocket connects on its first loop(), the
+//              "server" answers auth, sends are counted and dropped, and
+//              HTTP POSTs return 200. For benchmarks and tests.
+namespace ZiLinkHost
+{
+        enum Mode
+        {
+                InMemory,
+                Sockets
+        };
+
+        struct Counters
+        {
+                uint32_t wsText = 0;
+                uint32_t wsBinary = 0;
+                uint32_t mqttPublish = 0;
+                uint32_t httpPost = 0;
+                uint64_t bytes = 0;
+        };
+
+        void setMode(Mode mode);
+        Mode mode();
+        // WiFi.status(): WL_CONNECTED or WL_DISCONNECTED
+        void setWifiConnected(bool connected);
+        bool wifiConnected();
+        // Serial output to stdout (off by default)
+        void setLogging(bool enabled);
+        bool logging();
+
+        // InMemory: reply to the device's auth message
+        // (nullptr: the default {"type":"auth_success","data":{}})
+        void setAuthReply(const char *json);
+        // InMemory: delivered to the WebSocket client on its next loop()
+        void injectText(const char *json);
+        void injectBinary(const uint8_t *data, size_t length);
+        // InMemory: drop the WebSocket (reconnects on the next loop())
+        void dropWebSocket();
+
+        // InMemory: traced frames ("trace":[n, ms], see ZiLinkLatency) are
+        // answered with trace_ack like the server does. The uplink takes
+        // delayUs / 2 plus up to jitterUs, so acks can overtake each other;
+        // the downlink takes delayUs / 2. lossPercent of the acks are
+        // dropped, and the "server" clock reads serverOffsetMs ahead of the
+        // device's. The default is an instant, lossless echo.
+        struct TraceEcho
+        {
+                uint32_t delayUs = 0;
+                uint32_t jitterUs = 0;
+                uint8_t lossPercent = 0;
+                int32_t serverOffsetMs = 0;
+        };
+        void setTraceEcho(const TraceEcho &echo);
+
+        const Counters &counters();
+        void resetCounters();
+        // Used by the stand-in libraries
+        Counters &mutableCounters();
+}
+
+#endif
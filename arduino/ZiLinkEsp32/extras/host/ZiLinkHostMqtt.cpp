@@ -0,0 +1,342 @@
+#include "ZiLinkHost.h"
+
+#include <PubSubClient.h>
+
+#include <thread>
+
+PubSubClient &PubSubClient::setServer(const char *host, uint16_t port)
+{
+  _host = host;
+  _port = port;
+  return *this;
+}
+
+PubSubClient &PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE)
+{
+  _callback = callback;
+  return *this;
+}
+
+PubSubClient &PubSubClient::setSocketTimeout(uint16_t seconds)
+{
+  _socketTimeoutS = seconds;
+  return *this;
+}
+
+PubSubClient &PubSubClient::setKeepAlive(uint16_t seconds)
+{
+  _keepAliveS = seconds;
+  return *this;
+}
+
+bool PubSubClient::setBufferSize(uint16_t size)
+{
+  if (size == 0)
+  {
+    return false;
+  }
+  _bufferSize = size;
+  return true;
+}
+
+static void putString(std::vector<uint8_t> &out, const char *s)
+{
+  const size_t n = strlen(s);
+  out.push_back((uint8_t)(n >> 8));
+  out.push_back((uint8_t)n);
+  out.insert(out.end(), s, s + n);
+}
+
+bool PubSubClient::writePacket(uint8_t header, const std::vector<uint8_t> &body)
+{
+  uint8_t head[5];
+  size_t n = 0;
+  head[n++] = header;
+  size_t remaining = body.size();
+  do
+  {
+    uint8_t digit = remaining % 128;
+    remaining /= 128;
+    head[n++] = digit | (remaining ? 0x80 : 0);
+  } while (remaining && n < sizeof(head));
+  if (_client->write(head, n) != n || _client->write(body.data(), body.size()) != body.size())
+  {
+    lost();
+    return false;
+  }
+  _lastOutMs = millis();
+  return true;
+}
+
+bool PubSubClient::readPacket(uint8_t &header, std::vector<uint8_t> &body, uint32_t timeoutMs)
+{
+  const unsigned long start = millis();
+  for (;;)
+  {
+    uint8_t buf[512];
+    int r;
+    while ((r = _client->read(buf, sizeof(buf))) > 0)
+    {
+      _rx.insert(_rx.end(), buf, buf + r);
+    }
+    // Fixed header: type byte, then up to four length bytes
+    size_t length = 0;
+    size_t at = 1;
+    uint32_t multiplier = 1;
+    bool complete = false;
+    while (at < _rx.size() && at <= 4)
+    {
+      length += (_rx[at] & 0x7F) * multiplier;
+      multiplier *= 128;
+      if (!(_rx[at++] & 0x80))
+      {
+        complete = true;
+        break;
+      }
+    }
+    if (complete && _rx.size() >= at + length)
+    {
+      header = _rx[0];
+      body.assign(_rx.begin() + at, _rx.begin() + at + length);
+      _rx.erase(_rx.begin(), _rx.begin() + at + length);
+      _lastInMs = millis();
+      return true;
+    }
+    if (!_client->connected() || millis() - start >= timeoutMs)
+    {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+bool PubSubClient::connect(const char *id, const char *user, const char *pass)
+{
+  if (ZiLinkHost::mode() == ZiLinkHost::InMemory)
+  {
+    _memoryConnected = true;
+    _state = MQTT_CONNECTED;
+    return true;
+  }
+  if (!_client || (!_client->connected() && !_client->connect(_host, _port)))
+  {
+    _state = MQTT_CONNECT_FAILED;
+    return false;
+  }
+  _rx.clear();
+  std::vector<uint8_t> body;
+  putString(body, "MQTT");
+  body.push_back(4); // 3.1.1
+  uint8_t flags = 0x02; // clean session
+  flags |= user ? 0x80 : 0;
+  flags |= pass ? 0x40 : 0;
+  body.push_back(flags);
+  body.push_back((uint8_t)(_keepAliveS >> 8));
+  body.push_back((uint8_t)_keepAliveS);
+  putString(body, id);
+  if (user)
+  {
+    putString(body, user);
+  }
+  if (pass)
+  {
+    putString(body, pass);
+  }
+  uint8_t header;
+  if (!writePacket(0x10, body) || !readPacket(header, body, _socketTimeoutS * 1000u))
+  {
+    _client->stop();
+    _state = MQTT_CONNECTION_TIMEOUT;
+    return false;
+  }
+  if ((header & 0xF0) != 0x20 || body.size() < 2 || body[1] != 0)
+  {
+    _client->stop();
+    _state = body.size() >= 2 ? body[1] : MQTT_CONNECT_FAILED;
+    return false;
+  }
+  _pingOutstanding = false;
+  _state = MQTT_CONNECTED;
+  return true;
+}
+
+bool PubSubClient::connected()
+{
+  if (ZiLinkHost::mode() == ZiLinkHost::InMemory)
+  {
+    return _memoryConnected;
+  }
+  if (_state != MQTT_CONNECTED)
+  {
+    return false;
+  }
+  if (!_client || !_client->connected())
+  {
+    lost();
+    return false;
+  }
+  return true;
+}
+
+void PubSubClient::lost()
+{
+  if (_client)
+  {
+    _client->stop();
+  }
+  _state = MQTT_CONNECTION_LOST;
+}
+
+void PubSubClient::disconnect()
+{
+  _memoryConnected = false;
+  if (_state == MQTT_CONNECTED && _client)
+  {
+    writePacket(0xE0, std::vector<uint8_t>());
+    _client->stop();
+  }
+  _state = MQTT_DISCONNECTED;
+}
+
+bool PubSubClient::subscribe(const char *topic, uint8_t qos)
+{
+  if (!connected())
+  {
+    return false;
+  }
+  if (ZiLinkHost::mode() == ZiLinkHost::InMemory)
+  {
+    return true;
+  }
+  std::vector<uint8_t> body;
+  const uint16_t id = _nextPacketId++;
+  body.push_back((uint8_t)(id >> 8));
+  body.push_back((uint8_t)id);
+  putString(body, topic);
+  body.push_back(qos);
+  return writePacket(0x82, body);
+}
+
+bool PubSubClient::publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained)
+{
+  // Header (up to 5 bytes), topic and payload are built in the buffer
+  if (!connected() || 5 + 2 + strlen(topic) + length > _bufferSize)
+  {
+    return false;
+  }
+  ZiLinkHost::Counters &c = ZiLinkHost::mutableCounters();
+  c.mqttPublish++;
+  c.bytes += length;
+  if (ZiLinkHost::mode() == ZiLinkHost::InMemory)
+  {
+    return true;
+  }
+  std::vector<uint8_t> body;
+  body.reserve(strlen(topic) + 2 + length);
+  putString(body, topic);
+  body.insert(body.end(), payload, payload + length);
+  return writePacket(0x30 | (retained ? 1 : 0), body);
+}
+
+bool PubSubClient::beginPublish(const char *topic, unsigned int length, bool retained)
+{
+  if (!connected())
+  {
+    return false;
+  }
+  ZiLinkHost::Counters &c = ZiLinkHost::mutableCounters();
+  c.mqttPublish++;
+  c.bytes += length;
+  if (ZiLinkHost::mode() == ZiLinkHost::InMemory)
+  {
+    return true;
+  }
+  // The header covers the payload write() sends next
+  std::vector<uint8_t> head;
+  head.push_back(0x30 | (retained ? 1 : 0));
+  size_t remaining = 2 + strlen(topic) + length;
+  do
+  {
+    uint8_t digit = remaining % 128;
+    remaining /= 128;
+    head.push_back(digit | (remaining ? 0x80 : 0));
+  } while (remaining);
+  putString(head, topic);
+  if (_client->write(head.data(), head.size()) != head.size())
+  {
+    lost();
+    return false;
+  }
+  _lastOutMs = millis();
+  return true;
+}
+
+size_t PubSubClient::write(const uint8_t *data, size_t length)
+{
+  if (ZiLinkHost::mode() == ZiLinkHost::InMemory)
+  {
+    return length;
+  }
+  _lastOutMs = millis();
+  return _client ? _client->write(data, length) : 0;
+}
+
+bool PubSubClient::loop()
+{
+  if (!connected())
+  {
+    return false;
+  }
+  if (ZiLinkHost::mode() == ZiLinkHost::InMemory)
+  {
+    return true;
+  }
+  const unsigned long now = millis();
+  const unsigned long keepAliveMs = _keepAliveS * 1000ul;
+  if (now - _lastOutMs >= keepAliveMs || (now - _lastInMs >= keepAliveMs && !_pingOutstanding))
+  {
+    if (_pingOutstanding)
+    {
+      lost();
+      return false;
+    }
+    _pingOutstanding = writePacket(0xC0, std::vector<uint8_t>());
+  }
+  uint8_t header;
+  std::vector<uint8_t> body;
+  while (readPacket(header, body, 0))
+  {
+    switch (header & 0xF0)
+    {
+    case 0x30:
+    {
+      if (body.size() < 2)
+      {
+        break;
+      }
+      const size_t topicLength = ((size_t)body[0] << 8) | body[1];
+      const size_t qos = (header >> 1) & 3;
+      const size_t payloadAt = 2 + topicLength + (qos ? 2 : 0);
+      if (payloadAt > body.size())
+      {
+        break;
+      }
+      // "topic\0payload" so both can be handed out in place
+      std::vector<uint8_t> message(body.begin() + 2, body.begin() + 2 + topicLength);
+      message.push_back(0);
+      message.insert(message.end(), body.begin() + payloadAt, body.end());
+      if (_callback)
+      {
+        _callback((char *)message.data(), message.data() + topicLength + 1, (unsigned int)(body.size() - payloadAt));
+      }
+      break;
+    }
+    case 0xD0:
+      _pingOutstanding = false;
+      break;
+    default:
+      break;
+    }
+  }
+  return connected();
+}
@@ -0,0 +1,475 @@
+#include "ZiLinkHost.h"
+
+#include <WebSocketsClient.h>
+
+#include "ZiLinkMsgPack.h"
+
+#include <poll.h>
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <random>
+
+// In-memory "server" shared with ZiLinkHost's controls
+struct InboundFrame
+{
+  WStype_t type;
+  std::vector<uint8_t> data;
+};
+static std::deque<InboundFrame> g_inbox;
+static const char DEFAULT_AUTH_REPLY[] = "{\"type\":\"auth_success\",\"data\":{}}";
+static std::string g_authReply = DEFAULT_AUTH_REPLY;
+static bool g_drop = false;
+static ZiLinkHost::TraceEcho g_echo;
+// trace_ack replies by delivery time (us)
+static std::multimap<uint64_t, std::string> g_echoes;
+static std::minstd_rand g_rng(std::random_device{}());
+
+static uint64_t nowUs()
+{
+  using namespace std::chrono;
+  return (uint64_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void ZiLinkHost::setAuthReply(const char *json) { g_authReply = json ? json : DEFAULT_AUTH_REPLY; }
+
+void ZiLinkHost::injectText(const char *json)
+{
+  g_inbox.push_back({WStype_TEXT, std::vector<uint8_t>(json, json + strlen(json))});
+}
+
+void ZiLinkHost::injectBinary(const uint8_t *data, size_t length)
+{
+  g_inbox.push_back({WStype_BIN, std::vector<uint8_t>(data, data + length)});
+}
+
+void ZiLinkHost::dropWebSocket() { g_drop = true; }
+
+void ZiLinkHost::setTraceEcho(const TraceEcho &echo) { g_echo = echo; }
+
+// [n, deviceMs] of a traced frame, as the device library writes it
+static bool findTrace(uint8_t opcode, const uint8_t *payload, size_t length, uint32_t &seq, uint32_t &deviceMs)
+{
+  if (opcode == 0x1)
+  {
+    static const char KEY[] = "\"trace\":[";
+    const std::string text((const char *)payload, length);
+    const size_t at = text.find(KEY);
+    if (at == std::string::npos)
+    {
+      return false;
+    }
+    char *end;
+    seq = (uint32_t)strtoul(text.c_str() + at + sizeof(KEY) - 1, &end, 10);
+    deviceMs = (uint32_t)strtoul(end + 1, nullptr, 10);
+    return *end == ',';
+  }
+  // Binary: the trace is the last element of a device_data, component or batch frame
+  ZiLinkMsgPackReader in(payload, length);
+  uint32_t count;
+  int64_t kind;
+  if (!in.readArray(count) || !in.readInt(kind))
+  {
+    return false;
+  }
+  const uint32_t traced = kind == ZILINK_KIND_DEVICE_DATA ? 4 : kind == ZILINK_KIND_COMPONENT ? 5 : kind == ZILINK_KIND_BATCH ? 3 : 0;
+  if (!traced || count != traced)
+  {
+    return false;
+  }
+  for (uint32_t i = 2; i < count; i++)
+  {
+    in.skip();
+  }
+  uint32_t n;
+  int64_t a, b;
+  if (!in.readArray(n) || n != 2 || !in.readInt(a) || !in.readInt(b))
+  {
+    return false;
+  }
+  seq = (uint32_t)a;
+  deviceMs = (uint32_t)b;
+  return true;
+}
+
+static void echoTrace(uint8_t opcode, const uint8_t *payload, size_t length)
+{
+  uint32_t seq, deviceMs;
+  if (!findTrace(opcode, payload, length, seq, deviceMs) || (uint32_t)(g_rng() % 100) < g_echo.lossPercent)
+  {
+    return;
+  }
+  const uint64_t upUs = g_echo.delayUs / 2 + (g_echo.jitterUs ? g_rng() % (g_echo.jitterUs + 1) : 0);
+  const uint64_t now = nowUs();
+  // Stamped when the "server" receives it, on a clock serverOffsetMs ahead
+  const uint32_t at = millis() + (uint32_t)g_echo.serverOffsetMs + (uint32_t)(upUs / 1000);
+  char reply[128];
+  snprintf(reply, sizeof(reply), "{\"type\":\"trace_ack\",\"data\":{\"trace\":[%u,%u],\"at\":%u}}", seq, deviceMs, at);
+  g_echoes.emplace(now + upUs + g_echo.delayUs / 2, reply);
+}
+
+void WebSocketsClient::begin(const char *host, uint16_t port, const char *url, const char *)
+{
+  _host = host;
+  _port = port;
+  _url = url;
+  _ssl = false;
+  _attempted = false;
+}
+
+void WebSocketsClient::beginSSL(const char *host, uint16_t port, const char *url, const char *, const char *protocol)
+{
+  begin(host, port, url, protocol);
+  _ssl = true;
+}
+
+void WebSocketsClient::beginSslWithCA(const char *host, uint16_t port, const char *url, const char *,
+                                      const char *protocol)
+{
+  beginSSL(host, port, url, "", protocol);
+}
+
+void WebSocketsClient::enableHeartbeat(uint32_t pingIntervalMs, uint32_t, uint8_t)
+{
+  _pingIntervalMs = pingIntervalMs;
+}
+
+void WebSocketsClient::emit(WStype_t type, uint8_t *payload, size_t length)
+{
+  if (_callback)
+  {
+    _callback(type, payload, length);
+  }
+}
+
+bool WebSocketsClient::sendTXT(uint8_t *payload, size_t length, bool headerToPayload)
+{
+  // Like the library: with headerToPayload the data starts after the reserved header bytes
+  if (headerToPayload)
+  {
+    payload += WEBSOCKETS_MAX_HEADER_SIZE;
+  }
+  if (length == 0)
+  {
+    length = strlen((const char *)payload);
+  }
+  return sendFrame(0x1, payload, length);
+}
+
+bool WebSocketsClient::sendTXT(const char *payload, size_t length)
+{
+  return sendTXT((uint8_t *)payload, length ? length : strlen(payload));
+}
+
+bool WebSocketsClient::sendBIN(uint8_t *payload, size_t length, bool headerToPayload)
+{
+  return sendFrame(0x2, headerToPayload ? payload + WEBSOCKETS_MAX_HEADER_SIZE : payload, length);
+}
+
+bool WebSocketsClient::sendBIN(const uint8_t *payload, size_t length)
+{
+  return sendFrame(0x2, payload, length);
+}
+
+bool WebSocketsClient::sendFrame(uint8_t opcode, const uint8_t *payload, size_t length)
+{
+  if (!_connected)
+  {
+    return false;
+  }
+  ZiLinkHost::Counters &c = ZiLinkHost::mutableCounters();
+  if (opcode == 0x1 || opcode == 0x2)
+  {
+    (opcode == 0x1 ? c.wsText : c.wsBinary)++;
+    c.bytes += length;
+  }
+  if (ZiLinkHost::mode() == ZiLinkHost::InMemory)
+  {
+    static const char AUTH[] = "{\"type\":\"auth\"";
+    if (opcode == 0x1 && length >= sizeof(AUTH) - 1 && memcmp(payload, AUTH, sizeof(AUTH) - 1) == 0)
+    {
+      ZiLinkHost::injectText(g_authReply.c_str());
+    }
+    else
+    {
+      echoTrace(opcode, payload, length);
+    }
+    return true;
+  }
+
+  // Client frames are masked (RFC 6455 5.3)
+  static std::minstd_rand rng(std::random_device{}());
+  std::vector<uint8_t> frame;
+  frame.reserve(length + WEBSOCKETS_MAX_HEADER_SIZE);
+  frame.push_back(0x80 | opcode);
+  if (length < 126)
+  {
+    frame.push_back(0x80 | (uint8_t)length);
+  }
+  else if (length <= 0xFFFF)
+  {
+    frame.push_back(0x80 | 126);
+    frame.push_back((uint8_t)(length >> 8));
+    frame.push_back((uint8_t)length);
+  }
+  else
+  {
+    frame.push_back(0x80 | 127);
+    for (int shift = 56; shift >= 0; shift -= 8)
+    {
+      frame.push_back((uint8_t)((uint64_t)length >> shift));
+    }
+  }
+  uint8_t mask[4];
+  const uint32_t key = (uint32_t)rng();
+  memcpy(mask, &key, 4);
+  frame.insert(frame.end(), mask, mask + 4);
+  for (size_t i = 0; i < length; i++)
+  {
+    frame.push_back(payload[i] ^ mask[i & 3]);
+  }
+  if (_client.write(frame.data(), frame.size()) != frame.size())
+  {
+    closed();
+    return false;
+  }
+  return true;
+}
+
+bool WebSocketsClient::connectSocket()
+{
+  if (!_client.connect(_host.c_str(), _port))
+  {
+    return false;
+  }
+  char request[512];
+  const int n = snprintf(request, sizeof(request),
+                         "GET %s HTTP/1.1\r\nHost: %s:%u\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                         "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n",
+                         _url.c_str(), _host.c_str(), _port);
+  if (n <= 0 || (size_t)n >= sizeof(request) || _client.write((const uint8_t *)request, n) != (size_t)n)
+  {
+    _client.stop();
+    return false;
+  }
+  // Blocking handshake, like the library it stands in for
+  std::string response;
+  const unsigned long start = millis();
+  size_t end = std::string::npos;
+  while (end == std::string::npos && millis() - start < 5000)
+  {
+    struct pollfd p = {_client.fd(), POLLIN, 0};
+    if (poll(&p, 1, 10) != 1)
+    {
+      continue;
+    }
+    uint8_t buf[512];
+    const int r = _client.read(buf, sizeof(buf));
+    if (r < 0)
+    {
+      break;
+    }
+    response.append((const char *)buf, r);
+    end = response.find("\r\n\r\n");
+  }
+  if (end == std::string::npos || response.compare(0, 12, "HTTP/1.1 101") != 0)
+  {
+    _client.stop();
+    return false;
+  }
+  _rx.assign(response.begin() + end + 4, response.end());
+  _message.clear();
+  return true;
+}
+
+void WebSocketsClient::closed()
+{
+  _client.stop();
+  _rx.clear();
+  _message.clear();
+  if (_connected)
+  {
+    _connected = false;
+    emit(WStype_DISCONNECTED, nullptr, 0);
+  }
+}
+
+void WebSocketsClient::disconnect()
+{
+  if (_connected && ZiLinkHost::mode() == ZiLinkHost::Sockets)
+  {
+    sendFrame(0x8, nullptr, 0);
+  }
+  closed();
+}
+
+bool WebSocketsClient::readFrames()
+{
+  uint8_t buf[1024];
+  int r;
+  while ((r = _client.read(buf, sizeof(buf))) > 0)
+  {
+    _rx.insert(_rx.end(), buf, buf + r);
+  }
+  if (!_client.connected())
+  {
+    return false;
+  }
+  size_t at = 0;
+  while (_rx.size() - at >= 2)
+  {
+    const uint8_t *f = _rx.data() + at;
+    const bool fin = f[0] & 0x80;
+    const uint8_t opcode = f[0] & 0x0F;
+    const bool masked = f[1] & 0x80;
+    uint64_t length = f[1] & 0x7F;
+    size_t header = 2;
+    if (length == 126)
+    {
+      if (_rx.size() - at < 4)
+      {
+        break;
+      }
+      length = ((uint64_t)f[2] << 8) | f[3];
+      header = 4;
+    }
+    else if (length == 127)
+    {
+      if (_rx.size() - at < 10)
+      {
+        break;
+      }
+      length = 0;
+      for (int i = 0; i < 8; i++)
+      {
+        length = (length << 8) | f[2 + i];
+      }
+      header = 10;
+    }
+    const size_t maskAt = header;
+    header += masked ? 4 : 0;
+    if (_rx.size() - at < header + length)
+    {
+      break;
+    }
+    uint8_t *payload = _rx.data() + at + header;
+    if (masked)
+    {
+      for (uint64_t i = 0; i < length; i++)
+      {
+        payload[i] ^= _rx[at + maskAt + (i & 3)];
+      }
+    }
+    at += header + length;
+
+    switch (opcode)
+    {
+    case 0x0:
+    case 0x1:
+    case 0x2:
+      if (opcode != 0x0)
+      {
+        _messageOpcode = opcode;
+        _message.clear();
+      }
+      _message.insert(_message.end(), payload, payload + length);
+      if (fin)
+      {
+        const size_t n = _message.size();
+        // Text payloads are NUL-terminated for the callback
+        _message.push_back(0);
+        emit(_messageOpcode == 0x1 ? WStype_TEXT : WStype_BIN, _message.data(), n);
+        _message.clear();
+      }
+      break;
+    case 0x8:
+      sendFrame(0x8, nullptr, 0);
+      return false;
+    case 0x9:
+      sendFrame(0xA, payload, (size_t)length);
+      break;
+    default:
+      break;
+    }
+    if (!_connected)
+    {
+      // A callback disconnected
+      return true;
+    }
+  }
+  _rx.erase(_rx.begin(), _rx.begin() + at);
+  return true;
+}
+
+void WebSocketsClient::loop()
+{
+  if (_host.length() == 0)
+  {
+    return;
+  }
+  if (ZiLinkHost::mode() == ZiLinkHost::InMemory)
+  {
+    if (!_connected)
+    {
+      g_drop = false;
+      g_inbox.clear();
+      g_echoes.clear();
+      _connected = true;
+      emit(WStype_CONNECTED, (uint8_t *)_url.c_str(), _url.length());
+      return;
+    }
+    if (g_drop)
+    {
+      g_drop = false;
+      closed();
+      return;
+    }
+    // Echoes whose time has come, in delivery order
+    const uint64_t now = nowUs();
+    while (!g_echoes.empty() && g_echoes.begin()->first <= now)
+    {
+      ZiLinkHost::injectText(g_echoes.begin()->second.c_str());
+      g_echoes.erase(g_echoes.begin());
+    }
+    // Only what was queued before this call; replies wait for the next loop()
+    for (size_t n = g_inbox.size(); n > 0 && _connected && !g_inbox.empty(); n--)
+    {
+      InboundFrame frame = std::move(g_inbox.front());
+      g_inbox.pop_front();
+      const size_t length = frame.data.size();
+      frame.data.push_back(0);
+      emit(frame.type, frame.data.data(), length);
+    }
+    return;
+  }
+
+  if (!_connected)
+  {
+    // Like arduinoWebSockets, only a failed attempt delays the next one
+    if (_ssl || (_attempted && millis() - _lastAttemptMs < _reconnectMs))
+    {
+      return;
+    }
+    _attempted = true;
+    _lastAttemptMs = millis();
+    if (connectSocket())
+    {
+      _attempted = false;
+      _connected = true;
+      _lastPingMs = millis();
+      emit(WStype_CONNECTED, (uint8_t *)_url.c_str(), _url.length());
+    }
+    return;
+  }
+  if (!readFrames())
+  {
+    closed();
+    return;
+  }
+  if (_connected && _pingIntervalMs && millis() - _lastPingMs >= _pingIntervalMs)
+  {
+    _lastPingMs = millis();
+    sendFrame(0x9, nullptr, 0);
+  }
+}
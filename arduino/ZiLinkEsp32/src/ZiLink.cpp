@@ -0,0 +1,24 @@
+#include "ZiLink.h"
+
+#include "ZiLinkCommandQueue.h"
+
+void zilinkCommand(JsonVariantConst command, ZiLinkCommandFn fn)
+{
+  if (command.isNull())
+  {
+    return;
+  }
+  if (command.is<const char *>())
+  {
+    const char *text = command.as<const char *>();
+    fn(text, strlen(text));
+    return;
+  }
+  // Structured commands ({"type":"ui_button",...}) as JSON text, like ZiLinkEsp32
+  char text[ZILINK_COMMAND_MAX_LEN + 1];
+  const size_t length = serializeJson(command, text, sizeof(text));
+  if (length < sizeof(text) - 1)
+  {
+    fn(text, length);
+  }
+}
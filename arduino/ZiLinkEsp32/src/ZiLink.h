@@ -0,0 +1,108 @@
+#ifndef ZILINK_H
+#define ZILINK_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <initializer_list>
+#include <type_traits>
+#include "ZiLinkFrameWriter.h"
+
+// What a frame carries; each transport maps it to its own topic or path
+enum ZiLinkKind : uint8_t
+{
+        ZiLinkData,
+        ZiLinkStatus,
+        ZiLinkComponent
+};
+
+// Command text from the server (data.command; structured commands as JSON)
+typedef void (*ZiLinkCommandFn)(const char *command, size_t length);
+
+// Hands a parsed data.command to `fn`
+void zilinkCommand(JsonVariantConst command, ZiLinkCommandFn fn);
+
+// Compile-time transport selection for boards where every byte counts:
+//
+//   ZiLink<ZiLinkMqtt> zi(DEVICE_ID, DEVICE_TOKEN, {BROKER, 1883});
+//   ZiLink<ZiLinkWs, ZiLinkHttp> zi(DEVICE_ID, DEVICE_TOKEN, {HOST, 5000, "/ws"}, {"http://host:5000/api"});
+//
+// Only the listed transports (ZiLinkWs.h, ZiLinkMqtt.h, ZiLinkHttp.h) are
+// members, so the others' clients take no RAM and their code is never
+// linked. Topic and URL prefixes are built once in the constructor, and a
+// send is inlined down to the client call: no queue, no batching, no
+// component table, no durable log. A send goes to the first transport in
+// the list that is up and carries that kind, and fails when none is; use
+// ZiLinkEsp32 when updates must survive outages.
+//
+// The strings passed in (device id, token, hosts) are kept by pointer and
+// must outlive the object: string literals or globals.
+template <typename... Transports>
+class ZiLink : public Transports...
+{
+public:
+        ZiLink(const char *deviceId, const char *token, const typename Transports::Config &...configs)
+            : Transports(deviceId, token, configs)...
+        {
+        }
+
+        void begin() { each({(Transports::begin(), 0)...}); }
+        void loop()
+        {
+                const uint32_t now = millis();
+                each({(Transports::loop(now), 0)...});
+        }
+        bool connected() { return any({Transports::ready()...}); }
+
+        bool sendData(const char *payload, size_t length) { return send<Transports...>(ZiLinkData, payload, length); }
+        bool sendData(const String &payload) { return sendData(payload.c_str(), payload.length()); }
+        bool sendStatus(const char *payload, size_t length) { return send<Transports...>(ZiLinkStatus, payload, length); }
+        bool sendStatus(const String &payload) { return sendStatus(payload.c_str(), payload.length()); }
+
+        bool createButton(bool value, const char *id) { return component("button", id, value, true); }
+        bool createSlider(int value, const char *id) { return component("slider", id, value, false); }
+        bool createToggle(bool value, const char *id) { return component("toggle", id, value, true); }
+        bool createProgress(int value, const char *id) { return component("progress", id, value, false); }
+
+        // Commands from every listed transport that receives them
+        void onCommand(ZiLinkCommandFn fn) { each({(Transports::setCommandHandler(fn), 0)...}); }
+
+        // Direct access, e.g. zi.transport<ZiLinkMqtt>().client()
+        template <typename T>
+        T &transport() { return *this; }
+
+private:
+        static void each(std::initializer_list<int>) {}
+        static bool any(std::initializer_list<bool> ready)
+        {
+                for (bool r : ready)
+                {
+                        if (r)
+                        {
+                                return true;
+                        }
+                }
+                return false;
+        }
+
+        template <typename T, typename... Rest>
+        bool send(ZiLinkKind kind, const char *data, size_t length)
+        {
+                return (T::ready() && T::send(kind, data, length)) || send<Rest...>(kind, data, length);
+        }
+        template <typename... None>
+        typename std::enable_if<sizeof...(None) == 0, bool>::type send(ZiLinkKind, const char *, size_t)
+        {
+                return false;
+        }
+
+        bool component(const char *type, const char *id, int value, bool isBool)
+        {
+                ZiLinkFrame<> frame;
+                frame.raw("{\"type\":\"").cstr(type).raw("\",\"id\":").str(id).raw(",\"value\":");
+                isBool ? frame.boolean(value != 0) : frame.integer(value);
+                frame.raw('}');
+                return frame.ok() && send<Transports...>(ZiLinkComponent, frame.c_str(), frame.length());
+        }
+};
+
+#endif
@@ -0,0 +1,47 @@
+#include "ZiLinkBackoff.h"
+
+#include "ZiLinkClock.h"
+
+void ZiLinkBackoff::configure(uint32_t initialMs, uint32_t maxMs)
+{
+  _initialMs = initialMs ? initialMs : 1;
+  _maxMs = maxMs < _initialMs ? _initialMs : maxMs;
+}
+
+void ZiLinkBackoff::reset()
+{
+  _failures = 0;
+  _waiting = false;
+}
+
+uint32_t ZiLinkBackoff::random()
+{
+  if (_seed == 0)
+  {
+    // Timing of the first failure differs between devices; good enough for jitter
+    _seed = zilinkMicros() | 1;
+  }
+  // xorshift32
+  _seed ^= _seed << 13;
+  _seed ^= _seed >> 17;
+  _seed ^= _seed << 5;
+  return _seed;
+}
+
+uint32_t ZiLinkBackoff::fail(uint32_t nowMs)
+{
+  uint32_t delay = _initialMs;
+  for (uint16_t i = 0; i < _failures && delay < _maxMs; i++)
+  {
+    delay = delay > _maxMs / 2 ? _maxMs : delay * 2;
+  }
+  if (_failures < 0xFFFF)
+  {
+    _failures++;
+  }
+  const uint32_t half = delay / 2;
+  delay = half + random() % (delay - half + 1);
+  _nextMs = nowMs + delay;
+  _waiting = true;
+  return delay;
+}
@@ -0,0 +1,35 @@
+#ifndef ZILINK_BACKOFF_H
+#define ZILINK_BACKOFF_H
+
+#include <stdint.h>
+
+// Reconnect scheduler: exponential backoff with "equal jitter" (a random
+// delay in [d/2, d] where d doubles per failure up to maxMs), so a fleet
+// of devices does not reconnect in lockstep after a broker restart.
+class ZiLinkBackoff
+{
+public:
+        ZiLinkBackoff(uint32_t initialMs = 1000, uint32_t maxMs = 60000) { configure(initialMs, maxMs); }
+
+        void configure(uint32_t initialMs, uint32_t maxMs);
+        // Next attempt is allowed immediately
+        void reset();
+        // Records a failed attempt and returns the delay until the next one
+        uint32_t fail(uint32_t nowMs);
+        bool due(uint32_t nowMs) const { return !_waiting || (int32_t)(nowMs - _nextMs) >= 0; }
+
+        uint16_t failures() const { return _failures; }
+        uint32_t nextAttemptMs() const { return _nextMs; }
+
+private:
+        uint32_t random();
+
+        uint32_t _initialMs = 1000;
+        uint32_t _maxMs = 60000;
+        uint16_t _failures = 0;
+        bool _waiting = false;
+        uint32_t _nextMs = 0;
+        uint32_t _seed = 0;
+};
+
+#endif
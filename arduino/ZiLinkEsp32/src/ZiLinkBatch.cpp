@@ -0,0 +1,87 @@
+#include "ZiLinkBatch.h"
+
+#include <new>
+
+bool ZiLinkBatch::begin(const char *prefix, const char *suffix, size_t maxBytes, uint16_t maxReadings, uint32_t maxLatencyMs,
+                        size_t trailerBytes)
+{
+  end();
+  _prefix = prefix;
+  _suffix = suffix;
+  _prefixLen = strlen(prefix);
+  _suffixLen = strlen(suffix);
+  _trailerLen = trailerBytes;
+  if (maxBytes <= _prefixLen + _suffixLen + _trailerLen)
+  {
+    return false;
+  }
+  const size_t cap = maxBytes + ZILINK_FRAME_HEADROOM + 1;
+  _storage.reset(new (std::nothrow) char[cap]);
+  if (!_storage)
+  {
+    return false;
+  }
+  _frame = ZiLinkFrameWriter(_storage.get(), cap, ZILINK_FRAME_HEADROOM);
+  _maxReadings = maxReadings ? maxReadings : 1;
+  _maxLatencyMs = maxLatencyMs;
+  clear();
+  return true;
+}
+
+void ZiLinkBatch::end()
+{
+  _storage.reset();
+  _frame = ZiLinkFrameWriter(nullptr, 0);
+  _count = 0;
+}
+
+void ZiLinkBatch::clear()
+{
+  _count = 0;
+  if (enabled())
+  {
+    _frame.reset();
+    _frame.cstr(_prefix);
+  }
+}
+
+ZiLinkBatch::AppendResult ZiLinkBatch::append(const char *reading, size_t length, uint32_t nowMs)
+{
+  // Always keep room for the separator, the closing suffix and the trailer
+  const size_t separator = _count ? 1 : 0;
+  if (_frame.length() + separator + length + _suffixLen + _trailerLen > _frame.capacity())
+  {
+    return _count ? Full : TooLarge;
+  }
+  if (_count == 0)
+  {
+    _startMs = nowMs;
+  }
+  else
+  {
+    _frame.raw(',');
+  }
+  _frame.raw(reading, length);
+  _count++;
+  return Appended;
+}
+
+bool ZiLinkBatch::due(uint32_t nowMs) const
+{
+  if (_count == 0)
+  {
+    return false;
+  }
+  return _count >= _maxReadings || (uint32_t)(nowMs - _startMs) >= _maxLatencyMs;
+}
+
+ZiLinkFrameWriter &ZiLinkBatch::close()
+{
+  return _frame.raw(_suffix, _suffixLen);
+}
+
+const char *ZiLinkBatch::readings(size_t &length) const
+{
+  length = _frame.length() > _prefixLen ? _frame.length() - _prefixLen : 0;
+  return _frame.c_str() + _prefixLen;
+}
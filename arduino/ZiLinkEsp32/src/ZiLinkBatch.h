@@ -0,0 +1,54 @@
+#ifndef ZILINK_BATCH_H
+#define ZILINK_BATCH_H
+
+#include <memory>
+#include "ZiLinkFrameWriter.h"
+
+// Coalesces many JSON readings into a single frame of the form
+// `<prefix>r1,r2,...<suffix>`. Storage is allocated once in begin() and
+// reused for every frame; the owner decides when to send, using due()
+// for the count/latency triggers and the append() result for size.
+class ZiLinkBatch
+{
+public:
+        enum AppendResult
+        {
+                Appended, // reading is in the batch
+                Full,     // batch must be flushed before this reading fits
+                TooLarge  // reading alone exceeds the batch size, send it directly
+        };
+
+        // `trailerBytes` stay free after the suffix for the owner to finish
+        // the frame (e.g. a field only known at send time)
+        bool begin(const char *prefix, const char *suffix, size_t maxBytes, uint16_t maxReadings, uint32_t maxLatencyMs,
+                   size_t trailerBytes = 0);
+        void end();
+
+        AppendResult append(const char *reading, size_t length, uint32_t nowMs);
+        bool due(uint32_t nowMs) const;
+
+        // Terminates the frame for sending; call clear() afterwards
+        ZiLinkFrameWriter &close();
+        void clear();
+        // The comma separated readings between prefix and suffix (before close())
+        const char *readings(size_t &length) const;
+
+        bool enabled() const { return _storage != nullptr; }
+        bool empty() const { return _count == 0; }
+        uint16_t count() const { return _count; }
+
+private:
+        std::unique_ptr<char[]> _storage;
+        ZiLinkFrameWriter _frame{nullptr, 0};
+        const char *_prefix = "";
+        const char *_suffix = "";
+        size_t _prefixLen = 0;
+        size_t _suffixLen = 0;
+        size_t _trailerLen = 0;
+        uint16_t _maxReadings = 0;
+        uint32_t _maxLatencyMs = 0;
+        uint16_t _count = 0;
+        uint32_t _startMs = 0;
+};
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef ZILINK_CLOCK_H
+#define ZILINK_CLOCK_H
+
+#include <stdint.h>
+
+// Time source for the transport-independent helpers so they also build on
+// the host (benchmarks) where Arduino's millis()/micros() do not exist.
+#ifdef ARDUINO
+#include <Arduino.h>
+
+inline uint32_t zilinkMillis() { return millis(); }
+inline uint32_t zilinkMicros() { return micros(); }
+inline void zilinkYield() { yield(); }
+#else
+#include <chrono>
+#include <thread>
+
+inline uint32_t zilinkMillis()
+{
+        using namespace std::chrono;
+        return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+inline uint32_t zilinkMicros()
+{
+        using namespace std::chrono;
+        return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+inline void zilinkYield() { std::this_thread::yield(); }
+#endif
+
+#endif
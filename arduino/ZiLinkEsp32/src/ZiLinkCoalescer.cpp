@@ -0,0 +1,224 @@
+#include "ZiLinkCoalescer.h"
+
+#include <new>
+#include <string.h>
+
+static const char *skipSpace(const char *p, const char *end)
+{
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+  {
+    p++;
+  }
+  return p;
+}
+
+// End of the JSON value at `p`: the first ',' or '}' outside strings and nesting
+static const char *valueEnd(const char *p, const char *end)
+{
+  int depth = 0;
+  bool inString = false;
+  for (; p < end; p++)
+  {
+    const char c = *p;
+    if (inString)
+    {
+      if (c == '\\')
+      {
+        p++;
+      }
+      else if (c == '"')
+      {
+        inString = false;
+      }
+      continue;
+    }
+    switch (c)
+    {
+    case '"':
+      inString = true;
+      break;
+    case '{':
+    case '[':
+      depth++;
+      break;
+    case ']':
+      depth--;
+      break;
+    case '}':
+      if (depth == 0)
+      {
+        return p;
+      }
+      depth--;
+      break;
+    case ',':
+      if (depth == 0)
+      {
+        return p;
+      }
+      break;
+    }
+  }
+  return nullptr;
+}
+
+bool ZiLinkCoalescer::member(const char *&at, const char *end, Span &key, Span &value)
+{
+  const char *p = skipSpace(at, end);
+  if (p >= end || *p != '"')
+  {
+    return false;
+  }
+  const char *k = p++;
+  while (p < end && *p != '"')
+  {
+    p += *p == '\\' ? 2 : 1;
+  }
+  if (p >= end)
+  {
+    return false;
+  }
+  key = {k, (size_t)(++p - k)};
+  p = skipSpace(p, end);
+  if (p >= end || *p != ':')
+  {
+    return false;
+  }
+  p = skipSpace(p + 1, end);
+  const char *v = valueEnd(p, end);
+  if (!v || v == p)
+  {
+    return false;
+  }
+  // Trailing whitespace is not part of the value
+  const char *last = v;
+  while (last > p && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r' || last[-1] == '\n'))
+  {
+    last--;
+  }
+  value = {p, (size_t)(last - p)};
+  at = v;
+  return true;
+}
+
+bool ZiLinkCoalescer::find(const Span &key, Span &value) const
+{
+  const char *at = _buf.get() + 1;
+  const char *end = _buf.get() + _length;
+  Span k;
+  while (member(at, end, k, value))
+  {
+    if (k.n == key.n && memcmp(k.p, key.p, k.n) == 0)
+    {
+      return true;
+    }
+    at++; // ',' or the closing '}'
+  }
+  return false;
+}
+
+bool ZiLinkCoalescer::replace(const Span &old, const Span &value)
+{
+  if (_length - old.n + value.n > _capacity)
+  {
+    return false;
+  }
+  char *at = const_cast<char *>(old.p);
+  memmove(at + value.n, at + old.n, _length - (at + old.n - _buf.get()));
+  memcpy(at, value.p, value.n);
+  _length = _length - old.n + value.n;
+  return true;
+}
+
+bool ZiLinkCoalescer::append(const Span &key, const Span &value)
+{
+  // ,"key":value before the closing brace ({} takes no comma)
+  const bool first = _length == 2;
+  const size_t add = (first ? 0 : 1) + key.n + 1 + value.n;
+  if (_length + add > _capacity)
+  {
+    return false;
+  }
+  char *p = _buf.get() + _length - 1;
+  if (!first)
+  {
+    *p++ = ',';
+  }
+  memcpy(p, key.p, key.n);
+  p += key.n;
+  *p++ = ':';
+  memcpy(p, value.p, value.n);
+  p += value.n;
+  *p++ = '}';
+  _length += add;
+  return true;
+}
+
+bool ZiLinkCoalescer::merge(const char *reading, size_t length)
+{
+  const char *end = reading + length;
+  const char *p = skipSpace(reading, end);
+  while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n'))
+  {
+    end--;
+  }
+  if (end - p < 2 || *p != '{' || end[-1] != '}')
+  {
+    return false;
+  }
+  const char *at = skipSpace(p + 1, end);
+  if (*at == '}')
+  {
+    // {}: nothing to merge
+    return at + 1 == end;
+  }
+  // Check the whole reading first, so a malformed one changes nothing
+  size_t grow = 0;
+  Span key, value;
+  for (at = p + 1;;)
+  {
+    if (!member(at, end, key, value))
+    {
+      return false;
+    }
+    grow += key.n + value.n + 2;
+    if (*at++ == '}')
+    {
+      break;
+    }
+  }
+  if (at != end)
+  {
+    return false;
+  }
+  if (!_buf)
+  {
+    _buf.reset(new (std::nothrow) char[_capacity]);
+    if (!_buf || _capacity < 2)
+    {
+      _buf.reset();
+      return false;
+    }
+  }
+  // Worst case (every key new) must fit, else the caller sends what is pending first
+  if (_length == 0)
+  {
+    if (2 + grow > _capacity)
+    {
+      return false;
+    }
+    _buf[0] = '{';
+    _buf[1] = '}';
+    _length = 2;
+  }
+  else if (_length + grow > _capacity)
+  {
+    return false;
+  }
+  for (at = p + 1; member(at, end, key, value); at++)
+  {
+    Span old;
+    find(key, old) ? replace(old, value) : append(key, value);
+  }
+  return true;
+}
@@ -0,0 +1,50 @@
+#ifndef ZILINK_COALESCER_H
+#define ZILINK_COALESCER_H
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef ZILINK_COALESCE_BYTES
+#define ZILINK_COALESCE_BYTES 512
+#endif
+
+// Latest-value merge of JSON object readings: {"t":21.5,"h":40} followed
+// by {"t":21.7} holds {"t":21.7,"h":40}. A member keeps its place; a new
+// key is appended. Only the top level is merged, nested values are
+// replaced whole. Used while the server throttles the device, so a
+// burst of readings leaves as one frame with the newest value of every
+// sensor.
+//
+// The buffer is allocated on the first merge and kept. merge() leaves the
+// pending reading untouched when it fails (not an object, or no room).
+class ZiLinkCoalescer
+{
+public:
+        explicit ZiLinkCoalescer(size_t capacity = ZILINK_COALESCE_BYTES) : _capacity(capacity) {}
+
+        bool merge(const char *reading, size_t length);
+        bool empty() const { return _length == 0; }
+        const char *data() const { return _buf.get(); }
+        size_t length() const { return _length; }
+        void clear() { _length = 0; }
+
+private:
+        struct Span
+        {
+                const char *p;
+                size_t n;
+        };
+
+        // Next `"key":value` member of the object text at `at`, up to `end`
+        static bool member(const char *&at, const char *end, Span &key, Span &value);
+        bool find(const Span &key, Span &value) const;
+        bool replace(const Span &old, const Span &value);
+        bool append(const Span &key, const Span &value);
+
+        std::unique_ptr<char[]> _buf;
+        size_t _capacity;
+        size_t _length = 0;
+};
+
+#endif
@@ -0,0 +1,289 @@
+#include "ZiLinkCommandQueue.h"
+
+#include "ZiLinkClock.h"
+
+#include <string.h>
+
+uint32_t ZiLinkCommandQueue::hash(const char *s, size_t length)
+{
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < length; i++)
+  {
+    h ^= (uint8_t)s[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static size_t skipSpace(const char *text, size_t length, size_t i)
+{
+  while (i < length && (text[i] == ' ' || text[i] == '\t' || text[i] == '\r' || text[i] == '\n'))
+  {
+    i++;
+  }
+  return i;
+}
+
+// Index past the closing quote of the string starting at text[i] ('"'), or 0
+static size_t skipString(const char *text, size_t length, size_t i)
+{
+  for (i++; i < length; i++)
+  {
+    if (text[i] == '\\')
+    {
+      i++;
+    }
+    else if (text[i] == '"')
+    {
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+bool ZiLinkCommandQueue::nameOf(const char *text, size_t length, const char *&name, size_t &nameLength)
+{
+  size_t i = skipSpace(text, length, 0);
+  if (i < length && text[i] == '{')
+  {
+    // Shallow scan for the top-level "type": "..." member
+    int depth = 0;
+    bool expectKey = false;
+    while (i < length)
+    {
+      const char c = text[i];
+      if (c == '"')
+      {
+        const size_t end = skipString(text, length, i);
+        if (!end)
+        {
+          return false;
+        }
+        if (depth == 1 && expectKey)
+        {
+          const bool isType = end - i == 6 && memcmp(text + i, "\"type\"", 6) == 0;
+          i = skipSpace(text, length, end);
+          if (i >= length || text[i] != ':')
+          {
+            return false;
+          }
+          i = skipSpace(text, length, i + 1);
+          expectKey = false;
+          if (isType)
+          {
+            const size_t valueEnd = i < length && text[i] == '"' ? skipString(text, length, i) : 0;
+            // Escaped names are not worth decoding here
+            if (!valueEnd || memchr(text + i + 1, '\\', valueEnd - i - 2))
+            {
+              return false;
+            }
+            name = text + i + 1;
+            nameLength = valueEnd - i - 2;
+            return nameLength > 0;
+          }
+          continue;
+        }
+        i = end;
+        continue;
+      }
+      if (c == '{' || c == '[')
+      {
+        depth++;
+        expectKey = depth == 1;
+      }
+      else if (c == '}' || c == ']')
+      {
+        if (--depth <= 0)
+        {
+          return false;
+        }
+      }
+      else if (c == ',' && depth == 1)
+      {
+        expectKey = true;
+      }
+      i++;
+    }
+    return false;
+  }
+  // Plain text: the first word
+  const size_t start = i;
+  while (i < length && text[i] != ' ' && text[i] != ':' && text[i] != '=' && text[i] != '\t' && text[i] != '\r' &&
+         text[i] != '\n')
+  {
+    i++;
+  }
+  name = text + start;
+  nameLength = i - start;
+  return nameLength > 0;
+}
+
+bool ZiLinkCommandQueue::push(const char *text, size_t length, Source source)
+{
+  _received.fetch_add(1, std::memory_order_relaxed);
+  if (length > ZILINK_COMMAND_MAX_LEN)
+  {
+    _oversized.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  const uint32_t head = _head.load(std::memory_order_relaxed);
+  if (head - _tail.load(std::memory_order_acquire) >= ZILINK_COMMAND_SLOTS)
+  {
+    _dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  Slot &slot = _slots[head & (ZILINK_COMMAND_SLOTS - 1)];
+  memcpy(slot.text, text, length);
+  slot.text[length] = '\0';
+  slot.length = (uint16_t)length;
+  slot.source = source;
+
+  const char *name = slot.text;
+  size_t nameLength;
+  if (!nameOf(slot.text, length, name, nameLength) || nameLength >= ZILINK_COMMAND_NAME_LEN)
+  {
+    nameLength = 0;
+  }
+  memcpy(slot.name, name, nameLength);
+  slot.name[nameLength] = '\0';
+  slot.hash = nameLength ? hash(slot.name, nameLength) : 0;
+  slot.enqueuedUs = zilinkMicros();
+  // Publish the slot contents before the index
+  _head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+const ZiLinkCommandQueue::Command *ZiLinkCommandQueue::front()
+{
+  const uint32_t tail = _tail.load(std::memory_order_relaxed);
+  if (_head.load(std::memory_order_acquire) == tail)
+  {
+    return nullptr;
+  }
+  const Slot &slot = _slots[tail & (ZILINK_COMMAND_SLOTS - 1)];
+  _current.text = slot.text;
+  _current.length = slot.length;
+  _current.name = slot.name;
+  _current.hash = slot.hash;
+  _current.source = slot.source;
+  _current.waitUs = zilinkMicros() - slot.enqueuedUs;
+  return &_current;
+}
+
+void ZiLinkCommandQueue::pop()
+{
+  const uint32_t tail = _tail.load(std::memory_order_relaxed);
+  if (_head.load(std::memory_order_acquire) == tail)
+  {
+    return;
+  }
+  record(zilinkMicros() - _slots[tail & (ZILINK_COMMAND_SLOTS - 1)].enqueuedUs);
+  // Hand the slot back to the producer only once we are done reading it
+  _tail.store(tail + 1, std::memory_order_release);
+}
+
+void ZiLinkCommandQueue::record(uint32_t waitUs)
+{
+  _totalWaitUs += waitUs;
+  if (waitUs > _maxWaitUs)
+  {
+    _maxWaitUs = waitUs;
+  }
+}
+
+size_t ZiLinkCommandQueue::dispatch()
+{
+  size_t handled = 0;
+  // Commands pushed while the handlers run wait for the next call
+  for (size_t n = size(); n > 0; n--)
+  {
+    const Command *command = front();
+    const Handler *handler = nullptr;
+    if (command->hash)
+    {
+      Entry *entry = find(command->hash, command->name);
+      handler = entry ? &entry->handler : nullptr;
+    }
+    if (!handler && _fallback)
+    {
+      handler = &_fallback;
+    }
+    if (handler)
+    {
+      (*handler)(*command);
+      _dispatched++;
+      handled++;
+    }
+    else
+    {
+      _unhandled++;
+    }
+    pop();
+  }
+  return handled;
+}
+
+bool ZiLinkCommandQueue::on(const char *name, Handler handler)
+{
+  const size_t length = strlen(name);
+  if (length == 0 || length >= ZILINK_COMMAND_NAME_LEN)
+  {
+    return false;
+  }
+  const uint32_t h = hash(name, length);
+  Entry *entry = find(h, name);
+  if (entry)
+  {
+    if (handler)
+    {
+      entry->handler = handler;
+    }
+    else
+    {
+      // Keep the table dense for the lookup
+      _handlerCount--;
+      *entry = _handlers[_handlerCount];
+      _handlers[_handlerCount].handler = nullptr;
+    }
+    return true;
+  }
+  if (!handler || _handlerCount >= ZILINK_COMMAND_HANDLERS)
+  {
+    return false;
+  }
+  _handlers[_handlerCount].hash = h;
+  memcpy(_handlers[_handlerCount].name, name, length + 1);
+  _handlers[_handlerCount].handler = handler;
+  _handlerCount++;
+  return true;
+}
+
+ZiLinkCommandQueue::Entry *ZiLinkCommandQueue::find(uint32_t hash, const char *name)
+{
+  for (uint8_t i = 0; i < _handlerCount; i++)
+  {
+    if (_handlers[i].hash == hash && strcmp(_handlers[i].name, name) == 0)
+    {
+      return &_handlers[i];
+    }
+  }
+  return nullptr;
+}
+
+size_t ZiLinkCommandQueue::size() const
+{
+  return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+}
+
+ZiLinkCommandQueue::Stats ZiLinkCommandQueue::stats() const
+{
+  Stats s;
+  s.received = _received.load(std::memory_order_relaxed);
+  s.dropped = _dropped.load(std::memory_order_relaxed);
+  s.oversized = _oversized.load(std::memory_order_relaxed);
+  s.dispatched = _dispatched;
+  s.unhandled = _unhandled;
+  s.maxWaitUs = _maxWaitUs;
+  s.totalWaitUs = _totalWaitUs;
+  return s;
+}
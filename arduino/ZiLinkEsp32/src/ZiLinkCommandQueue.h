@@ -0,0 +1,152 @@
+#ifndef ZILINK_COMMAND_QUEUE_H
+#define ZILINK_COMMAND_QUEUE_H
+
+#include <atomic>
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+
+// Inbound commands buffered between the transports and the sketch (power of two)
+#ifndef ZILINK_COMMAND_SLOTS
+#define ZILINK_COMMAND_SLOTS 8
+#endif
+
+// Longest command text kept; longer ones are dropped
+#ifndef ZILINK_COMMAND_MAX_LEN
+#define ZILINK_COMMAND_MAX_LEN 128
+#endif
+
+// Longest command name used for dispatch (including the terminator)
+#ifndef ZILINK_COMMAND_NAME_LEN
+#define ZILINK_COMMAND_NAME_LEN 24
+#endif
+
+#ifndef ZILINK_COMMAND_HANDLERS
+#define ZILINK_COMMAND_HANDLERS 8
+#endif
+
+// Bounded single-producer/single-consumer queue of inbound commands.
+//
+// push() runs in the network context (WebSocket and MQTT callbacks) and
+// never blocks: when every slot is taken the command is dropped and
+// counted. The sketch side either polls front()/pop() or calls dispatch(),
+// which hands each command to the handler registered for its name. Names
+// are hashed once when they arrive and once when the handler is registered,
+// so dispatch compares integers and only checks the name of a handler whose
+// hash matches.
+//
+// A command's name is its first word ("led on" -> "led"), or the top-level
+// "type" member when it is a JSON object ({"type":"ui_button",...}).
+class ZiLinkCommandQueue
+{
+public:
+        enum Source : uint8_t
+        {
+                SourceWebSocket,
+                SourceMqtt
+        };
+
+        struct Command
+        {
+                const char *text; // as received, NUL-terminated
+                size_t length;
+                const char *name; // NUL-terminated
+                uint32_t hash;
+                Source source;
+                uint32_t waitUs; // time spent queued (set by dispatch()/pop())
+        };
+
+        typedef std::function<void(const Command &)> Handler;
+
+        struct Stats
+        {
+                uint32_t received = 0;
+                uint32_t dropped = 0;   // queue full
+                uint32_t oversized = 0; // longer than ZILINK_COMMAND_MAX_LEN
+                uint32_t dispatched = 0;
+                uint32_t unhandled = 0; // no handler for the name and no fallback
+                uint32_t maxWaitUs = 0;
+                uint64_t totalWaitUs = 0; // over dispatched + polled commands
+        };
+
+        ZiLinkCommandQueue() = default;
+        ZiLinkCommandQueue(const ZiLinkCommandQueue &) = delete;
+        ZiLinkCommandQueue &operator=(const ZiLinkCommandQueue &) = delete;
+
+        // Producer side
+        bool push(const char *text, size_t length, Source source);
+
+        // Consumer side. front() stays valid until pop().
+        const Command *front();
+        void pop();
+        // Runs the handlers for everything queued; returns the number handled.
+        // A handler must not call front()/pop() itself.
+        size_t dispatch();
+
+        // Consumer side, before or between dispatch() calls. Registering a
+        // name again replaces its handler; `handler` empty removes it.
+        bool on(const char *name, Handler handler);
+        // Receives commands no named handler claimed
+        void onUnknown(Handler handler) { _fallback = handler; }
+        bool hasHandlers() const { return _handlerCount > 0 || _fallback; }
+
+        size_t size() const;
+        bool empty() const { return size() == 0; }
+        Stats stats() const;
+
+        // FNV-1a; `length` bytes of `s`
+        static uint32_t hash(const char *s, size_t length);
+        // Same hash of a NUL-terminated literal, usable as a case label
+        static constexpr uint32_t hashOf(const char *s, uint32_t h = 2166136261u)
+        {
+                return *s ? hashOf(s + 1, (h ^ (uint8_t)*s) * 16777619u) : h;
+        }
+        // Dispatch name of a command (see above); false when it has none
+        static bool nameOf(const char *text, size_t length, const char *&name, size_t &nameLength);
+
+private:
+        static_assert((ZILINK_COMMAND_SLOTS & (ZILINK_COMMAND_SLOTS - 1)) == 0, "ZILINK_COMMAND_SLOTS must be a power of two");
+
+        struct Slot
+        {
+                uint32_t enqueuedUs;
+                uint32_t hash;
+                uint16_t length;
+                Source source;
+                char text[ZILINK_COMMAND_MAX_LEN + 1];
+                char name[ZILINK_COMMAND_NAME_LEN];
+        };
+
+        struct Entry
+        {
+                uint32_t hash;
+                char name[ZILINK_COMMAND_NAME_LEN]; // hashes can collide
+                Handler handler;
+        };
+
+        Entry *find(uint32_t hash, const char *name);
+
+        void record(uint32_t waitUs);
+
+        Slot _slots[ZILINK_COMMAND_SLOTS];
+        // Free-running indices: _head written by the producer, _tail by the consumer
+        std::atomic<uint32_t> _head{0};
+        std::atomic<uint32_t> _tail{0};
+        Command _current = {};
+
+        Entry _handlers[ZILINK_COMMAND_HANDLERS];
+        uint8_t _handlerCount = 0;
+        Handler _fallback;
+
+        // Producer-owned counters
+        std::atomic<uint32_t> _received{0};
+        std::atomic<uint32_t> _dropped{0};
+        std::atomic<uint32_t> _oversized{0};
+        // Consumer-owned counters
+        uint32_t _dispatched = 0;
+        uint32_t _unhandled = 0;
+        uint32_t _maxWaitUs = 0;
+        uint64_t _totalWaitUs = 0;
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "ZiLinkComponentTable.h"
+
+#include <string.h>
+
+void ZiLinkComponentTable::setDefaults(const Config &config)
+{
+  _defaults = config;
+  for (size_t i = 0; i < _count; i++)
+  {
+    if (!_entries[i].customConfig)
+    {
+      _entries[i].config = config;
+    }
+  }
+}
+
+bool ZiLinkComponentTable::configure(const char *id, const Config &config)
+{
+  Entry *e = find(id);
+  if (!e)
+  {
+    e = insert(id);
+  }
+  if (!e)
+  {
+    return false;
+  }
+  e->config = config;
+  e->customConfig = true;
+  return true;
+}
+
+ZiLinkComponentTable::Entry *ZiLinkComponentTable::find(const char *id)
+{
+  for (size_t i = 0; i < _count; i++)
+  {
+    if (strcmp(_entries[i].id, id) == 0)
+    {
+      return &_entries[i];
+    }
+  }
+  return nullptr;
+}
+
+ZiLinkComponentTable::Entry *ZiLinkComponentTable::insert(const char *id)
+{
+  const size_t len = strlen(id);
+  if (_count >= ZILINK_MAX_COMPONENTS || len >= ZILINK_COMPONENT_ID_LEN)
+  {
+    return nullptr;
+  }
+  Entry &e = _entries[_count++];
+  e = Entry();
+  memcpy(e.id, id, len + 1);
+  e.type = "";
+  e.widget = -1;
+  e.config = _defaults;
+  return &e;
+}
+
+static bool withinDeadband(const ZiLinkComponentTable::Entry &e, int32_t value)
+{
+  if (e.isBool)
+  {
+    return (value != 0) == (e.sent != 0);
+  }
+  const int64_t diff = (int64_t)value - (int64_t)e.sent;
+  return (diff < 0 ? -diff : diff) <= (int64_t)e.config.deadband;
+}
+
+ZiLinkComponentTable::Decision ZiLinkComponentTable::update(const char *type, const char *id, int32_t value, bool isBool,
+                                                            uint32_t nowMs, Entry *&entry)
+{
+  _stats.updates++;
+  entry = find(id);
+  if (!entry)
+  {
+    entry = insert(id);
+    if (!entry)
+    {
+      _stats.untracked++;
+      return Untracked;
+    }
+  }
+  entry->type = type;
+  entry->isBool = isBool;
+  return apply(*entry, value, nowMs);
+}
+
+ZiLinkComponentTable::Decision ZiLinkComponentTable::update(Entry &entry, int32_t value, uint32_t nowMs)
+{
+  _stats.updates++;
+  return apply(entry, value, nowMs);
+}
+
+ZiLinkComponentTable::Entry *ZiLinkComponentTable::add(const char *type, const char *id, bool isBool)
+{
+  Entry *e = find(id);
+  if (!e)
+  {
+    e = insert(id);
+  }
+  if (e)
+  {
+    e->type = type;
+    e->isBool = isBool;
+  }
+  return e;
+}
+
+ZiLinkComponentTable::Decision ZiLinkComponentTable::apply(Entry &e, int32_t value, uint32_t nowMs)
+{
+  e.hasValue = true;
+  e.value = value;
+
+  if (e.delivered && withinDeadband(e, value))
+  {
+    // Back to (about) what the server shows: a held value is obsolete
+    if (e.dirty)
+    {
+      _stats.coalesced++;
+    }
+    e.dirty = false;
+    _stats.suppressed++;
+    return Suppressed;
+  }
+  if (e.dirty)
+  {
+    // Replaces a value that was never sent
+    _stats.coalesced++;
+  }
+  e.dirty = true;
+  if (e.attempted && (uint32_t)(nowMs - e.lastAttemptMs) < e.config.minIntervalMs)
+  {
+    return Deferred;
+  }
+  return Send;
+}
+
+void ZiLinkComponentTable::markSent(Entry &entry, uint32_t nowMs)
+{
+  entry.sent = entry.value;
+  entry.delivered = true;
+  entry.dirty = false;
+  entry.attempted = true;
+  entry.lastSendMs = entry.lastAttemptMs = nowMs;
+  _stats.sent++;
+}
+
+void ZiLinkComponentTable::markFailed(Entry &entry, uint32_t nowMs)
+{
+  entry.attempted = true;
+  entry.lastAttemptMs = nowMs;
+}
+
+void ZiLinkComponentTable::markAllSent(uint32_t nowMs)
+{
+  for (size_t i = 0; i < _count; i++)
+  {
+    if (_entries[i].hasValue)
+    {
+      markSent(_entries[i], nowMs);
+    }
+  }
+}
+
+bool ZiLinkComponentTable::due(const Entry &e, uint32_t nowMs) const
+{
+  if (!e.hasValue || (e.attempted && (uint32_t)(nowMs - e.lastAttemptMs) < e.config.minIntervalMs))
+  {
+    return false;
+  }
+  if (e.dirty)
+  {
+    return true;
+  }
+  // Heartbeat for a value that has not changed
+  return e.delivered && e.config.maxIntervalMs && (uint32_t)(nowMs - e.lastSendMs) >= e.config.maxIntervalMs;
+}
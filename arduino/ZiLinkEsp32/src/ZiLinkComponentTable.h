@@ -0,0 +1,147 @@
+#ifndef ZILINK_COMPONENT_TABLE_H
+#define ZILINK_COMPONENT_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Components tracked individually; further ids are sent unfiltered
+#ifndef ZILINK_MAX_COMPONENTS
+#define ZILINK_MAX_COMPONENTS 16
+#endif
+
+// Longest component id kept in the table (including the terminator)
+#ifndef ZILINK_COMPONENT_ID_LEN
+#define ZILINK_COMPONENT_ID_LEN 24
+#endif
+
+// Default spacing between two sends of the same component
+#ifndef ZILINK_COMPONENT_MIN_INTERVAL_MS
+#define ZILINK_COMPONENT_MIN_INTERVAL_MS 100
+#endif
+
+// Last known state of every component, used to filter create*() calls.
+//
+// A value within `deadband` of the last one sent is dropped. A change that
+// comes sooner than `minIntervalMs` after the previous send is held and
+// replaced by later values, so a burst costs one frame carrying the newest
+// value once the interval has passed (service()). With `maxIntervalMs` set,
+// an unchanged value is re-sent that often as a heartbeat.
+class ZiLinkComponentTable
+{
+public:
+        struct Config
+        {
+                int32_t deadband = 0;
+                uint32_t minIntervalMs = ZILINK_COMPONENT_MIN_INTERVAL_MS;
+                uint32_t maxIntervalMs = 0; // 0 disables the heartbeat
+        };
+
+        struct Entry
+        {
+                char id[ZILINK_COMPONENT_ID_LEN];
+                const char *type; // static string ("slider", ...)
+                int32_t value;    // latest value from the sketch
+                int32_t sent;     // value the server last received
+                int16_t widget;   // index in the widget schema, -1 for create*() ids
+                uint32_t lastSendMs;
+                uint32_t lastAttemptMs;
+                Config config;
+                bool isBool;
+                bool hasValue;   // set by an update (not only configure())
+                bool delivered;  // `sent` is valid
+                bool attempted;  // lastAttemptMs is valid
+                bool dirty;      // `value` still has to be sent
+                bool customConfig;
+        };
+
+        struct Stats
+        {
+                uint32_t updates = 0;
+                uint32_t sent = 0;
+                uint32_t suppressed = 0; // within the deadband of the sent value
+                uint32_t coalesced = 0;  // replaced by a newer value before it was sent
+                uint32_t untracked = 0;  // table full
+        };
+
+        enum Decision
+        {
+                Send,       // send `entry` now, then report markSent()/markFailed()
+                Suppressed, // nothing to send
+                Deferred,   // held until service() finds it due
+                Untracked   // table full or id too long: send it unfiltered
+        };
+
+        // Applies to every component without its own configure()
+        void setDefaults(const Config &config);
+        bool configure(const char *id, const Config &config);
+
+        Decision update(const char *type, const char *id, int32_t value, bool isBool, uint32_t nowMs, Entry *&entry);
+        // Same, for an entry from add(): no lookup by id
+        Decision update(Entry &entry, int32_t value, uint32_t nowMs);
+        // Tracks `id` ahead of its first update (widget schemas); null when full
+        Entry *add(const char *type, const char *id, bool isBool);
+        void markSent(Entry &entry, uint32_t nowMs);
+        void markFailed(Entry &entry, uint32_t nowMs);
+        // After a full snapshot reached the server
+        void markAllSent(uint32_t nowMs);
+
+        // Sends held values and heartbeats that are due through `send(const
+        // Entry &)`, which returns true once the frame is handed off. Stops at
+        // the first failure, the transport is most likely down.
+        template <typename Fn>
+        size_t service(uint32_t nowMs, Fn send);
+
+        // Visits every entry that has a value
+        template <typename Fn>
+        void forEach(Fn fn) const;
+
+        size_t count() const { return _count; }
+        const Stats &stats() const { return _stats; }
+
+private:
+        Entry *find(const char *id);
+        Entry *insert(const char *id);
+        Decision apply(Entry &e, int32_t value, uint32_t nowMs);
+        bool due(const Entry &e, uint32_t nowMs) const;
+
+        Entry _entries[ZILINK_MAX_COMPONENTS];
+        size_t _count = 0;
+        Config _defaults;
+        Stats _stats;
+};
+
+template <typename Fn>
+size_t ZiLinkComponentTable::service(uint32_t nowMs, Fn send)
+{
+        size_t sent = 0;
+        for (size_t i = 0; i < _count; i++)
+        {
+                Entry &e = _entries[i];
+                if (!due(e, nowMs))
+                {
+                        continue;
+                }
+                if (!send(static_cast<const Entry &>(e)))
+                {
+                        markFailed(e, nowMs);
+                        break;
+                }
+                markSent(e, nowMs);
+                sent++;
+        }
+        return sent;
+}
+
+template <typename Fn>
+void ZiLinkComponentTable::forEach(Fn fn) const
+{
+        for (size_t i = 0; i < _count; i++)
+        {
+                if (_entries[i].hasValue)
+                {
+                        fn(_entries[i]);
+                }
+        }
+}
+
+#endif
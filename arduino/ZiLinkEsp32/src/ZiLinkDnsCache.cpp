@@ -0,0 +1,130 @@
+#include "ZiLinkDnsCache.h"
+
+#include "ZiLinkTcpConnect.h"
+
+#include <atomic>
+#include <new>
+#include <string.h>
+
+#if defined(ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <thread>
+#endif
+
+// Shared by the owner and the lookup; whichever lets go of it last frees it
+struct ZiLinkDnsCache::Query
+{
+  enum State : uint8_t
+  {
+    Running,
+    Done,
+    Abandoned
+  };
+
+  char host[256];
+  uint32_t ip = 0;
+  bool ok = false;
+  std::atomic<uint8_t> state{Running};
+};
+
+bool ZiLinkDnsCache::resolve(const char *host, uint32_t &ipv4, uint32_t nowMs)
+{
+  if (_valid && nowMs - _resolvedMs < _ttlMs)
+  {
+    _hits++;
+    ipv4 = _ip;
+    return true;
+  }
+  _lookups++;
+  _valid = ZiLinkTcpConnect::resolve(host, _ip);
+  _resolvedMs = nowMs;
+  ipv4 = _ip;
+  return _valid;
+}
+
+ZiLinkDnsCache::Lookup ZiLinkDnsCache::lookup(const char *host, uint32_t &ipv4, uint32_t nowMs)
+{
+  if (_valid && nowMs - _resolvedMs < _ttlMs)
+  {
+    _hits++;
+    ipv4 = _ip;
+    return Resolved;
+  }
+  // A lookup for another host is of no use any more
+  if (_query && strcmp(_query->host, host) != 0)
+  {
+    abandon();
+  }
+  if (!_query)
+  {
+    _lookups++;
+    if (ZiLinkTcpConnect::parse(host, _ip))
+    {
+      _valid = true;
+      _resolvedMs = nowMs;
+      ipv4 = _ip;
+      return Resolved;
+    }
+    return start(host) ? Pending : Failed;
+  }
+  if (_query->state.load(std::memory_order_acquire) == Query::Running)
+  {
+    return Pending;
+  }
+  _valid = _query->ok;
+  _ip = _query->ip;
+  _resolvedMs = nowMs;
+  delete _query;
+  _query = nullptr;
+  ipv4 = _ip;
+  return _valid ? Resolved : Failed;
+}
+
+void ZiLinkDnsCache::run(Query *query)
+{
+  query->ok = ZiLinkTcpConnect::resolve(query->host, query->ip);
+  if (query->state.exchange(Query::Done, std::memory_order_acq_rel) == Query::Abandoned)
+  {
+    delete query;
+  }
+}
+
+bool ZiLinkDnsCache::start(const char *host)
+{
+  if (strlen(host) >= sizeof(Query::host))
+  {
+    return false;
+  }
+  Query *query = new (std::nothrow) Query;
+  if (!query)
+  {
+    return false;
+  }
+  strcpy(query->host, host);
+#if defined(ESP32)
+  if (xTaskCreatePinnedToCore([](void *arg)
+                              {
+                                run(static_cast<Query *>(arg));
+                                vTaskDelete(nullptr); },
+                              "zilink-dns", ZILINK_DNS_TASK_STACK, query, 1, nullptr, tskNO_AFFINITY) != pdPASS)
+  {
+    delete query;
+    return false;
+  }
+#else
+  std::thread(run, query).detach();
+#endif
+  _query = query;
+  return true;
+}
+
+void ZiLinkDnsCache::abandon()
+{
+  if (_query && _query->state.exchange(Query::Abandoned, std::memory_order_acq_rel) == Query::Done)
+  {
+    delete _query;
+  }
+  _query = nullptr;
+}
@@ -0,0 +1,66 @@
+#ifndef ZILINK_DNS_CACHE_H
+#define ZILINK_DNS_CACHE_H
+
+#include <stdint.h>
+
+// How long a resolved address is reused. getaddrinfo() does not return the
+// record's TTL, so this stands in for it.
+#ifndef ZILINK_DNS_TTL_MS
+#define ZILINK_DNS_TTL_MS 300000
+#endif
+
+// Stack of the short-lived task that runs a background lookup (ESP32)
+#ifndef ZILINK_DNS_TASK_STACK
+#define ZILINK_DNS_TASK_STACK 4096
+#endif
+
+// Address of one server, resolved once and reused for reconnects until
+// ttlMs has passed or the owner invalidates it (host changed, or several
+// connects in a row failed and the server may have moved). resolve()
+// blocks in the system resolver; lookup() runs the resolver on a task of
+// its own and is polled, so a slow or unreachable DNS server never stalls
+// the caller. A reconnect that hits the cache goes straight to the TCP
+// connect.
+class ZiLinkDnsCache
+{
+public:
+        enum Lookup : uint8_t
+        {
+                Resolved,
+                Pending, // call again later
+                Failed
+        };
+
+        explicit ZiLinkDnsCache(uint32_t ttlMs = ZILINK_DNS_TTL_MS) : _ttlMs(ttlMs) {}
+        ~ZiLinkDnsCache() { abandon(); }
+        ZiLinkDnsCache(const ZiLinkDnsCache &) = delete;
+        ZiLinkDnsCache &operator=(const ZiLinkDnsCache &) = delete;
+
+        void setTtl(uint32_t ms) { _ttlMs = ms; }
+        // `ipv4` in network byte order
+        bool resolve(const char *host, uint32_t &ipv4, uint32_t nowMs);
+        // Like resolve(), but a name that is not cached is looked up in the
+        // background: Pending until the resolver answers
+        Lookup lookup(const char *host, uint32_t &ipv4, uint32_t nowMs);
+        void invalidate() { _valid = false; }
+
+        uint32_t lookups() const { return _lookups; }
+        uint32_t hits() const { return _hits; }
+
+private:
+        struct Query;
+        static void run(Query *query);
+        bool start(const char *host);
+        // Leaves a running lookup to free itself
+        void abandon();
+
+        uint32_t _ttlMs;
+        uint32_t _ip = 0;
+        uint32_t _resolvedMs = 0;
+        bool _valid = false;
+        uint32_t _lookups = 0;
+        uint32_t _hits = 0;
+        Query *_query = nullptr;
+};
+
+#endif
@@ -1,8 +1,41 @@
 #include "ZiLinkEsp32.h"
 
-ZiLinkEsp32::ZiLinkEsp32() : _mqtt(_wifi) {}
+#include <memory>
+#include <new>
 
-ZiLinkEsp32::ZiLinkEsp32(const char *deviceId, const char *serverHost, int serverPort) : _mqtt(_wifi) {
+// Duration of a send call and whether it succeeded, into `stats` and the
+// transport's health score
+static bool recordSend(ZiLinkTransportStats &stats, ZiLinkTransportHealth &health, bool ok, size_t bytes, uint32_t startUs)
+{
+  const uint32_t us = micros() - startUs;
+  ok ? stats.sent(bytes, us) : stats.failed(us);
+  health.record(ok, us);
+  return ok;
+}
+
+// "trace":[n,deviceMs] for latency tracing, JSON and MessagePack
+static ZiLinkFrameWriter &writeTrace(ZiLinkFrameWriter &out, const ZiLinkLatency::Trace &trace)
+{
+  return out.raw("\"trace\":[").uinteger(trace.seq).raw(',').uinteger(trace.deviceMs).raw(']');
+}
+
+static void writeTrace(ZiLinkMsgPack &mp, const ZiLinkLatency::Trace &trace)
+{
+  mp.array(2).uinteger(trace.seq).uinteger(trace.deviceMs);
+}
+
+ZiLinkEsp32::ZiLinkEsp32() : _mqtt(_mqttTap) {
+  _mqttTap.onPuback(mqttPuback, this);
+  _router.add(&_wsLink);
+  _router.add(&_mqttLink);
+  _router.add(&_httpLink);
+}
+
+ZiLinkEsp32::ZiLinkEsp32(const char *deviceId, const char *serverHost, int serverPort) : _mqtt(_mqttTap) {
+  _mqttTap.onPuback(mqttPuback, this);
+  _router.add(&_wsLink);
+  _router.add(&_mqttLink);
+  _router.add(&_httpLink);
   _deviceId = String(deviceId);
   _baseUrl = "http://" + String(serverHost) + ":" + String(serverPort);
 }
@@ -14,29 +47,70 @@ void ZiLinkEsp32::setupHttp(const char *baseUrl, const char *deviceId, const cha
   _token = token;
 }
 
-bool ZiLinkEsp32::sendHttp(const String &endpoint, const String &payload)
+bool ZiLinkEsp32::writeDevicePath(ZiLinkFrameWriter &out, const char *prefix, const char *suffix)
+{
+  out.cstr(prefix).raw(_deviceId.c_str(), _deviceId.length()).cstr(suffix);
+  return out.ok();
+}
+
+bool ZiLinkEsp32::enableHttpPipeline(const ZiLinkHttpPipeline::Config &config)
+{
+  _httpPipeline.onResult(httpResult, this);
+  ZiLinkHttpPipeline::Config pinned = config;
+  pinned.caCert = pinned.caCert ? pinned.caCert : _tlsCaCert;
+  pinned.fingerprint = pinned.fingerprint ? pinned.fingerprint : _tlsFingerprint;
+  return _httpPipeline.begin(_baseUrl.c_str(), _deviceId.c_str(), _token.c_str(), pinned);
+}
+
+void ZiLinkEsp32::httpResult(void *ctx, int status, size_t bytes, uint32_t us)
+{
+  ZiLinkEsp32 *self = static_cast<ZiLinkEsp32 *>(ctx);
+  const bool ok = status > 0;
+  ok ? self->_httpStats.sent(bytes, us) : self->_httpStats.failed(us);
+  self->_httpLink.health.record(ok, us);
+}
+
+bool ZiLinkEsp32::sendHttp(ZiLinkHttpPipeline::Kind kind, const char *payload, size_t length)
 {
+  if (_httpPipeline.enabled())
+  {
+    // Sent from loop(); the outcome goes to onHttpComplete()
+    const uint16_t id = _httpPipeline.post(kind, payload, length);
+    if (!id)
+    {
+      return false;
+    }
+    _httpLastId = id;
+    return true;
+  }
   if (WiFi.status() != WL_CONNECTED)
   {
     return false;
   }
+  char urlBuf[192];
+  ZiLinkFrameWriter url(urlBuf, sizeof(urlBuf));
+  url.raw(_baseUrl.c_str(), _baseUrl.length());
+  if (!writeDevicePath(url, "/devices/", ZiLinkHttpPipeline::pathOf(kind)))
+  {
+    return false;
+  }
+  const uint32_t start = micros();
   HTTPClient http;
-  String url = _baseUrl + endpoint;
-  http.begin(url);
+  _tlsCaCert ? http.begin(url.c_str(), _tlsCaCert) : http.begin(url.c_str());
   http.addHeader("Authorization", "Bearer " + _token);
-  int httpCode = http.POST(payload);
+  int httpCode = http.POST((uint8_t *)payload, length);
   http.end();
-  return httpCode > 0;
+  return recordSend(_httpStats, _httpLink.health, httpCode > 0, length, start);
 }
 
 bool ZiLinkEsp32::sendStatus(const String &payload)
 {
-  return sendHttp("/devices/" + _deviceId + "/status", payload);
+  return sendOrQueue(ChannelHttpStatus, payload.c_str(), payload.length());
 }
 
 bool ZiLinkEsp32::sendData(const String &payload)
 {
-  return sendHttp("/devices/" + _deviceId + "/data", payload);
+  return sendOrQueue(ChannelHttpData, payload.c_str(), payload.length());
 }
 
 void ZiLinkEsp32::setupWebSocket(const char *host, uint16_t port, const char *path, const char *deviceId, const char *token)
@@ -45,18 +119,20 @@ void ZiLinkEsp32::setupWebSocket(const char *host, uint16_t port, const char *pa
   _deviceId = deviceId;
   _wsConnected = false;
   _wsAuthenticated = false;
-  _wsQHead = _wsQTail = 0;
 
   // Use TLS (WSS) automatically when using port 443
   if (port == 443)
   {
-    // For ESP32 with WebSocketsClient, beginSSL enables wss://
-    // If your environment requires a specific CA, you may need to
-    // provide it via WebSocketsClient API (e.g. setCACert) before calling beginSSL.
-    _ws.beginSSL(host, port, path);
-    // Optional: if your environment uses a certificate chain the device
-    // cannot validate, consider enabling insecure mode (not recommended):
-    // _ws.setInsecure();
+    // The server is authenticated by a pinned CA or certificate
+    // fingerprint when one is set (setTlsCaCert()/setTlsFingerprint())
+    if (_tlsCaCert)
+    {
+      _ws.beginSslWithCA(host, port, path, _tlsCaCert);
+    }
+    else
+    {
+      _ws.beginSSL(host, port, path, _tlsFingerprint ? _tlsFingerprint : "");
+    }
   }
   else
   {
@@ -69,46 +145,51 @@ void ZiLinkEsp32::setupWebSocket(const char *host, uint16_t port, const char *pa
               {
     switch(type) {
       case WStype_DISCONNECTED:
+        if (_wsConnected) {
+          _wsStats.disconnects++;
+        }
         _wsConnected = false;
         _wsAuthenticated = false;
+        _wsBinary = false;
+        _schemaSent = false;
+        // The server dropped the sub-devices with the connection
+        if (_gateway) {
+          _gateway->sessionLost();
+        }
+        // Streams are announced again and wait for fresh credit
+        for (uint8_t i = 0; i < ZILINK_MAX_STREAMS; i++) {
+          _streams[i].revoke();
+          _streamAnnounced[i] = false;
+        }
+        // Unacknowledged replays are sent again after the next auth_success
+        _log.rewind();
         Serial.printf("[%s] Disconnected!\n", _deviceId.c_str());
         break;
       case WStype_CONNECTED:
         {
           _wsConnected = true;
+          _wsConnectedMs = millis();
+          _wsStats.connectMs = _wsConnectedMs - _wsLoopMs;
+          _wsStats.connects++;
           Serial.printf("[%s] Connected to server!\n", _deviceId.c_str());
-          String authMsg = "{\"type\":\"auth\",\"data\":{\"token\":\"" + _token + "\",\"clientType\":\"device\",\"deviceId\":\"" + _deviceId + "\"}}";
-          _ws.sendTXT(authMsg);
+          ZiLinkFrame<512> authMsg;
+          authMsg.raw("{\"type\":\"auth\",\"data\":{\"token\":").str(_token.c_str(), _token.length());
+          authMsg.raw(",\"clientType\":\"device\",\"deviceId\":").str(_deviceId.c_str(), _deviceId.length());
+          if (_wireRequested == EncodingMsgPack) {
+            authMsg.raw(",\"encoding\":\"msgpack\"");
+          }
+          authMsg.raw("}}");
+          sendWsFrame(authMsg);
           // Devices do not subscribe via WS; web clients subscribe.
           // Optionally, a device could register its info here using
           // a `device_register` message if supported by the server.
         }
         break;
       case WStype_TEXT:
-        {
-          String message = String((char*)payload);
-          Serial.printf("[%s] Received: %s\n", _deviceId.c_str(), message.c_str());
-          // Parse and handle command
-          DynamicJsonDocument doc(1024);
-          deserializeJson(doc, message);
-          const char* msgType = doc["type"];
-          if (msgType && strcmp(msgType, "auth_success") == 0) {
-            _wsAuthenticated = true;
-            wsFlushQueue();
-          } else if (msgType && strcmp(msgType, "error") == 0) {
-            const char* err = doc["data"]["error"] | "unknown";
-            Serial.printf("[%s] WS error: %s\n", _deviceId.c_str(), err);
-          } else if (msgType && strcmp(msgType, "command") == 0) {
-            const char* command = doc["data"]["command"];
-            Serial.printf("Received command: %s\n", command);
-            // Store command for hasCommand()/getCommand()
-            _pendingCommand = String(command);
-            _hasPendingCommand = true;
-          }
-        }
+        handleTextMessage((char*)payload, length, ZiLinkCommandQueue::SourceWebSocket);
         break;
       case WStype_BIN:
-        Serial.printf("[%s] Binary message received\n", _deviceId.c_str());
+        handleBinaryFrame(payload, length);
         break;
       case WStype_ERROR:
         Serial.printf("[%s] WS Error!\n", _deviceId.c_str());
@@ -117,175 +198,1691 @@ void ZiLinkEsp32::setupWebSocket(const char *host, uint16_t port, const char *pa
   _ws.setReconnectInterval(5000);
 }
 
-bool ZiLinkEsp32::sendWebSocketData(const String &message)
+bool ZiLinkEsp32::sendWsFrame(ZiLinkFrameWriter &frame, bool binary)
+{
+  if (!frame.ok())
+  {
+    Serial.printf("[%s] Frame exceeds buffer, dropped\n", _deviceId.c_str());
+    _wsStats.failed(0);
+    return false;
+  }
+  const uint32_t start = micros();
+  bool ok;
+  if (frame.headroom() >= WEBSOCKETS_MAX_HEADER_SIZE)
+  {
+    // Let the client write its header into the reserved headroom (no copy, no malloc)
+    uint8_t *at = frame.base() + frame.headroom() - WEBSOCKETS_MAX_HEADER_SIZE;
+    ok = binary ? _ws.sendBIN(at, frame.length(), true) : _ws.sendTXT(at, frame.length(), true);
+  }
+  else if (binary)
+  {
+    ok = _ws.sendBIN(reinterpret_cast<const uint8_t *>(frame.c_str()), frame.length());
+  }
+  else
+  {
+    ok = _ws.sendTXT(frame.c_str(), frame.length());
+  }
+  return recordSend(_wsStats, _wsLink.health, ok, frame.length(), start);
+}
+
+template <typename Fn>
+bool ZiLinkEsp32::withFrame(size_t needed, Fn build)
+{
+  if (needed <= ZILINK_FRAME_SIZE)
+  {
+    ZiLinkFrame<> frame;
+    return build(frame);
+  }
+  // Larger frames share one grow-only buffer instead of allocating per send.
+  // Not reentrant: `build` must not call withFrame() again.
+  const size_t cap = needed + ZILINK_FRAME_HEADROOM + 1;
+  if (cap > _scratchCap)
+  {
+    _scratch.reset(new (std::nothrow) char[cap]);
+    _scratchCap = _scratch ? cap : 0;
+    if (!_scratch)
+    {
+      return false;
+    }
+  }
+  ZiLinkFrameWriter frame(_scratch.get(), cap, ZILINK_FRAME_HEADROOM);
+  return build(frame);
+}
+
+template <typename Fn>
+bool ZiLinkEsp32::throttled(Fn send)
 {
-  if (_ws.isConnected() && _wsAuthenticated)
+  // Taken only once the caller knows where the frame goes, so a down
+  // transport does not use up the granted rate
+  if (!_throttle.take(millis()))
+  {
+    return false;
+  }
+  if (send())
   {
-    String msg = "{\"type\":\"device_data\",\"data\":{\"sensorData\":" + message + "}}";
-    _ws.sendTXT(msg);
     return true;
   }
-  // If not ready, enqueue so it can be sent after auth/connection
-  wsEnqueue(message);
+  _throttle.refund();
   return false;
 }
 
-void ZiLinkEsp32::setupMqtt(const char *broker, uint16_t port, const char *deviceId, const char *token)
+bool ZiLinkEsp32::sendDeviceData(const char *sensors, size_t length, uint32_t seq)
 {
-  _token = token;
-  _deviceId = deviceId;
-  _mqtt.setServer(broker, port);
-  _mqtt.setCallback([this](char *topic, byte *payload, unsigned int length)
-                    {
-    String message;
-    for (int i = 0; i < length; i++) {
-      message += (char)payload[i];
-    }
-    Serial.printf("[%s] MQTT message on topic %s: %s\n", _deviceId.c_str(), topic, message.c_str());
-    // Parse and handle command
-    DynamicJsonDocument doc(1024);
-    deserializeJson(doc, message);
-    const char* msgType = doc["type"];
-    if (strcmp(msgType, "command") == 0) {
-      const char* command = doc["data"]["command"];
-      Serial.printf("Received MQTT command: %s\n", command);
-      // Call user callback or update local state
-      // Example: if (strcmp(command, "toggle") == 0) digitalWrite(LED_BUILTIN, !digitalRead(LED_BUILTIN));
-    } });
-  while (!_mqtt.connected())
+  if (_wsBinary)
   {
-    if (_mqtt.connect(deviceId, _token.c_str(), ""))
+    bool encoded = false;
+    const ZiLinkLatency::Trace trace = _latency.start(millis(), micros());
+    // Short floats ("1.5") grow to 5 bytes, so allow twice the JSON size
+    const bool sent = withFrame(2 * length + 32, [&](ZiLinkFrameWriter &frame)
+                                {
+      ZiLinkMsgPack mp(frame);
+      mp.array(trace.seq ? 4 : seq ? 3 : 2).uinteger(ZILINK_KIND_DEVICE_DATA);
+      encoded = mp.json(sensors, length);
+      if (seq) {
+        mp.uinteger(seq);
+      } else if (trace.seq) {
+        mp.nil();
+      }
+      if (trace.seq) {
+        writeTrace(mp, trace);
+      }
+      return encoded && sendWsFrame(frame, true); });
+    _latency.finish(trace, sent);
+    if (encoded)
     {
-      Serial.printf("[%s] Connected to MQTT broker\n", _deviceId.c_str());
-      String subTopic = "zilink/devices/" + String(deviceId) + "/commands";
-      _mqtt.subscribe(subTopic.c_str());
+      return sent;
     }
-    else
-    {
-      delay(500);
+    // Not valid JSON: the server still accepts it as a text frame
+  }
+
+  static const char PREFIX[] = "{\"type\":\"device_data\",\"data\":{";
+  static const char SUFFIX[] = "}}";
+  const ZiLinkLatency::Trace trace = _latency.start(millis(), micros());
+  // Envelope plus room for `"seq":4294967295,` and `"trace":[4294967295,4294967295],`
+  const size_t needed = (sizeof(PREFIX) - 1) + 13 + length + (sizeof(SUFFIX) - 1) + (seq ? 17 : 0) + (trace.seq ? 33 : 0);
+  return _latency.finish(trace, withFrame(needed, [&](ZiLinkFrameWriter &frame)
+                                          {
+    frame.raw(PREFIX);
+    if (seq) {
+      // Replayed from the durable log; the server acknowledges by seq
+      frame.raw("\"seq\":").uinteger(seq).raw(',');
+    }
+    if (trace.seq) {
+      writeTrace(frame, trace).raw(',');
     }
+    frame.raw("\"sensorData\":").raw(sensors, length).raw(SUFFIX);
+    return sendWsFrame(frame); }));
+}
+
+bool ZiLinkEsp32::sendWebSocketData(const String &message, bool urgent)
+{
+  if (offload())
+  {
+    return post(urgent ? RequestUrgentReading : RequestReading, message.c_str(), message.length());
   }
+  return sendReading(message.c_str(), message.length(), urgent);
 }
 
-bool ZiLinkEsp32::publishMqttData(const String &payload)
+bool ZiLinkEsp32::sendCommandResponse(const String &response)
+{
+  return sendOrQueue(ChannelControl, response.c_str(), response.length());
+}
+
+bool ZiLinkEsp32::sendReading(const char *reading, size_t length, bool urgent)
 {
-  if (_mqtt.connected())
+  // Throttled: readings merge into one that waits for a token (sendLatest())
+  if (!urgent && (!_latest.empty() || (wsReady() && _throttle.limited(millis()))) &&
+      coalesceReading(reading, length))
   {
-    String topic = "zilink/devices/" + _deviceId + "/data";
-    return _mqtt.publish(topic.c_str(), payload.c_str());
+    return true;
+  }
+  if (wsReady() && !backlogged(ChannelWsData))
+  {
+    if (urgent || !_batch.enabled())
+    {
+      // Keep ordering: anything already batched goes out first
+      flush();
+      return sendDeviceData(reading, length);
+    }
+    return batchReading(reading, length);
   }
+  // If not ready (or older readings are still queued), enqueue so it can
+  // be sent in order after auth/connection
+  queue(ChannelWsData, 0, reading, length);
   return false;
 }
 
-bool ZiLinkEsp32::publishMqttStatus(const String &payload)
+bool ZiLinkEsp32::coalesceReading(const char *reading, size_t length)
 {
-  if (_mqtt.connected())
+  const bool pending = !_latest.empty();
+  if (_latest.merge(reading, length))
+  {
+    _throttle.stats().coalesced += pending;
+    return true;
+  }
+  // Not an object, or no room: the pending reading is older, so it is queued first
+  if (pending)
   {
-    String topic = "zilink/devices/" + _deviceId + "/status";
-    return _mqtt.publish(topic.c_str(), payload.c_str());
+    queue(ChannelWsData, 0, _latest.data(), _latest.length());
+    _latest.clear();
   }
   return false;
 }
 
-bool ZiLinkEsp32::sendComponentData(const String &payload)
+void ZiLinkEsp32::sendLatest()
+{
+  // After anything older, and only with a token
+  if (_batch.empty() && !backlogged(ChannelWsData) &&
+      throttled([this]
+                { return sendDeviceData(_latest.data(), _latest.length()); }))
+  {
+    _latest.clear();
+  }
+}
+
+bool ZiLinkEsp32::sendWebSocketSamples(const char *name, const float *values, size_t count, uint8_t decimals)
 {
-  if (_ws.isConnected())
+  const size_t nameLen = strlen(name);
+  if (offload())
   {
-    String tmp = payload;
-    _ws.sendTXT(tmp);
+    // [decimals][name\0][pad][float32 x count]; floats stay 4-byte aligned in the ring
+    const size_t valuesAt = (1 + nameLen + 1 + 3) & ~(size_t)3;
+    uint8_t *p = _requests.reserve(valuesAt + count * sizeof(float));
+    if (!p)
+    {
+      return false;
+    }
+    p[0] = decimals;
+    memcpy(p + 1, name, nameLen + 1);
+    memcpy(p + valuesAt, values, count * sizeof(float));
+    _requests.commit(RequestSamples, valuesAt + count * sizeof(float));
+    _netTask.notify();
     return true;
   }
-  if (_mqtt.connected())
+  if (_wsBinary && wsReady() && !backlogged(ChannelWsData))
+  {
+    flush();
+    // [1, {name: ext float32[]}]: 4 bytes per sample, no formatting
+    return withFrame(nameLen + 4 * count + 16, [&](ZiLinkFrameWriter &frame)
+                     {
+      ZiLinkMsgPack mp(frame);
+      mp.array(2).uinteger(ZILINK_KIND_DEVICE_DATA).map(1).str(name, nameLen).floatArray(values, count);
+      return sendWsFrame(frame, true); });
+  }
+  // JSON reading {"name":[...]} through the regular path (batching, queue, log).
+  // Its own buffer, since sendDeviceData() may use the shared scratch one.
+  const size_t cap = nameLen * 6 + 8 + count * 20;
+  std::unique_ptr<char[]> storage(new (std::nothrow) char[cap]);
+  if (!storage)
+  {
+    return false;
+  }
+  ZiLinkFrameWriter reading(storage.get(), cap);
+  reading.raw('{').key(name, true).raw('[');
+  for (size_t i = 0; i < count; i++)
   {
-    String topic = "zilink/devices/" + _deviceId + "/components";
-    return _mqtt.publish(topic.c_str(), payload.c_str());
+    if (i)
+    {
+      reading.raw(',');
+    }
+    reading.number(values[i], decimals);
   }
-  return sendHttp("/devices/" + _deviceId + "/components", payload);
+  reading.raw("]}");
+  return reading.ok() && sendReading(reading.c_str(), reading.length(), false);
 }
 
-void ZiLinkEsp32::createButton(bool value, const char *id)
+bool ZiLinkEsp32::enableBatching(uint16_t maxReadings, uint32_t maxLatencyMs, size_t maxBytes)
 {
-  String payload =
-      "{\"type\":\"button\",\"id\":\"" + String(id) + "\",\"value\":" + (value ? "true" : "false") + "}";
-  sendComponentData(payload);
+  flush();
+  // The envelope is closed at send time, after an optional trace
+  return _batch.begin("{\"type\":\"device_data\",\"data\":{\"batch\":[", "]", maxBytes, maxReadings, maxLatencyMs,
+                      BATCH_TRAILER_BYTES);
 }
 
-void ZiLinkEsp32::createSlider(int value, const char *id)
+void ZiLinkEsp32::disableBatching()
 {
-  String payload =
-      "{\"type\":\"slider\",\"id\":\"" + String(id) + "\",\"value\":" + String(value) + "}";
-  sendComponentData(payload);
+  flush();
+  _batch.end();
 }
 
-void ZiLinkEsp32::createToggle(bool value, const char *id)
+bool ZiLinkEsp32::batchReading(const char *reading, size_t length)
 {
-  String payload =
-      "{\"type\":\"toggle\",\"id\":\"" + String(id) + "\",\"value\":" + (value ? "true" : "false") + "}";
-  sendComponentData(payload);
+  ZiLinkBatch::AppendResult res = _batch.append(reading, length, millis());
+  if (res == ZiLinkBatch::Full)
+  {
+    flush();
+    res = _batch.append(reading, length, millis());
+  }
+  if (res == ZiLinkBatch::TooLarge)
+  {
+    flush();
+    return sendDeviceData(reading, length);
+  }
+  if (_batch.due(millis()))
+  {
+    return flush();
+  }
+  return true;
 }
 
-void ZiLinkEsp32::createProgress(int value, const char *id)
+bool ZiLinkEsp32::flush()
 {
-  String payload =
-      "{\"type\":\"progress\",\"id\":\"" + String(id) + "\",\"value\":" + String(value) + "}";
-  sendComponentData(payload);
+  if (offload())
+  {
+    return post(RequestFlush, nullptr, 0);
+  }
+  if (_batch.empty())
+  {
+    return true;
+  }
+  if (!wsReady())
+  {
+    // Kept until the next flush once authenticated again
+    return false;
+  }
+  bool ok = _wsBinary ? sendBinaryBatch() : sendJsonBatch();
+  _batch.clear();
+  return ok;
 }
 
-void ZiLinkEsp32::begin() {
-  // Default initialization - setup WebSocket connection
-  setupWebSocket(_baseUrl.substring(7).c_str(), 8080, "/ws", _deviceId.c_str(), _token.c_str());
+bool ZiLinkEsp32::sendJsonBatch()
+{
+  const ZiLinkLatency::Trace trace = _latency.start(millis(), micros());
+  ZiLinkFrameWriter &frame = _batch.close();
+  if (trace.seq)
+  {
+    writeTrace(frame.raw(','), trace);
+  }
+  frame.raw("}}");
+  return _latency.finish(trace, sendWsFrame(frame));
 }
 
-void ZiLinkEsp32::begin(const char *deviceId, const char *serverHost, int serverPort) {
-  _deviceId = String(deviceId);
-  _baseUrl = "http://" + String(serverHost) + ":" + String(serverPort);
-  setupWebSocket(serverHost, serverPort, "/ws", deviceId, _token.c_str());
+bool ZiLinkEsp32::sendBinaryBatch()
+{
+  size_t length;
+  const char *readings = _batch.readings(length);
+  bool encoded = false;
+  const ZiLinkLatency::Trace trace = _latency.start(millis(), micros());
+  const bool sent = withFrame(2 * length + 32, [&](ZiLinkFrameWriter &frame)
+                              {
+    ZiLinkMsgPack mp(frame);
+    uint32_t count = 0;
+    mp.array(trace.seq ? 3 : 2).uinteger(ZILINK_KIND_BATCH).array(_batch.count());
+    encoded = mp.jsonList(readings, length, count) && count == _batch.count();
+    if (trace.seq) {
+      writeTrace(mp, trace);
+    }
+    return encoded && sendWsFrame(frame, true); });
+  _latency.finish(trace, sent);
+  return encoded ? sent : sendJsonBatch();
 }
 
-bool ZiLinkEsp32::hasCommand() {
-  return _hasPendingCommand;
+void ZiLinkEsp32::handleBinaryFrame(const uint8_t *payload, size_t length)
+{
+  ZiLinkMsgPackReader in(payload, length);
+  uint32_t items;
+  int64_t kind;
+  if (!in.readArray(items) || items < 2 || !in.readInt(kind) || kind != ZILINK_KIND_COMMAND)
+  {
+    Serial.printf("[%s] Unsupported binary frame\n", _deviceId.c_str());
+    return;
+  }
+  // String commands are delivered as is, structured ones as JSON text
+  ZiLinkFrame<> command;
+  const char *text;
+  uint32_t n;
+  if (in.peek() == ZiLinkMsgPackReader::Str)
+  {
+    if (in.readStr(text, n))
+    {
+      command.raw(text, n);
+    }
+  }
+  else
+  {
+    in.toJson(command);
+  }
+  if (!in.ok() || !command.ok())
+  {
+    Serial.printf("[%s] Malformed command frame\n", _deviceId.c_str());
+    return;
+  }
+  queueCommand(command.c_str(), command.length(), ZiLinkCommandQueue::SourceWebSocket);
 }
 
-String ZiLinkEsp32::getCommand() {
-  if (_hasPendingCommand) {
-    _hasPendingCommand = false;
-    return _pendingCommand;
+void ZiLinkEsp32::handleTextMessage(char *payload, size_t length, ZiLinkCommandQueue::Source source)
+{
+  const ZiLinkInbound::Type type = _inbound.parse(payload, length);
+  if (source == ZiLinkCommandQueue::SourceMqtt)
+  {
+    // The broker only relays commands and throttles
+    if (type == ZiLinkInbound::Command)
+    {
+      commandReceived(_inbound.command(), source);
+    }
+    else if (type == ZiLinkInbound::Throttle)
+    {
+      applyThrottle();
+    }
+    return;
+  }
+  switch (type)
+  {
+  case ZiLinkInbound::AuthSuccess:
+  {
+    _wsAuthenticated = true;
+    _wsStats.authenticated(millis() - _wsConnectedMs);
+    // Binary frames only once the server confirms it can decode them
+    const char *encoding = _inbound.encoding();
+    _wsBinary = _wireRequested == EncodingMsgPack && encoding && strcmp(encoding, "msgpack") == 0;
+    // Index -> id mapping first, then one frame with every component instead of replaying each change
+    sendComponentSchema();
+    sendComponentSnapshot();
+    // Batched readings predate anything queued while offline
+    flush();
+    flushOutbound();
+    break;
+  }
+  case ZiLinkInbound::Ack:
+    _log.acknowledge(_inbound.seq());
+    break;
+  case ZiLinkInbound::TraceAck:
+    _latency.acked(_inbound.traceSeq(), _inbound.traceMs(), _inbound.serverMs(), millis(), micros());
+    break;
+  case ZiLinkInbound::StreamCredit:
+  {
+    const uint8_t id = _inbound.streamId();
+    if (id >= 1 && id <= ZILINK_MAX_STREAMS)
+    {
+      _streams[id - 1].grant(_inbound.streamUntil());
+    }
+    break;
+  }
+  case ZiLinkInbound::Throttle:
+    applyThrottle();
+    break;
+  case ZiLinkInbound::GatewayAuth:
+    gatewayAuthResult();
+    break;
+  case ZiLinkInbound::Gateway:
+  {
+    const char *message = _inbound.gatewayMessage();
+    if (_gateway && message)
+    {
+      _gateway->route(_inbound.gatewayChannel(), message, strlen(message));
+    }
+    break;
+  }
+  case ZiLinkInbound::Error:
+    Serial.printf("[%s] WS error: %s\n", _deviceId.c_str(), _inbound.error());
+    break;
+  case ZiLinkInbound::Command:
+    commandReceived(_inbound.command(), source);
+    break;
+  case ZiLinkInbound::Invalid:
+    Serial.printf("[%s] Unparsable message (%u bytes)\n", _deviceId.c_str(), (unsigned)length);
+    break;
+  default:
+    break;
   }
-  return "";
 }
 
-void ZiLinkEsp32::loop()
+void ZiLinkEsp32::applyThrottle()
 {
-  _ws.loop();
-  // Try to flush any queued messages when ready
-  if (_ws.isConnected() && _wsAuthenticated) {
-    wsFlushQueue();
+  const uint32_t now = millis();
+  const float before = _throttle.rate(now);
+  _throttle.set(_inbound.throttleRate(), _inbound.throttleBurst(), _inbound.throttleCredit(), _inbound.throttleTtlMs(),
+                now);
+  // Renewals come every few seconds; only report changes
+  const float after = _throttle.rate(now);
+  if (after != before)
+  {
+    Serial.printf("[%s] Server throttle: %s%.2f frames/s\n", _deviceId.c_str(), after > 0 ? "" : "lifted, was ",
+                  after > 0 ? after : before);
+  }
+}
+
+void ZiLinkEsp32::commandReceived(JsonVariantConst command, ZiLinkCommandQueue::Source source)
+{
+  if (command.isNull())
+  {
+    return;
+  }
+  if (command.is<const char *>())
+  {
+    const char *text = command.as<const char *>();
+    queueCommand(text, strlen(text), source);
+    return;
+  }
+  // Structured commands ({"type":"ui_button",...}) are queued as JSON text.
+  // One byte over the limit so a truncated one is rejected as oversized.
+  char text[ZILINK_COMMAND_MAX_LEN + 2];
+  const size_t length = serializeJson(command, text, sizeof(text));
+  queueCommand(text, length, source);
+}
+
+void ZiLinkEsp32::queueCommand(const char *text, size_t length, ZiLinkCommandQueue::Source source)
+{
+  Serial.printf("[%s] Received %s command: %.*s\n", _deviceId.c_str(),
+                source == ZiLinkCommandQueue::SourceMqtt ? "MQTT" : "WS", (int)length, text);
+  if (!_commands.push(text, length, source))
+  {
+    Serial.printf("[%s] Command dropped (queue full or too long)\n", _deviceId.c_str());
+  }
+}
+
+void ZiLinkEsp32::setupMqtt(const char *broker, uint16_t port, const char *deviceId, const char *token)
+{
+  _token = token;
+  _deviceId = deviceId;
+  _mqttHost = broker;
+  _mqttPort = port;
+  _mqttDns.invalidate();
+  // PubSubClient keeps the pointer, so hand it our copy
+  _mqtt.setServer(_mqttHost.c_str(), port);
+  // loop() waits for the CONNACK itself (MqttHandshake); PubSubClient only
+  // waits this long for the rest of a packet it has started reading
+  _mqtt.setSocketTimeout(ZILINK_MQTT_HANDSHAKE_TIMEOUT_S);
+  // Also announced in the CONNECT loop() writes
+  _mqtt.setKeepAlive(ZILINK_MQTT_KEEPALIVE_S);
+  _mqtt.setCallback([this](char *topic, byte *payload, unsigned int length)
+                    {
+    Serial.printf("[%s] MQTT message on topic %s\n", _deviceId.c_str(), topic);
+    // Parsed in PubSubClient's receive buffer
+    handleTextMessage((char*)payload, length, ZiLinkCommandQueue::SourceMqtt); });
+  _mqttTopics[0] = "zilink/devices/" + String(deviceId) + "/commands";
+  _mqttTopicCount = 1;
+  _mqttTcp.cancel();
+  _mqttBackoff.reset();
+  setMqttState(MqttBackoff);
+  // First attempt right away; loop() carries it on
+  serviceMqtt();
+}
+
+void ZiLinkEsp32::setMqttState(MqttState state)
+{
+  if (state == _mqttState)
+  {
+    return;
+  }
+  _mqttState = state;
+  if (_mqttStateCallback)
+  {
+    _mqttStateCallback(state);
+  }
+}
+
+void ZiLinkEsp32::serviceMqtt()
+{
+  const uint32_t now = millis();
+  switch (_mqttState)
+  {
+  case MqttDisabled:
+    return;
+  case MqttConnected:
+    if (_mqtt.loop())
+    {
+      serviceMqttQos1();
+      return;
+    }
+    Serial.printf("[%s] MQTT connection lost\n", _deviceId.c_str());
+    _mqttStats.disconnects++;
+    mqttFailed(now);
+    return;
+  case MqttBackoff:
+    if (!_mqttBackoff.due(now) || WiFi.status() != WL_CONNECTED)
+    {
+      return;
+    }
+    _mqttAttemptMs = now;
+    setMqttState(MqttConnecting);
+    break;
+  case MqttConnecting:
+    break;
+  case MqttHandshake:
+    serviceMqttHandshake(now);
+    return;
+  }
+
+  // A name not in the cache is looked up in the background; TCP starts once it is known
+  if (_mqttTcp.status() == ZiLinkTcpConnect::Idle)
+  {
+    uint32_t ip;
+    const ZiLinkDnsCache::Lookup lookup = _mqttDns.lookup(_mqttHost.c_str(), ip, now);
+    if (lookup == ZiLinkDnsCache::Pending)
+    {
+      return;
+    }
+    if (lookup == ZiLinkDnsCache::Failed || !_mqttTcp.start(ip, _mqttPort, ZILINK_MQTT_CONNECT_TIMEOUT_MS, now))
+    {
+      mqttFailed(now);
+      return;
+    }
+  }
+  const ZiLinkTcpConnect::Status status = _mqttTcp.poll(now);
+  if (status == ZiLinkTcpConnect::InProgress)
+  {
+    return;
+  }
+  if (status != ZiLinkTcpConnect::Connected)
+  {
+    mqttFailed(now);
+    return;
+  }
+  _wifi = WiFiClient(_mqttTcp.release());
+  _mqttTap.reset();
+  // The CONNECT goes out now; its CONNACK is polled for in MqttHandshake
+  const size_t cap = 32 + _deviceId.length() + _token.length();
+  std::unique_ptr<uint8_t[]> connect(new (std::nothrow) uint8_t[cap]);
+  const size_t n = connect ? ZiLinkMqttTap::writeConnect(connect.get(), cap, _deviceId.c_str(), _token.c_str(), "",
+                                                         ZILINK_MQTT_KEEPALIVE_S)
+                           : 0;
+  if (!n || _wifi.write(connect.get(), n) != n)
+  {
+    _wifi.stop();
+    mqttFailed(now);
+    return;
+  }
+  _mqttTcpUpMs = now;
+  setMqttState(MqttHandshake);
+}
+
+void ZiLinkEsp32::serviceMqttHandshake(uint32_t nowMs)
+{
+  if (_wifi.available() < (int)ZiLinkMqttTap::CONNACK_BYTES)
+  {
+    if (!_wifi.connected() || nowMs - _mqttTcpUpMs >= ZILINK_MQTT_HANDSHAKE_TIMEOUT_S * 1000u)
+    {
+      Serial.printf("[%s] No CONNACK from the MQTT broker\n", _deviceId.c_str());
+      _wifi.stop();
+      mqttFailed(nowMs);
+    }
+    return;
+  }
+  uint8_t connack[ZiLinkMqttTap::CONNACK_BYTES];
+  if (_wifi.read(connack, sizeof(connack)) != (int)sizeof(connack) || connack[0] != 0x20 || connack[1] != 2)
+  {
+    _wifi.stop();
+    mqttFailed(nowMs);
+    return;
+  }
+  // PubSubClient skips the TCP connect on a connected client and, with the
+  // CONNACK already waiting in the tap, returns without blocking
+  _mqttTap.handshake(connack);
+  if (!_mqtt.connect(_deviceId.c_str(), _token.c_str(), ""))
+  {
+    _wifi.stop();
+    mqttFailed(nowMs);
+    return;
+  }
+  // Attempt -> TCP up -> CONNACK
+  _mqttStats.connects++;
+  _mqttStats.connectMs = _mqttTcpUpMs - _mqttAttemptMs;
+  _mqttStats.authenticated(nowMs - _mqttTcpUpMs);
+  Serial.printf("[%s] Connected to MQTT broker\n", _deviceId.c_str());
+  for (uint8_t i = 0; i < _mqttTopicCount; i++)
+  {
+    _mqtt.subscribe(_mqttTopics[i].c_str());
+  }
+  _mqttBackoff.reset();
+  setMqttState(MqttConnected);
+  // The broker kept nothing of the last session (clean session)
+  _mqttQos1.resendAll();
+  serviceMqttQos1();
+}
+
+void ZiLinkEsp32::mqttFailed(uint32_t nowMs)
+{
+  _mqttTcp.cancel();
+  // Resolve the name again every few failures in case the broker moved
+  if (_mqttBackoff.failures() % 4 == 3)
+  {
+    _mqttDns.invalidate();
   }
+  const uint32_t delay = _mqttBackoff.fail(nowMs);
+  Serial.printf("[%s] MQTT unavailable (state %d), retry in %lu ms\n", _deviceId.c_str(), _mqtt.state(),
+                (unsigned long)delay);
+  setMqttState(MqttBackoff);
+}
+
+bool ZiLinkEsp32::publishMqtt(const char *suffix, const char *payload, size_t length)
+{
   if (!_mqtt.connected())
   {
-    _mqtt.connect(_deviceId.c_str(), _token.c_str(), "");
+    return false;
+  }
+  char topicBuf[128];
+  ZiLinkFrameWriter topic(topicBuf, sizeof(topicBuf));
+  if (!writeDevicePath(topic, "zilink/devices/", suffix))
+  {
+    return false;
+  }
+  const uint32_t start = micros();
+  // Streamed past PubSubClient's buffer when larger than it
+  return recordSend(_mqttStats, _mqttLink.health, zilinkMqttPublish(_mqtt, _wifi, topic.c_str(), payload, length), length,
+                    start);
+}
+
+bool ZiLinkEsp32::publishMqttQos1(uint8_t channel, const char *payload, size_t length)
+{
+  const uint16_t id = _mqttQos1.publish(channel, payload, length);
+  if (!id)
+  {
+    return false;
   }
-  _mqtt.loop();
+  _mqttLastId = id;
+  serviceMqttQos1();
+  return true;
 }
 
-void ZiLinkEsp32::wsEnqueue(const String &payload)
+void ZiLinkEsp32::serviceMqttQos1()
 {
-  size_t nextTail = (_wsQTail + 1) % WS_QUEUE_SIZE;
-  if (nextTail == _wsQHead) {
-    // Queue full, drop the oldest to make room
-    _wsQHead = (_wsQHead + 1) % WS_QUEUE_SIZE;
+  if (!_mqttQos1.enabled() || _mqttState != MqttConnected)
+  {
+    return;
   }
-  _wsQueue[_wsQTail] = payload;
-  _wsQTail = nextTail;
+  _mqttQos1.service(millis(), [this](uint16_t id, bool dup, uint8_t channel, const char *payload, size_t length)
+                    {
+    char topicBuf[128];
+    ZiLinkFrameWriter topic(topicBuf, sizeof(topicBuf));
+    if (!writeDevicePath(topic, "zilink/devices/", channel == ChannelMqttStatus ? "/status" : "/data")) {
+      return false;
+    }
+    // Written past PubSubClient, on the socket it uses
+    uint8_t head[9 + sizeof(topicBuf)];
+    const size_t n = ZiLinkMqttQos1::writeHeader(head, topic.c_str(), topic.length(), id, dup, length);
+    const uint32_t start = micros();
+    const bool ok = _wifi.write(head, n) == n && _wifi.write((const uint8_t *)payload, length) == length;
+    return recordSend(_mqttStats, _mqttLink.health, ok, length, start); });
 }
 
-void ZiLinkEsp32::wsFlushQueue()
+void ZiLinkEsp32::mqttPuback(void *ctx, uint16_t id)
 {
-  while (_wsQHead != _wsQTail && _ws.isConnected() && _wsAuthenticated) {
-    String sensors = _wsQueue[_wsQHead];
-    String msg = "{\"type\":\"device_data\",\"data\":{\"sensorData\":" + sensors + "}}";
-    _ws.sendTXT(msg);
-    _wsQueue[_wsQHead] = String();
-    _wsQHead = (_wsQHead + 1) % WS_QUEUE_SIZE;
+  static_cast<ZiLinkEsp32 *>(ctx)->_mqttQos1.acked(id);
+}
+
+bool ZiLinkEsp32::publishMqttData(const String &payload)
+{
+  return sendOrQueue(ChannelMqttData, payload.c_str(), payload.length());
+}
+
+bool ZiLinkEsp32::publishMqttStatus(const String &payload)
+{
+  return sendOrQueue(ChannelMqttStatus, payload.c_str(), payload.length());
+}
+
+bool ZiLinkEsp32::sendComponent(ZiLinkFrameWriter &frame, const char *id)
+{
+  if (!frame.ok())
+  {
+    return false;
+  }
+  if (!_outbox.pending(ChannelComponent) && throttled([&]
+                                                     { return sendComponentData(frame.c_str(), frame.length()); }))
+  {
+    return true;
+  }
+  // Keyed by component id, so the state queue (CoalesceByKey) keeps only the latest value
+  _outbox.push(ZiLinkOutbox::State, ChannelComponent, ZiLinkRingBuffer::keyOf(id), frame.c_str(), frame.length());
+  return false;
+}
+
+bool ZiLinkEsp32::sendComponentData(const char *data, size_t length)
+{
+  ZiLinkTransport *transport = _router.select(millis());
+  return transport && transport->send(data, length);
+}
+
+const char *ZiLinkEsp32::Link::name() const
+{
+  switch (_kind)
+  {
+  case Ws:
+    return "ws";
+  case Mqtt:
+    return "mqtt";
+  default:
+    return "http";
+  }
+}
+
+bool ZiLinkEsp32::Link::ready()
+{
+  switch (_kind)
+  {
+  case Ws:
+    return _owner.wsReady();
+  case Mqtt:
+    return _owner._mqtt.connected();
+  default:
+    return _owner._baseUrl.length() > 0 && (WiFi.status() == WL_CONNECTED || _owner._httpPipeline.enabled());
+  }
+}
+
+bool ZiLinkEsp32::Link::send(const char *data, size_t length)
+{
+  switch (_kind)
+  {
+  case Ws:
+    // The WS client masks the frame in place, so send a copy and keep `data` for a retry
+    return _owner.wsReady() && _owner.withFrame(length, [&](ZiLinkFrameWriter &frame)
+                                                { return _owner.sendWsFrame(frame.raw(data, length)); });
+  case Mqtt:
+    return _owner.publishMqtt("/components", data, length);
+  default:
+    return _owner.sendHttp(ZiLinkHttpPipeline::Components, data, length);
+  }
+}
+
+size_t ZiLinkEsp32::Link::backlog()
+{
+  const ZiLinkOutbox &q = _owner._outbox;
+  switch (_kind)
+  {
+  case Ws:
+    return q.pending(ChannelWsData);
+  case Mqtt:
+    return q.pending(ChannelMqttData) + q.pending(ChannelMqttStatus) + _owner._mqttQos1.inflight() +
+           _owner._mqttQos1.waiting();
+  default:
+    return q.pending(ChannelHttpData) + q.pending(ChannelHttpStatus) + _owner._httpPipeline.pending();
+  }
+}
+
+uint32_t ZiLinkEsp32::Link::expectedUs() const
+{
+  // An HTTP POST opens a connection every time, unless pipelined
+  return _kind == Http && !_owner._httpPipeline.enabled() ? 100000 : 1000;
+}
+
+void ZiLinkEsp32::writeComponentJson(ZiLinkFrameWriter &out, const char *type, const char *id, int32_t value, bool isBool,
+                                     const ZiLinkLatency::Trace *trace)
+{
+  out.raw("{\"type\":\"").cstr(type).raw("\",\"id\":").str(id).raw(",\"value\":");
+  isBool ? out.boolean(value != 0) : out.integer(value);
+  if (trace && trace->seq)
+  {
+    writeTrace(out.raw(','), *trace);
+  }
+  out.raw('}');
+}
+
+void ZiLinkEsp32::sendComponentValue(const char *type, const char *id, int32_t value, bool isBool)
+{
+  if (offload())
+  {
+    // [value][isBool][type pointer (static string)][id\0]
+    const size_t idLen = strlen(id);
+    uint8_t *p = _requests.reserve(4 + 1 + sizeof(type) + idLen + 1);
+    if (p)
+    {
+      memcpy(p, &value, 4);
+      p[4] = isBool;
+      memcpy(p + 5, &type, sizeof(type));
+      memcpy(p + 5 + sizeof(type), id, idLen + 1);
+      _requests.commit(RequestComponent, 4 + 1 + sizeof(type) + idLen + 1);
+      _netTask.notify();
+    }
+    return;
+  }
+  ZiLinkComponentTable::Entry *entry;
+  const uint32_t now = millis();
+  const ZiLinkComponentTable::Decision decision = _components.update(type, id, value, isBool, now, entry);
+  if (decision == ZiLinkComponentTable::Untracked)
+  {
+    // Table full: unfiltered, queued like any other send
+    ZiLinkFrame<> frame;
+    writeComponentJson(frame, type, id, value, isBool);
+    sendComponent(frame, id);
+    return;
+  }
+  updateComponent(*entry, decision, now);
+}
+
+void ZiLinkEsp32::sendWidgetValue(uint8_t index, int32_t value)
+{
+  if (offload())
+  {
+    // [value][index]
+    uint8_t *p = _requests.reserve(4 + 1);
+    if (p)
+    {
+      memcpy(p, &value, 4);
+      p[4] = index;
+      _requests.commit(RequestWidget, 4 + 1);
+      _netTask.notify();
+    }
+    return;
+  }
+  if (index >= _widgetCount)
+  {
+    return;
+  }
+  const uint32_t now = millis();
+  ZiLinkComponentTable::Entry &entry = *_widgets[index];
+  updateComponent(entry, _components.update(entry, value, now), now);
+}
+
+void ZiLinkEsp32::updateComponent(ZiLinkComponentTable::Entry &entry, ZiLinkComponentTable::Decision decision,
+                                  uint32_t nowMs)
+{
+  if (decision != ZiLinkComponentTable::Send)
+  {
+    // Unchanged, or held until minIntervalMs has passed
+    return;
+  }
+  if (deliverComponent(entry))
+  {
+    _components.markSent(entry, nowMs);
+  }
+  else
+  {
+    // Retried from loop(), or covered by the snapshot after auth_success
+    _components.markFailed(entry, nowMs);
+  }
+}
+
+bool ZiLinkEsp32::setWidgets(const ZiLinkWidget *widgets, size_t count)
+{
+  for (uint8_t i = 0; i < _widgetCount; i++)
+  {
+    _widgets[i]->widget = -1;
+  }
+  _widgetCount = 0;
+  if (count > ZILINK_MAX_COMPONENTS)
+  {
+    return false;
+  }
+  for (size_t i = 0; i < count; i++)
+  {
+    const ZiLinkWidget::Type type = widgets[i].type;
+    ZiLinkComponentTable::Entry *entry = _components.add(ZiLinkWidget::typeName(type), widgets[i].id,
+                                                         ZiLinkWidget::isBool(type));
+    if (!entry)
+    {
+      return false;
+    }
+    entry->widget = (int16_t)i;
+    _widgets[_widgetCount++] = entry;
+  }
+  // A session already running learns the schema now
+  _schemaSent = false;
+  if (!offload())
+  {
+    sendComponentSchema();
+  }
+  return true;
+}
+
+bool ZiLinkEsp32::deliverComponent(const ZiLinkComponentTable::Entry &entry)
+{
+  ZiLinkTransport *transport = _router.select(millis());
+  if (!transport)
+  {
+    return false;
+  }
+  // Without a token the table keeps the value and service() retries the newest one
+  return throttled([&]
+                   {
+    ZiLinkFrame<> frame;
+    if (transport == &_wsLink)
+    {
+      const ZiLinkLatency::Trace trace = _latency.start(millis(), micros());
+      if (entry.widget >= 0 && _schemaSent)
+      {
+        // The server maps the index back to the id and type it was announced with
+        if (_wsBinary)
+        {
+          ZiLinkMsgPack mp(frame);
+          mp.array(trace.seq ? 4 : 3).uinteger(ZILINK_KIND_WIDGET).uinteger(entry.widget);
+          entry.isBool ? mp.boolean(entry.value != 0) : mp.integer(entry.value);
+          if (trace.seq)
+          {
+            writeTrace(mp, trace);
+          }
+          return _latency.finish(trace, sendWsFrame(frame, true));
+        }
+        frame.raw("{\"type\":\"c\",\"i\":").integer(entry.widget).raw(",\"v\":");
+        entry.isBool ? frame.boolean(entry.value != 0) : frame.integer(entry.value);
+        if (trace.seq)
+        {
+          writeTrace(frame.raw(','), trace);
+        }
+        frame.raw('}');
+        return _latency.finish(trace, sendWsFrame(frame));
+      }
+      if (_wsBinary)
+      {
+        ZiLinkMsgPack mp(frame);
+        mp.array(trace.seq ? 5 : 4).uinteger(ZILINK_KIND_COMPONENT).str(entry.type).str(entry.id);
+        entry.isBool ? mp.boolean(entry.value != 0) : mp.integer(entry.value);
+        if (trace.seq)
+        {
+          writeTrace(mp, trace);
+        }
+        return _latency.finish(trace, sendWsFrame(frame, true));
+      }
+      writeComponentJson(frame, entry.type, entry.id, entry.value, entry.isBool, &trace);
+      return _latency.finish(trace, sendWsFrame(frame));
+    }
+    writeComponentJson(frame, entry.type, entry.id, entry.value, entry.isBool);
+    return frame.ok() && transport->send(frame.c_str(), frame.length());
+  });
+}
+
+bool ZiLinkEsp32::sendComponentSnapshot()
+{
+  if (_components.count() == 0 || !wsReady())
+  {
+    return false;
+  }
+  // Envelope plus, per component, the JSON object with an escaped id
+  const size_t needed = 64 + _components.count() * (48 + 6 * ZILINK_COMPONENT_ID_LEN);
+  const bool sent = withFrame(needed, [&](ZiLinkFrameWriter &frame)
+                              {
+    size_t n = 0;
+    _components.forEach([&](const ZiLinkComponentTable::Entry &) { n++; });
+    if (n == 0) {
+      return false;
+    }
+    if (_wsBinary) {
+      ZiLinkMsgPack mp(frame);
+      mp.array(2).uinteger(ZILINK_KIND_COMPONENT_SNAPSHOT).array(n);
+      _components.forEach([&](const ZiLinkComponentTable::Entry &e) {
+        mp.array(3).str(e.type).str(e.id);
+        e.isBool ? mp.boolean(e.value != 0) : mp.integer(e.value);
+      });
+      return sendWsFrame(frame, true);
+    }
+    frame.raw("{\"type\":\"component_snapshot\",\"data\":{\"components\":[");
+    bool first = true;
+    _components.forEach([&](const ZiLinkComponentTable::Entry &e) {
+      if (!first) {
+        frame.raw(',');
+      }
+      first = false;
+      writeComponentJson(frame, e.type, e.id, e.value, e.isBool);
+    });
+    frame.raw("]}}");
+    return sendWsFrame(frame); });
+  if (sent)
+  {
+    _components.markAllSent(millis());
+  }
+  return sent;
+}
+
+bool ZiLinkEsp32::sendComponentSchema()
+{
+  if (_widgetCount == 0 || !wsReady())
+  {
+    return false;
+  }
+  // Envelope plus, per widget, an escaped id and its type
+  const size_t needed = 64 + _widgetCount * (16 + 6 * ZILINK_COMPONENT_ID_LEN);
+  _schemaSent = withFrame(needed, [&](ZiLinkFrameWriter &frame)
+                          {
+    if (_wsBinary) {
+      ZiLinkMsgPack mp(frame);
+      mp.array(2).uinteger(ZILINK_KIND_COMPONENT_SCHEMA).array(_widgetCount);
+      for (uint8_t i = 0; i < _widgetCount; i++) {
+        mp.array(2).str(_widgets[i]->id).str(_widgets[i]->type);
+      }
+      return sendWsFrame(frame, true);
+    }
+    frame.raw("{\"type\":\"component_schema\",\"data\":{\"components\":[");
+    for (uint8_t i = 0; i < _widgetCount; i++) {
+      if (i) {
+        frame.raw(',');
+      }
+      frame.raw('[').str(_widgets[i]->id).raw(",\"").cstr(_widgets[i]->type).raw("\"]");
+    }
+    frame.raw("]}}");
+    return sendWsFrame(frame); });
+  return _schemaSent;
+}
+
+void ZiLinkEsp32::createButton(bool value, const char *id)
+{
+  sendComponentValue("button", id, value, true);
+}
+
+void ZiLinkEsp32::createSlider(int value, const char *id)
+{
+  sendComponentValue("slider", id, value, false);
+}
+
+void ZiLinkEsp32::createToggle(bool value, const char *id)
+{
+  sendComponentValue("toggle", id, value, true);
+}
+
+void ZiLinkEsp32::createProgress(int value, const char *id)
+{
+  sendComponentValue("progress", id, value, false);
+}
+
+void ZiLinkEsp32::begin() {
+  // Default initialization - setup WebSocket connection
+  setupWebSocket(_baseUrl.substring(7).c_str(), 8080, "/ws", _deviceId.c_str(), _token.c_str());
+}
+
+void ZiLinkEsp32::begin(const char *deviceId, const char *serverHost, int serverPort) {
+  _deviceId = String(deviceId);
+  _baseUrl = "http://" + String(serverHost) + ":" + String(serverPort);
+  setupWebSocket(serverHost, serverPort, "/ws", deviceId, _token.c_str());
+}
+
+bool ZiLinkEsp32::hasCommand() {
+  return !_commands.empty();
+}
+
+String ZiLinkEsp32::getCommand() {
+  const ZiLinkCommandQueue::Command *command = _commands.front();
+  if (!command) {
+    return "";
+  }
+  String text(command->text);
+  _commands.pop();
+  return text;
+}
+
+void ZiLinkEsp32::loop()
+{
+  if (_sampler.count()) {
+    serviceSampler();
+  }
+  // In threaded mode the network task does this part
+  if (!_netTask.running()) {
+    serviceNetwork();
+  }
+  if (_commands.hasHandlers()) {
+    _commands.dispatch();
+  }
+}
+
+// Reading size for the windows that end in one loop(); more go out in several readings
+#ifndef ZILINK_SAMPLE_READING_BYTES
+#define ZILINK_SAMPLE_READING_BYTES 512
+#endif
+
+void ZiLinkEsp32::serviceSampler()
+{
+  ZiLinkFrame<ZILINK_SAMPLE_READING_BYTES> reading;
+  _sampler.service(micros(), [&](const ZiLinkSampler::Sensor &sensor, const ZiLinkSampler::Window &w)
+                   {
+    for (int attempt = 0; attempt < 2; attempt++) {
+      const size_t mark = reading.length();
+      reading.raw(mark ? ',' : '{').str(sensor.name).raw(":{\"min\":").number(w.min, sensor.decimals);
+      reading.raw(",\"max\":").number(w.max, sensor.decimals).raw(",\"mean\":").number(w.mean, sensor.decimals);
+      reading.raw(",\"last\":").number(w.last, sensor.decimals).raw(",\"n\":").uinteger(w.count).raw('}');
+      // Room for the closing brace too, else send what is there and start another reading
+      if (reading.ok() && reading.length() < reading.capacity()) {
+        return;
+      }
+      reading.truncate(mark);
+      if (mark == 0) {
+        break;
+      }
+      sendSampleReading(reading);
+      reading.reset();
+    }
+    Serial.printf("[%s] Window of %s does not fit a reading\n", _deviceId.c_str(), sensor.name); });
+  if (reading.length())
+  {
+    sendSampleReading(reading);
+  }
+}
+
+void ZiLinkEsp32::sendSampleReading(ZiLinkFrameWriter &reading)
+{
+  reading.raw('}');
+  if (_sampleSink)
+  {
+    _sampleSink(reading.c_str(), reading.length());
+  }
+  else if (offload())
+  {
+    post(RequestReading, reading.c_str(), reading.length());
+  }
+  else
+  {
+    sendReading(reading.c_str(), reading.length(), false);
+  }
+}
+
+void ZiLinkEsp32::serviceNetwork()
+{
+  serviceRequests();
+  _wsLoopMs = millis();
+  _ws.loop();
+  // Try to flush any queued messages when ready
+  flushOutbound();
+  _log.service(millis());
+  replayDurableLog();
+  // Held component values and heartbeats
+  _components.service(millis(), [this](const ZiLinkComponentTable::Entry &e)
+                      { return deliverComponent(e); });
+  if (wsReady()) {
+    // Paced by the server's throttle, if any
+    if (_batch.due(millis())) {
+      throttled([this] { return flush(); });
+    }
+    if (!_latest.empty()) {
+      sendLatest();
+    }
+    serviceStreams();
+    serviceGateway();
+  }
+  serviceMqtt();
+  _httpPipeline.service(millis());
+  if (_statsIntervalMs && millis() - _statsLastMs >= _statsIntervalMs) {
+    reportStats();
+  }
+}
+
+bool ZiLinkEsp32::enableGateway(ZiLinkGateway::DownlinkFn downlink, void *ctx, size_t queueBytesPerChannel)
+{
+  // The decoder and the queues are not shared with the network task
+  if (_netTask.running())
+  {
+    return false;
+  }
+  if (!_gateway)
+  {
+    _gateway.reset(new (std::nothrow) ZiLinkGateway());
+  }
+  if (!_gateway || !_gateway->begin(queueBytesPerChannel))
+  {
+    _gateway.reset();
+    return false;
+  }
+  _gateway->onDownlink(downlink, ctx);
+  return true;
+}
+
+void ZiLinkEsp32::serviceGateway()
+{
+  if (!_gateway)
+  {
+    return;
+  }
+  if (_gateway->hasPending())
+  {
+    sendGatewayAuth();
+  }
+  _gateway->service([this](uint8_t channel, const char *message, size_t length)
+                    {
+    ZiLinkGateway::SendResult result = ZiLinkGateway::Held;
+    withFrame(length + 48, [&](ZiLinkFrameWriter &frame) {
+      if (_wsBinary) {
+        ZiLinkMsgPack mp(frame);
+        mp.array(3).uinteger(ZILINK_KIND_GATEWAY).uinteger(channel);
+        if (!mp.json(message, length)) {
+          // Not JSON: the server would reject it, so it costs no token
+          result = ZiLinkGateway::Dropped;
+          return false;
+        }
+      } else {
+        frame.raw("{\"type\":\"gw\",\"data\":{\"ch\":").uinteger(channel).raw(",\"msg\":");
+        frame.raw(message, length).raw("}}");
+      }
+      // Sub-device messages count against the gateway's throttle like its own
+      if (throttled([&] { return sendWsFrame(frame, _wsBinary); })) {
+        result = ZiLinkGateway::Sent;
+      }
+      return result == ZiLinkGateway::Sent;
+    });
+    return result; });
+}
+
+bool ZiLinkEsp32::sendGatewayAuth()
+{
+  // Envelope plus, per channel, the number and the escaped id and token
+  size_t needed = 64;
+  _gateway->forEachPending([&](uint8_t, const char *id, const char *token)
+                           { needed += 16 + 6 * (strlen(id) + strlen(token)); });
+  const bool sent = withFrame(needed, [&](ZiLinkFrameWriter &frame)
+                              {
+    frame.raw("{\"type\":\"gateway_auth\",\"data\":{\"devices\":[");
+    bool first = true;
+    _gateway->forEachPending([&](uint8_t channel, const char *id, const char *token) {
+      if (!first) {
+        frame.raw(',');
+      }
+      first = false;
+      frame.raw('[').uinteger(channel).raw(',').str(id).raw(',').str(token).raw(']');
+    });
+    frame.raw("]}}");
+    return sendWsFrame(frame); });
+  if (sent)
+  {
+    _gateway->authSent();
+  }
+  return sent;
+}
+
+void ZiLinkEsp32::gatewayAuthResult()
+{
+  if (!_gateway)
+  {
+    return;
+  }
+  for (JsonVariantConst channel : _inbound.gatewayAccepted())
+  {
+    _gateway->authResult(channel.as<uint8_t>(), true);
+  }
+  for (JsonVariantConst channel : _inbound.gatewayRejected())
+  {
+    _gateway->authResult(channel.as<uint8_t>(), false);
+  }
+}
+
+ZiLinkStream *ZiLinkEsp32::openStream(const char *name, ZiLinkStream::Format format, uint32_t sampleRate,
+                                      uint16_t blockSamples)
+{
+  for (uint8_t i = 0; i < ZILINK_MAX_STREAMS; i++)
+  {
+    if (!_streams[i].active())
+    {
+      return _streams[i].begin(i + 1, name, format, sampleRate, blockSamples) ? &_streams[i] : nullptr;
+    }
+  }
+  return nullptr;
+}
+
+bool ZiLinkEsp32::announceStream(ZiLinkStream &stream)
+{
+  // The sequence number lets the server grant credit from where the device is
+  ZiLinkFrame<> open;
+  open.raw("{\"type\":\"stream_open\",\"data\":{\"id\":").uinteger(stream.id()).raw(",\"name\":").str(stream.name());
+  open.raw(",\"format\":").str(stream.formatName()).raw(",\"rate\":").uinteger(stream.sampleRate());
+  open.raw(",\"chunk\":").uinteger(stream.chunkSamples()).raw(",\"seq\":").uinteger(stream.seq()).raw("}}");
+  return sendWsFrame(open);
+}
+
+void ZiLinkEsp32::serviceStreams()
+{
+  static_assert(ZILINK_STREAM_HEADROOM >= WEBSOCKETS_MAX_HEADER_SIZE, "stream headroom too small for a WS header");
+  // 0: heap unknown (host build)
+  const uint32_t heap = zilinkHeapFree();
+  for (uint8_t i = 0; i < ZILINK_MAX_STREAMS; i++)
+  {
+    ZiLinkStream &stream = _streams[i];
+    if (!stream.active())
+    {
+      continue;
+    }
+    if (!_streamAnnounced[i])
+    {
+      _streamAnnounced[i] = announceStream(stream);
+      continue;
+    }
+    if (heap && heap < ZILINK_STREAM_MIN_HEAP)
+    {
+      continue;
+    }
+    stream.service([this](uint8_t *chunk, size_t length)
+                   {
+      const uint32_t start = micros();
+      // The client writes its header in the headroom in front of the chunk
+      const bool ok = _ws.sendBIN(chunk - WEBSOCKETS_MAX_HEADER_SIZE, length, true);
+      return recordSend(_wsStats, _wsLink.health, ok, length, start); },
+                   ZILINK_STREAM_CHUNKS_PER_LOOP);
+  }
+}
+
+ZiLinkEsp32::Stats ZiLinkEsp32::getStats() const
+{
+  Stats s;
+  s.ws = _wsStats;
+  s.mqtt = _mqttStats;
+  s.http = _httpStats;
+  s.http.connects = _httpPipeline.stats().connects;
+  s.http.connectMs = s.http.readyMs = _httpPipeline.stats().connectMs;
+  s.queue = _outbox.stats();
+  s.queuedBytes = _outbox.usedBytes();
+  s.droppedRequests = _requests.dropped();
+  s.route = _router.current() ? _router.current()->name() : "";
+  s.routeSwitches = _router.switches();
+  s.grantedRate = _throttle.rate(millis());
+  s.heapFree = zilinkHeapFree();
+  s.heapMinFree = zilinkHeapMinFree();
+  s.uptimeMs = millis();
+  return s;
+}
+
+// [frames, bytes, failures, reconnects, auth ms, p50 us, p99 us, max us, ready ms]
+static void writeTransportStats(ZiLinkFrameWriter &out, const char *key, const ZiLinkTransportStats &t)
+{
+  out.raw(",\"").cstr(key).raw("\":[").uinteger(t.framesSent).raw(',').uinteger(t.bytesSent);
+  out.raw(',').uinteger(t.sendFailures).raw(',').uinteger(t.reconnects()).raw(',').uinteger(t.authLatencyMs);
+  out.raw(',').uinteger(t.sendUs.percentile(50)).raw(',').uinteger(t.sendUs.percentile(99));
+  out.raw(',').uinteger(t.sendUs.maximum()).raw(',').uinteger(t.readyMs).raw(']');
+}
+
+void ZiLinkEsp32::reportStats()
+{
+  _statsLastMs = millis();
+  const Stats s = getStats();
+  ZiLinkFrame<512> frame;
+  frame.raw("{\"type\":\"device_stats\",\"data\":{\"up\":").uinteger(s.uptimeMs);
+  frame.raw(",\"heap\":[").uinteger(s.heapFree).raw(',').uinteger(s.heapMinFree).raw(']');
+  writeTransportStats(frame, "ws", s.ws);
+  writeTransportStats(frame, "mqtt", s.mqtt);
+  writeTransportStats(frame, "http", s.http);
+  // [enqueued, dropped, coalesced, high-water bytes, queued bytes, hand-off drops]
+  frame.raw(",\"q\":[").uinteger(s.queue.enqueued).raw(',').uinteger(s.queue.dropped);
+  frame.raw(',').uinteger(s.queue.coalesced).raw(',').uinteger((uint32_t)s.queue.highWaterBytes);
+  frame.raw(',').uinteger((uint32_t)s.queuedBytes).raw(',').uinteger(s.droppedRequests).raw(']');
+  // p99 ms from queued to sent: [control, component, status, telemetry]
+  frame.raw(",\"qw\":[");
+  for (uint8_t p = 0; p < ZiLinkOutbox::PRIORITIES; p++)
+  {
+    if (p)
+    {
+      frame.raw(',');
+    }
+    frame.uinteger(_outbox.classStats((ZiLinkOutbox::Priority)p).waitUs.percentile(99) / 1000);
+  }
+  frame.raw(']');
+  // [transport for component updates, switches]
+  frame.raw(",\"route\":[").str(s.route).raw(',').uinteger(s.routeSwitches).raw(']');
+  if (_throttle.stats().updates)
+  {
+    // [granted frames/s (0: not throttled), readings coalesced, waits for a token]
+    const ZiLinkThrottle::Stats &t = _throttle.stats();
+    frame.raw(",\"thr\":[").number(s.grantedRate, 2).raw(',').uinteger(t.coalesced).raw(',').uinteger(t.waits).raw(']');
+  }
+  if (_latency.enabled())
+  {
+    // [rtt p50 us, rtt p99 us, uplink p99 ms, downlink p99 ms, missing, reordered]
+    const ZiLinkLatency::Stats &l = _latency.stats();
+    frame.raw(",\"lat\":[").uinteger(_latency.rttUs().percentile(50)).raw(',').uinteger(_latency.rttUs().percentile(99));
+    frame.raw(',').uinteger(_latency.uplinkMs().percentile(99)).raw(',').uinteger(_latency.downlinkMs().percentile(99));
+    frame.raw(',').uinteger(l.missing).raw(',').uinteger(l.reordered).raw(']');
+  }
+  frame.raw("}}");
+  // Text even on a MessagePack connection; never queued, the next report supersedes it
+  if (wsReady())
+  {
+    sendWsFrame(frame);
+  }
+  else if (frame.ok() && _mqtt.connected())
+  {
+    publishMqtt("/stats", frame.c_str(), frame.length());
+  }
+}
+
+bool ZiLinkEsp32::startNetworkTask(const ZiLinkNetTask::Config &config, size_t requestBytes)
+{
+  // Gateway mode runs in loop() only
+  if (_netTask.running() || _gateway || !_requests.resize(requestBytes))
+  {
+    return false;
+  }
+  return _netTask.start(networkTask, this, config);
+}
+
+void ZiLinkEsp32::networkTask(void *ctx)
+{
+  static_cast<ZiLinkEsp32 *>(ctx)->serviceNetwork();
+}
+
+bool ZiLinkEsp32::post(uint8_t request, const char *data, size_t length)
+{
+  if (!_requests.push(request, data, length))
+  {
+    return false;
+  }
+  _netTask.notify();
+  return true;
+}
+
+void ZiLinkEsp32::serviceRequests()
+{
+  uint8_t request;
+  const uint8_t *data;
+  size_t length;
+  while (_requests.front(request, data, length))
+  {
+    const char *text = reinterpret_cast<const char *>(data);
+    switch (request)
+    {
+    case RequestReading:
+    case RequestUrgentReading:
+      sendReading(text, length, request == RequestUrgentReading);
+      break;
+    case RequestSamples:
+    {
+      const size_t nameLen = strlen(text + 1);
+      const size_t valuesAt = (1 + nameLen + 1 + 3) & ~(size_t)3;
+      sendWebSocketSamples(text + 1, reinterpret_cast<const float *>(data + valuesAt),
+                           (length - valuesAt) / sizeof(float), data[0]);
+      break;
+    }
+    case RequestComponent:
+    {
+      int32_t value;
+      const char *type;
+      memcpy(&value, data, 4);
+      memcpy(&type, data + 5, sizeof(type));
+      sendComponentValue(type, text + 5 + sizeof(type), value, data[4] != 0);
+      break;
+    }
+    case RequestWidget:
+    {
+      int32_t value;
+      memcpy(&value, data, 4);
+      sendWidgetValue(data[4], value);
+      break;
+    }
+    case RequestFlush:
+      flush();
+      break;
+    default:
+      sendOrQueue(request, text, length);
+      break;
+    }
+    _requests.pop();
+  }
+}
+
+bool ZiLinkEsp32::configureQueue(size_t capacityBytes, ZiLinkRingBuffer::OverflowPolicy policy, uint32_t blockTimeoutMs)
+{
+  return _outbox.configure(ZiLinkOutbox::Telemetry, capacityBytes, policy, blockTimeoutMs);
+}
+
+ZiLinkOutbox::Priority ZiLinkEsp32::priorityOf(uint8_t channel)
+{
+  switch (channel)
+  {
+  case ChannelControl:
+    return ZiLinkOutbox::Control;
+  case ChannelComponent:
+    return ZiLinkOutbox::State;
+  case ChannelMqttStatus:
+  case ChannelHttpStatus:
+    return ZiLinkOutbox::Status;
+  default:
+    return ZiLinkOutbox::Telemetry;
+  }
+}
+
+bool ZiLinkEsp32::sendOrQueue(uint8_t channel, const char *data, size_t length)
+{
+  if (offload())
+  {
+    return post(channel, data, length);
+  }
+  // Only bypass the queue when nothing older is waiting on the same channel
+  if (!backlogged(channel) && transmitThrottled(channel, data, length))
+  {
+    return true;
+  }
+  queue(channel, 0, data, length);
+  return false;
+}
+
+void ZiLinkEsp32::queue(uint8_t channel, uint16_t key, const char *data, size_t length)
+{
+  // Telemetry survives long outages (and reboots) in the durable log when enabled
+  const bool telemetry = channel == ChannelWsData || channel == ChannelMqttData || channel == ChannelHttpData;
+  if (telemetry && _log.enabled())
+  {
+    _log.append(channel, data, length, millis());
+    return;
+  }
+  _outbox.push(priorityOf(channel), channel, key, data, length);
+}
+
+bool ZiLinkEsp32::backlogged(uint8_t channel) const
+{
+  // Logged telemetry replays first; a reading sent directly would overtake it
+  const bool telemetry = channel == ChannelWsData || channel == ChannelMqttData || channel == ChannelHttpData;
+  return _outbox.pending(channel) || (telemetry && _log.hasBacklog());
+}
+
+bool ZiLinkEsp32::enableDurableLog(const char *dir, const ZiLinkFlashLog::Config &config)
+{
+  return _log.begin(dir, config);
+}
+
+void ZiLinkEsp32::replayDurableLog()
+{
+  // Checked first, so a throttled device does not read records it cannot send.
+  // The queues come first: replay waits for a loop() that left them budget.
+  if (!_log.hasBacklog() || !_throttle.ready(millis()) || _outbox.exhausted())
+  {
+    return;
+  }
+  const bool wifiUp = WiFi.status() == WL_CONNECTED;
+  bool httpUsed = false;
+  _log.replay([&](uint8_t channel, uint32_t seq, const char *data, size_t length)
+              {
+    // A token only for a record whose transport is up
+    switch (channel) {
+      case ChannelWsData:
+        // Acknowledged by the server with {"type":"ack","data":{"seq":N}}
+        return wsReady() && throttled([&] { return sendDeviceData(data, length, seq); }) ? ZiLinkFlashLog::Sent
+                                                                                         : ZiLinkFlashLog::NotSent;
+      case ChannelMqttData:
+        // With QoS 1 the record is delivered once it is in the QoS 1 store
+        return _mqtt.connected() && transmitThrottled(channel, data, length) ? ZiLinkFlashLog::Delivered
+                                                                             : ZiLinkFlashLog::NotSent;
+      case ChannelHttpData:
+        // Blocking HTTP POSTs: replay at most one per loop(). The pipeline
+        // takes the record into its own queue.
+        if (!_httpPipeline.enabled()) {
+          if (!wifiUp || httpUsed) {
+            return ZiLinkFlashLog::NotSent;
+          }
+          httpUsed = true;
+        }
+        return transmitThrottled(channel, data, length) ? ZiLinkFlashLog::Delivered : ZiLinkFlashLog::NotSent;
+    }
+    // Unknown channel (e.g. written by a newer firmware): skip it
+    return ZiLinkFlashLog::Delivered; }, millis());
+}
+
+bool ZiLinkEsp32::transmit(uint8_t channel, const char *data, size_t length)
+{
+  switch (channel)
+  {
+  case ChannelWsData:
+    if (!wsReady())
+    {
+      return false;
+    }
+    return _batch.enabled() ? batchReading(data, length) : sendDeviceData(data, length);
+  case ChannelComponent:
+    return sendComponentData(data, length);
+  case ChannelMqttData:
+  case ChannelMqttStatus:
+    if (_mqttQos1.enabled())
+    {
+      return publishMqttQos1(channel, data, length);
+    }
+    return publishMqtt(channel == ChannelMqttData ? "/data" : "/status", data, length);
+  case ChannelHttpData:
+    return sendHttp(ZiLinkHttpPipeline::Data, data, length);
+  case ChannelHttpStatus:
+    return sendHttp(ZiLinkHttpPipeline::Status, data, length);
+  case ChannelControl:
+    return wsReady() && withFrame(length + 48, [&](ZiLinkFrameWriter &frame)
+                                  {
+      frame.raw("{\"type\":\"command_response\",\"data\":").raw(data, length).raw('}');
+      return frame.ok() && sendWsFrame(frame); });
+  }
+  return false;
+}
+
+bool ZiLinkEsp32::transmitThrottled(uint8_t channel, const char *data, size_t length)
+{
+  // Command responses answer the server and are not paced
+  if (channel == ChannelControl)
+  {
+    return transmit(channel, data, length);
+  }
+  return throttled([&]
+                   { return transmit(channel, data, length); });
+}
+
+void ZiLinkEsp32::flushOutbound()
+{
+  if (_outbox.empty())
+  {
+    return;
+  }
+  const bool wifiUp = WiFi.status() == WL_CONNECTED;
+  const bool mqttUp = _mqtt.connected();
+  // The pipeline queues without blocking, and also while WiFi is down
+  const bool httpPipelined = _httpPipeline.enabled();
+  uint8_t blocked = 0; // channels that failed this pass; later records must wait to keep order
+  bool httpUsed = false;
+  bool replayedWs = false;
+  // Highest priority first, within this loop()'s budget
+  _outbox.service([&](const ZiLinkRingBuffer::Record &r)
+                  {
+    const uint8_t bit = (uint8_t)(1u << r.channel);
+    if (blocked & bit) {
+      return false;
+    }
+    bool ready;
+    bool viaHttp = false;
+    switch (r.channel) {
+      case ChannelWsData:
+      case ChannelControl:
+        ready = wsReady();
+        break;
+      case ChannelComponent:
+      {
+        // Whichever transport is healthiest now, so queued updates fail over with the live ones
+        const ZiLinkTransport *transport = _router.select(millis());
+        ready = transport != nullptr;
+        viaHttp = transport == &_httpLink && !httpPipelined;
+        break;
+      }
+      case ChannelMqttData:
+      case ChannelMqttStatus:
+        // The QoS 1 store takes messages while disconnected too
+        ready = mqttUp || _mqttQos1.enabled();
+        break;
+      default:
+        viaHttp = !httpPipelined;
+        ready = wifiUp || httpPipelined;
+        break;
+    }
+    // HTTP POSTs block, so replay at most one per loop(); a throttled device also needs a token
+    if (!ready || (viaHttp && httpUsed) || !transmitThrottled(r.channel, r.data, r.length)) {
+      blocked |= bit;
+      return false;
+    }
+    httpUsed |= viaHttp;
+    replayedWs |= r.channel == ChannelWsData;
+    return true; });
+  if (replayedWs)
+  {
+    flush();
   }
 }
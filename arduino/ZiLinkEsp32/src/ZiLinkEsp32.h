@@ -7,6 +7,69 @@
 #include <WebSocketsClient.h>
 #include <PubSubClient.h>
 #include <ArduinoJson.h>
+#include "ZiLinkFrameWriter.h"
+#include "ZiLinkBatch.h"
+#include "ZiLinkRingBuffer.h"
+#include "ZiLinkOutbox.h"
+#include "ZiLinkFlashLog.h"
+#include "ZiLinkMsgPack.h"
+#include "ZiLinkComponentTable.h"
+#include "ZiLinkWidgets.h"
+#include "ZiLinkBackoff.h"
+#include "ZiLinkTcpConnect.h"
+#include "ZiLinkCommandQueue.h"
+#include "ZiLinkInbound.h"
+#include "ZiLinkSpscRing.h"
+#include "ZiLinkNetTask.h"
+#include "ZiLinkStats.h"
+#include "ZiLinkLatency.h"
+#include "ZiLinkTransport.h"
+#include "ZiLinkSampler.h"
+#include "ZiLinkStream.h"
+#include "ZiLinkThrottle.h"
+#include "ZiLinkCoalescer.h"
+#include "ZiLinkMqttQos1.h"
+#include "ZiLinkDnsCache.h"
+#include "ZiLinkHttpPipeline.h"
+#include "ZiLinkGateway.h"
+#include "ZiLinkMqttPublish.h"
+
+// TCP connect budget for the MQTT broker; polled from loop(), never blocks
+#ifndef ZILINK_MQTT_CONNECT_TIMEOUT_MS
+#define ZILINK_MQTT_CONNECT_TIMEOUT_MS 5000
+#endif
+
+// CONNACK wait once TCP is up; polled from loop() like the TCP connect
+#ifndef ZILINK_MQTT_HANDSHAKE_TIMEOUT_S
+#define ZILINK_MQTT_HANDSHAKE_TIMEOUT_S 2
+#endif
+
+#ifndef ZILINK_MQTT_KEEPALIVE_S
+#define ZILINK_MQTT_KEEPALIVE_S 15
+#endif
+
+#ifndef ZILINK_MQTT_MAX_SUBSCRIPTIONS
+#define ZILINK_MQTT_MAX_SUBSCRIPTIONS 4
+#endif
+
+// Hand-off queue from the sketch to the network task (threaded mode only)
+#ifndef ZILINK_REQUEST_BYTES
+#define ZILINK_REQUEST_BYTES 2048
+#endif
+
+#ifndef ZILINK_MAX_STREAMS
+#define ZILINK_MAX_STREAMS 2
+#endif
+
+// Stream chunks sent per stream and loop(), so streaming cannot starve the rest
+#ifndef ZILINK_STREAM_CHUNKS_PER_LOOP
+#define ZILINK_STREAM_CHUNKS_PER_LOOP 4
+#endif
+
+// Stream chunks wait while free heap is below this (lwIP buffers unsent data on the heap)
+#ifndef ZILINK_STREAM_MIN_HEAP
+#define ZILINK_STREAM_MIN_HEAP 24576
+#endif
 
 class ZiLinkEsp32
 {
@@ -23,53 +86,512 @@ public:
         bool sendStatus(const String &payload);
         bool sendData(const String &payload);
 
+        // Authenticates the server of wss:// (port 443) and https://
+        // connections: against one pinned CA certificate (PEM), so only
+        // that CA's chain is checked, or by the SHA-256 fingerprint of the
+        // server's certificate ("AB:CD:..." or plain hex), checked after the
+        // handshake without a chain. Without either, TLS encrypts but does
+        // not authenticate. Call before setupWebSocket()/setupHttp(); the
+        // strings are kept, not copied. Blocking HTTP POSTs use the CA only.
+        void setTlsCaCert(const char *pem) { _tlsCaCert = pem; }
+        void setTlsFingerprint(const char *sha256) { _tlsFingerprint = sha256; }
+
         // WebSocket
         void setupWebSocket(const char *host, uint16_t port, const char *path, const char *deviceId, const char *token);
-        bool sendWebSocketData(const String &message);
+        // urgent = true bypasses batching and sends the reading on its own
+        bool sendWebSocketData(const String &message, bool urgent = false);
+        // Answer to a command, any JSON value: sent over the WebSocket as
+        // {"type":"command_response","data":<response>} ahead of every other
+        // queued frame, and never throttled. Queued while the WebSocket is
+        // down.
+        bool sendCommandResponse(const String &response);
+
+        // Numeric samples under one sensor name (e.g. a waveform block):
+        // a float32 array in binary mode, a JSON number array otherwise
+        bool sendWebSocketSamples(const char *name, const float *values, size_t count, uint8_t decimals = 2);
+
+        // WebSocket wire encoding. MsgPack is requested in the auth message
+        // and used once the server confirms it in auth_success; servers that
+        // do not know it keep receiving JSON. Call before setupWebSocket().
+        enum WireEncoding : uint8_t
+        {
+                EncodingJson,
+                EncodingMsgPack
+        };
+        void setWireEncoding(WireEncoding encoding) { _wireRequested = encoding; }
+        // Encoding in use on the current connection
+        WireEncoding wireEncoding() const { return _wsBinary ? EncodingMsgPack : EncodingJson; }
+
+        // Telemetry batching: readings passed to sendWebSocketData() are
+        // coalesced into one device_data frame, sent when maxReadings,
+        // maxLatencyMs or maxBytes (whole frame) is reached, or on flush()
+        bool enableBatching(uint16_t maxReadings, uint32_t maxLatencyMs, size_t maxBytes = 1024);
+        void disableBatching();
+        bool flush();
 
-        // MQTT
+        // MQTT. setupMqtt() returns immediately; loop() connects in the
+        // background (name lookup, TCP connect and CONNACK are all polled)
+        // and reconnects with exponential backoff plus jitter
         void setupMqtt(const char *broker, uint16_t port, const char *deviceId, const char *token);
+        enum MqttState : uint8_t
+        {
+                MqttDisabled,   // setupMqtt() not called
+                MqttBackoff,    // waiting for the next attempt
+                MqttConnecting, // name lookup or TCP connect in progress
+                MqttHandshake,  // CONNECT sent, waiting for CONNACK
+                MqttConnected
+        };
+        MqttState mqttState() const { return _mqttState; }
+        void onMqttStateChange(std::function<void(MqttState)> callback) { _mqttStateCallback = callback; }
+        void setMqttBackoff(uint32_t initialMs, uint32_t maxMs) { _mqttBackoff.configure(initialMs, maxMs); }
         bool publishMqttData(const String &payload);
         bool publishMqttStatus(const String &payload);
 
+        // QoS 1 for publishMqttData()/publishMqttStatus(): each message is
+        // kept until the broker acknowledges it, with up to config.window in
+        // flight, and sent again on timeout or after a reconnect (see
+        // ZiLinkMqttQos1). The publish calls then return true once the
+        // message is stored, also while disconnected; lastMqttMessageId()
+        // is its id and onMqttDelivery() reports how it ended. A full store
+        // falls back to the outbound queue. Without the network task only:
+        // with it, the id is assigned on the task.
+        bool enableMqttQos1(const ZiLinkMqttQos1::Config &config = ZiLinkMqttQos1::Config())
+        {
+                return _mqttQos1.begin(config);
+        }
+        void onMqttDelivery(ZiLinkMqttQos1::DoneFn callback) { _mqttQos1.onDone(callback); }
+        uint16_t lastMqttMessageId() const { return _mqttLastId; }
+        const ZiLinkMqttQos1::Stats &mqttQos1Stats() const { return _mqttQos1.stats(); }
+
+        // HTTP sends over one keep-alive connection without blocking loop()
+        // (see ZiLinkHttpPipeline): sendData()/sendStatus() queue the POST
+        // and return true, loop() writes it and reads the response, and
+        // onHttpComplete() reports its status code under lastHttpRequestId().
+        // config.batchMax > 1 sends runs of readings to /batch-data. Call
+        // after setupHttp(); not with the network task.
+        bool enableHttpPipeline(const ZiLinkHttpPipeline::Config &config = ZiLinkHttpPipeline::Config());
+        void onHttpComplete(ZiLinkHttpPipeline::DoneFn callback) { _httpPipeline.onDone(callback); }
+        uint16_t lastHttpRequestId() const { return _httpLastId; }
+        const ZiLinkHttpPipeline::Stats &httpPipelineStats() const { return _httpPipeline.stats(); }
+
+        // Gateway mode (ZiLinkGateway.h): sub-devices on a UART, ESP-NOW or
+        // any other link reach the server through this device's WebSocket
+        // session, each on a channel of its own, instead of opening one
+        // each. Pass what a link receives to gatewayReceive(); frames for
+        // the sub-devices (auth status, commands) go out through
+        // `downlink`. loop() authenticates new sub-devices in one
+        // gateway_auth message and sends their messages fairly across
+        // channels. Not with the network task.
+        bool enableGateway(ZiLinkGateway::DownlinkFn downlink, void *ctx,
+                           size_t queueBytesPerChannel = ZILINK_GATEWAY_QUEUE_BYTES);
+        void gatewayReceive(uint8_t link, const uint8_t *data, size_t length)
+        {
+                if (_gateway)
+                {
+                        _gateway->feed(link, data, length);
+                }
+        }
+        // Null until enableGateway()
+        const ZiLinkGateway *gateway() const { return _gateway.get(); }
+
         // Component helpers
         void createButton(bool value, const char *id);
         void createSlider(int value, const char *id);
         void createToggle(bool value, const char *id);
         void createProgress(int value, const char *id);
 
-        // Command handling
+        // Component updates go through a per-id state table: values within
+        // the deadband of the last one sent are dropped, bursts faster than
+        // minIntervalMs collapse to the newest value (sent from loop()), and
+        // all components are re-sent as one snapshot after reconnecting
+        void setComponentDefaults(const ZiLinkComponentTable::Config &config) { _components.setDefaults(config); }
+        bool configureComponent(const char *id, const ZiLinkComponentTable::Config &config)
+        {
+                return _components.configure(id, config);
+        }
+        const ZiLinkComponentTable::Stats &componentStats() const { return _components.stats(); }
+
+        // Compile-time widget schema (ZiLinkWidgets.h). The widgets are
+        // filtered like create*() ids; after auth_success the schema is sent
+        // once as a component_schema, and updates then carry the widget's
+        // index, {"type":"c","i":0,"v":42} or [7, 0, 42], instead of its id
+        // and type. MQTT and HTTP, which have no session, still get the full
+        // frame. Call once in setup(); false when the table has no room.
+        template <size_t N>
+        bool setWidgets(const ZiLinkWidget (&widgets)[N])
+        {
+                static_assert(N <= ZILINK_MAX_COMPONENTS, "more widgets than ZILINK_MAX_COMPONENTS");
+                return setWidgets(widgets, N);
+        }
+        bool setWidgets(const ZiLinkWidget *widgets, size_t count);
+        template <ZiLinkWidget::Type T>
+        void updateWidget(ZiLinkWidgetRef<T> widget, typename ZiLinkWidgetRef<T>::Value value)
+        {
+                sendWidgetValue(widget.index, (int32_t)value);
+        }
+
+        // Component updates go over the ready transport with the best
+        // health score (send duration, failure rate, frames waiting for
+        // it), with hysteresis against flapping; see ZiLinkTransportRouter.
+        // WebSocket, MQTT and HTTP are registered in that order and
+        // addTransport() appends another. Frames no transport takes wait in
+        // the outbound queue and go out, in order, on whichever is picked
+        // next.
+        bool addTransport(ZiLinkTransport *transport) { return _router.add(transport); }
+        void setTransportHysteresis(uint8_t percent, uint32_t minDwellMs) { _router.setHysteresis(percent, minDwellMs); }
+        const ZiLinkTransportRouter &transports() const { return _router; }
+
+        // Edge aggregation: loop() calls read() every periodUs and folds the
+        // values into windows of windowMs. Each window goes out as one reading,
+        // {"<name>":{"min":..,"max":..,"mean":..,"last":..,"n":..}}, and
+        // sensors whose windows end in the same loop() share it. Readings go
+        // through sendWebSocketData() unless a sink is set (e.g. one that
+        // calls publishMqttData()). Sampling runs in the sketch's context,
+        // also with the network task.
+        bool sampleSensor(const char *name, uint32_t periodUs, uint32_t windowMs, ZiLinkSampler::ReadFn read,
+                          uint8_t decimals = 2)
+        {
+                return _sampler.add(name, periodUs, windowMs, read, decimals, micros());
+        }
+        void setSampleSink(std::function<void(const char *reading, size_t length)> sink) { _sampleSink = sink; }
+        const ZiLinkSampler::Stats &samplerStats() const { return _sampler.stats(); }
+
+        // Waveform streaming over the WebSocket: raw sample blocks (audio,
+        // vibration) as binary chunks, see ZiLinkStream. The producer, the
+        // sketch or its own task, calls write() on the returned stream, while
+        // loop() or the network task sends the chunks. Nothing is sent until
+        // the server answers stream_open with credit. Chunks also wait while
+        // free heap is below ZILINK_STREAM_MIN_HEAP. When the producer
+        // outruns both, write() drops samples, and the next chunk carries
+        // the gap flag. Streams stay open for the life of the client; name
+        // is kept by pointer. nullptr when all ZILINK_MAX_STREAMS are taken
+        // or the blocks cannot be allocated.
+        ZiLinkStream *openStream(const char *name, ZiLinkStream::Format format, uint32_t sampleRate,
+                                 uint16_t blockSamples = 512);
+
+        // Server throttling: an overloaded server sends {"type":"throttle",
+        // "data":{"rate":r,"burst":b,"credit":c,"ttl":ms}} (WebSocket, or
+        // MQTT on the commands topic) and every frame the device sends
+        // then waits for a token, see ZiLinkThrottle. Batches and queued
+        // records go out at the granted rate, component updates keep only
+        // their latest value, and readings from sendWebSocketData() merge
+        // into one pending reading with the newest value per sensor.
+        // Urgent readings, snapshots, command responses and stream chunks
+        // are not throttled.
+        // The limit lapses after ttl unless renewed; rate 0 lifts it.
+        // Frames per second granted, 0 while unlimited
+        float grantedRate() const { return _throttle.rate(millis()); }
+        const ZiLinkThrottle::Stats &throttleStats() const { return _throttle.stats(); }
+
+        // Outbound queue shared by WebSocket, MQTT and HTTP; holds sends made
+        // while their transport is unavailable and replays them from loop().
+        // It has one bounded queue per priority class (command responses,
+        // component updates, status, telemetry), drained highest first by
+        // weight within a per-loop() budget; see ZiLinkOutbox. The first
+        // form sizes the telemetry queue. Reallocating discards anything
+        // queued in that class. BlockWithTimeout returns false.
+        bool configureQueue(size_t capacityBytes, ZiLinkRingBuffer::OverflowPolicy policy = ZiLinkRingBuffer::DropOldest,
+                            uint32_t blockTimeoutMs = 0);
+        bool configureQueue(ZiLinkOutbox::Priority priority, size_t capacityBytes,
+                            ZiLinkRingBuffer::OverflowPolicy policy = ZiLinkRingBuffer::DropOldest,
+                            uint32_t blockTimeoutMs = 0)
+        {
+                return _outbox.configure(priority, capacityBytes, policy, blockTimeoutMs);
+        }
+        void setQueueWeight(ZiLinkOutbox::Priority priority, uint8_t weight) { _outbox.setWeight(priority, weight); }
+        // Bytes and microseconds of replay per loop()
+        void setQueueBudget(size_t bytes, uint32_t us) { _outbox.setBudget(bytes, us); }
+        // Summed over the classes
+        ZiLinkRingBuffer::Stats queueStats() const { return _outbox.stats(); }
+        // One class: records sent from the queue and how long they waited
+        const ZiLinkOutbox::ClassStats &queueStats(ZiLinkOutbox::Priority priority) const
+        {
+                return _outbox.classStats(priority);
+        }
+
+        // Durable store-and-forward for telemetry (sendWebSocketData,
+        // publishMqttData, sendData) that cannot be sent right away. `dir`
+        // must exist on a mounted filesystem, e.g. "/littlefs/zilink" after
+        // LittleFS.begin(). Replayed in order from loop() once the transport
+        // is back (after auth_success for WebSocket).
+        bool enableDurableLog(const char *dir, const ZiLinkFlashLog::Config &config = ZiLinkFlashLog::Config());
+        const ZiLinkFlashLog::Stats &durableLogStats() const { return _log.stats(); }
+
+        // Command handling. Commands from WebSocket and MQTT share one queue
+        // of ZILINK_COMMAND_SLOTS; a burst beyond that is dropped and counted.
+        // Once a handler is registered loop() dispatches every command by
+        // name (see ZiLinkCommandQueue::nameOf); until then they wait for
+        // hasCommand()/getCommand().
+        bool onCommand(const char *name, ZiLinkCommandQueue::Handler handler) { return _commands.on(name, handler); }
+        // Commands without a handler of their own
+        void onCommand(ZiLinkCommandQueue::Handler handler) { _commands.onUnknown(handler); }
+        ZiLinkCommandQueue::Stats commandStats() const { return _commands.stats(); }
         bool hasCommand();
         String getCommand();
 
+        // Threaded mode: the network work loop() would do (WebSocket, MQTT,
+        // queues, blocking HTTP POSTs) runs on its own task, pinned to
+        // config.core. Sends from the sketch go through a lock-free queue of
+        // requestBytes and return true once queued (false when it is full);
+        // commands still reach the sketch through loop(). Call after the
+        // setup*(), configure*() and enable*() calls.
+        bool startNetworkTask(const ZiLinkNetTask::Config &config = ZiLinkNetTask::Config(),
+                              size_t requestBytes = ZILINK_REQUEST_BYTES);
+        void stopNetworkTask() { _netTask.stop(); }
+        bool networkTaskRunning() const { return _netTask.running(); }
+        // Sends rejected because the hand-off queue was full
+        uint32_t droppedRequests() const { return _requests.dropped(); }
+
+        // Runtime statistics. The counters are plain integers updated where
+        // the work happens (no allocation, no locks); getStats() copies them
+        // and samples the heap. With the network task running the copy may
+        // be a pass behind.
+        struct Stats
+        {
+                ZiLinkTransportStats ws;
+                ZiLinkTransportStats mqtt;
+                ZiLinkTransportStats http; // auth unused; connects only with the HTTP pipeline
+                ZiLinkRingBuffer::Stats queue;
+                size_t queuedBytes;
+                uint32_t droppedRequests; // network task hand-off queue full
+                const char *route;        // transport for component updates ("" before the first)
+                uint32_t routeSwitches;
+                float grantedRate; // frames per second, 0 while not throttled
+                uint32_t heapFree;
+                uint32_t heapMinFree;
+                uint32_t uptimeMs;
+        };
+        Stats getStats() const;
+        // Every intervalMs, sends a compact device_stats frame over the
+        // WebSocket, or MQTT (.../stats) when only that is up; skipped while
+        // both are down. 0 turns it off.
+        void setStatsReport(uint32_t intervalMs) { _statsIntervalMs = intervalMs; }
+
+        // Latency tracing: device_data and component frames sent over the
+        // WebSocket carry "trace":[n, deviceMs], the server answers each
+        // with trace_ack, and latency() builds RTT and one-way delay
+        // histograms and counts missing/reordered acks. Off by default.
+        void setLatencyTracking(bool enabled) { _latency.setEnabled(enabled); }
+        const ZiLinkLatency &latency() const { return _latency; }
+
+        // Without the network task: services every transport, then
+        // dispatches commands. With it: dispatches commands only.
         void loop();
 
 private:
-        bool sendHttp(const String &endpoint, const String &payload);
-        bool sendComponentData(const String &payload);
-        void wsEnqueue(const String &payload);
-        void wsFlushQueue();
+        // Outbound queue channels
+        enum Channel : uint8_t
+        {
+                ChannelWsData = 1,
+                ChannelComponent,
+                ChannelMqttData,
+                ChannelMqttStatus,
+                ChannelHttpData,
+                ChannelHttpStatus,
+                ChannelControl
+        };
+        static ZiLinkOutbox::Priority priorityOf(uint8_t channel);
+
+        // Built-in transports for component frames
+        class Link : public ZiLinkTransport
+        {
+        public:
+                enum Kind : uint8_t
+                {
+                        Ws,
+                        Mqtt,
+                        Http
+                };
+                Link(ZiLinkEsp32 &owner, Kind kind) : _owner(owner), _kind(kind) {}
+                const char *name() const override;
+                bool ready() override;
+                bool send(const char *data, size_t length) override;
+                size_t backlog() override;
+                uint32_t expectedUs() const override;
+
+        private:
+                ZiLinkEsp32 &_owner;
+                Kind _kind;
+        };
+
+        // Room after a JSON batch's readings for `,"trace":[n,ms]}}`
+        static const size_t BATCH_TRAILER_BYTES = 40;
+
+        // Hand-off records for the network task; plain sends are tagged with their Channel
+        enum Request : uint8_t
+        {
+                RequestReading = 16,
+                RequestUrgentReading,
+                RequestSamples,
+                RequestComponent,
+                RequestWidget,
+                RequestFlush
+        };
+
+        bool wsReady() { return _ws.isConnected() && _wsAuthenticated; }
+        // Called from the sketch while the network task owns the transports
+        bool offload() const { return _netTask.running() && !_netTask.inTask(); }
+        bool post(uint8_t request, const char *data, size_t length);
+        void serviceRequests();
+        void serviceNetwork();
+        static void networkTask(void *ctx);
+        bool sendHttp(ZiLinkHttpPipeline::Kind kind, const char *payload, size_t length);
+        static void httpResult(void *ctx, int status, size_t bytes, uint32_t us);
+        bool publishMqtt(const char *suffix, const char *payload, size_t length);
+        void serviceMqtt();
+        void serviceMqttHandshake(uint32_t nowMs);
+        bool publishMqttQos1(uint8_t channel, const char *payload, size_t length);
+        void serviceMqttQos1();
+        static void mqttPuback(void *ctx, uint16_t id);
+        void mqttFailed(uint32_t nowMs);
+        void setMqttState(MqttState state);
+        bool sendWsFrame(ZiLinkFrameWriter &frame, bool binary = false);
+        template <typename Fn>
+        bool withFrame(size_t needed, Fn build);
+        // Runs `send` only with a token from the server's throttle, and
+        // returns the token when the frame does not go out
+        template <typename Fn>
+        bool throttled(Fn send);
+        bool sendDeviceData(const char *sensors, size_t length, uint32_t seq = 0);
+        bool sendReading(const char *reading, size_t length, bool urgent);
+        bool coalesceReading(const char *reading, size_t length);
+        void sendLatest();
+        void applyThrottle();
+        bool sendBinaryBatch();
+        bool sendJsonBatch();
+        void handleTextMessage(char *payload, size_t length, ZiLinkCommandQueue::Source source);
+        void handleBinaryFrame(const uint8_t *payload, size_t length);
+        void commandReceived(JsonVariantConst command, ZiLinkCommandQueue::Source source);
+        void queueCommand(const char *text, size_t length, ZiLinkCommandQueue::Source source);
+        bool sendComponentData(const char *data, size_t length);
+        bool writeDevicePath(ZiLinkFrameWriter &out, const char *prefix, const char *suffix);
+        bool batchReading(const char *reading, size_t length);
+        bool sendComponent(ZiLinkFrameWriter &frame, const char *id);
+        void sendComponentValue(const char *type, const char *id, int32_t value, bool isBool);
+        void sendWidgetValue(uint8_t index, int32_t value);
+        void updateComponent(ZiLinkComponentTable::Entry &entry, ZiLinkComponentTable::Decision decision, uint32_t nowMs);
+        bool deliverComponent(const ZiLinkComponentTable::Entry &entry);
+        void writeComponentJson(ZiLinkFrameWriter &out, const char *type, const char *id, int32_t value, bool isBool,
+                                const ZiLinkLatency::Trace *trace = nullptr);
+        bool sendComponentSnapshot();
+        bool sendComponentSchema();
+        void serviceGateway();
+        bool sendGatewayAuth();
+        void gatewayAuthResult();
+        bool sendOrQueue(uint8_t channel, const char *data, size_t length);
+        bool transmit(uint8_t channel, const char *data, size_t length);
+        bool transmitThrottled(uint8_t channel, const char *data, size_t length);
+        void queue(uint8_t channel, uint16_t key, const char *data, size_t length);
+        // Something older waits for `channel`, so a new message must queue behind it
+        bool backlogged(uint8_t channel) const;
+        void replayDurableLog();
+        void reportStats();
+        void serviceSampler();
+        void sendSampleReading(ZiLinkFrameWriter &reading);
+        void flushOutbound();
+        void serviceStreams();
+        bool announceStream(ZiLinkStream &stream);
 
         String _baseUrl;
         String _token;
         String _deviceId;
         WebSocketsClient _ws;
         WiFiClient _wifi;
+        // PubSubClient reads through it, so QoS 1 sees the PUBACKs
+        ZiLinkMqttTap _mqttTap{_wifi};
         PubSubClient _mqtt;
 
+        // MQTT connection state machine
+        String _mqttHost;
+        uint16_t _mqttPort = 0;
+        ZiLinkDnsCache _mqttDns;
+        uint32_t _mqttAttemptMs = 0;
+        uint32_t _mqttTcpUpMs = 0;
+        MqttState _mqttState = MqttDisabled;
+        ZiLinkBackoff _mqttBackoff;
+        ZiLinkTcpConnect _mqttTcp;
+        std::function<void(MqttState)> _mqttStateCallback;
+        // Restored after every reconnect
+        String _mqttTopics[ZILINK_MQTT_MAX_SUBSCRIPTIONS];
+        uint8_t _mqttTopicCount = 0;
+        // QoS 1 publishing (idle until enableMqttQos1())
+        ZiLinkMqttQos1 _mqttQos1;
+        uint16_t _mqttLastId = 0;
+        // Keep-alive HTTP (idle until enableHttpPipeline())
+        ZiLinkHttpPipeline _httpPipeline;
+        uint16_t _httpLastId = 0;
+
         // WebSocket state
         bool _wsConnected = false;
         bool _wsAuthenticated = false;
+        WireEncoding _wireRequested = EncodingJson;
+        bool _wsBinary = false; // MsgPack confirmed by the server for this connection
+
+        // Grow-only buffer for frames larger than the stack frame
+        std::unique_ptr<char[]> _scratch;
+        size_t _scratchCap = 0;
+
+        // Sub-device channels (no storage until enableGateway())
+        std::unique_ptr<ZiLinkGateway> _gateway;
+
+        // Pending telemetry batch (no storage until enableBatching())
+        ZiLinkBatch _batch;
+
+        // Last known state per component id
+        ZiLinkComponentTable _components;
+        // setWidgets(): table entry per schema index
+        ZiLinkComponentTable::Entry *_widgets[ZILINK_MAX_COMPONENTS] = {};
+        uint8_t _widgetCount = 0;
+        // The server has this session's schema, so updates may go by index
+        bool _schemaSent = false;
+
+        // Pending sends for every transport (to cover early sends and outages)
+        ZiLinkOutbox _outbox;
+        // Optional flash-backed log for telemetry (disabled until enableDurableLog())
+        ZiLinkFlashLog _log;
+
+        // Threaded mode (idle until startNetworkTask())
+        ZiLinkNetTask _netTask;
+        ZiLinkSpscRing _requests;
+
+        // Inbound commands (filled from the transport callbacks)
+        ZiLinkCommandQueue _commands;
+        // Reused for every JSON message from the server
+        ZiLinkInbound _inbound;
+
+        // Sensors sampled from loop() and their aggregated readings
+        ZiLinkSampler _sampler;
+        std::function<void(const char *, size_t)> _sampleSink;
+
+        // Waveform streams; ids are index + 1
+        ZiLinkStream _streams[ZILINK_MAX_STREAMS];
+        // Per stream: stream_open sent on this connection
+        bool _streamAnnounced[ZILINK_MAX_STREAMS] = {};
+
+        // Component frame routing
+        Link _wsLink{*this, Link::Ws};
+        Link _mqttLink{*this, Link::Mqtt};
+        Link _httpLink{*this, Link::Http};
+        ZiLinkTransportRouter _router;
+
+        // Upload rate granted by the server, and the readings merged while it is throttled
+        ZiLinkThrottle _throttle;
+        ZiLinkCoalescer _latest;
 
-        // Tiny ring buffer for pending WS payloads (to cover early sends)
-        static const size_t WS_QUEUE_SIZE = 8;
-        String _wsQueue[WS_QUEUE_SIZE];
-        size_t _wsQHead = 0; // points to next item to pop
-        size_t _wsQTail = 0; // points to next free slot
+        // End-to-end latency of traced frames
+        ZiLinkLatency _latency;
 
-        // Command handling
-        String _pendingCommand = "";
-        bool _hasPendingCommand = false;
+        // Runtime statistics (see getStats())
+        ZiLinkTransportStats _wsStats;
+        ZiLinkTransportStats _mqttStats;
+        ZiLinkTransportStats _httpStats;
+        uint32_t _wsConnectedMs = 0;
+        // WebSocketsClient connects inside loop(), blocking: the call's start is the attempt's
+        uint32_t _wsLoopMs = 0;
+        const char *_tlsCaCert = nullptr;
+        const char *_tlsFingerprint = nullptr;
+        uint32_t _statsIntervalMs = 0;
+        uint32_t _statsLastMs = 0;
 };
 
 #endif
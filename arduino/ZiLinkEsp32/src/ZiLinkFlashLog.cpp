@@ -0,0 +1,515 @@
+#include "ZiLinkFlashLog.h"
+
+#include <dirent.h>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+
+static void putU16(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void putU32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static uint16_t getU16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t getU32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint32_t ZiLinkFlashLog::crc32(uint32_t crc, const uint8_t *data, size_t length)
+{
+  // Nibble-table CRC-32 (IEEE): small enough for flash, fast enough for replay
+  static const uint32_t table[16] = {
+      0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+      0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++)
+  {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+void ZiLinkFlashLog::segmentPath(uint32_t id, char *out, size_t cap) const
+{
+  snprintf(out, cap, "%s/%08lx.zl", _dir, (unsigned long)id);
+}
+
+bool ZiLinkFlashLog::begin(const char *dir, const Config &config)
+{
+  end();
+  if (!dir || strlen(dir) >= sizeof(_dir) || config.maxSegments == 0)
+  {
+    return false;
+  }
+  strcpy(_dir, dir);
+  _config = config;
+  if (_config.maxSegments > ZILINK_LOG_MAX_SEGMENTS)
+  {
+    _config.maxSegments = ZILINK_LOG_MAX_SEGMENTS;
+  }
+  if (_config.stagingBytes < HEADER_SIZE + _config.maxRecordBytes)
+  {
+    _config.stagingBytes = HEADER_SIZE + _config.maxRecordBytes;
+  }
+  _staging.reset(new (std::nothrow) uint8_t[_config.stagingBytes]);
+  _readBuf.reset(new (std::nothrow) uint8_t[_config.maxRecordBytes]);
+  if (!_staging || !_readBuf)
+  {
+    end();
+    return false;
+  }
+  _stats = Stats();
+  if (!recover())
+  {
+    end();
+    return false;
+  }
+  return true;
+}
+
+void ZiLinkFlashLog::end()
+{
+  if (_staging)
+  {
+    flushStaging();
+  }
+  closeReader();
+  _staging.reset();
+  _readBuf.reset();
+  _stagingLen = 0;
+  _segmentCount = 0;
+}
+
+bool ZiLinkFlashLog::scanSegment(Segment &seg, uint32_t &lastSeq)
+{
+  char path[64];
+  segmentPath(seg.id, path, sizeof(path));
+  FILE *f = fopen(path, "rb");
+  if (!f)
+  {
+    return false;
+  }
+  uint8_t header[HEADER_SIZE];
+  uint32_t offset = 0;
+  seg.firstSeq = 0;
+  while (fread(header, 1, HEADER_SIZE, f) == HEADER_SIZE)
+  {
+    const uint16_t length = getU16(header + 2);
+    if (header[0] != MAGIC || length > _config.maxRecordBytes ||
+        fread(_readBuf.get(), 1, length, f) != length)
+    {
+      break;
+    }
+    uint32_t crc = crc32(0, header + 1, 7);
+    if (crc32(crc, _readBuf.get(), length) != getU32(header + 8))
+    {
+      _stats.corrupt++;
+      break;
+    }
+    const uint32_t seq = getU32(header + 4);
+    if (seg.firstSeq == 0)
+    {
+      seg.firstSeq = seq;
+    }
+    lastSeq = seq;
+    offset += HEADER_SIZE + length;
+  }
+  fclose(f);
+  // Anything after the last valid record is a torn write and is ignored
+  seg.bytes = offset;
+  return true;
+}
+
+bool ZiLinkFlashLog::recover()
+{
+  _segmentCount = 0;
+  _lastSegmentId = 0;
+  DIR *d = opendir(_dir);
+  if (!d)
+  {
+    return false;
+  }
+  struct dirent *e;
+  while ((e = readdir(d)) != nullptr)
+  {
+    // Entries may be reported as "<id>.zl" or with the directory prefix
+    const char *name = strrchr(e->d_name, '/');
+    name = name ? name + 1 : e->d_name;
+    char *end = nullptr;
+    unsigned long id = strtoul(name, &end, 16);
+    if (end != name + 8 || strcmp(end, ".zl") != 0 || id == 0)
+    {
+      continue;
+    }
+    if (id > _lastSegmentId)
+    {
+      _lastSegmentId = (uint32_t)id;
+    }
+    // Keep the newest maxSegments ids in ascending order
+    uint8_t pos = _segmentCount;
+    while (pos > 0 && _segments[pos - 1].id > id)
+    {
+      pos--;
+    }
+    if (_segmentCount == _config.maxSegments)
+    {
+      char path[64];
+      if (pos == 0)
+      {
+        segmentPath((uint32_t)id, path, sizeof(path));
+        remove(path);
+        continue;
+      }
+      segmentPath(_segments[0].id, path, sizeof(path));
+      remove(path);
+      memmove(&_segments[0], &_segments[1], (pos - 1) * sizeof(Segment));
+      pos--;
+      _segmentCount--;
+    }
+    memmove(&_segments[pos + 1], &_segments[pos], (_segmentCount - pos) * sizeof(Segment));
+    _segments[pos].id = (uint32_t)id;
+    _segmentCount++;
+  }
+  closedir(d);
+
+  uint32_t lastSeq = 0;
+  for (uint8_t i = 0; i < _segmentCount; i++)
+  {
+    scanSegment(_segments[i], lastSeq);
+  }
+  _nextSeq = lastSeq + 1;
+  // Acknowledgements are not persisted: everything left on flash is replayed
+  _ackedSeq = _sentSeq = _lastAckable = 0;
+  for (uint8_t i = 0; i < _segmentCount; i++)
+  {
+    if (_segments[i].firstSeq)
+    {
+      _ackedSeq = _sentSeq = _lastAckable = _segments[i].firstSeq - 1;
+      break;
+    }
+  }
+  if (_segmentCount == 0 || _ackedSeq + 1 >= _nextSeq)
+  {
+    _ackedSeq = _sentSeq = _lastAckable = _nextSeq - 1;
+  }
+  _stats.ackedSeq = _ackedSeq;
+  _replaySeq = _ackedSeq + 1;
+  _readIndex = 0;
+  _readOffset = 0;
+  _sealed = _segmentCount > 0;
+  trim();
+  return true;
+}
+
+bool ZiLinkFlashLog::openNewSegment()
+{
+  if (_segmentCount == _config.maxSegments)
+  {
+    evictOldest();
+  }
+  Segment &seg = _segments[_segmentCount++];
+  seg.id = ++_lastSegmentId;
+  seg.firstSeq = 0;
+  seg.bytes = 0;
+  _sealed = false;
+  return true;
+}
+
+void ZiLinkFlashLog::removeOldest()
+{
+  if (_segmentCount == 0)
+  {
+    return;
+  }
+  char path[64];
+  if (_readFile && _readFileId == _segments[0].id)
+  {
+    closeReader();
+  }
+  segmentPath(_segments[0].id, path, sizeof(path));
+  remove(path);
+  _segmentCount--;
+  memmove(&_segments[0], &_segments[1], _segmentCount * sizeof(Segment));
+  if (_readIndex > 0)
+  {
+    _readIndex--;
+  }
+  else
+  {
+    _readOffset = 0;
+  }
+}
+
+void ZiLinkFlashLog::evictOldest()
+{
+  // Out of budget: lose the oldest segment, acknowledged or not
+  const uint32_t endSeq = _segmentCount > 1 ? _segments[1].firstSeq : _nextSeq;
+  if (endSeq > _ackedSeq + 1)
+  {
+    const uint32_t from = _segments[0].firstSeq > _ackedSeq + 1 ? _segments[0].firstSeq : _ackedSeq + 1;
+    _stats.dropped += endSeq - from;
+    _ackedSeq = endSeq - 1;
+    _stats.ackedSeq = _ackedSeq;
+    if (_sentSeq < _ackedSeq)
+    {
+      _sentSeq = _ackedSeq;
+    }
+    if (_replaySeq <= _ackedSeq)
+    {
+      _replaySeq = _ackedSeq + 1;
+    }
+  }
+  removeOldest();
+}
+
+void ZiLinkFlashLog::trim()
+{
+  while (_segmentCount > 0)
+  {
+    const Segment &seg = _segments[0];
+    const bool newest = _segmentCount == 1;
+    uint32_t endSeq = newest ? (_stagingLen ? _stagingFirstSeq : _nextSeq) : _segments[1].firstSeq;
+    if (seg.firstSeq == 0 && !newest)
+    {
+      // Empty (e.g. fully torn) segment
+      removeOldest();
+      continue;
+    }
+    if (seg.firstSeq == 0 || endSeq == 0 || endSeq - 1 > _ackedSeq)
+    {
+      break;
+    }
+    removeOldest();
+  }
+}
+
+bool ZiLinkFlashLog::append(uint8_t channel, const char *data, size_t length, uint32_t nowMs)
+{
+  if (!enabled() || length > _config.maxRecordBytes)
+  {
+    _stats.dropped++;
+    return false;
+  }
+  const size_t total = HEADER_SIZE + length;
+  if (_stagingLen + total > _config.stagingBytes && !flushStaging())
+  {
+    _stats.dropped++;
+    return false;
+  }
+  uint8_t *p = _staging.get() + _stagingLen;
+  const uint32_t seq = _nextSeq++;
+  p[0] = MAGIC;
+  p[1] = channel;
+  putU16(p + 2, (uint16_t)length);
+  putU32(p + 4, seq);
+  memcpy(p + HEADER_SIZE, data, length);
+  uint32_t crc = crc32(0, p + 1, 7);
+  putU32(p + 8, crc32(crc, p + HEADER_SIZE, length));
+  if (_stagingLen == 0)
+  {
+    _stagingSince = nowMs;
+    _stagingFirstSeq = seq;
+  }
+  _stagingLen += total;
+  _stats.appended++;
+  return true;
+}
+
+void ZiLinkFlashLog::service(uint32_t nowMs)
+{
+  if (_stagingLen > 0 && (uint32_t)(nowMs - _stagingSince) >= _config.flushIntervalMs)
+  {
+    flushStaging();
+  }
+}
+
+bool ZiLinkFlashLog::flushStaging()
+{
+  if (_stagingLen == 0)
+  {
+    return true;
+  }
+  if (_segmentCount == 0 || _sealed ||
+      (_segments[_segmentCount - 1].bytes > 0 &&
+       _segments[_segmentCount - 1].bytes + _stagingLen > _config.segmentBytes))
+  {
+    openNewSegment();
+  }
+  Segment &seg = _segments[_segmentCount - 1];
+  char path[64];
+  segmentPath(seg.id, path, sizeof(path));
+  // The reader may hold a stale view of this file
+  closeReader();
+  FILE *f = fopen(path, "ab");
+  if (!f)
+  {
+    return false;
+  }
+  const size_t written = fwrite(_staging.get(), 1, _stagingLen, f);
+  fclose(f);
+  _stats.flashWrites++;
+  if (written != _stagingLen)
+  {
+    // Partial write: the torn tail is skipped on recovery, start a fresh segment
+    seg.bytes += (uint32_t)written;
+    _sealed = true;
+    return false;
+  }
+  if (seg.firstSeq == 0)
+  {
+    seg.firstSeq = _stagingFirstSeq;
+  }
+  seg.bytes += (uint32_t)_stagingLen;
+  _stagingLen = 0;
+  return true;
+}
+
+void ZiLinkFlashLog::closeReader()
+{
+  if (_readFile)
+  {
+    fclose(_readFile);
+    _readFile = nullptr;
+  }
+}
+
+void ZiLinkFlashLog::restoreCursor(uint32_t segmentId, uint32_t offset)
+{
+  // Records before _replaySeq are skipped by readNext(), so falling back to
+  // the oldest segment is always safe
+  _readIndex = 0;
+  _readOffset = 0;
+  for (uint8_t i = 0; i < _segmentCount; i++)
+  {
+    if (_segments[i].id == segmentId)
+    {
+      _readIndex = i;
+      _readOffset = offset;
+      break;
+    }
+  }
+}
+
+bool ZiLinkFlashLog::readNext(uint8_t &channel, uint32_t &seq, size_t &length)
+{
+  for (;;)
+  {
+    if (_readIndex >= _segmentCount || _readOffset >= _segments[_readIndex].bytes)
+    {
+      if (_readIndex + 1 < _segmentCount)
+      {
+        _readIndex++;
+        _readOffset = 0;
+        continue;
+      }
+      // Caught up with flash: staged records must be written before they can be read back
+      if (_stagingLen > 0 && flushStaging())
+      {
+        continue;
+      }
+      return false;
+    }
+    const Segment &seg = _segments[_readIndex];
+    if (!_readFile || _readFileId != seg.id)
+    {
+      closeReader();
+      char path[64];
+      segmentPath(seg.id, path, sizeof(path));
+      _readFile = fopen(path, "rb");
+      _readFileId = seg.id;
+      if (!_readFile)
+      {
+        _readOffset = seg.bytes;
+        continue;
+      }
+    }
+    uint8_t header[HEADER_SIZE];
+    bool valid = fseek(_readFile, _readOffset, SEEK_SET) == 0 &&
+                 fread(header, 1, HEADER_SIZE, _readFile) == HEADER_SIZE && header[0] == MAGIC;
+    length = valid ? getU16(header + 2) : 0;
+    valid = valid && length <= _config.maxRecordBytes && fread(_readBuf.get(), 1, length, _readFile) == length;
+    if (valid)
+    {
+      uint32_t crc = crc32(0, header + 1, 7);
+      valid = crc32(crc, _readBuf.get(), length) == getU32(header + 8);
+    }
+    if (!valid)
+    {
+      // Skip the damaged remainder of this segment
+      _stats.corrupt++;
+      _readOffset = seg.bytes;
+      continue;
+    }
+    _readOffset += HEADER_SIZE + length;
+    channel = header[1];
+    seq = getU32(header + 4);
+    if (seq >= _replaySeq)
+    {
+      return true;
+    }
+  }
+}
+
+void ZiLinkFlashLog::markDelivered(uint32_t seq)
+{
+  // Only advance while no replayed record is still waiting for a server ack
+  if (_lastAckable <= _ackedSeq && seq > _ackedSeq)
+  {
+    _ackedSeq = seq;
+    _stats.ackedSeq = seq;
+    trim();
+  }
+}
+
+void ZiLinkFlashLog::acknowledge(uint32_t seq)
+{
+  if (!enabled() || seq <= _ackedSeq)
+  {
+    return;
+  }
+  if (seq >= _nextSeq)
+  {
+    seq = _nextSeq - 1;
+  }
+  // Once the newest ack-bearing record is confirmed, everything sent so far is delivered
+  _ackedSeq = seq >= _lastAckable && _sentSeq > seq ? _sentSeq : seq;
+  if (_sentSeq < _ackedSeq)
+  {
+    _sentSeq = _ackedSeq;
+  }
+  if (_replaySeq <= _ackedSeq)
+  {
+    _replaySeq = _ackedSeq + 1;
+  }
+  _stats.ackedSeq = _ackedSeq;
+  trim();
+}
+
+void ZiLinkFlashLog::rewind()
+{
+  if (!enabled())
+  {
+    return;
+  }
+  _replaySeq = _ackedSeq + 1;
+  _sentSeq = _lastAckable = _ackedSeq;
+  _readIndex = 0;
+  _readOffset = 0;
+  closeReader();
+}
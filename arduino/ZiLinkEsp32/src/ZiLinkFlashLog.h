@@ -0,0 +1,201 @@
+#ifndef ZILINK_FLASH_LOG_H
+#define ZILINK_FLASH_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <memory>
+
+#ifndef ZILINK_LOG_MAX_SEGMENTS
+#define ZILINK_LOG_MAX_SEGMENTS 16
+#endif
+
+// Durable store-and-forward log for outbound telemetry.
+//
+// Records are appended to a RAM staging buffer and written to the current
+// segment file in one chunk once the buffer fills or flushIntervalMs
+// passes, so flash sees a few large writes instead of one per reading.
+// Segments are plain files under `dir`, which works on the host and on
+// ESP32 through the VFS mount of LittleFS/SPIFFS (e.g. "/littlefs/zilink").
+//
+// On-flash record: magic(1) channel(1) length(2) seq(4) crc32(4) payload.
+// The CRC covers channel, length, seq and payload; replay stops at the
+// first damaged record of a segment (torn write) and moves to the next.
+//
+// Replay is in sequence order and rate limited. Records sent over a
+// transport with server acknowledgements (Sent) stay on flash until
+// acknowledge() covers them; others (Delivered) count as acknowledged
+// once sent. Fully acknowledged segments are deleted.
+class ZiLinkFlashLog
+{
+public:
+        struct Config
+        {
+                size_t segmentBytes = 16384;   // roll over to a new file beyond this
+                uint8_t maxSegments = 8;       // oldest segment is evicted beyond this
+                size_t stagingBytes = 1024;    // RAM write-behind buffer
+                size_t maxRecordBytes = 512;   // largest payload accepted
+                uint32_t flushIntervalMs = 2000;
+                uint16_t replayPerSecond = 20; // replay rate limit
+                uint16_t maxInFlight = 16;     // unacknowledged replayed records
+        };
+
+        struct Stats
+        {
+                uint32_t appended = 0;
+                uint32_t dropped = 0; // rejected records plus records in evicted segments
+                uint32_t flashWrites = 0;
+                uint32_t replayed = 0;
+                uint32_t corrupt = 0;
+                uint32_t ackedSeq = 0;
+        };
+
+        enum SendResult
+        {
+                NotSent,  // transport unavailable, retry later
+                Sent,     // awaiting acknowledge()
+                Delivered // no acknowledgement expected
+        };
+
+        ZiLinkFlashLog() = default;
+        ~ZiLinkFlashLog() { end(); }
+        ZiLinkFlashLog(const ZiLinkFlashLog &) = delete;
+        ZiLinkFlashLog &operator=(const ZiLinkFlashLog &) = delete;
+
+        // Opens (and recovers) the log in an existing, mounted directory
+        bool begin(const char *dir, const Config &config);
+        void end();
+        bool enabled() const { return _staging != nullptr; }
+
+        bool append(uint8_t channel, const char *data, size_t length, uint32_t nowMs);
+        // Writes out the staging buffer when it is due; call from loop()
+        void service(uint32_t nowMs);
+        bool flushStaging();
+
+        // True while records exist that have not been replayed yet
+        bool hasBacklog() const { return _replaySeq < _nextSeq; }
+
+        // Replays due records through `send(channel, seq, data, length)`,
+        // which returns a SendResult. Returns the number of records sent.
+        template <typename Fn>
+        size_t replay(Fn send, uint32_t nowMs);
+
+        // Cumulative acknowledgement from the server
+        void acknowledge(uint32_t seq);
+        // Connection lost: resend everything after the last acknowledgement
+        void rewind();
+
+        const Stats &stats() const { return _stats; }
+
+private:
+        struct Segment
+        {
+                uint32_t id;
+                uint32_t firstSeq; // 0 until the first record is written
+                uint32_t bytes;
+        };
+
+        static const uint8_t MAGIC = 0xA7;
+        static const size_t HEADER_SIZE = 12;
+
+        static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t length);
+
+        void segmentPath(uint32_t id, char *out, size_t cap) const;
+        bool recover();
+        bool scanSegment(Segment &seg, uint32_t &lastSeq);
+        bool openNewSegment();
+        void removeOldest();
+        void evictOldest();
+        void trim();
+        bool readNext(uint8_t &channel, uint32_t &seq, size_t &length);
+        void closeReader();
+        void restoreCursor(uint32_t segmentId, uint32_t offset);
+        void markDelivered(uint32_t seq);
+
+        char _dir[48] = {0};
+        Config _config;
+        Stats _stats;
+
+        std::unique_ptr<uint8_t[]> _staging;
+        size_t _stagingLen = 0;
+        uint32_t _stagingSince = 0;
+        std::unique_ptr<uint8_t[]> _readBuf;
+
+        Segment _segments[ZILINK_LOG_MAX_SEGMENTS];
+        uint8_t _segmentCount = 0;
+        uint32_t _lastSegmentId = 0;
+        bool _sealed = false; // last segment may end in a torn write; append to a new one
+        uint32_t _stagingFirstSeq = 0;
+
+        uint32_t _nextSeq = 1;   // seq of the next appended record
+        uint32_t _ackedSeq = 0;  // everything <= is acknowledged
+        uint32_t _sentSeq = 0;   // highest replayed seq
+        uint32_t _lastAckable = 0; // highest replayed seq that needs a server ack
+
+        // Replay cursor: next record to send
+        uint32_t _replaySeq = 1;
+        uint8_t _readIndex = 0;
+        uint32_t _readOffset = 0;
+        FILE *_readFile = nullptr;
+        uint32_t _readFileId = 0;
+
+        // Token bucket for the replay rate
+        uint32_t _tokens = 0;
+        uint32_t _lastRefillMs = 0;
+};
+
+template <typename Fn>
+size_t ZiLinkFlashLog::replay(Fn send, uint32_t nowMs)
+{
+        if (!enabled() || !hasBacklog())
+        {
+                return 0;
+        }
+        // Refill at replayPerSecond, allowing a burst of at most one second
+        const uint32_t rate = _config.replayPerSecond ? _config.replayPerSecond : 1;
+        const uint32_t elapsed = nowMs - _lastRefillMs;
+        const uint32_t earned = (uint32_t)(((uint64_t)elapsed * rate) / 1000);
+        if (earned > 0)
+        {
+                _tokens = _tokens + earned > rate ? rate : _tokens + earned;
+                _lastRefillMs = nowMs;
+        }
+
+        size_t sent = 0;
+        while (_tokens > 0 && hasBacklog() && _sentSeq - _ackedSeq < _config.maxInFlight)
+        {
+                uint8_t channel;
+                uint32_t seq;
+                size_t length;
+                const uint32_t segmentId = _readIndex < _segmentCount ? _segments[_readIndex].id : 0;
+                const uint32_t readOffset = _readOffset;
+                if (!readNext(channel, seq, length))
+                {
+                        break;
+                }
+                SendResult res = send(channel, seq, (const char *)_readBuf.get(), length);
+                if (res == NotSent)
+                {
+                        // Retry the same record next time
+                        restoreCursor(segmentId, readOffset);
+                        break;
+                }
+                _tokens--;
+                _stats.replayed++;
+                _replaySeq = seq + 1;
+                _sentSeq = seq;
+                if (res == Sent)
+                {
+                        _lastAckable = seq;
+                }
+                else
+                {
+                        markDelivered(seq);
+                }
+                sent++;
+        }
+        closeReader();
+        return sent;
+}
+
+#endif
@@ -0,0 +1,219 @@
+#include "ZiLinkFrameWriter.h"
+
+#include <math.h>
+#include <stdio.h>
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+ZiLinkFrameWriter::ZiLinkFrameWriter(char *buf, size_t cap, size_t headroom)
+    : _buf(buf), _cap(cap), _headroom(headroom)
+{
+  if (_buf == nullptr || _cap <= _headroom)
+  {
+    // Not even room for the terminator: clamp to the real storage so that
+    // c_str() stays inside it, and stay overflowed
+    static char empty[1];
+    _buf = buf && cap ? buf : empty;
+    _headroom = buf && cap ? cap - 1 : 0;
+    _cap = _headroom;
+    _buf[_headroom] = '\0';
+  }
+  reset();
+}
+
+void ZiLinkFrameWriter::reset()
+{
+  _len = 0;
+  // Without room for the terminator every append overflows
+  _overflow = _cap <= _headroom;
+  if (!_overflow)
+  {
+    _buf[_headroom] = '\0';
+  }
+}
+
+void ZiLinkFrameWriter::truncate(size_t len)
+{
+  if (len < _len)
+  {
+    _len = len;
+    _buf[_headroom + _len] = '\0';
+  }
+  // Rolling back below capacity makes the writer usable again
+  _overflow = _cap <= _headroom;
+}
+
+bool ZiLinkFrameWriter::reserve(size_t n)
+{
+  if (_overflow)
+  {
+    return false;
+  }
+  if (n > capacity() - _len)
+  {
+    _overflow = true;
+    return false;
+  }
+  return true;
+}
+
+ZiLinkFrameWriter &ZiLinkFrameWriter::raw(const char *s, size_t n)
+{
+  if (n == 0 || !reserve(n))
+  {
+    return *this;
+  }
+  char *dst = _buf + _headroom + _len;
+  memcpy(dst, s, n);
+  _len += n;
+  dst[n] = '\0';
+  return *this;
+}
+
+ZiLinkFrameWriter &ZiLinkFrameWriter::raw(char c)
+{
+  if (!reserve(1))
+  {
+    return *this;
+  }
+  char *dst = _buf + _headroom + _len;
+  dst[0] = c;
+  dst[1] = '\0';
+  _len++;
+  return *this;
+}
+
+ZiLinkFrameWriter &ZiLinkFrameWriter::str(const char *s)
+{
+  return str(s, s ? strlen(s) : 0);
+}
+
+ZiLinkFrameWriter &ZiLinkFrameWriter::str(const char *s, size_t n)
+{
+  raw('"');
+  size_t runStart = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    unsigned char c = (unsigned char)s[i];
+    if (c >= 0x20 && c != '"' && c != '\\')
+    {
+      continue;
+    }
+    // Flush the unescaped run, then the escape sequence
+    raw(s + runStart, i - runStart);
+    runStart = i + 1;
+    switch (c)
+    {
+    case '"':
+      raw("\\\"");
+      break;
+    case '\\':
+      raw("\\\\");
+      break;
+    case '\n':
+      raw("\\n");
+      break;
+    case '\r':
+      raw("\\r");
+      break;
+    case '\t':
+      raw("\\t");
+      break;
+    default:
+    {
+      char esc[6] = {'\\', 'u', '0', '0', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0x0F]};
+      raw(esc, sizeof(esc));
+    }
+    break;
+    }
+  }
+  raw(s + runStart, n - runStart);
+  return raw('"');
+}
+
+ZiLinkFrameWriter &ZiLinkFrameWriter::uinteger(uint32_t v)
+{
+  char tmp[10];
+  size_t i = sizeof(tmp);
+  do
+  {
+    tmp[--i] = (char)('0' + (v % 10));
+    v /= 10;
+  } while (v);
+  return raw(tmp + i, sizeof(tmp) - i);
+}
+
+ZiLinkFrameWriter &ZiLinkFrameWriter::integer(int32_t v)
+{
+  if (v < 0)
+  {
+    raw('-');
+    // Negate in unsigned space so INT32_MIN does not overflow
+    return uinteger(0u - (uint32_t)v);
+  }
+  return uinteger((uint32_t)v);
+}
+
+ZiLinkFrameWriter &ZiLinkFrameWriter::number(float v, uint8_t decimals)
+{
+  if (isnan(v) || isinf(v))
+  {
+    // JSON has no representation for NaN/Inf
+    return raw("null");
+  }
+  if (decimals > 6)
+  {
+    decimals = 6;
+  }
+  if (fabsf(v) >= 4.0e9f)
+  {
+    // Out of range for the fixed-point path below
+    char tmp[24];
+    int n = snprintf(tmp, sizeof(tmp), "%.*e", (int)decimals, (double)v);
+    return raw(tmp, n > 0 ? (size_t)n : 0);
+  }
+
+  uint32_t scale = 1;
+  for (uint8_t i = 0; i < decimals; i++)
+  {
+    scale *= 10;
+  }
+  double mag = fabs((double)v);
+  uint64_t fixed = (uint64_t)(mag * scale + 0.5);
+  uint32_t whole = (uint32_t)(fixed / scale);
+  uint32_t frac = (uint32_t)(fixed % scale);
+
+  if (v < 0 && fixed != 0)
+  {
+    raw('-');
+  }
+  uinteger(whole);
+  if (decimals == 0)
+  {
+    return *this;
+  }
+
+  char tmp[7];
+  for (uint8_t i = decimals; i > 0; i--)
+  {
+    tmp[i - 1] = (char)('0' + (frac % 10));
+    frac /= 10;
+  }
+  raw('.');
+  return raw(tmp, decimals);
+}
+
+ZiLinkFrameWriter &ZiLinkFrameWriter::boolean(bool v)
+{
+  return v ? raw("true") : raw("false");
+}
+
+ZiLinkFrameWriter &ZiLinkFrameWriter::key(const char *name, bool first)
+{
+  if (!first)
+  {
+    raw(',');
+  }
+  str(name);
+  return raw(':');
+}
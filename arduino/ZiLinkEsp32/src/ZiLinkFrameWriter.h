@@ -0,0 +1,88 @@
+#ifndef ZILINK_FRAME_WRITER_H
+#define ZILINK_FRAME_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Bytes reserved in front of every frame so the WebSocket client can write
+// its header in place (sendTXT/sendBIN with headerToPayload = true) instead
+// of copying the payload into a temporary heap buffer.
+// Must be >= WEBSOCKETS_MAX_HEADER_SIZE.
+#ifndef ZILINK_FRAME_HEADROOM
+#define ZILINK_FRAME_HEADROOM 14
+#endif
+
+// Default stack frame size used by the component and telemetry send paths
+#ifndef ZILINK_FRAME_SIZE
+#define ZILINK_FRAME_SIZE 256
+#endif
+
+// Append-only JSON frame writer over caller-provided storage.
+// It never allocates: once the buffer is exhausted the writer latches into
+// an overflow state and ignores further appends, so callers only need to
+// check ok() once after building the whole frame.
+// The written bytes are always NUL-terminated.
+class ZiLinkFrameWriter
+{
+public:
+        ZiLinkFrameWriter(char *buf, size_t cap, size_t headroom = 0);
+
+        void reset();
+
+        // Literal copy without escaping; the array overload avoids strlen()
+        template <size_t N>
+        ZiLinkFrameWriter &raw(const char (&lit)[N]) { return raw(lit, N - 1); }
+        ZiLinkFrameWriter &raw(const char *s, size_t n);
+        ZiLinkFrameWriter &raw(char c);
+        ZiLinkFrameWriter &cstr(const char *s) { return raw(s, s ? strlen(s) : 0); }
+
+        // Value emitters
+        ZiLinkFrameWriter &str(const char *s);
+        ZiLinkFrameWriter &str(const char *s, size_t n);
+        ZiLinkFrameWriter &integer(int32_t v);
+        ZiLinkFrameWriter &uinteger(uint32_t v);
+        ZiLinkFrameWriter &number(float v, uint8_t decimals = 2);
+        ZiLinkFrameWriter &boolean(bool v);
+
+        // Writes `"name":`; pass `first = false` to prefix a comma
+        ZiLinkFrameWriter &key(const char *name, bool first = false);
+
+        bool ok() const { return !_overflow; }
+        size_t length() const { return _len; }
+        size_t headroom() const { return _headroom; }
+        size_t capacity() const { return _cap > _headroom ? _cap - _headroom - 1 : 0; }
+
+        // Payload start (after the reserved headroom)
+        const char *c_str() const { return _buf + _headroom; }
+        // Mutable payload, for encoders that patch headers after the fact
+        char *data() { return _buf + _headroom; }
+        // Start of the underlying storage including the headroom
+        uint8_t *base() { return reinterpret_cast<uint8_t *>(_buf); }
+
+        // Drop everything after `len` and clear the overflow latch; used to
+        // roll back a partially written element
+        void truncate(size_t len);
+
+private:
+        bool reserve(size_t n);
+
+        char *_buf;
+        size_t _cap;
+        size_t _headroom;
+        size_t _len = 0;
+        bool _overflow = false;
+};
+
+// Writer with inline (typically stack) storage and WebSocket headroom
+template <size_t N = ZILINK_FRAME_SIZE>
+class ZiLinkFrame : public ZiLinkFrameWriter
+{
+public:
+        ZiLinkFrame() : ZiLinkFrameWriter(_storage, sizeof(_storage), ZILINK_FRAME_HEADROOM) {}
+
+private:
+        char _storage[N + ZILINK_FRAME_HEADROOM + 1];
+};
+
+#endif
@@ -0,0 +1,313 @@
+#include "ZiLinkGateway.h"
+
+#include <new>
+#include <string.h>
+
+static uint8_t checksum(const uint8_t *p, size_t n)
+{
+  uint8_t sum = 0;
+  while (n--)
+  {
+    sum += *p++;
+  }
+  return sum;
+}
+
+size_t ZiLinkGateway::encode(uint8_t *out, size_t capacity, uint8_t channel, uint8_t type, const void *payload,
+                             size_t length)
+{
+  const size_t total = HEADER_BYTES + length + 1;
+  if (length > ZILINK_GATEWAY_FRAME_BYTES || total > capacity)
+  {
+    return 0;
+  }
+  out[0] = SYNC;
+  out[1] = channel;
+  out[2] = type;
+  out[3] = (uint8_t)(length & 0xFF);
+  out[4] = (uint8_t)(length >> 8);
+  if (length)
+  {
+    memcpy(out + HEADER_BYTES, payload, length);
+  }
+  out[HEADER_BYTES + length] = checksum(out + 1, HEADER_BYTES - 1 + length);
+  return total;
+}
+
+ZiLinkGateway::~ZiLinkGateway()
+{
+  for (Channel &c : _channels)
+  {
+    delete[] c.token;
+  }
+}
+
+bool ZiLinkGateway::begin(size_t queueBytesPerChannel)
+{
+  for (Channel &c : _channels)
+  {
+    if (!c.queue.resize(queueBytesPerChannel))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ZiLinkGateway::feed(uint8_t link, const uint8_t *data, size_t length)
+{
+  if (link >= ZILINK_GATEWAY_MAX_LINKS)
+  {
+    return;
+  }
+  Decoder &d = _decoders[link];
+  for (size_t i = 0; i < length; i++)
+  {
+    if (d.have == 0 && data[i] != SYNC)
+    {
+      // Between frames: line noise or a sub-device booting
+      continue;
+    }
+    d.buf[d.have++] = data[i];
+    // A resync can leave a whole frame in the buffer, so check until more bytes are needed
+    while (d.have >= HEADER_BYTES)
+    {
+      const size_t payload = d.buf[3] | ((size_t)d.buf[4] << 8);
+      if (payload > ZILINK_GATEWAY_FRAME_BYTES)
+      {
+        _linkErrors++;
+        resync(d);
+        continue;
+      }
+      if (d.have < HEADER_BYTES + payload + 1)
+      {
+        break;
+      }
+      if (checksum(d.buf + 1, HEADER_BYTES - 1 + payload) != d.buf[HEADER_BYTES + payload])
+      {
+        _linkErrors++;
+        resync(d);
+        continue;
+      }
+      d.have = 0;
+      receive(link, d.buf[1], d.buf[2], d.buf + HEADER_BYTES, payload);
+      break;
+    }
+  }
+}
+
+void ZiLinkGateway::resync(Decoder &d)
+{
+  // Restart at the next sync byte after the one that failed
+  const uint8_t *next = (const uint8_t *)memchr(d.buf + 1, SYNC, d.have - 1);
+  if (!next)
+  {
+    d.have = 0;
+    return;
+  }
+  d.have -= next - d.buf;
+  memmove(d.buf, next, d.have);
+}
+
+void ZiLinkGateway::receive(uint8_t link, uint8_t channel, uint8_t type, const uint8_t *payload, size_t length)
+{
+  if (channel == 0)
+  {
+    _linkErrors++;
+    return;
+  }
+  Channel *c = find(channel);
+  if (type == Hello)
+  {
+    const char *id = (const char *)payload;
+    const size_t idLen = strnlen(id, length);
+    const size_t tokenLen = idLen < length ? length - idLen - 1 : 0;
+    if (idLen == 0 || idLen >= ZILINK_GATEWAY_ID_LEN || tokenLen == 0)
+    {
+      sendStatus(link, channel, Rejected);
+      return;
+    }
+    if (c && c->state != Rejected && strcmp(c->deviceId, id) == 0)
+    {
+      // Restarted or impatient sub-device: keep its queue and its place in the auth sequence
+      c->link = link;
+      if (c->state == Ready)
+      {
+        sendStatus(*c);
+      }
+      return;
+    }
+    if (!c)
+    {
+      c = find(0);
+    }
+    char *token = new (std::nothrow) char[tokenLen + 1];
+    if (!c || !token)
+    {
+      delete[] token;
+      sendStatus(link, channel, Rejected);
+      return;
+    }
+    memcpy(token, id + idLen + 1, tokenLen);
+    token[tokenLen] = '\0';
+    delete[] c->token;
+    c->token = token;
+    memcpy(c->deviceId, id, idLen + 1);
+    c->id = channel;
+    c->link = link;
+    c->state = Pending;
+    c->queue.clear();
+    c->deficit = 0;
+    c->stats = ChannelStats();
+    return;
+  }
+  if (type != Message)
+  {
+    return;
+  }
+  if (!c || c->state == Rejected)
+  {
+    if (c)
+    {
+      c->stats.dropped++;
+    }
+    // Tells a sub-device that missed its status to say hello (again)
+    sendStatus(link, channel, c ? Rejected : Unknown);
+    return;
+  }
+  c->link = link;
+  c->stats.received++;
+  // Queued while the channel authenticates, too. Counts the message itself
+  // when it does not fit, or the older ones evicted to make room.
+  const uint32_t dropped = c->queue.stats().dropped;
+  c->queue.push(0, 0, (const char *)payload, length);
+  c->stats.dropped += c->queue.stats().dropped - dropped;
+}
+
+void ZiLinkGateway::authSent()
+{
+  for (Channel &c : _channels)
+  {
+    if (c.id && c.state == Pending)
+    {
+      c.state = Authenticating;
+    }
+  }
+}
+
+void ZiLinkGateway::authResult(uint8_t channel, bool accepted)
+{
+  Channel *c = find(channel);
+  if (!c || c->state != Authenticating)
+  {
+    return;
+  }
+  c->state = accepted ? Ready : Rejected;
+  if (!accepted)
+  {
+    c->stats.dropped += c->queue.records();
+    c->queue.clear();
+  }
+  sendStatus(*c);
+}
+
+void ZiLinkGateway::sessionLost()
+{
+  for (Channel &c : _channels)
+  {
+    if (c.id && (c.state == Ready || c.state == Authenticating))
+    {
+      // Queued messages wait for the next session
+      c.state = Pending;
+    }
+  }
+}
+
+bool ZiLinkGateway::route(uint8_t channel, const char *message, size_t length)
+{
+  Channel *c = find(channel);
+  if (!c || c->state != Ready || length > ZILINK_GATEWAY_FRAME_BYTES)
+  {
+    return false;
+  }
+  c->stats.routed++;
+  downlink(c->link, c->id, Message, message, length);
+  return true;
+}
+
+bool ZiLinkGateway::hasPending() const
+{
+  for (const Channel &c : _channels)
+  {
+    if (c.id && c.state == Pending)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+ZiLinkGateway::State ZiLinkGateway::state(uint8_t channel) const
+{
+  const Channel *c = find(channel);
+  return c ? c->state : Unknown;
+}
+
+const ZiLinkGateway::ChannelStats *ZiLinkGateway::stats(uint8_t channel) const
+{
+  const Channel *c = find(channel);
+  return c ? &c->stats : nullptr;
+}
+
+size_t ZiLinkGateway::queuedBytes(uint8_t channel) const
+{
+  const Channel *c = find(channel);
+  return c ? c->queue.usedBytes() : 0;
+}
+
+size_t ZiLinkGateway::channels() const
+{
+  size_t n = 0;
+  for (const Channel &c : _channels)
+  {
+    n += c.id != 0;
+  }
+  return n;
+}
+
+ZiLinkGateway::Channel *ZiLinkGateway::find(uint8_t channel)
+{
+  for (Channel &c : _channels)
+  {
+    if (c.id == channel)
+    {
+      return &c;
+    }
+  }
+  return nullptr;
+}
+
+const ZiLinkGateway::Channel *ZiLinkGateway::find(uint8_t channel) const
+{
+  return const_cast<ZiLinkGateway *>(this)->find(channel);
+}
+
+void ZiLinkGateway::sendStatus(const Channel &c)
+{
+  sendStatus(c.link, c.id, c.state);
+}
+
+void ZiLinkGateway::sendStatus(uint8_t link, uint8_t channel, State state)
+{
+  const uint8_t s = state;
+  downlink(link, channel, Status, &s, 1);
+}
+
+void ZiLinkGateway::downlink(uint8_t link, uint8_t channel, uint8_t type, const void *payload, size_t length)
+{
+  const size_t n = encode(_out, sizeof(_out), channel, type, payload, length);
+  if (_downlink && n)
+  {
+    _downlink(_downlinkCtx, link, _out, n);
+  }
+}
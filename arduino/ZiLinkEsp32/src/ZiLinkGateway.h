@@ -0,0 +1,264 @@
+#ifndef ZILINK_GATEWAY_H
+#define ZILINK_GATEWAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ZiLinkRingBuffer.h"
+
+// Sub-devices one gateway carries
+#ifndef ZILINK_GATEWAY_MAX_CHANNELS
+#define ZILINK_GATEWAY_MAX_CHANNELS 8
+#endif
+
+// Links the sub-devices come in on (UARTs, ESP-NOW, ...), each with its own decoder
+#ifndef ZILINK_GATEWAY_MAX_LINKS
+#define ZILINK_GATEWAY_MAX_LINKS 2
+#endif
+
+// Outbound queue per sub-device
+#ifndef ZILINK_GATEWAY_QUEUE_BYTES
+#define ZILINK_GATEWAY_QUEUE_BYTES 1024
+#endif
+
+// Largest link frame payload: one message, or a hello with id and token
+#ifndef ZILINK_GATEWAY_FRAME_BYTES
+#define ZILINK_GATEWAY_FRAME_BYTES 512
+#endif
+
+#ifndef ZILINK_GATEWAY_ID_LEN
+#define ZILINK_GATEWAY_ID_LEN 32
+#endif
+
+// Bytes a channel may send per scheduling round
+#ifndef ZILINK_GATEWAY_QUANTUM
+#define ZILINK_GATEWAY_QUANTUM 256
+#endif
+
+// Budget of one service() call, i.e. of one loop()
+#ifndef ZILINK_GATEWAY_LOOP_BYTES
+#define ZILINK_GATEWAY_LOOP_BYTES 4096
+#endif
+
+// Gateway mode: sub-devices without a connection of their own (on a UART,
+// ESP-NOW, ...) reach the server through the gateway's WebSocket session.
+// Each sub-device picks a channel id (1-255, like a bus address) and talks
+// in link frames:
+//
+//   [0xA5][channel][type][length lo][length hi][payload][sum]
+//
+// where sum is the 8-bit sum of channel..payload. A stream decoder drops
+// what does not check out and resyncs on the next 0xA5, so frames can share
+// one serial line; a datagram link passes whole frames.
+//
+// A sub-device says Hello with its device id and token. The gateway
+// authenticates all new channels in one gateway_auth message and answers
+// each with a Status frame. Messages are the JSON a device would send over
+// its own WebSocket; they wait in a queue per channel and go out by
+// deficit round robin, so a chatty sub-device only overflows its own queue.
+// Messages the server sends a sub-device (commands, acks, throttle) come
+// back addressed by channel and are written to the link it was heard on.
+class ZiLinkGateway
+{
+public:
+        enum FrameType : uint8_t
+        {
+                Hello = 1,   // sub-device -> gateway: "<deviceId>\0<token>"
+                Message = 2, // either way: one JSON message
+                Status = 3   // gateway -> sub-device: one State byte
+        };
+
+        enum State : uint8_t
+        {
+                Unknown,        // no hello from this channel (sent when a message arrives without one)
+                Pending,        // hello received, auth not sent yet
+                Authenticating, // in a gateway_auth batch
+                Ready,
+                Rejected // by the server, or no free channel
+        };
+
+        struct ChannelStats
+        {
+                uint32_t received = 0; // messages from the sub-device
+                uint32_t sent = 0;     // handed to the server
+                uint32_t dropped = 0;  // queue full, rejected, unknown channel or not sendable
+                uint32_t routed = 0;   // server messages written back to it
+        };
+
+        // What a service() send function returns; true and false mean Sent and Held
+        enum SendResult : uint8_t
+        {
+                Held,   // not sent; stays queued and ends the call
+                Sent,   // handed to the server
+                Dropped // cannot be sent at all (e.g. not JSON); removed and counted
+        };
+
+        // Writes one link frame towards the sub-devices on `link`
+        typedef void (*DownlinkFn)(void *ctx, uint8_t link, const uint8_t *frame, size_t length);
+
+        static const uint8_t SYNC = 0xA5;
+        static const size_t HEADER_BYTES = 5;
+        static const size_t MAX_FRAME_BYTES = HEADER_BYTES + ZILINK_GATEWAY_FRAME_BYTES + 1;
+
+        // Builds a link frame; 0 when it does not fit
+        static size_t encode(uint8_t *out, size_t capacity, uint8_t channel, uint8_t type, const void *payload,
+                             size_t length);
+
+        ZiLinkGateway() = default;
+        ~ZiLinkGateway();
+        ZiLinkGateway(const ZiLinkGateway &) = delete;
+        ZiLinkGateway &operator=(const ZiLinkGateway &) = delete;
+
+        // Allocates the per-channel queues
+        bool begin(size_t queueBytesPerChannel = ZILINK_GATEWAY_QUEUE_BYTES);
+        void onDownlink(DownlinkFn fn, void *ctx)
+        {
+                _downlink = fn;
+                _downlinkCtx = ctx;
+        }
+        void setBudget(size_t bytes) { _budgetBytes = bytes; }
+
+        // Bytes from a stream link, in any chunks
+        void feed(uint8_t link, const uint8_t *data, size_t length);
+        // One decoded frame
+        void receive(uint8_t link, uint8_t channel, uint8_t type, const uint8_t *payload, size_t length);
+
+        // Visits the channels whose hello has not been sent to the server
+        // with `fn(channel, deviceId, token)`; authSent() once they are
+        template <typename Fn>
+        size_t forEachPending(Fn fn) const;
+        void authSent();
+        void authResult(uint8_t channel, bool accepted);
+        // The server session ended: channels authenticate again in the next
+        void sessionLost();
+        // A message from the server for `channel`
+        bool route(uint8_t channel, const char *message, size_t length);
+
+        // `send(channel, message, length)` returns a SendResult: Held leaves
+        // the message queued and ends the call, Sent and Dropped remove it
+        // (a bool works too). Ready channels only, ZILINK_GATEWAY_QUANTUM
+        // bytes each per round, within the call's byte budget. Within a
+        // channel, messages keep their order.
+        template <typename Fn>
+        void service(Fn send);
+
+        bool hasPending() const;
+        State state(uint8_t channel) const;
+        const ChannelStats *stats(uint8_t channel) const;
+        size_t queuedBytes(uint8_t channel) const;
+        size_t channels() const;
+        uint32_t linkErrors() const { return _linkErrors; }
+
+private:
+        struct Channel
+        {
+                uint8_t id = 0; // 0: free slot
+                uint8_t link = 0;
+                State state = Unknown;
+                char deviceId[ZILINK_GATEWAY_ID_LEN] = {};
+                char *token = nullptr;
+                ZiLinkRingBuffer queue;
+                uint32_t deficit = 0;
+                ChannelStats stats;
+        };
+
+        struct Decoder
+        {
+                uint8_t buf[MAX_FRAME_BYTES];
+                size_t have = 0;
+        };
+
+        Channel *find(uint8_t channel);
+        const Channel *find(uint8_t channel) const;
+        void sendStatus(const Channel &c);
+        void sendStatus(uint8_t link, uint8_t channel, State state);
+        void downlink(uint8_t link, uint8_t channel, uint8_t type, const void *payload, size_t length);
+        static void resync(Decoder &d);
+
+        Channel _channels[ZILINK_GATEWAY_MAX_CHANNELS];
+        Decoder _decoders[ZILINK_GATEWAY_MAX_LINKS];
+        uint8_t _out[MAX_FRAME_BYTES];
+        DownlinkFn _downlink = nullptr;
+        void *_downlinkCtx = nullptr;
+        size_t _budgetBytes = ZILINK_GATEWAY_LOOP_BYTES;
+        uint8_t _next = 0; // round robin starts after the channel served first last time
+        uint32_t _linkErrors = 0;
+};
+
+template <typename Fn>
+size_t ZiLinkGateway::forEachPending(Fn fn) const
+{
+        size_t n = 0;
+        for (const Channel &c : _channels)
+        {
+                if (c.id && c.state == Pending)
+                {
+                        fn(c.id, (const char *)c.deviceId, (const char *)c.token);
+                        n++;
+                }
+        }
+        return n;
+}
+
+template <typename Fn>
+void ZiLinkGateway::service(Fn send)
+{
+        size_t spent = 0;
+        bool again = true;
+        bool stopped = false;
+        const uint8_t first = _next;
+        while (again && !stopped)
+        {
+                again = false;
+                for (uint8_t k = 0; k < ZILINK_GATEWAY_MAX_CHANNELS && !stopped; k++)
+                {
+                        Channel &c = _channels[(first + k) % ZILINK_GATEWAY_MAX_CHANNELS];
+                        if (!c.id || c.state != Ready || c.queue.empty())
+                        {
+                                c.deficit = 0;
+                                continue;
+                        }
+                        c.deficit += ZILINK_GATEWAY_QUANTUM;
+                        bool waiting = false;
+                        c.queue.drain([&](const ZiLinkRingBuffer::Record &r)
+                                      {
+                                              if (waiting || stopped)
+                                              {
+                                                      return false;
+                                              }
+                                              if (r.length > c.deficit)
+                                              {
+                                                      waiting = true;
+                                                      return false;
+                                              }
+                                              if (spent > 0 && spent >= _budgetBytes)
+                                              {
+                                                      stopped = true;
+                                                      return false;
+                                              }
+                                              const uint8_t result = send(c.id, r.data, r.length);
+                                              if (result == Held)
+                                              {
+                                                      stopped = true;
+                                                      return false;
+                                              }
+                                              c.deficit -= r.length;
+                                              result == Dropped ? c.stats.dropped++ : c.stats.sent++;
+                                              spent += r.length ? r.length : 1;
+                                              again = true;
+                                              return true;
+                                      });
+                        if (waiting)
+                        {
+                                again = true;
+                        }
+                        else
+                        {
+                                c.deficit = 0;
+                        }
+                }
+        }
+        // The next call starts one channel further, so no channel is always first
+        _next = (uint8_t)((first + 1) % ZILINK_GATEWAY_MAX_CHANNELS);
+}
+
+#endif
@@ -0,0 +1,10 @@
+#include "ZiLinkHttp.h"
+
+ZiLinkHttp::ZiLinkHttp(const char *deviceId, const char *token, const Config &config)
+    : _authorization(String("Bearer ") + token)
+{
+  ZiLinkFrameWriter url(_url, sizeof(_url));
+  // Longest suffix ("components") must fit too
+  url.cstr(config.baseUrl).raw("/devices/").cstr(deviceId).raw("/components");
+  _prefixLen = url.ok() ? (uint8_t)(url.length() - 10) : 0;
+}
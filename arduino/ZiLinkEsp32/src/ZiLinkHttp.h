@@ -0,0 +1,48 @@
+#ifndef ZILINK_HTTP_H
+#define ZILINK_HTTP_H
+
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include "ZiLink.h"
+
+// Room for "<baseUrl>/devices/<id>/components"
+#ifndef ZILINK_URL_BYTES
+#define ZILINK_URL_BYTES 160
+#endif
+
+// HTTP transport for ZiLink<...>: one blocking POST per send to
+// <baseUrl>/devices/<id>/data, /status or /components. Always "ready"
+// while Wi-Fi is up, so list it last as the fallback.
+class ZiLinkHttp
+{
+public:
+        struct Config
+        {
+                Config(const char *baseUrl) : baseUrl(baseUrl) {}
+                const char *baseUrl;
+        };
+
+        ZiLinkHttp(const char *deviceId, const char *token, const Config &config);
+
+        void begin() {}
+        void loop(uint32_t) {}
+        bool ready() const { return _prefixLen > 0 && WiFi.status() == WL_CONNECTED; }
+        bool send(ZiLinkKind kind, const char *data, size_t length)
+        {
+                strcpy(_url + _prefixLen, kind == ZiLinkData ? "data" : kind == ZiLinkStatus ? "status" : "components");
+                HTTPClient http;
+                http.begin(_url);
+                http.addHeader("Authorization", _authorization);
+                const int code = http.POST((uint8_t *)data, length);
+                http.end();
+                return code > 0;
+        }
+        void setCommandHandler(ZiLinkCommandFn) {}
+
+private:
+        char _url[ZILINK_URL_BYTES];
+        uint8_t _prefixLen = 0; // 0: the URL did not fit
+        String _authorization;
+};
+
+#endif
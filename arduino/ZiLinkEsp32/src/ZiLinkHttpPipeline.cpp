@@ -0,0 +1,618 @@
+#include "ZiLinkHttpPipeline.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char BATCH_OPEN[] = "{\"batch\":[";
+static const char BATCH_CLOSE[] = "]}";
+
+// Gathers the pieces of a request into as few socket writes as possible
+struct RequestWriter
+{
+  explicit RequestWriter(Client &client) : client(client) {}
+
+  void put(const char *data, size_t length)
+  {
+    if (used + length > sizeof(buf))
+    {
+      flush();
+    }
+    if (length > sizeof(buf))
+    {
+      ok = ok && client.write((const uint8_t *)data, length) == length;
+      return;
+    }
+    memcpy(buf + used, data, length);
+    used += length;
+  }
+
+  bool flush()
+  {
+    if (used)
+    {
+      ok = ok && client.write(buf, used) == used;
+      used = 0;
+    }
+    return ok;
+  }
+
+  Client &client;
+  uint8_t buf[ZILINK_HTTP_WRITE_BYTES];
+  size_t used = 0;
+  bool ok = true;
+};
+
+const char *ZiLinkHttpPipeline::pathOf(Kind kind)
+{
+  switch (kind)
+  {
+  case Data:
+    return "/data";
+  case Status:
+    return "/status";
+  case Components:
+    return "/components";
+  }
+  return "";
+}
+
+bool ZiLinkHttpPipeline::begin(const char *baseUrl, const char *deviceId, const char *token, const Config &config)
+{
+  close();
+  _config = config;
+  if (_config.depth == 0)
+  {
+    _config.depth = 1;
+  }
+  if (_config.depth > ZILINK_HTTP_MAX_DEPTH)
+  {
+    _config.depth = ZILINK_HTTP_MAX_DEPTH;
+  }
+  if (_config.batchMax > ZILINK_HTTP_MAX_BATCH)
+  {
+    _config.batchMax = ZILINK_HTTP_MAX_BATCH;
+  }
+
+  const char *u = baseUrl;
+  if (strncmp(u, "http://", 7) == 0)
+  {
+    _tls = false;
+    _port = 80;
+    u += 7;
+  }
+#if defined(ESP32)
+  else if (strncmp(u, "https://", 8) == 0)
+  {
+    _tls = true;
+    _port = 443;
+    u += 8;
+  }
+#endif
+  else
+  {
+    return false;
+  }
+  // scheme://host[:port][/path]
+  const char *path = strchr(u, '/');
+  const char *hostEnd = path ? path : u + strlen(u);
+  const char *colon = (const char *)memchr(u, ':', hostEnd - u);
+  const char *nameEnd = colon ? colon : hostEnd;
+  if (nameEnd == u)
+  {
+    return false;
+  }
+  if (colon)
+  {
+    _port = (uint16_t)atoi(colon + 1);
+  }
+  const String authority = String(u).substring(0, hostEnd - u);
+  _host = authority.substring(0, nameEnd - u);
+  _dns.invalidate();
+
+  size_t pathLength = path ? strlen(path) : 0;
+  while (pathLength && path[pathLength - 1] == '/')
+  {
+    pathLength--;
+  }
+  _requestLine = "POST ";
+  _requestLine += String(path ? path : "").substring(0, pathLength);
+  _requestLine += "/devices/";
+  _requestLine += deviceId;
+  _headers = " HTTP/1.1\r\nHost: ";
+  _headers += authority;
+  _headers += "\r\nAuthorization: Bearer ";
+  _headers += token;
+  _headers += "\r\nContent-Type: application/json\r\nContent-Length: ";
+
+  _attempts = 0;
+  _backoff.reset();
+  return _queue.resize(config.queueBytes);
+}
+
+uint16_t ZiLinkHttpPipeline::post(Kind kind, const char *body, size_t length)
+{
+  const uint16_t id = _nextId;
+  if (!enabled() || !_queue.push(kind, id, body, length))
+  {
+    _stats.rejected++;
+    return 0;
+  }
+  // 0 means "not queued"
+  _nextId = _nextId == 0xFFFF ? 1 : _nextId + 1;
+  _stats.queued++;
+  return id;
+}
+
+void ZiLinkHttpPipeline::service(uint32_t nowMs)
+{
+  if (!enabled())
+  {
+    return;
+  }
+  switch (_state)
+  {
+  case Closed:
+    if (_queue.empty() || WiFi.status() != WL_CONNECTED || !_backoff.due(nowMs) || !open(nowMs) ||
+        _state != Open)
+    {
+      return;
+    }
+    break;
+  case Connecting:
+  {
+    const ZiLinkTcpConnect::Status status = _tcp.poll(nowMs);
+    if (status == ZiLinkTcpConnect::InProgress)
+    {
+      return;
+    }
+    if (status != ZiLinkTcpConnect::Connected)
+    {
+      failed(nowMs, HTTPC_ERROR_CONNECTION_REFUSED);
+      return;
+    }
+    _plain = WiFiClient(_tcp.release());
+    _client = &_plain;
+    _state = Open;
+    _lastIoMs = nowMs;
+    _stats.connects++;
+    _stats.connectMs = nowMs - _attemptMs;
+    break;
+  }
+  case Open:
+    break;
+  }
+
+  read(nowMs);
+  while (_state == Open && _count < _config.depth && writeNext(nowMs))
+  {
+  }
+  if (_state != Open)
+  {
+    return;
+  }
+  if (_count > 0 && nowMs - _lastIoMs >= _config.timeoutMs)
+  {
+    _stats.timeouts++;
+    failed(nowMs, HTTPC_ERROR_READ_TIMEOUT);
+  }
+  else if (_count == 0 && nowMs - _lastIoMs >= _config.idleMs)
+  {
+    close();
+  }
+}
+
+bool ZiLinkHttpPipeline::open(uint32_t nowMs)
+{
+#if defined(ESP32)
+  if (_tls)
+  {
+    // The handshake blocks, once per connection. Without a pinned CA the
+    // chain is not validated; a fingerprint is checked once it is done.
+    if (_config.caCert)
+    {
+      _secure.setCACert(_config.caCert);
+    }
+    else
+    {
+      _secure.setInsecure();
+    }
+    if (!_secure.connect(_host.c_str(), _port, (int32_t)_config.timeoutMs) ||
+        (_config.fingerprint && !_secure.verify(_config.fingerprint, _host.c_str())))
+    {
+      _secure.stop();
+      failed(nowMs, HTTPC_ERROR_CONNECTION_REFUSED);
+      return false;
+    }
+    _client = &_secure;
+    _state = Open;
+    _lastIoMs = millis();
+    _stats.connects++;
+    _stats.connectMs = _lastIoMs - nowMs;
+    return true;
+  }
+#endif
+  _attemptMs = nowMs;
+  uint32_t ip;
+  if (!_dns.resolve(_host.c_str(), ip, nowMs))
+  {
+    failed(nowMs, HTTPC_ERROR_CONNECTION_REFUSED);
+    return false;
+  }
+  if (!_tcp.start(ip, _port, _config.timeoutMs, nowMs))
+  {
+    failed(nowMs, HTTPC_ERROR_CONNECTION_REFUSED);
+    return false;
+  }
+  _state = Connecting;
+  return true;
+}
+
+void ZiLinkHttpPipeline::close()
+{
+  _tcp.cancel();
+  if (_client)
+  {
+    _client->stop();
+    _client = nullptr;
+  }
+  _state = Closed;
+  // Whatever was in flight goes out again on the next connection
+  _first = 0;
+  _count = 0;
+  _sentRecords = 0;
+  _parse = StatusLine;
+  _lineLength = 0;
+}
+
+void ZiLinkHttpPipeline::failed(uint32_t nowMs, int error)
+{
+  close();
+  _stats.failures++;
+  if (_onResult)
+  {
+    _onResult(_resultCtx, error, 0, 0);
+  }
+  // Resolve the name again every few failures in case the server moved
+  if (_backoff.failures() % 4 == 3)
+  {
+    _dns.invalidate();
+  }
+  _backoff.fail(nowMs);
+  if (_config.maxAttempts && ++_attempts >= _config.maxAttempts)
+  {
+    _attempts = 0;
+    _stats.gaveUp++;
+    finish(1, error);
+  }
+}
+
+bool ZiLinkHttpPipeline::writeNext(uint32_t nowMs)
+{
+  // The oldest records not yet in flight: one request, or a run of
+  // readings that fits one batch
+  const bool batching = _config.batchMax > 1;
+  size_t skip = _sentRecords;
+  uint8_t kind = Data;
+  uint8_t records = 0;
+  size_t bodyBytes = 0;
+  bool full = false;
+  _queue.drain([&](const ZiLinkRingBuffer::Record &r)
+               {
+    if (full)
+    {
+      return false;
+    }
+    if (skip)
+    {
+      skip--;
+      return false;
+    }
+    if (records == 0)
+    {
+      kind = r.channel;
+      records = 1;
+      bodyBytes = r.length;
+      return false;
+    }
+    const size_t batchBytes = sizeof(BATCH_OPEN) - 1 + bodyBytes + 1 + r.length + sizeof(BATCH_CLOSE) - 1;
+    if (batching && kind == Data && r.channel == Data && records < _config.batchMax &&
+        batchBytes <= _config.batchBytes)
+    {
+      records++;
+      bodyBytes += 1 + r.length;
+      return false;
+    }
+    full = true;
+    return false; });
+  if (records == 0)
+  {
+    return false;
+  }
+
+  const bool batch = records > 1;
+  const size_t contentLength = batch ? sizeof(BATCH_OPEN) - 1 + bodyBytes + sizeof(BATCH_CLOSE) - 1 : bodyBytes;
+  const char *path = batch ? "/batch-data" : pathOf((Kind)kind);
+  char length[20];
+  const int n = snprintf(length, sizeof(length), "%u\r\n\r\n", (unsigned)contentLength);
+
+  RequestWriter out(*_client);
+  out.put(_requestLine.c_str(), _requestLine.length());
+  out.put(path, strlen(path));
+  out.put(_headers.c_str(), _headers.length());
+  out.put(length, (size_t)n);
+  if (batch)
+  {
+    out.put(BATCH_OPEN, sizeof(BATCH_OPEN) - 1);
+  }
+  skip = _sentRecords;
+  uint8_t left = records;
+  _queue.drain([&](const ZiLinkRingBuffer::Record &r)
+               {
+    if (skip)
+    {
+      skip--;
+      return false;
+    }
+    if (left == 0)
+    {
+      return false;
+    }
+    if (left-- != records)
+    {
+      out.put(",", 1);
+    }
+    out.put(r.data, r.length);
+    return false; });
+  if (batch)
+  {
+    out.put(BATCH_CLOSE, sizeof(BATCH_CLOSE) - 1);
+  }
+  if (!out.flush())
+  {
+    failed(nowMs, HTTPC_ERROR_SEND_PAYLOAD_FAILED);
+    return false;
+  }
+
+  Request &q = _inflight[(_first + _count) % ZILINK_HTTP_MAX_DEPTH];
+  q.records = records;
+  q.bytes = (uint32_t)contentLength;
+  q.sentUs = micros();
+  _count++;
+  _sentRecords += records;
+  _lastIoMs = nowMs;
+  _stats.requests++;
+  if (batch)
+  {
+    _stats.batched += records;
+  }
+  return true;
+}
+
+void ZiLinkHttpPipeline::read(uint32_t nowMs)
+{
+  if (_state != Open)
+  {
+    return;
+  }
+  uint8_t buf[128];
+  while (_state == Open && _client->available() > 0)
+  {
+    const int n = _client->read(buf, sizeof(buf));
+    if (n <= 0)
+    {
+      break;
+    }
+    _lastIoMs = nowMs;
+    size_t at = 0;
+    while (at < (size_t)n && _state == Open)
+    {
+      at += feed(buf + at, (size_t)n - at);
+    }
+  }
+  if (_state != Open || _client->connected())
+  {
+    return;
+  }
+  if (_parse == UntilClose)
+  {
+    // A response without a length ends with the connection
+    complete();
+    close();
+  }
+  else if (_count > 0)
+  {
+    failed(nowMs, HTTPC_ERROR_CONNECTION_LOST);
+  }
+  else
+  {
+    close();
+  }
+}
+
+size_t ZiLinkHttpPipeline::feed(const uint8_t *data, size_t length)
+{
+  switch (_parse)
+  {
+  case Body:
+  case ChunkData:
+  {
+    // Response bodies are not needed, only skipped
+    const size_t n = length < _remaining ? length : _remaining;
+    _remaining -= n;
+    if (_remaining == 0)
+    {
+      if (_parse == Body)
+      {
+        complete();
+      }
+      else
+      {
+        _parse = ChunkEnd;
+      }
+    }
+    return n;
+  }
+  case UntilClose:
+    return length;
+  default:
+    break;
+  }
+  // Status line, headers and chunk sizes, a byte at a time; only the
+  // start of a long line is kept
+  const char c = (char)data[0];
+  if (c == '\n')
+  {
+    _line[_lineLength] = 0;
+    line();
+    _lineLength = 0;
+  }
+  else if (c != '\r' && _lineLength < sizeof(_line) - 1)
+  {
+    _line[_lineLength++] = (char)tolower((unsigned char)c);
+  }
+  return 1;
+}
+
+void ZiLinkHttpPipeline::line()
+{
+  switch (_parse)
+  {
+  case StatusLine:
+  {
+    // "http/1.1 201 created"
+    const char *space = strchr(_line, ' ');
+    if (!space)
+    {
+      return;
+    }
+    _status = atoi(space + 1);
+    _contentLength = -1;
+    _chunked = false;
+    _closeAfter = false;
+    _parse = Headers;
+    break;
+  }
+  case Headers:
+    if (_lineLength > 0)
+    {
+      if (strncmp(_line, "content-length:", 15) == 0)
+      {
+        _contentLength = atol(_line + 15);
+      }
+      else if (strncmp(_line, "transfer-encoding:", 18) == 0)
+      {
+        _chunked = strstr(_line + 18, "chunked") != nullptr;
+      }
+      else if (strncmp(_line, "connection:", 11) == 0)
+      {
+        _closeAfter = strstr(_line + 11, "close") != nullptr;
+      }
+    }
+    else if (_status < 200)
+    {
+      // 100 Continue and friends: the real response follows
+      _parse = StatusLine;
+    }
+    else if (_chunked)
+    {
+      _parse = ChunkSize;
+    }
+    else if (_contentLength > 0)
+    {
+      _remaining = (uint32_t)_contentLength;
+      _parse = Body;
+    }
+    else if (_contentLength == 0 || _status == 204 || _status == 304)
+    {
+      complete();
+    }
+    else
+    {
+      _parse = UntilClose;
+    }
+    break;
+  case ChunkSize:
+  {
+    const uint32_t size = strtoul(_line, nullptr, 16);
+    if (size == 0)
+    {
+      _parse = Trailer;
+    }
+    else
+    {
+      _remaining = size;
+      _parse = ChunkData;
+    }
+    break;
+  }
+  case ChunkEnd:
+    _parse = ChunkSize;
+    break;
+  case Trailer:
+    if (_lineLength == 0)
+    {
+      complete();
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+void ZiLinkHttpPipeline::complete()
+{
+  _parse = StatusLine;
+  if (_count == 0)
+  {
+    // Nothing was asked for
+    return;
+  }
+  const Request q = _inflight[_first];
+  _first = (_first + 1) % ZILINK_HTTP_MAX_DEPTH;
+  _count--;
+  _sentRecords -= q.records;
+  const uint32_t us = micros() - q.sentUs;
+  _stats.responses++;
+  if (_status < 200 || _status > 299)
+  {
+    _stats.errors++;
+  }
+  _stats.responseUs.record(us);
+  _attempts = 0;
+  _backoff.reset();
+  if (_onResult)
+  {
+    _onResult(_resultCtx, _status, q.bytes, us);
+  }
+  finish(q.records, _status);
+  if (_closeAfter)
+  {
+    close();
+  }
+}
+
+void ZiLinkHttpPipeline::finish(uint8_t records, int status)
+{
+  // In flight and given-up records lead the queue. Callbacks run once it
+  // is consistent again, so they may post().
+  uint16_t ids[ZILINK_HTTP_MAX_BATCH > 1 ? ZILINK_HTTP_MAX_BATCH : 1];
+  uint8_t n = 0;
+  _queue.drain([&](const ZiLinkRingBuffer::Record &r)
+               {
+    if (n < sizeof(ids) / sizeof(ids[0]))
+    {
+      ids[n++] = r.key;
+    }
+    return true; },
+               records);
+  if (!_done)
+  {
+    return;
+  }
+  for (uint8_t i = 0; i < n; i++)
+  {
+    _done(ids[i], status);
+  }
+}
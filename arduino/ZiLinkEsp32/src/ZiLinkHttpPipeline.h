@@ -0,0 +1,205 @@
+#ifndef ZILINK_HTTP_PIPELINE_H
+#define ZILINK_HTTP_PIPELINE_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include "ZiLinkBackoff.h"
+#include "ZiLinkDnsCache.h"
+#include "ZiLinkRingBuffer.h"
+#include "ZiLinkStats.h"
+#include "ZiLinkTcpConnect.h"
+
+#if defined(ESP32)
+#include <WiFiClientSecure.h>
+#endif
+
+// Requests written before the first response comes back, at most
+#ifndef ZILINK_HTTP_MAX_DEPTH
+#define ZILINK_HTTP_MAX_DEPTH 8
+#endif
+
+// Readings in one POST to /batch-data, at most
+#ifndef ZILINK_HTTP_MAX_BATCH
+#define ZILINK_HTTP_MAX_BATCH 32
+#endif
+
+// Request line, headers and body are gathered into one socket write of up
+// to this many bytes (stack); larger bodies are written on their own
+#ifndef ZILINK_HTTP_WRITE_BYTES
+#define ZILINK_HTTP_WRITE_BYTES 512
+#endif
+
+// Asynchronous HTTP POSTs over one keep-alive connection. post() copies the
+// body into a queue and returns at once; service(), called from loop(),
+// connects without blocking, writes up to `depth` requests ahead of their
+// responses (HTTP/1.1 pipelining; 1 waits for each), and reads responses as
+// their bytes arrive. Every request is reported to onDone() with its status
+// code. Network failures (refused, reset, timed out) are retried on a new
+// connection after a backoff; a response of any status completes the
+// request.
+//
+// The request line prefix and the headers (Host, Authorization,
+// Content-Type) are built once in begin(), so a small request is a single
+// write. With batchMax > 1, consecutive readings go out as one
+// POST to /batch-data: {"batch":[<reading>,<reading>,...]}.
+//
+// https:// base URLs use WiFiClientSecure (ESP32 only), whose TLS handshake
+// blocks; it happens once per connection instead of once per request. The
+// server's address is cached (ZiLinkDnsCache) across reconnects.
+class ZiLinkHttpPipeline
+{
+public:
+        enum Kind : uint8_t
+        {
+                Data,       // /data
+                Status,     // /status
+                Components, // /components
+        };
+
+        struct Config
+        {
+                size_t queueBytes = 4096;  // bodies waiting or in flight, 6 bytes of overhead each
+                uint8_t depth = 1;         // requests in flight on the connection, up to ZILINK_HTTP_MAX_DEPTH
+                uint8_t batchMax = 0;      // readings per POST to /batch-data, up to ZILINK_HTTP_MAX_BATCH; 0: one per /data
+                size_t batchBytes = 4096;  // body of a batch, at most
+                uint32_t timeoutMs = 5000; // connect, and waiting for a response
+                uint32_t idleMs = 4000;    // closed when unused this long (before the server's keep-alive timeout)
+                uint8_t maxAttempts = 0;   // failed connections before a request is given up; 0 retries until answered
+                // https:// only: pinned CA (PEM) or SHA-256 certificate fingerprint; neither encrypts without authenticating
+                const char *caCert = nullptr;
+                const char *fingerprint = nullptr;
+        };
+
+        // status: the HTTP status code, or HTTPC_ERROR_* once a request was
+        // given up after maxAttempts network failures
+        typedef std::function<void(uint16_t id, int status)> DoneFn;
+
+        struct Stats
+        {
+                uint32_t queued = 0;
+                uint32_t rejected = 0;    // queue full (or body too large)
+                uint32_t requests = 0;    // written, retries included
+                uint32_t batched = 0;     // readings sent in batches
+                uint32_t responses = 0;   // of any status
+                uint32_t errors = 0;      // responses outside 2xx
+                uint32_t connects = 0;
+                uint32_t failures = 0;    // connections that failed or broke with requests in flight
+                uint32_t timeouts = 0;
+                uint32_t gaveUp = 0;
+                uint32_t connectMs = 0;   // attempt started -> connected (DNS, TCP, TLS), last connection
+                ZiLinkHistogram responseUs; // request written -> response complete
+        };
+
+        // Parses `baseUrl` (http:// or https://, optionally with a path) and
+        // builds the request headers. Returns false for an unsupported URL
+        // or when the queue cannot be allocated.
+        bool begin(const char *baseUrl, const char *deviceId, const char *token, const Config &config);
+        bool enabled() const { return _queue.capacity() > 0; }
+        void onDone(DoneFn fn) { _done = fn; }
+        // Every response and failure, for transport statistics
+        void onResult(void (*fn)(void *ctx, int status, size_t bytes, uint32_t us), void *ctx)
+        {
+                _onResult = fn;
+                _resultCtx = ctx;
+        }
+
+        // Queues a POST of `body` to the path for `kind`. Returns its id
+        // (1..65535, wrapping), or 0 when the queue is full.
+        uint16_t post(Kind kind, const char *body, size_t length);
+        void service(uint32_t nowMs);
+
+        // Requests queued or in flight
+        size_t pending() const { return _queue.records(); }
+        bool connected() const { return _state == Open; }
+        const Stats &stats() const { return _stats; }
+
+        static const char *pathOf(Kind kind);
+
+private:
+        enum State : uint8_t
+        {
+                Closed,
+                Connecting,
+                Open
+        };
+
+        // Response parser
+        enum Parse : uint8_t
+        {
+                StatusLine,
+                Headers,
+                Body,
+                ChunkSize,
+                ChunkData,
+                ChunkEnd,
+                Trailer,
+                UntilClose
+        };
+
+        struct Request
+        {
+                uint8_t records;
+                uint32_t bytes;
+                uint32_t sentUs;
+        };
+
+        bool open(uint32_t nowMs);
+        void close();
+        void failed(uint32_t nowMs, int error);
+        bool writeNext(uint32_t nowMs);
+        void read(uint32_t nowMs);
+        size_t feed(const uint8_t *data, size_t length);
+        void line();
+        void complete();
+        void finish(uint8_t records, int status);
+
+        ZiLinkRingBuffer _queue{0, ZiLinkRingBuffer::DropNewest};
+        Config _config;
+        DoneFn _done;
+        void (*_onResult)(void *, int, size_t, uint32_t) = nullptr;
+        void *_resultCtx = nullptr;
+        Stats _stats;
+
+        // Connection
+        String _host;
+        uint16_t _port = 80;
+        bool _tls = false;
+        ZiLinkDnsCache _dns;
+        uint32_t _attemptMs = 0;
+        State _state = Closed;
+        ZiLinkTcpConnect _tcp;
+        ZiLinkBackoff _backoff{250, 30000};
+        WiFiClient _plain;
+#if defined(ESP32)
+        WiFiClientSecure _secure;
+#endif
+        Client *_client = nullptr;
+        uint32_t _lastIoMs = 0;
+        uint8_t _attempts = 0; // failed connections since the oldest request was last answered
+
+        // Precomputed "POST <path>/devices/<id>" and the headers up to Content-Length
+        String _requestLine;
+        String _headers;
+        uint16_t _nextId = 1;
+
+        // Requests in flight, oldest first; their records lead the queue
+        Request _inflight[ZILINK_HTTP_MAX_DEPTH];
+        uint8_t _first = 0;
+        uint8_t _count = 0;
+        size_t _sentRecords = 0;
+
+        Parse _parse = StatusLine;
+        char _line[48];
+        uint8_t _lineLength = 0;
+        int _status = 0;
+        int32_t _contentLength = -1;
+        bool _chunked = false;
+        bool _closeAfter = false;
+        uint32_t _remaining = 0;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#include "ZiLinkInbound.h"
+
+#include "ZiLinkCommandQueue.h"
+
+#include <string.h>
+
+ZiLinkInbound::ZiLinkInbound()
+{
+  _filter["type"] = true;
+  JsonObject data = _filter.createNestedObject("data");
+  data["command"] = true;
+  data["error"] = true;
+  data["encoding"] = true;
+  data["seq"] = true;
+  data["trace"] = true;
+  data["at"] = true;
+  data["id"] = true;
+  data["until"] = true;
+  data["rate"] = true;
+  data["burst"] = true;
+  data["credit"] = true;
+  data["ttl"] = true;
+  data["ch"] = true;
+  data["msg"] = true;
+  data["accepted"] = true;
+  data["rejected"] = true;
+}
+
+ZiLinkInbound::Type ZiLinkInbound::classify(const char *type)
+{
+  if (!type)
+  {
+    return Unknown;
+  }
+  switch (ZiLinkCommandQueue::hash(type, strlen(type)))
+  {
+  case ZiLinkCommandQueue::hashOf("auth_success"):
+    return AuthSuccess;
+  case ZiLinkCommandQueue::hashOf("ack"):
+    return Ack;
+  case ZiLinkCommandQueue::hashOf("error"):
+    return Error;
+  case ZiLinkCommandQueue::hashOf("command"):
+    return Command;
+  case ZiLinkCommandQueue::hashOf("trace_ack"):
+    return TraceAck;
+  case ZiLinkCommandQueue::hashOf("stream_credit"):
+    return StreamCredit;
+  case ZiLinkCommandQueue::hashOf("throttle"):
+    return Throttle;
+  case ZiLinkCommandQueue::hashOf("gateway_auth_result"):
+    return GatewayAuth;
+  case ZiLinkCommandQueue::hashOf("gw"):
+    return Gateway;
+  }
+  return Unknown;
+}
+
+ZiLinkInbound::Type ZiLinkInbound::parse(char *text, size_t length)
+{
+  // char * input: ArduinoJson's zero-copy mode
+  if (deserializeJson(_doc, text, length, DeserializationOption::Filter(_filter)))
+  {
+    _doc.clear();
+    return Invalid;
+  }
+  return classify(_doc["type"].as<const char *>());
+}
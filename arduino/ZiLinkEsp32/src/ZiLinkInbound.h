@@ -0,0 +1,74 @@
+#ifndef ZILINK_INBOUND_H
+#define ZILINK_INBOUND_H
+
+#include <ArduinoJson.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Capacity of the document reused for every server message. Parsing is
+// zero-copy and filtered, so it only holds the few kept members and the
+// structure of a command object, not the strings.
+#ifndef ZILINK_INBOUND_DOC_SIZE
+#define ZILINK_INBOUND_DOC_SIZE 384
+#endif
+
+// Parser for JSON messages from the server (WebSocket text frames and MQTT
+// payloads). The text is parsed in place, strings point into it, and only
+// type and data.command/error/encoding/seq/trace/at/id/until, the
+// throttle fields (rate/burst/credit/ttl) and the gateway fields
+// (ch/msg/accepted/rejected) are kept; no heap allocation per message.
+class ZiLinkInbound
+{
+public:
+        enum Type : uint8_t
+        {
+                Invalid, // not JSON, or larger than the document
+                Unknown,
+                AuthSuccess,
+                Ack,
+                Error,
+                Command,
+                TraceAck,
+                StreamCredit,
+                Throttle,
+                GatewayAuth, // gateway_auth_result
+                Gateway      // gw: a message for a sub-device
+        };
+
+        ZiLinkInbound();
+
+        // `text` is modified and must outlive the accessors below
+        Type parse(char *text, size_t length);
+
+        JsonVariantConst command() const { return _doc["data"]["command"]; }
+        const char *error() const { return _doc["data"]["error"] | "unknown"; }
+        const char *encoding() const { return _doc["data"]["encoding"]; }
+        uint32_t seq() const { return _doc["data"]["seq"].as<uint32_t>(); }
+        // trace_ack: the frame's [n, deviceMs] and the server clock
+        uint32_t traceSeq() const { return _doc["data"]["trace"][0].as<uint32_t>(); }
+        uint32_t traceMs() const { return _doc["data"]["trace"][1].as<uint32_t>(); }
+        uint32_t serverMs() const { return _doc["data"]["at"].as<uint32_t>(); }
+        // stream_credit: chunks of stream `id` with a sequence number below `until` may go
+        uint8_t streamId() const { return _doc["data"]["id"].as<uint8_t>(); }
+        uint32_t streamUntil() const { return _doc["data"]["until"].as<uint32_t>(); }
+        // throttle: frames per second (0 lifts), burst, extra credit in frames, ms until it lapses
+        float throttleRate() const { return _doc["data"]["rate"].as<float>(); }
+        uint16_t throttleBurst() const { return _doc["data"]["burst"].as<uint16_t>(); }
+        uint32_t throttleCredit() const { return _doc["data"]["credit"].as<uint32_t>(); }
+        uint32_t throttleTtlMs() const { return _doc["data"]["ttl"].as<uint32_t>(); }
+        // gateway_auth_result: channels the server accepted and rejected
+        JsonArrayConst gatewayAccepted() const { return _doc["data"]["accepted"]; }
+        JsonArrayConst gatewayRejected() const { return _doc["data"]["rejected"]; }
+        // gw: the sub-device's channel and the message for it, as JSON text
+        uint8_t gatewayChannel() const { return _doc["data"]["ch"].as<uint8_t>(); }
+        const char *gatewayMessage() const { return _doc["data"]["msg"]; }
+
+        // Message type by hash, no string compare chain
+        static Type classify(const char *type);
+
+private:
+        StaticJsonDocument<ZILINK_INBOUND_DOC_SIZE> _doc;
+        StaticJsonDocument<256> _filter;
+};
+
+#endif
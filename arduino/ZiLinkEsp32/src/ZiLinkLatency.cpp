@@ -0,0 +1,119 @@
+#include "ZiLinkLatency.h"
+
+ZiLinkLatency::Trace ZiLinkLatency::start(uint32_t nowMs, uint32_t nowUs)
+{
+  Trace trace = {0, nowMs};
+  if (!_enabled)
+  {
+    return trace;
+  }
+  // 0 means "not traced", so skip it when the counter wraps
+  if (++_next == 0)
+  {
+    _next = 1;
+  }
+  trace.seq = _next;
+  const uint32_t slot = _next & (ZILINK_LATENCY_SLOTS - 1);
+  _sentSeq[slot] = _next;
+  _sentUs[slot] = nowUs;
+  _stats.traced++;
+  return trace;
+}
+
+bool ZiLinkLatency::finish(const Trace &trace, bool sent)
+{
+  if (trace.seq && !sent)
+  {
+    // Only the latest number can be taken back without leaving a gap
+    if (trace.seq == _next)
+    {
+      _sentSeq[_next & (ZILINK_LATENCY_SLOTS - 1)] = 0;
+      _next--;
+    }
+    _stats.traced--;
+  }
+  return sent;
+}
+
+void ZiLinkLatency::classify(uint32_t seq)
+{
+  const int32_t ahead = (int32_t)(seq - _highest);
+  if (ahead > 0)
+  {
+    _stats.missing += (uint32_t)ahead - 1;
+    _seen = ahead >= 32 ? 1 : (_seen << ahead) | 1;
+    _highest = seq;
+    return;
+  }
+  const uint32_t behind = (uint32_t)-ahead;
+  if (behind >= 32)
+  {
+    _stats.stale++;
+    return;
+  }
+  const uint32_t bit = 1u << behind;
+  if (_seen & bit)
+  {
+    _stats.duplicates++;
+    return;
+  }
+  _seen |= bit;
+  _stats.reordered++;
+  if (_stats.missing)
+  {
+    _stats.missing--;
+  }
+}
+
+void ZiLinkLatency::acked(uint32_t seq, uint32_t deviceMs, uint32_t serverMs, uint32_t nowMs, uint32_t nowUs)
+{
+  if (seq == 0)
+  {
+    return;
+  }
+  _stats.acked++;
+  classify(seq);
+
+  const uint32_t slot = seq & (ZILINK_LATENCY_SLOTS - 1);
+  const uint32_t rttUs = _sentSeq[slot] == seq ? nowUs - _sentUs[slot] : (nowMs - deviceMs) * 1000u;
+  _rttUs.record(rttUs);
+
+  // Offset if this round trip had been symmetric
+  const int32_t offsetMs = (int32_t)(serverMs - deviceMs) - (int32_t)(rttUs / 2000);
+  if (_windowAcks == 0 || rttUs < _windowMinRttUs)
+  {
+    _windowMinRttUs = rttUs;
+    _windowOffsetMs = offsetMs;
+  }
+  if (!_haveOffset || rttUs < _stats.minRttUs)
+  {
+    // A faster round trip improves the estimate right away
+    _haveOffset = true;
+    _offsetMs = offsetMs;
+    _stats.minRttUs = rttUs;
+  }
+  if (++_windowAcks >= ZILINK_LATENCY_WINDOW)
+  {
+    // Start over from this window's floor so drift does not build up
+    _offsetMs = _windowOffsetMs;
+    _stats.minRttUs = _windowMinRttUs;
+    _windowAcks = 0;
+  }
+
+  const int32_t uplink = (int32_t)(serverMs - deviceMs) - _offsetMs;
+  const int32_t rttMs = (int32_t)(rttUs / 1000);
+  const int32_t downlink = rttMs - uplink;
+  _uplinkMs.record(uplink > 0 ? (uint32_t)uplink : 0);
+  _downlinkMs.record(downlink > 0 ? (uint32_t)downlink : 0);
+}
+
+void ZiLinkLatency::reset()
+{
+  // Numbering, the ack window and the offset estimate carry on
+  _rttUs.reset();
+  _uplinkMs.reset();
+  _downlinkMs.reset();
+  const uint32_t minRttUs = _stats.minRttUs;
+  _stats = Stats();
+  _stats.minRttUs = minRttUs;
+}
@@ -0,0 +1,96 @@
+#ifndef ZILINK_LATENCY_H
+#define ZILINK_LATENCY_H
+
+#include "ZiLinkStats.h"
+
+// Traced frames whose send time is kept for a microsecond RTT (power of
+// two); older acks fall back to the millisecond timestamp in the frame
+#ifndef ZILINK_LATENCY_SLOTS
+#define ZILINK_LATENCY_SLOTS 32
+#endif
+
+// Acks per clock offset estimate, so crystal drift does not accumulate
+#ifndef ZILINK_LATENCY_WINDOW
+#define ZILINK_LATENCY_WINDOW 256
+#endif
+
+// End-to-end latency of traced frames. A traced frame carries
+// "trace":[n, deviceMs] with n counting up from 1; the server echoes it in
+// trace_ack together with its own clock ("at", ms modulo 2^32).
+//
+// RTT needs only the device clock. The one-way split needs the offset
+// between the clocks, estimated NTP-style from the fastest round trip in
+// each window of ZILINK_LATENCY_WINDOW acks (half of it each way). One-way
+// delays are therefore relative to that floor: they show where queueing
+// happens (uplink vs downlink), not an absolute split of an asymmetric
+// path.
+//
+// Gaps and reordering come from the sequence numbers of the acks, over a
+// 32-ack window: an ack that skips numbers counts them as missing, one
+// arriving below the highest seen counts as reordered (and is no longer
+// missing), one seen before counts as a duplicate. Fixed memory, no
+// allocation; all calls from the context that owns the WebSocket.
+class ZiLinkLatency
+{
+public:
+        struct Trace
+        {
+                uint32_t seq; // 0: not traced
+                uint32_t deviceMs;
+        };
+
+        struct Stats
+        {
+                uint32_t traced = 0; // frames sent with a trace
+                uint32_t acked = 0;
+                uint32_t missing = 0;   // skipped by the acks and not seen since
+                uint32_t reordered = 0; // arrived after a later one
+                uint32_t duplicates = 0;
+                uint32_t stale = 0; // older than the 32-ack window, not classified
+                uint32_t minRttUs = 0; // floor of the current offset estimate
+        };
+
+        void setEnabled(bool enabled) { _enabled = enabled; }
+        bool enabled() const { return _enabled; }
+
+        // Numbers the next frame (seq 0 when disabled) and notes its send time
+        Trace start(uint32_t nowMs, uint32_t nowUs);
+        // Returns `sent`; an unsent frame gives its number back
+        bool finish(const Trace &trace, bool sent);
+        void acked(uint32_t seq, uint32_t deviceMs, uint32_t serverMs, uint32_t nowMs, uint32_t nowUs);
+
+        const ZiLinkHistogram &rttUs() const { return _rttUs; }
+        const ZiLinkHistogram &uplinkMs() const { return _uplinkMs; }
+        const ZiLinkHistogram &downlinkMs() const { return _downlinkMs; }
+        const Stats &stats() const { return _stats; }
+        // Clears the histograms and counters
+        void reset();
+
+private:
+        static_assert((ZILINK_LATENCY_SLOTS & (ZILINK_LATENCY_SLOTS - 1)) == 0, "ZILINK_LATENCY_SLOTS must be a power of two");
+
+        void classify(uint32_t seq);
+
+        bool _enabled = false;
+        uint32_t _next = 0; // last number handed out
+        uint32_t _sentSeq[ZILINK_LATENCY_SLOTS] = {};
+        uint32_t _sentUs[ZILINK_LATENCY_SLOTS] = {};
+
+        // Highest acked number and which of the 32 below it were seen (bit i: highest - i)
+        uint32_t _highest = 0;
+        uint32_t _seen = 1;
+
+        // Server clock minus device clock, from the fastest round trip
+        bool _haveOffset = false;
+        int32_t _offsetMs = 0;
+        uint32_t _windowAcks = 0;
+        uint32_t _windowMinRttUs = 0;
+        int32_t _windowOffsetMs = 0;
+
+        ZiLinkHistogram _rttUs;
+        ZiLinkHistogram _uplinkMs;
+        ZiLinkHistogram _downlinkMs;
+        Stats _stats;
+};
+
+#endif
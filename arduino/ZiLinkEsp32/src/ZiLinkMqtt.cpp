@@ -0,0 +1,94 @@
+#include "ZiLinkMqtt.h"
+
+#include "ZiLinkInbound.h"
+
+ZiLinkMqtt::ZiLinkMqtt(const char *deviceId, const char *token, const Config &config)
+    : _deviceId(deviceId), _token(token), _broker(config.broker), _port(config.port), _mqtt(_wifi)
+{
+  ZiLinkFrameWriter topic(_topic, sizeof(_topic));
+  // Longest suffix ("components") must fit too
+  topic.raw("zilink/devices/").cstr(deviceId).raw("/components");
+  _prefixLen = topic.ok() ? (uint8_t)(topic.length() - 10) : 0;
+}
+
+void ZiLinkMqtt::begin()
+{
+  if (_prefixLen == 0)
+  {
+    Serial.printf("[%s] Device id too long for ZILINK_TOPIC_BYTES\n", _deviceId);
+    return;
+  }
+  _mqtt.setServer(_broker, _port);
+  _mqtt.setSocketTimeout(ZILINK_MQTT_HANDSHAKE_TIMEOUT_S);
+  _mqtt.setCallback([this](char *, uint8_t *payload, unsigned int length)
+                    {
+    ZiLinkInbound inbound;
+    if (_onCommand && inbound.parse((char *)payload, length) == ZiLinkInbound::Command) {
+      zilinkCommand(inbound.command(), _onCommand);
+    } });
+}
+
+void ZiLinkMqtt::loop(uint32_t nowMs)
+{
+  if (_prefixLen == 0)
+  {
+    return;
+  }
+  if (_connected)
+  {
+    if (!_mqtt.loop())
+    {
+      _connected = false;
+      failed(nowMs);
+    }
+    return;
+  }
+  if (!_connecting)
+  {
+    if (!_backoff.due(nowMs) || WiFi.status() != WL_CONNECTED)
+    {
+      return;
+    }
+    if ((_ip == 0 && !ZiLinkTcpConnect::resolve(_broker, _ip)) || !_tcp.start(_ip, _port, ZILINK_MQTT_CONNECT_TIMEOUT_MS, nowMs))
+    {
+      failed(nowMs);
+      return;
+    }
+    _connecting = true;
+  }
+  const ZiLinkTcpConnect::Status status = _tcp.poll(nowMs);
+  if (status == ZiLinkTcpConnect::InProgress)
+  {
+    return;
+  }
+  _connecting = false;
+  if (status != ZiLinkTcpConnect::Connected)
+  {
+    failed(nowMs);
+    return;
+  }
+  // PubSubClient skips its own blocking TCP connect when the client is already connected
+  _wifi = WiFiClient(_tcp.release());
+  if (!_mqtt.connect(_deviceId, _token, ""))
+  {
+    _wifi.stop();
+    failed(nowMs);
+    return;
+  }
+  strcpy(_topic + _prefixLen, "commands");
+  _mqtt.subscribe(_topic);
+  _backoff.reset();
+  _connected = true;
+}
+
+void ZiLinkMqtt::failed(uint32_t nowMs)
+{
+  _tcp.cancel();
+  _connecting = false;
+  // Resolve the name again every few failures in case the broker moved
+  if (_backoff.failures() % 4 == 3)
+  {
+    _ip = 0;
+  }
+  _backoff.fail(nowMs);
+}
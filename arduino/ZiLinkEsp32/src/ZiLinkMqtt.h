@@ -0,0 +1,70 @@
+#ifndef ZILINK_MQTT_H
+#define ZILINK_MQTT_H
+
+#include <WiFi.h>
+#include <PubSubClient.h>
+#include "ZiLink.h"
+#include "ZiLinkBackoff.h"
+#include "ZiLinkMqttPublish.h"
+#include "ZiLinkTcpConnect.h"
+
+// Room for "zilink/devices/<id>/components"
+#ifndef ZILINK_TOPIC_BYTES
+#define ZILINK_TOPIC_BYTES 80
+#endif
+
+#ifndef ZILINK_MQTT_CONNECT_TIMEOUT_MS
+#define ZILINK_MQTT_CONNECT_TIMEOUT_MS 5000
+#endif
+
+#ifndef ZILINK_MQTT_HANDSHAKE_TIMEOUT_S
+#define ZILINK_MQTT_HANDSHAKE_TIMEOUT_S 2
+#endif
+
+// MQTT transport for ZiLink<...>: publishes to zilink/devices/<id>/data,
+// /status and /components and receives /commands. Connects from loop()
+// without blocking on TCP and backs off between attempts like ZiLinkEsp32.
+class ZiLinkMqtt
+{
+public:
+        struct Config
+        {
+                Config(const char *broker, uint16_t port = 1883) : broker(broker), port(port) {}
+                const char *broker;
+                uint16_t port;
+        };
+
+        ZiLinkMqtt(const char *deviceId, const char *token, const Config &config);
+
+        void begin();
+        void loop(uint32_t nowMs);
+        bool ready() { return _connected; }
+        bool send(ZiLinkKind kind, const char *data, size_t length)
+        {
+                // Only the suffix changes; the prefix was written in the constructor
+                strcpy(_topic + _prefixLen, kind == ZiLinkData ? "data" : kind == ZiLinkStatus ? "status" : "components");
+                return zilinkMqttPublish(_mqtt, _wifi, _topic, data, length);
+        }
+        void setCommandHandler(ZiLinkCommandFn fn) { _onCommand = fn; }
+        PubSubClient &client() { return _mqtt; }
+
+private:
+        void failed(uint32_t nowMs);
+
+        const char *_deviceId;
+        const char *_token;
+        const char *_broker;
+        uint16_t _port;
+        char _topic[ZILINK_TOPIC_BYTES];
+        uint8_t _prefixLen = 0; // 0: the device id did not fit
+        bool _connected = false;
+        bool _connecting = false;
+        uint32_t _ip = 0;
+        WiFiClient _wifi;
+        PubSubClient _mqtt;
+        ZiLinkBackoff _backoff;
+        ZiLinkTcpConnect _tcp;
+        ZiLinkCommandFn _onCommand = nullptr;
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef ZILINK_MQTT_PUBLISH_H
+#define ZILINK_MQTT_PUBLISH_H
+
+#include <PubSubClient.h>
+#include <string.h>
+
+// QoS 0 PUBLISH of any size through PubSubClient. publish() builds the
+// whole packet in the client's buffer (MQTT_MAX_PACKET_SIZE, 256 bytes by
+// default) and refuses anything larger. A message that fits still goes that
+// way, in one write; a larger one is streamed instead: beginPublish() sends
+// the header and topic, then the payload is written straight from the
+// caller's memory (frame writer, batch buffer) to the socket. No buffer
+// grows, so the size is bounded by the network and not by RAM.
+//
+// A payload written only in part leaves the connection in the middle of a
+// packet the broker can no longer parse, so `socket` is closed and the
+// client reconnects; the message reports failure.
+inline bool zilinkMqttPublish(PubSubClient &mqtt, Client &socket, const char *topic, const char *payload,
+                              size_t length)
+{
+        // Fixed header (up to 5 bytes) and the length-prefixed topic
+        const size_t packet = 5 + 2 + strlen(topic) + length;
+        if (packet <= mqtt.getBufferSize())
+        {
+                return mqtt.publish(topic, (const uint8_t *)payload, length);
+        }
+        if (!mqtt.beginPublish(topic, length, false))
+        {
+                return false;
+        }
+        if (mqtt.write((const uint8_t *)payload, length) != length)
+        {
+                socket.stop();
+                return false;
+        }
+        return mqtt.endPublish() == 1;
+}
+
+#endif
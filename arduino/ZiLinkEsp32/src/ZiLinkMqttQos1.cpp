@@ -0,0 +1,180 @@
+#include "ZiLinkMqttQos1.h"
+
+#include <string.h>
+
+bool ZiLinkMqttQos1::begin(const Config &config)
+{
+  _config = config;
+  if (_config.window == 0)
+  {
+    _config.window = 1;
+  }
+  if (_config.window > ZILINK_MQTT_MAX_INFLIGHT)
+  {
+    _config.window = ZILINK_MQTT_MAX_INFLIGHT;
+  }
+  memset(_slots, 0, sizeof(_slots));
+  _inflight = 0;
+  return _store.resize(config.storeBytes);
+}
+
+uint16_t ZiLinkMqttQos1::publish(uint8_t topic, const char *payload, size_t length)
+{
+  const uint16_t id = _nextId;
+  if (!_store.push(topic, id, payload, length))
+  {
+    _stats.rejected++;
+    return 0;
+  }
+  // 0 is not a valid packet id
+  _nextId = _nextId == 0xFFFF ? 1 : _nextId + 1;
+  _stats.queued++;
+  return id;
+}
+
+ZiLinkMqttQos1::Slot *ZiLinkMqttQos1::slotOf(uint16_t id)
+{
+  for (uint8_t i = 0; i < ZILINK_MQTT_MAX_INFLIGHT; i++)
+  {
+    if (_slots[i].id == id)
+    {
+      return &_slots[i];
+    }
+  }
+  return nullptr;
+}
+
+void ZiLinkMqttQos1::acked(uint16_t id)
+{
+  Slot *s = id ? slotOf(id) : nullptr;
+  if (!s)
+  {
+    _stats.strayAcks++;
+    return;
+  }
+  _stats.ackUs.record(micros() - s->sentUs);
+  s->id = 0;
+  _inflight--;
+  _store.drain([id](const ZiLinkRingBuffer::Record &r)
+               { return r.key == id; },
+               1);
+  _stats.acked++;
+  if (_done)
+  {
+    _done(id, Acked);
+  }
+}
+
+void ZiLinkMqttQos1::resendAll()
+{
+  for (uint8_t i = 0; i < ZILINK_MQTT_MAX_INFLIGHT; i++)
+  {
+    _slots[i].resend = _slots[i].id != 0;
+  }
+}
+
+size_t ZiLinkMqttQos1::writeHeader(uint8_t *out, const char *topic, size_t topicLength, uint16_t id, bool dup,
+                                   size_t payloadLength)
+{
+  size_t n = 0;
+  // PUBLISH, QoS 1
+  out[n++] = 0x32 | (dup ? 0x08 : 0);
+  size_t remaining = 2 + topicLength + 2 + payloadLength;
+  do
+  {
+    const uint8_t digit = remaining % 128;
+    remaining /= 128;
+    out[n++] = digit | (remaining ? 0x80 : 0);
+  } while (remaining);
+  out[n++] = (uint8_t)(topicLength >> 8);
+  out[n++] = (uint8_t)topicLength;
+  memcpy(out + n, topic, topicLength);
+  n += topicLength;
+  out[n++] = (uint8_t)(id >> 8);
+  out[n++] = (uint8_t)id;
+  return n;
+}
+
+static void putString(uint8_t *out, size_t &n, const char *s, size_t length)
+{
+  out[n++] = (uint8_t)(length >> 8);
+  out[n++] = (uint8_t)length;
+  memcpy(out + n, s, length);
+  n += length;
+}
+
+size_t ZiLinkMqttTap::writeConnect(uint8_t *out, size_t capacity, const char *id, const char *user, const char *pass,
+                                   uint16_t keepAliveS)
+{
+  const size_t idLength = strlen(id);
+  const size_t userLength = user ? strlen(user) : 0;
+  const size_t passLength = pass ? strlen(pass) : 0;
+  // Protocol name and level, flags, keep-alive, then the strings
+  size_t remaining = 10 + 2 + idLength + (user ? 2 + userLength : 0) + (pass ? 2 + passLength : 0);
+  if (idLength > 0xFFFF || userLength > 0xFFFF || passLength > 0xFFFF || 5 + remaining > capacity)
+  {
+    return 0;
+  }
+  size_t n = 0;
+  out[n++] = 0x10;
+  do
+  {
+    const uint8_t digit = remaining % 128;
+    remaining /= 128;
+    out[n++] = digit | (remaining ? 0x80 : 0);
+  } while (remaining);
+  putString(out, n, "MQTT", 4);
+  out[n++] = 4; // 3.1.1
+  out[n++] = 0x02 | (user ? 0x80 : 0) | (pass ? 0x40 : 0);
+  out[n++] = (uint8_t)(keepAliveS >> 8);
+  out[n++] = (uint8_t)keepAliveS;
+  putString(out, n, id, idLength);
+  if (user)
+  {
+    putString(out, n, user, userLength);
+  }
+  if (pass)
+  {
+    putString(out, n, pass, passLength);
+  }
+  return n;
+}
+
+void ZiLinkMqttTap::feed(uint8_t b)
+{
+  switch (_state)
+  {
+  case Type:
+    // PUBACK: 0x40 with a 2-byte body
+    _puback = b == 0x40;
+    _remaining = 0;
+    _shift = 0;
+    _state = Length;
+    break;
+  case Length:
+    _remaining |= (uint32_t)(b & 0x7F) << _shift;
+    _shift += 7;
+    if (b & 0x80)
+    {
+      break;
+    }
+    _id = 0;
+    _puback = _puback && _remaining == 2;
+    _state = _remaining ? Body : Type;
+    break;
+  case Body:
+    if (_puback)
+    {
+      _id = (uint16_t)(_id << 8 | b);
+    }
+    if (--_remaining == 0)
+    {
+      _state = Type;
+      if (_puback && _onPuback)
+      {
+        _onPuback(_ctx, _id);
+      }
+    }
+    break;
+  }
+}
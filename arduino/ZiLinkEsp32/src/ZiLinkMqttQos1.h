@@ -0,0 +1,312 @@
+#ifndef ZILINK_MQTT_QOS1_H
+#define ZILINK_MQTT_QOS1_H
+
+#include <Arduino.h>
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "ZiLinkRingBuffer.h"
+#include "ZiLinkStats.h"
+
+#ifndef ZILINK_MQTT_MAX_INFLIGHT
+#define ZILINK_MQTT_MAX_INFLIGHT 16
+#endif
+
+// QoS 1 publishing next to PubSubClient, which only does QoS 0. Messages
+// are copied into a store and published with a packet id; up to `window`
+// of them are in flight at once (pipelined, not stop-and-wait). Each stays
+// in the store until the broker's PUBACK for its id comes back, and is
+// sent again with the DUP flag when none came within retryMs or after a
+// reconnect (resendAll()). Brokers acknowledge QoS 1 in order, but any
+// order is accepted.
+//
+// The caller writes the packets (service()) and reports PUBACKs (acked()),
+// which ZiLinkMqttTap picks out of the stream PubSubClient reads. Message
+// ids are the packet ids: 1..65535, wrapping. No allocation after begin().
+class ZiLinkMqttQos1
+{
+public:
+        struct Config
+        {
+                uint8_t window = 8;         // in flight at once, up to ZILINK_MQTT_MAX_INFLIGHT
+                uint32_t retryMs = 3000;    // resend when no PUBACK came within this
+                uint8_t maxAttempts = 0;    // sends before giving up; 0 retries until acknowledged
+                size_t storeBytes = 4096;   // messages waiting or in flight, 6 bytes of overhead each
+        };
+
+        enum Outcome : uint8_t
+        {
+                Acked,
+                GaveUp // maxAttempts sends without a PUBACK
+        };
+
+        typedef std::function<void(uint16_t id, Outcome outcome)> DoneFn;
+
+        struct Stats
+        {
+                uint32_t queued = 0;      // taken by publish()
+                uint32_t rejected = 0;    // store full (or message too large)
+                uint32_t published = 0;   // first sends
+                uint32_t retransmits = 0; // DUP sends
+                uint32_t acked = 0;
+                uint32_t gaveUp = 0;
+                uint32_t strayAcks = 0;   // PUBACK for an id not in flight (late duplicate)
+                uint8_t inflightHigh = 0;
+                ZiLinkHistogram ackUs;    // last send -> PUBACK
+        };
+
+        bool begin(const Config &config);
+        bool enabled() const { return _store.capacity() > 0; }
+        void onDone(DoneFn fn) { _done = fn; }
+
+        // Copies the message for `topic` (a caller-defined index below 8).
+        // Returns its id, or 0 when the store is full.
+        uint16_t publish(uint8_t topic, const char *payload, size_t length);
+
+        // Sends what is due through `send(uint16_t id, bool dup, uint8_t
+        // topic, const char *payload, size_t length)`: timed-out messages
+        // again, then new ones while the window has room, oldest first. Stops
+        // at the first failed send. Returns the packets sent.
+        template <typename Send>
+        size_t service(uint32_t nowMs, Send send);
+
+        // A PUBACK arrived
+        void acked(uint16_t id);
+        // After a reconnect the broker has forgotten everything in flight
+        void resendAll();
+
+        uint8_t inflight() const { return _inflight; }
+        size_t waiting() const { return _store.records() - _inflight; }
+        const Stats &stats() const { return _stats; }
+
+        // PUBLISH fixed header, topic and packet id into `out` (up to 9 +
+        // topicLength bytes); the payload follows. Returns the bytes written.
+        static size_t writeHeader(uint8_t *out, const char *topic, size_t topicLength, uint16_t id, bool dup,
+                                  size_t payloadLength);
+
+private:
+        struct Slot
+        {
+                uint16_t id; // 0: free
+                uint8_t attempts;
+                bool resend;
+                uint32_t sentMs;
+                uint32_t sentUs;
+        };
+
+        Slot *slotOf(uint16_t id);
+        void finish(uint16_t id, Outcome outcome);
+
+        ZiLinkRingBuffer _store{0, ZiLinkRingBuffer::DropNewest};
+        Config _config;
+        Slot _slots[ZILINK_MQTT_MAX_INFLIGHT] = {};
+        uint8_t _inflight = 0;
+        uint16_t _nextId = 1;
+        DoneFn _done;
+        Stats _stats;
+};
+
+// Client in front of the socket PubSubClient reads from. Forwards every
+// call, and follows the MQTT packets coming in to report each PUBACK's
+// packet id, which PubSubClient itself ignores.
+//
+// It also lets the MQTT handshake run without PubSubClient::connect()
+// waiting for the CONNACK: the owner sends the CONNECT (writeConnect())
+// and polls for the answer itself, then passes it to handshake(). The
+// connect() call that follows finds the CONNACK already there and
+// returns at once; the CONNECT it writes meanwhile is discarded.
+class ZiLinkMqttTap : public Client
+{
+public:
+        static const size_t CONNACK_BYTES = 4;
+
+        explicit ZiLinkMqttTap(Client &inner) : _inner(inner) {}
+
+        // CONNECT as PubSubClient writes it (MQTT 3.1.1, clean session; no
+        // user or password when null). Returns the bytes written, 0 when
+        // it does not fit.
+        static size_t writeConnect(uint8_t *out, size_t capacity, const char *id, const char *user, const char *pass,
+                                   uint16_t keepAliveS);
+        // A CONNACK (CONNACK_BYTES) read by the owner, for connect() to find
+        void handshake(const uint8_t *connack)
+        {
+                memcpy(_connack, connack, CONNACK_BYTES);
+                _connackAt = 0;
+        }
+
+        void onPuback(void (*fn)(void *ctx, uint16_t id), void *ctx)
+        {
+                _onPuback = fn;
+                _ctx = ctx;
+        }
+        // A new connection starts at a packet boundary
+        void reset()
+        {
+                _state = Type;
+                _connackAt = CONNACK_BYTES;
+        }
+
+        int connect(const char *host, uint16_t port) override
+        {
+                reset();
+                return _inner.connect(host, port);
+        }
+#if defined(ESP32)
+        int connect(IPAddress ip, uint16_t port) override
+        {
+                reset();
+                return _inner.connect(ip, port);
+        }
+#if defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 3
+        int connect(IPAddress ip, uint16_t port, int32_t timeout) override
+        {
+                reset();
+                return _inner.connect(ip, port, timeout);
+        }
+        int connect(const char *host, uint16_t port, int32_t timeout) override
+        {
+                reset();
+                return _inner.connect(host, port, timeout);
+        }
+#endif
+#endif
+        uint8_t connected() override { return _inner.connected(); }
+        void stop() override { _inner.stop(); }
+        void flush() override { _inner.flush(); }
+        // Until the CONNACK is read, what PubSubClient writes is its CONNECT
+        size_t write(uint8_t c) override { return handshaking() ? 1 : _inner.write(c); }
+        size_t write(const uint8_t *data, size_t length) override
+        {
+                return handshaking() ? length : _inner.write(data, length);
+        }
+        int available() override { return handshaking() ? (int)(CONNACK_BYTES - _connackAt) : _inner.available(); }
+        int peek() override { return handshaking() ? _connack[_connackAt] : _inner.peek(); }
+        int read() override
+        {
+                const int c = handshaking() ? _connack[_connackAt++] : _inner.read();
+                if (c >= 0)
+                {
+                        feed((uint8_t)c);
+                }
+                return c;
+        }
+        int read(uint8_t *buffer, size_t length) override
+        {
+                int n;
+                if (handshaking())
+                {
+                        n = (int)(length < CONNACK_BYTES - _connackAt ? length : CONNACK_BYTES - _connackAt);
+                        memcpy(buffer, _connack + _connackAt, n);
+                        _connackAt += n;
+                }
+                else
+                {
+                        n = _inner.read(buffer, length);
+                }
+                for (int i = 0; i < n; i++)
+                {
+                        feed(buffer[i]);
+                }
+                return n;
+        }
+        operator bool() { return _inner.connected(); }
+
+private:
+        enum State : uint8_t
+        {
+                Type,
+                Length,
+                Body
+        };
+
+        void feed(uint8_t b);
+        bool handshaking() const { return _connackAt < CONNACK_BYTES; }
+
+        Client &_inner;
+        uint8_t _connack[CONNACK_BYTES] = {};
+        size_t _connackAt = CONNACK_BYTES;
+        void (*_onPuback)(void *, uint16_t) = nullptr;
+        void *_ctx = nullptr;
+        State _state = Type;
+        bool _puback = false;
+        uint8_t _shift = 0;
+        uint32_t _remaining = 0;
+        uint16_t _id = 0;
+};
+
+template <typename Send>
+size_t ZiLinkMqttQos1::service(uint32_t nowMs, Send send)
+{
+        bool due = false;
+        for (uint8_t i = 0; i < ZILINK_MQTT_MAX_INFLIGHT && !due; i++)
+        {
+                const Slot &s = _slots[i];
+                due = s.id && (s.resend || nowMs - s.sentMs >= _config.retryMs);
+        }
+        if (!due && (_inflight >= _config.window || waiting() == 0))
+        {
+                return 0;
+        }
+        size_t sent = 0;
+        bool stopped = false;
+        _store.drain([&](const ZiLinkRingBuffer::Record &r)
+                     {
+                if (stopped)
+                {
+                        return false;
+                }
+                Slot *s = slotOf(r.key);
+                if (s)
+                {
+                        if (!s->resend && nowMs - s->sentMs < _config.retryMs)
+                        {
+                                return false;
+                        }
+                        if (_config.maxAttempts && s->attempts >= _config.maxAttempts)
+                        {
+                                s->id = 0;
+                                _inflight--;
+                                _stats.gaveUp++;
+                                if (_done)
+                                {
+                                        _done(r.key, GaveUp);
+                                }
+                                return true;
+                        }
+                        if (!send(r.key, true, r.channel, r.data, r.length))
+                        {
+                                stopped = true;
+                                return false;
+                        }
+                        s->attempts++;
+                        s->resend = false;
+                        s->sentMs = nowMs;
+                        s->sentUs = micros();
+                        _stats.retransmits++;
+                        sent++;
+                        return false;
+                }
+                if (_inflight >= _config.window)
+                {
+                        return false;
+                }
+                if (!send(r.key, false, r.channel, r.data, r.length))
+                {
+                        stopped = true;
+                        return false;
+                }
+                s = slotOf(0);
+                *s = {r.key, 1, false, nowMs, (uint32_t)micros()};
+                _inflight++;
+                if (_inflight > _stats.inflightHigh)
+                {
+                        _stats.inflightHigh = _inflight;
+                }
+                _stats.published++;
+                sent++;
+                return false; });
+        return sent;
+}
+
+#endif
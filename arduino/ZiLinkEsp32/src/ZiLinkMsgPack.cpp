@@ -0,0 +1,1109 @@
+#include "ZiLinkMsgPack.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// ---------------------------------------------------------------------------
+// Encoder
+
+void ZiLinkMsgPack::header(uint8_t tag, uint64_t v, uint8_t bytes)
+{
+  char tmp[9];
+  tmp[0] = (char)tag;
+  for (uint8_t i = 0; i < bytes; i++)
+  {
+    tmp[bytes - i] = (char)(v >> (8 * i));
+  }
+  _out.raw(tmp, (size_t)bytes + 1);
+}
+
+ZiLinkMsgPack &ZiLinkMsgPack::nil()
+{
+  _out.raw((char)0xc0);
+  return *this;
+}
+
+ZiLinkMsgPack &ZiLinkMsgPack::boolean(bool v)
+{
+  _out.raw((char)(v ? 0xc3 : 0xc2));
+  return *this;
+}
+
+ZiLinkMsgPack &ZiLinkMsgPack::uinteger(uint64_t v)
+{
+  if (v < 0x80)
+  {
+    _out.raw((char)v);
+  }
+  else if (v <= 0xff)
+  {
+    header(0xcc, v, 1);
+  }
+  else if (v <= 0xffff)
+  {
+    header(0xcd, v, 2);
+  }
+  else if (v <= 0xffffffffull)
+  {
+    header(0xce, v, 4);
+  }
+  else
+  {
+    header(0xcf, v, 8);
+  }
+  return *this;
+}
+
+ZiLinkMsgPack &ZiLinkMsgPack::integer(int64_t v)
+{
+  if (v >= 0)
+  {
+    return uinteger((uint64_t)v);
+  }
+  if (v >= -32)
+  {
+    _out.raw((char)(uint8_t)v);
+  }
+  else if (v >= INT8_MIN)
+  {
+    header(0xd0, (uint64_t)v, 1);
+  }
+  else if (v >= INT16_MIN)
+  {
+    header(0xd1, (uint64_t)v, 2);
+  }
+  else if (v >= INT32_MIN)
+  {
+    header(0xd2, (uint64_t)v, 4);
+  }
+  else
+  {
+    header(0xd3, (uint64_t)v, 8);
+  }
+  return *this;
+}
+
+ZiLinkMsgPack &ZiLinkMsgPack::float32(float v)
+{
+  uint32_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  header(0xca, bits, 4);
+  return *this;
+}
+
+ZiLinkMsgPack &ZiLinkMsgPack::float64(double v)
+{
+  uint64_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  header(0xcb, bits, 8);
+  return *this;
+}
+
+ZiLinkMsgPack &ZiLinkMsgPack::str(const char *s)
+{
+  return str(s, s ? strlen(s) : 0);
+}
+
+ZiLinkMsgPack &ZiLinkMsgPack::str(const char *s, size_t n)
+{
+  if (n < 32)
+  {
+    _out.raw((char)(0xa0 | n));
+  }
+  else if (n <= 0xff)
+  {
+    header(0xd9, n, 1);
+  }
+  else if (n <= 0xffff)
+  {
+    header(0xda, n, 2);
+  }
+  else
+  {
+    header(0xdb, n, 4);
+  }
+  _out.raw(s, n);
+  return *this;
+}
+
+ZiLinkMsgPack &ZiLinkMsgPack::array(uint32_t count)
+{
+  if (count < 16)
+  {
+    _out.raw((char)(0x90 | count));
+  }
+  else
+  {
+    count <= 0xffff ? header(0xdc, count, 2) : header(0xdd, count, 4);
+  }
+  return *this;
+}
+
+ZiLinkMsgPack &ZiLinkMsgPack::map(uint32_t count)
+{
+  if (count < 16)
+  {
+    _out.raw((char)(0x80 | count));
+  }
+  else
+  {
+    count <= 0xffff ? header(0xde, count, 2) : header(0xdf, count, 4);
+  }
+  return *this;
+}
+
+ZiLinkMsgPack &ZiLinkMsgPack::floatArray(const float *values, size_t count)
+{
+  const size_t bytes = count * 4;
+  switch (bytes)
+  {
+  case 4:
+    _out.raw((char)0xd6);
+    break;
+  case 8:
+    _out.raw((char)0xd7);
+    break;
+  case 16:
+    _out.raw((char)0xd8);
+    break;
+  default:
+    if (bytes <= 0xff)
+    {
+      header(0xc7, bytes, 1);
+    }
+    else if (bytes <= 0xffff)
+    {
+      header(0xc8, bytes, 2);
+    }
+    else
+    {
+      header(0xc9, bytes, 4);
+    }
+    break;
+  }
+  _out.raw((char)ZILINK_EXT_FLOAT32_ARRAY);
+  // Convert in small chunks so the writer is called once per 16 samples
+  char chunk[64];
+  size_t used = 0;
+  for (size_t i = 0; i < count && _out.ok(); i++)
+  {
+    uint32_t bits;
+    memcpy(&bits, &values[i], sizeof(bits));
+    chunk[used++] = (char)bits;
+    chunk[used++] = (char)(bits >> 8);
+    chunk[used++] = (char)(bits >> 16);
+    chunk[used++] = (char)(bits >> 24);
+    if (used == sizeof(chunk))
+    {
+      _out.raw(chunk, used);
+      used = 0;
+    }
+  }
+  _out.raw(chunk, used);
+  return *this;
+}
+
+// ---------------------------------------------------------------------------
+// JSON transcoder
+
+static void skipSpace(const char *&p, const char *end)
+{
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+  {
+    p++;
+  }
+}
+
+static bool literal(const char *&p, const char *end, const char *word, size_t n)
+{
+  if ((size_t)(end - p) < n || memcmp(p, word, n) != 0)
+  {
+    return false;
+  }
+  p += n;
+  return true;
+}
+
+static int hexValue(char c)
+{
+  if (c >= '0' && c <= '9')
+  {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f')
+  {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F')
+  {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+static bool hex4(const char *&p, const char *end, uint32_t &v)
+{
+  if (end - p < 4)
+  {
+    return false;
+  }
+  v = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    const int h = hexValue(*p++);
+    if (h < 0)
+    {
+      return false;
+    }
+    v = (v << 4) | (uint32_t)h;
+  }
+  return true;
+}
+
+static size_t utf8(uint32_t cp, char *out)
+{
+  if (cp < 0x80)
+  {
+    out[0] = (char)cp;
+    return 1;
+  }
+  if (cp < 0x800)
+  {
+    out[0] = (char)(0xc0 | (cp >> 6));
+    out[1] = (char)(0x80 | (cp & 0x3f));
+    return 2;
+  }
+  if (cp < 0x10000)
+  {
+    out[0] = (char)(0xe0 | (cp >> 12));
+    out[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+    out[2] = (char)(0x80 | (cp & 0x3f));
+    return 3;
+  }
+  out[0] = (char)(0xf0 | (cp >> 18));
+  out[1] = (char)(0x80 | ((cp >> 12) & 0x3f));
+  out[2] = (char)(0x80 | ((cp >> 6) & 0x3f));
+  out[3] = (char)(0x80 | (cp & 0x3f));
+  return 4;
+}
+
+bool ZiLinkMsgPack::json(const char *text, size_t length)
+{
+  Cursor c = {text, text + length};
+  if (!jsonValue(c, 0))
+  {
+    return false;
+  }
+  skipSpace(c.p, c.end);
+  return c.p == c.end && _out.ok();
+}
+
+bool ZiLinkMsgPack::jsonList(const char *text, size_t length, uint32_t &count)
+{
+  Cursor c = {text, text + length};
+  return jsonElements(c, 0, '\0', count) && _out.ok();
+}
+
+bool ZiLinkMsgPack::jsonValue(Cursor &c, uint8_t depth)
+{
+  skipSpace(c.p, c.end);
+  if (c.p >= c.end)
+  {
+    return false;
+  }
+  switch (*c.p)
+  {
+  case '{':
+    return jsonContainer(c, depth, '}');
+  case '[':
+    return jsonContainer(c, depth, ']');
+  case '"':
+    return jsonString(c);
+  case 't':
+    boolean(true);
+    return literal(c.p, c.end, "true", 4);
+  case 'f':
+    boolean(false);
+    return literal(c.p, c.end, "false", 5);
+  case 'n':
+    nil();
+    return literal(c.p, c.end, "null", 4);
+  default:
+    return jsonNumber(c);
+  }
+}
+
+bool ZiLinkMsgPack::jsonContainer(Cursor &c, uint8_t depth, char close)
+{
+  if (depth >= ZILINK_MSGPACK_MAX_DEPTH)
+  {
+    return false;
+  }
+  c.p++;
+  // The count is unknown until the closing bracket; reserve a 16-bit header
+  const size_t pos = _out.length();
+  header(close == '}' ? 0xde : 0xdc, 0, 2);
+  uint32_t count;
+  if (!jsonElements(c, depth + 1, close, count) || !_out.ok() || count > 0xffff)
+  {
+    return false;
+  }
+  char *d = _out.data();
+  if (count < 16)
+  {
+    // Compact to the one byte fix header
+    memmove(d + pos + 1, d + pos + 3, _out.length() - pos - 3);
+    d[pos] = (char)((close == '}' ? 0x80 : 0x90) | count);
+    _out.truncate(_out.length() - 2);
+  }
+  else
+  {
+    d[pos + 1] = (char)(count >> 8);
+    d[pos + 2] = (char)count;
+  }
+  return true;
+}
+
+bool ZiLinkMsgPack::jsonElements(Cursor &c, uint8_t depth, char close, uint32_t &count)
+{
+  count = 0;
+  skipSpace(c.p, c.end);
+  if (close == '\0' ? c.p == c.end : (c.p < c.end && *c.p == close))
+  {
+    c.p += close ? 1 : 0;
+    return true;
+  }
+  for (;;)
+  {
+    if (close == '}')
+    {
+      skipSpace(c.p, c.end);
+      if (c.p >= c.end || *c.p != '"' || !jsonString(c))
+      {
+        return false;
+      }
+      skipSpace(c.p, c.end);
+      if (c.p >= c.end || *c.p != ':')
+      {
+        return false;
+      }
+      c.p++;
+    }
+    if (!jsonValue(c, depth) || !_out.ok())
+    {
+      return false;
+    }
+    count++;
+    skipSpace(c.p, c.end);
+    if (close == '\0' && c.p == c.end)
+    {
+      return true;
+    }
+    if (c.p >= c.end)
+    {
+      return false;
+    }
+    if (*c.p == ',')
+    {
+      c.p++;
+      continue;
+    }
+    if (close != '\0' && *c.p == close)
+    {
+      c.p++;
+      return true;
+    }
+    return false;
+  }
+}
+
+bool ZiLinkMsgPack::jsonString(Cursor &c)
+{
+  const char *start = ++c.p;
+  const char *q = start;
+  while (q < c.end && *q != '"' && *q != '\\')
+  {
+    q++;
+  }
+  if (q >= c.end)
+  {
+    return false;
+  }
+  if (*q == '"')
+  {
+    // Common case: no escapes, the length is known up front
+    str(start, (size_t)(q - start));
+    c.p = q + 1;
+    return true;
+  }
+
+  const size_t pos = _out.length();
+  header(0xda, 0, 2);
+  c.p = start;
+  while (c.p < c.end && *c.p != '"')
+  {
+    if (*c.p != '\\')
+    {
+      const char *run = c.p;
+      while (c.p < c.end && *c.p != '"' && *c.p != '\\')
+      {
+        c.p++;
+      }
+      _out.raw(run, (size_t)(c.p - run));
+      continue;
+    }
+    if (++c.p >= c.end)
+    {
+      return false;
+    }
+    const char e = *c.p++;
+    switch (e)
+    {
+    case '"':
+    case '\\':
+    case '/':
+      _out.raw(e);
+      break;
+    case 'b':
+      _out.raw('\b');
+      break;
+    case 'f':
+      _out.raw('\f');
+      break;
+    case 'n':
+      _out.raw('\n');
+      break;
+    case 'r':
+      _out.raw('\r');
+      break;
+    case 't':
+      _out.raw('\t');
+      break;
+    case 'u':
+    {
+      uint32_t cp;
+      if (!hex4(c.p, c.end, cp))
+      {
+        return false;
+      }
+      if (cp >= 0xd800 && cp < 0xdc00)
+      {
+        uint32_t low;
+        if (!literal(c.p, c.end, "\\u", 2) || !hex4(c.p, c.end, low) || low < 0xdc00 || low > 0xdfff)
+        {
+          return false;
+        }
+        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+      }
+      char tmp[4];
+      _out.raw(tmp, utf8(cp, tmp));
+    }
+    break;
+    default:
+      return false;
+    }
+  }
+  if (c.p >= c.end || !_out.ok())
+  {
+    return false;
+  }
+  c.p++;
+
+  char *d = _out.data();
+  const size_t n = _out.length() - pos - 3;
+  if (n > 0xffff)
+  {
+    return false;
+  }
+  if (n < 32)
+  {
+    memmove(d + pos + 1, d + pos + 3, n);
+    d[pos] = (char)(0xa0 | n);
+    _out.truncate(_out.length() - 2);
+  }
+  else
+  {
+    d[pos + 1] = (char)(n >> 8);
+    d[pos + 2] = (char)n;
+  }
+  return true;
+}
+
+bool ZiLinkMsgPack::jsonNumber(Cursor &c)
+{
+  const char *start = c.p;
+  const char *p = c.p;
+  bool negative = false;
+  if (p < c.end && *p == '-')
+  {
+    negative = true;
+    p++;
+  }
+  const char *digits = p;
+  uint64_t whole = 0;
+  bool overflow = false;
+  while (p < c.end && *p >= '0' && *p <= '9')
+  {
+    const uint64_t digit = (uint64_t)(*p - '0');
+    overflow |= whole > (UINT64_MAX - digit) / 10;
+    whole = whole * 10 + digit;
+    p++;
+  }
+  const size_t wholeDigits = (size_t)(p - digits);
+  if (wholeDigits == 0)
+  {
+    return false;
+  }
+  bool integral = true;
+  if (p < c.end && *p == '.')
+  {
+    integral = false;
+    p++;
+    while (p < c.end && *p >= '0' && *p <= '9')
+    {
+      p++;
+    }
+  }
+  if (p < c.end && (*p == 'e' || *p == 'E'))
+  {
+    integral = false;
+    p++;
+    if (p < c.end && (*p == '+' || *p == '-'))
+    {
+      p++;
+    }
+    while (p < c.end && *p >= '0' && *p <= '9')
+    {
+      p++;
+    }
+  }
+  c.p = p;
+
+  // Integers keep every digit: uint64 up to 2^64-1, int64 down to -2^63
+  if (integral && !overflow && !negative)
+  {
+    uinteger(whole);
+    return true;
+  }
+  if (integral && !overflow && whole <= (uint64_t)INT64_MAX + 1)
+  {
+    integer(whole == (uint64_t)INT64_MAX + 1 ? INT64_MIN : -(int64_t)whole);
+    return true;
+  }
+  // strtod needs a terminated copy; the input is not necessarily terminated
+  char tmp[40];
+  const size_t n = (size_t)(p - start);
+  if (n >= sizeof(tmp))
+  {
+    return false;
+  }
+  memcpy(tmp, start, n);
+  tmp[n] = '\0';
+  const double v = strtod(tmp, nullptr);
+  // float32 only when its 7 significant digits read back as the same number
+  // (23.45, 0.5); coordinates, timestamps and the like stay float64
+  char single[24];
+  snprintf(single, sizeof(single), "%.7g", (double)(float)v);
+  if (strtod(single, nullptr) == v)
+  {
+    float32((float)v);
+  }
+  else
+  {
+    float64(v);
+  }
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Reader
+
+bool ZiLinkMsgPackReader::take(size_t n, const uint8_t *&at)
+{
+  if (!_ok || (size_t)(_end - _p) < n)
+  {
+    return fail();
+  }
+  at = _p;
+  _p += n;
+  return true;
+}
+
+bool ZiLinkMsgPackReader::readUint(uint8_t bytes, uint64_t &v)
+{
+  const uint8_t *at;
+  if (!take(bytes, at))
+  {
+    return false;
+  }
+  v = 0;
+  for (uint8_t i = 0; i < bytes; i++)
+  {
+    v = (v << 8) | at[i];
+  }
+  return true;
+}
+
+ZiLinkMsgPackReader::Type ZiLinkMsgPackReader::peek() const
+{
+  if (!_ok || _p >= _end)
+  {
+    return Invalid;
+  }
+  const uint8_t t = *_p;
+  if (t <= 0x7f || t >= 0xe0 || (t >= 0xcc && t <= 0xd3))
+  {
+    return Int;
+  }
+  if (t <= 0x8f || t == 0xde || t == 0xdf)
+  {
+    return Map;
+  }
+  if (t <= 0x9f || t == 0xdc || t == 0xdd)
+  {
+    return Array;
+  }
+  if (t <= 0xbf || (t >= 0xd9 && t <= 0xdb))
+  {
+    return Str;
+  }
+  switch (t)
+  {
+  case 0xc0:
+    return Nil;
+  case 0xc2:
+  case 0xc3:
+    return Bool;
+  case 0xca:
+  case 0xcb:
+    return Float;
+  case 0xc4:
+  case 0xc5:
+  case 0xc6:
+    return Bin;
+  case 0xc7:
+  case 0xc8:
+  case 0xc9:
+  case 0xd4:
+  case 0xd5:
+  case 0xd6:
+  case 0xd7:
+  case 0xd8:
+    return Ext;
+  default:
+    return Invalid;
+  }
+}
+
+bool ZiLinkMsgPackReader::readNil()
+{
+  const uint8_t *at;
+  if (peek() != Nil)
+  {
+    return fail();
+  }
+  return take(1, at);
+}
+
+bool ZiLinkMsgPackReader::readBool(bool &v)
+{
+  const uint8_t *at;
+  if (peek() != Bool || !take(1, at))
+  {
+    return fail();
+  }
+  v = *at == 0xc3;
+  return true;
+}
+
+bool ZiLinkMsgPackReader::readInt(int64_t &v)
+{
+  const uint8_t *at;
+  if (peek() != Int || !take(1, at))
+  {
+    return fail();
+  }
+  const uint8_t t = *at;
+  if (t <= 0x7f)
+  {
+    v = t;
+    return true;
+  }
+  if (t >= 0xe0)
+  {
+    v = (int8_t)t;
+    return true;
+  }
+  uint64_t u;
+  if (t <= 0xcf)
+  {
+    // uint 8/16/32/64
+    if (!readUint((uint8_t)(1u << (t - 0xcc)), u) || u > (uint64_t)INT64_MAX)
+    {
+      return fail();
+    }
+    v = (int64_t)u;
+    return true;
+  }
+  // int 8/16/32/64: sign-extend from the encoded width
+  const uint8_t bytes = (uint8_t)(1u << (t - 0xd0));
+  if (!readUint(bytes, u))
+  {
+    return false;
+  }
+  const unsigned shift = 64 - 8 * bytes;
+  v = shift ? (int64_t)(u << shift) >> shift : (int64_t)u;
+  return true;
+}
+
+bool ZiLinkMsgPackReader::readFloat(double &v)
+{
+  if (peek() == Int)
+  {
+    int64_t i;
+    if (!readInt(i))
+    {
+      return false;
+    }
+    v = (double)i;
+    return true;
+  }
+  const uint8_t *at;
+  if (peek() != Float || !take(1, at))
+  {
+    return fail();
+  }
+  uint64_t bits;
+  if (*at == 0xca)
+  {
+    if (!readUint(4, bits))
+    {
+      return false;
+    }
+    const uint32_t b32 = (uint32_t)bits;
+    float f;
+    memcpy(&f, &b32, sizeof(f));
+    v = f;
+    return true;
+  }
+  if (!readUint(8, bits))
+  {
+    return false;
+  }
+  memcpy(&v, &bits, sizeof(v));
+  return true;
+}
+
+bool ZiLinkMsgPackReader::readLength(uint8_t tag, uint32_t &n)
+{
+  // Lengths after the str8/bin8/array16/... tags
+  uint8_t bytes;
+  switch (tag)
+  {
+  case 0xc4:
+  case 0xc7:
+  case 0xd9:
+    bytes = 1;
+    break;
+  case 0xc5:
+  case 0xc8:
+  case 0xda:
+  case 0xdc:
+  case 0xde:
+    bytes = 2;
+    break;
+  default:
+    bytes = 4;
+    break;
+  }
+  uint64_t v;
+  if (!readUint(bytes, v))
+  {
+    return false;
+  }
+  n = (uint32_t)v;
+  return true;
+}
+
+bool ZiLinkMsgPackReader::readStr(const char *&s, uint32_t &n)
+{
+  const uint8_t *at;
+  if (peek() != Str || !take(1, at))
+  {
+    return fail();
+  }
+  if (*at <= 0xbf)
+  {
+    n = *at & 0x1f;
+  }
+  else if (!readLength(*at, n))
+  {
+    return false;
+  }
+  const uint8_t *body;
+  if (!take(n, body))
+  {
+    return false;
+  }
+  s = (const char *)body;
+  return true;
+}
+
+bool ZiLinkMsgPackReader::readArray(uint32_t &count)
+{
+  const uint8_t *at;
+  if (peek() != Array || !take(1, at))
+  {
+    return fail();
+  }
+  if (*at <= 0x9f)
+  {
+    count = *at & 0x0f;
+    return true;
+  }
+  return readLength(*at, count);
+}
+
+bool ZiLinkMsgPackReader::readMap(uint32_t &count)
+{
+  const uint8_t *at;
+  if (peek() != Map || !take(1, at))
+  {
+    return fail();
+  }
+  if (*at <= 0x8f)
+  {
+    count = *at & 0x0f;
+    return true;
+  }
+  return readLength(*at, count);
+}
+
+bool ZiLinkMsgPackReader::skip()
+{
+  // Iterative so hostile nesting cannot exhaust the stack
+  uint64_t pending = 1;
+  while (pending > 0)
+  {
+    pending--;
+    const Type type = peek();
+    const uint8_t tag = _ok && _p < _end ? *_p : 0;
+    uint32_t n;
+    const uint8_t *at;
+    switch (type)
+    {
+    case Nil:
+    case Bool:
+      take(1, at);
+      break;
+    case Int:
+    {
+      int64_t v;
+      readInt(v);
+    }
+    break;
+    case Float:
+    {
+      double v;
+      readFloat(v);
+    }
+    break;
+    case Str:
+    {
+      const char *s;
+      readStr(s, n);
+    }
+    break;
+    case Array:
+      if (readArray(n))
+      {
+        pending += n;
+      }
+      break;
+    case Map:
+      if (readMap(n))
+      {
+        pending += 2ull * n;
+      }
+      break;
+    case Bin:
+      take(1, at) && readLength(tag, n) && take(n, at);
+      break;
+    case Ext:
+      take(1, at);
+      if (tag >= 0xd4)
+      {
+        n = 1u << (tag - 0xd4);
+      }
+      else
+      {
+        readLength(tag, n);
+      }
+      take(1, at) && take(n, at);
+      break;
+    default:
+      return fail();
+    }
+    if (!_ok)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void jsonFloat(ZiLinkFrameWriter &out, double v, int digits)
+{
+  if (isnan(v) || isinf(v))
+  {
+    out.raw("null");
+    return;
+  }
+  char tmp[32];
+  const int n = snprintf(tmp, sizeof(tmp), "%.*g", digits, v);
+  out.raw(tmp, n > 0 ? (size_t)n : 0);
+}
+
+bool ZiLinkMsgPackReader::toJson(ZiLinkFrameWriter &out, uint8_t depth)
+{
+  if (depth >= ZILINK_MSGPACK_MAX_DEPTH)
+  {
+    return fail();
+  }
+  uint32_t n;
+  switch (peek())
+  {
+  case Nil:
+    readNil();
+    out.raw("null");
+    break;
+  case Bool:
+  {
+    bool v;
+    if (readBool(v))
+    {
+      out.boolean(v);
+    }
+  }
+  break;
+  case Int:
+  {
+    int64_t v;
+    if (readInt(v))
+    {
+      char tmp[24];
+      const int len = snprintf(tmp, sizeof(tmp), "%lld", (long long)v);
+      out.raw(tmp, len > 0 ? (size_t)len : 0);
+    }
+  }
+  break;
+  case Float:
+  {
+    // float32 carries ~7 significant digits; printing more shows noise
+    const bool single = *_p == 0xca;
+    double v;
+    if (readFloat(v))
+    {
+      jsonFloat(out, v, single ? 7 : 15);
+    }
+  }
+  break;
+  case Str:
+  {
+    const char *s;
+    if (readStr(s, n))
+    {
+      out.str(s, n);
+    }
+  }
+  break;
+  case Array:
+    if (!readArray(n))
+    {
+      return false;
+    }
+    out.raw('[');
+    for (uint32_t i = 0; i < n && _ok; i++)
+    {
+      if (i)
+      {
+        out.raw(',');
+      }
+      toJson(out, depth + 1);
+    }
+    out.raw(']');
+    break;
+  case Map:
+    if (!readMap(n))
+    {
+      return false;
+    }
+    out.raw('{');
+    for (uint32_t i = 0; i < n && _ok; i++)
+    {
+      const char *k;
+      uint32_t kn;
+      if (!readStr(k, kn))
+      {
+        // JSON object keys must be strings
+        return false;
+      }
+      if (i)
+      {
+        out.raw(',');
+      }
+      out.str(k, kn).raw(':');
+      toJson(out, depth + 1);
+    }
+    out.raw('}');
+    break;
+  case Ext:
+  {
+    const uint8_t tag = *_p;
+    const uint8_t *at;
+    take(1, at);
+    if (tag >= 0xd4)
+    {
+      n = 1u << (tag - 0xd4);
+    }
+    else if (!readLength(tag, n))
+    {
+      return false;
+    }
+    const uint8_t *type;
+    const uint8_t *body;
+    if (!take(1, type) || !take(n, body))
+    {
+      return false;
+    }
+    if ((int8_t)*type != ZILINK_EXT_FLOAT32_ARRAY || n % 4 != 0)
+    {
+      out.raw("null");
+      break;
+    }
+    out.raw('[');
+    for (uint32_t i = 0; i < n; i += 4)
+    {
+      const uint32_t bits = body[i] | (body[i + 1] << 8) | (body[i + 2] << 16) | ((uint32_t)body[i + 3] << 24);
+      float f;
+      memcpy(&f, &bits, sizeof(f));
+      if (i)
+      {
+        out.raw(',');
+      }
+      jsonFloat(out, f, 7);
+    }
+    out.raw(']');
+  }
+  break;
+  case Bin:
+    // No JSON equivalent
+    skip();
+    out.raw("null");
+    break;
+  default:
+    return fail();
+  }
+  return _ok && out.ok();
+}
@@ -0,0 +1,137 @@
+#ifndef ZILINK_MSGPACK_H
+#define ZILINK_MSGPACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ZiLinkFrameWriter.h"
+
+// Binary WebSocket frames are a MessagePack array whose first element is
+// the frame kind. The layouts mirror the JSON messages:
+//   [1, sensorData, seq?, trace?]     device_data (seq nil when only traced)
+//   [2, type, id, value, trace?]      component update
+//   [3, command]                      server -> device command
+//   [4, [reading, ...], trace?]       batched device_data
+//   [5, [[type, id, value], ...]]     component snapshot
+//   [6, [[id, type], ...]]            component schema (index = position)
+//   [7, index, value, trace?]         component update by schema index
+//   [8, channel, message]             a gateway sub-device's message
+// trace is [n, deviceMs] (see ZiLinkLatency).
+enum ZiLinkFrameKind : uint8_t
+{
+        ZILINK_KIND_DEVICE_DATA = 1,
+        ZILINK_KIND_COMPONENT = 2,
+        ZILINK_KIND_COMMAND = 3,
+        ZILINK_KIND_BATCH = 4,
+        ZILINK_KIND_COMPONENT_SNAPSHOT = 5,
+        ZILINK_KIND_COMPONENT_SCHEMA = 6,
+        ZILINK_KIND_WIDGET = 7,
+        ZILINK_KIND_GATEWAY = 8
+};
+
+// Extension type carrying little-endian float32 samples back to back
+#define ZILINK_EXT_FLOAT32_ARRAY 1
+
+#ifndef ZILINK_MSGPACK_MAX_DEPTH
+#define ZILINK_MSGPACK_MAX_DEPTH 8
+#endif
+
+// MessagePack encoder appending to a ZiLinkFrameWriter, so binary frames
+// get the same fixed buffers and WebSocket headroom as JSON ones.
+// Overflow is reported through the writer's ok().
+class ZiLinkMsgPack
+{
+public:
+        explicit ZiLinkMsgPack(ZiLinkFrameWriter &out) : _out(out) {}
+
+        ZiLinkMsgPack &nil();
+        ZiLinkMsgPack &boolean(bool v);
+        ZiLinkMsgPack &uinteger(uint64_t v);
+        ZiLinkMsgPack &integer(int64_t v);
+        ZiLinkMsgPack &float32(float v);
+        ZiLinkMsgPack &float64(double v);
+        ZiLinkMsgPack &str(const char *s);
+        ZiLinkMsgPack &str(const char *s, size_t n);
+        ZiLinkMsgPack &array(uint32_t count);
+        ZiLinkMsgPack &map(uint32_t count);
+        // Samples as one ext value: 4 bytes each instead of ~6 as JSON text
+        ZiLinkMsgPack &floatArray(const float *values, size_t count);
+
+        // Transcodes one JSON value. Integers stay exact; other numbers become
+        // float32 when 7 digits hold them exactly, float64 otherwise.
+        // Returns false on malformed input or overflow.
+        bool json(const char *text, size_t length);
+        // Transcodes a comma separated list of JSON values without brackets,
+        // e.g. the body of a batch; `count` receives the number of values
+        bool jsonList(const char *text, size_t length, uint32_t &count);
+
+        bool ok() const { return _out.ok(); }
+
+private:
+        struct Cursor
+        {
+                const char *p;
+                const char *end;
+        };
+
+        void header(uint8_t tag, uint64_t v, uint8_t bytes);
+        bool jsonValue(Cursor &c, uint8_t depth);
+        bool jsonString(Cursor &c);
+        bool jsonNumber(Cursor &c);
+        bool jsonContainer(Cursor &c, uint8_t depth, char close);
+        bool jsonElements(Cursor &c, uint8_t depth, char close, uint32_t &count);
+
+        ZiLinkFrameWriter &_out;
+};
+
+// Zero-copy MessagePack reader: strings point into the input buffer
+class ZiLinkMsgPackReader
+{
+public:
+        enum Type
+        {
+                Nil,
+                Bool,
+                Int,
+                Float,
+                Str,
+                Bin,
+                Array,
+                Map,
+                Ext,
+                Invalid
+        };
+
+        ZiLinkMsgPackReader(const uint8_t *data, size_t length) : _p(data), _end(data + length) {}
+
+        Type peek() const;
+        bool readNil();
+        bool readBool(bool &v);
+        bool readInt(int64_t &v);
+        // Accepts integers as well
+        bool readFloat(double &v);
+        bool readStr(const char *&s, uint32_t &n);
+        bool readArray(uint32_t &count);
+        bool readMap(uint32_t &count);
+        bool skip();
+        // Renders the next value as JSON; ext float arrays become number arrays
+        bool toJson(ZiLinkFrameWriter &out, uint8_t depth = 0);
+
+        bool ok() const { return _ok; }
+        size_t remaining() const { return (size_t)(_end - _p); }
+
+private:
+        bool take(size_t n, const uint8_t *&at);
+        bool readUint(uint8_t bytes, uint64_t &v);
+        bool readLength(uint8_t tag, uint32_t &n);
+        bool fail()
+        {
+                _ok = false;
+                return false;
+        }
+
+        const uint8_t *_p;
+        const uint8_t *_end;
+        bool _ok = true;
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include "ZiLinkNetTask.h"
+
+#if !defined(ESP32) && defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+bool ZiLinkNetTask::start(void (*body)(void *ctx), void *ctx, const Config &config)
+{
+  if (running() || !body)
+  {
+    return false;
+  }
+  _body = body;
+  _ctx = ctx;
+  _config = config;
+  _stop.store(false);
+  _running.store(true, std::memory_order_release);
+#if defined(ESP32)
+  const BaseType_t core = config.core < 0 ? tskNO_AFFINITY : config.core;
+  if (xTaskCreatePinnedToCore(entry, "zilink-net", config.stackBytes, this, config.priority, &_handle, core) != pdPASS)
+  {
+    _handle = nullptr;
+    _running.store(false);
+    return false;
+  }
+#else
+  _thread = std::thread([this]
+                        { run(); });
+#if defined(__linux__)
+  if (config.core >= 0)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(config.core, &set);
+    pthread_setaffinity_np(_thread.native_handle(), sizeof(set), &set);
+  }
+#endif
+#endif
+  return true;
+}
+
+void ZiLinkNetTask::run()
+{
+  while (!_stop.load(std::memory_order_acquire))
+  {
+    _body(_ctx);
+    _iterations.fetch_add(1, std::memory_order_relaxed);
+    idle();
+  }
+}
+
+#if defined(ESP32)
+
+void ZiLinkNetTask::entry(void *self)
+{
+  ZiLinkNetTask *task = static_cast<ZiLinkNetTask *>(self);
+  task->run();
+  task->_running.store(false, std::memory_order_release);
+  vTaskDelete(nullptr);
+}
+
+void ZiLinkNetTask::idle()
+{
+  TickType_t ticks = pdMS_TO_TICKS(_config.idleMs);
+  // At least one tick, or lower-priority tasks (and the idle task's watchdog) starve
+  ulTaskNotifyTake(pdTRUE, ticks ? ticks : 1);
+}
+
+void ZiLinkNetTask::notify()
+{
+  if (_handle)
+  {
+    xTaskNotifyGive(_handle);
+  }
+}
+
+bool ZiLinkNetTask::inTask() const
+{
+  return _handle && xTaskGetCurrentTaskHandle() == _handle;
+}
+
+void ZiLinkNetTask::stop()
+{
+  if (!_handle)
+  {
+    return;
+  }
+  _stop.store(true, std::memory_order_release);
+  notify();
+  while (running())
+  {
+    vTaskDelay(1);
+  }
+  _handle = nullptr;
+}
+
+#else
+
+void ZiLinkNetTask::idle()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  _wake.wait_for(lock, std::chrono::milliseconds(_config.idleMs), [this]
+                 { return _notified; });
+  _notified = false;
+}
+
+void ZiLinkNetTask::notify()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _notified = true;
+  }
+  _wake.notify_one();
+}
+
+bool ZiLinkNetTask::inTask() const
+{
+  return _thread.joinable() && std::this_thread::get_id() == _thread.get_id();
+}
+
+void ZiLinkNetTask::stop()
+{
+  if (!_thread.joinable())
+  {
+    return;
+  }
+  _stop.store(true, std::memory_order_release);
+  notify();
+  _thread.join();
+  _running.store(false, std::memory_order_release);
+}
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef ZILINK_NET_TASK_H
+#define ZILINK_NET_TASK_H
+
+#include <atomic>
+#include <stdint.h>
+
+#if defined(ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+// Core the network task is pinned to (-1: any). Arduino's loop() runs on core 1.
+#ifndef ZILINK_NET_TASK_CORE
+#define ZILINK_NET_TASK_CORE 0
+#endif
+
+#ifndef ZILINK_NET_TASK_STACK
+#define ZILINK_NET_TASK_STACK 8192
+#endif
+
+#ifndef ZILINK_NET_TASK_PRIORITY
+#define ZILINK_NET_TASK_PRIORITY 2
+#endif
+
+// Runs `body` over and over on its own thread: a FreeRTOS task pinned to a
+// core on ESP32, a std::thread elsewhere (pinned with the Linux affinity
+// call when a core is given). Between iterations it sleeps up to idleMs,
+// or less when notify() wakes it.
+class ZiLinkNetTask
+{
+public:
+        struct Config
+        {
+                int8_t core = ZILINK_NET_TASK_CORE;
+                uint32_t stackBytes = ZILINK_NET_TASK_STACK; // ignored off ESP32
+                uint8_t priority = ZILINK_NET_TASK_PRIORITY; // ignored off ESP32
+                uint32_t idleMs = 1;
+        };
+
+        ZiLinkNetTask() = default;
+        ~ZiLinkNetTask() { stop(); }
+        ZiLinkNetTask(const ZiLinkNetTask &) = delete;
+        ZiLinkNetTask &operator=(const ZiLinkNetTask &) = delete;
+
+        bool start(void (*body)(void *ctx), void *ctx, const Config &config);
+        bool start(void (*body)(void *ctx), void *ctx) { return start(body, ctx, Config()); }
+        // Waits for the current iteration to finish
+        void stop();
+        void notify();
+
+        bool running() const { return _running.load(std::memory_order_acquire); }
+        // True on the task itself
+        bool inTask() const;
+        uint32_t iterations() const { return _iterations.load(std::memory_order_relaxed); }
+
+private:
+        void run();
+        void idle();
+
+        void (*_body)(void *) = nullptr;
+        void *_ctx = nullptr;
+        Config _config;
+        std::atomic<bool> _running{false};
+        std::atomic<bool> _stop{false};
+        std::atomic<uint32_t> _iterations{0};
+#if defined(ESP32)
+        static void entry(void *self);
+        TaskHandle_t _handle = nullptr;
+#else
+        std::thread _thread;
+        std::mutex _mutex;
+        std::condition_variable _wake;
+        bool _notified = false;
+#endif
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include "ZiLinkOutbox.h"
+
+ZiLinkOutbox::ZiLinkOutbox()
+{
+  _queues[Control].resize(ZILINK_CONTROL_QUEUE_BYTES);
+  // A component's newest value makes the queued ones obsolete
+  _queues[State].setPolicy(ZiLinkRingBuffer::CoalesceByKey);
+  _queues[State].resize(ZILINK_STATE_QUEUE_BYTES);
+  _queues[Status].resize(ZILINK_STATUS_QUEUE_BYTES);
+  _queues[Telemetry].resize(ZILINK_QUEUE_BYTES);
+}
+
+bool ZiLinkOutbox::configure(Priority priority, size_t capacityBytes, ZiLinkRingBuffer::OverflowPolicy policy,
+                             uint32_t blockTimeoutMs)
+{
+  if (priority >= PRIORITIES || policy == ZiLinkRingBuffer::BlockWithTimeout)
+  {
+    return false;
+  }
+  _queues[priority].setPolicy(policy, blockTimeoutMs);
+  _deficit[priority] = 0;
+  return _queues[priority].resize(capacityBytes);
+}
+
+bool ZiLinkOutbox::push(Priority priority, uint8_t channel, uint16_t key, const char *data, size_t length)
+{
+  const uint32_t stamp = zilinkMicros();
+  if (priority >= PRIORITIES || !_queues[priority].push(channel, key, &stamp, STAMP_BYTES, data, length))
+  {
+    return false;
+  }
+  // Only a push raises the total, so the peak is taken here
+  const size_t used = usedBytes();
+  if (used > _highWaterBytes)
+  {
+    _highWaterBytes = used;
+  }
+  return true;
+}
+
+bool ZiLinkOutbox::empty() const
+{
+  for (uint8_t p = 0; p < PRIORITIES; p++)
+  {
+    if (!_queues[p].empty())
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t ZiLinkOutbox::pending(uint8_t channel) const
+{
+  size_t n = 0;
+  for (uint8_t p = 0; p < PRIORITIES; p++)
+  {
+    n += _queues[p].pending(channel);
+  }
+  return n;
+}
+
+size_t ZiLinkOutbox::usedBytes() const
+{
+  size_t n = 0;
+  for (uint8_t p = 0; p < PRIORITIES; p++)
+  {
+    n += _queues[p].usedBytes();
+  }
+  return n;
+}
+
+ZiLinkRingBuffer::Stats ZiLinkOutbox::stats() const
+{
+  ZiLinkRingBuffer::Stats sum;
+  for (uint8_t p = 0; p < PRIORITIES; p++)
+  {
+    const ZiLinkRingBuffer::Stats &s = _queues[p].stats();
+    sum.enqueued += s.enqueued;
+    sum.dropped += s.dropped;
+    sum.coalesced += s.coalesced;
+  }
+  sum.highWaterBytes = _highWaterBytes;
+  return sum;
+}
@@ -0,0 +1,197 @@
+#ifndef ZILINK_OUTBOX_H
+#define ZILINK_OUTBOX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "ZiLinkClock.h"
+#include "ZiLinkRingBuffer.h"
+#include "ZiLinkStats.h"
+
+// Default byte budget per priority class (telemetry: ZILINK_QUEUE_BYTES)
+#ifndef ZILINK_CONTROL_QUEUE_BYTES
+#define ZILINK_CONTROL_QUEUE_BYTES 512
+#endif
+
+#ifndef ZILINK_STATE_QUEUE_BYTES
+#define ZILINK_STATE_QUEUE_BYTES 1024
+#endif
+
+#ifndef ZILINK_STATUS_QUEUE_BYTES
+#define ZILINK_STATUS_QUEUE_BYTES 512
+#endif
+
+#ifndef ZILINK_QUEUE_BYTES
+#define ZILINK_QUEUE_BYTES 2048
+#endif
+
+// Bytes a class of weight 1 may send per scheduling round
+#ifndef ZILINK_OUTBOX_QUANTUM
+#define ZILINK_OUTBOX_QUANTUM 256
+#endif
+
+// Default budget of one service() call, i.e. of one loop()
+#ifndef ZILINK_OUTBOX_LOOP_BYTES
+#define ZILINK_OUTBOX_LOOP_BYTES 4096
+#endif
+
+#ifndef ZILINK_OUTBOX_LOOP_US
+#define ZILINK_OUTBOX_LOOP_US 10000
+#endif
+
+// Outbound queue split into priority classes, each a ZiLinkRingBuffer with
+// its own byte budget and overflow policy, so a telemetry backlog can
+// neither evict nor hold up command responses, component state or status
+// messages.
+//
+// service() sends queued records by weighted deficit round robin. In every
+// round each class, highest first, may send up to weight x
+// ZILINK_OUTBOX_QUANTUM bytes (credit left over by a large record carries
+// into the next round). Rounds repeat until nothing more can be sent or
+// the call's budget of bytes or microseconds is spent, so one loop() never
+// replays a whole backlog and the records after the budget wait for the
+// next call. Within a channel, records keep their order.
+//
+// Each record is stamped when it is queued. The time until it is sent is
+// recorded per class.
+class ZiLinkOutbox
+{
+public:
+        enum Priority : uint8_t
+        {
+                Control,   // command responses
+                State,     // component updates
+                Status,    // status messages
+                Telemetry, // readings
+        };
+        static const uint8_t PRIORITIES = 4;
+
+        struct ClassStats
+        {
+                uint32_t sent = 0;
+                ZiLinkHistogram waitUs; // queued -> sent
+        };
+
+        ZiLinkOutbox();
+
+        // Reallocates the class's arena; its queued records are discarded.
+        // BlockWithTimeout is refused: a push happens inside a send call,
+        // where nothing can drain the queue without re-entering it.
+        bool configure(Priority priority, size_t capacityBytes,
+                       ZiLinkRingBuffer::OverflowPolicy policy = ZiLinkRingBuffer::DropOldest,
+                       uint32_t blockTimeoutMs = 0);
+        // Share of each round; 8, 4, 2 and 1 by default. At least 1.
+        void setWeight(Priority priority, uint8_t weight) { _weight[priority] = weight ? weight : 1; }
+        // Per service() call; at least one record is sent when one can be
+        void setBudget(size_t bytes, uint32_t us)
+        {
+                _budgetBytes = bytes;
+                _budgetUs = us;
+        }
+        bool push(Priority priority, uint8_t channel, uint16_t key, const char *data, size_t length);
+
+        // `send(const ZiLinkRingBuffer::Record &)` returns true once the
+        // record is sent; false leaves it queued. See the class comment.
+        template <typename Fn>
+        void service(Fn send);
+
+        bool empty() const;
+        size_t pending(uint8_t channel) const;
+        size_t usedBytes() const;
+        // Summed over the classes; highWaterBytes is the peak of the
+        // arena as a whole, not a sum of the classes' own peaks
+        ZiLinkRingBuffer::Stats stats() const;
+        const ZiLinkRingBuffer &queue(Priority priority) const { return _queues[priority]; }
+        const ClassStats &classStats(Priority priority) const { return _stats[priority]; }
+        // The last service() stopped on its budget with records left
+        bool exhausted() const { return _exhausted && !empty(); }
+        uint32_t budgetStops() const { return _budgetStops; }
+
+private:
+        static const size_t STAMP_BYTES = sizeof(uint32_t);
+
+        ZiLinkRingBuffer _queues[PRIORITIES];
+        uint8_t _weight[PRIORITIES] = {8, 4, 2, 1};
+        uint32_t _deficit[PRIORITIES] = {};
+        ClassStats _stats[PRIORITIES];
+        size_t _budgetBytes = ZILINK_OUTBOX_LOOP_BYTES;
+        uint32_t _budgetUs = ZILINK_OUTBOX_LOOP_US;
+        bool _exhausted = false;
+        uint32_t _budgetStops = 0;
+        size_t _highWaterBytes = 0;
+};
+
+template <typename Fn>
+void ZiLinkOutbox::service(Fn send)
+{
+        _exhausted = false;
+        if (empty())
+        {
+                return;
+        }
+        const uint32_t start = zilinkMicros();
+        size_t spent = 0;
+        bool again = true;
+        while (again && !_exhausted)
+        {
+                again = false;
+                for (uint8_t p = 0; p < PRIORITIES && !_exhausted; p++)
+                {
+                        ZiLinkRingBuffer &q = _queues[p];
+                        if (q.empty())
+                        {
+                                _deficit[p] = 0;
+                                continue;
+                        }
+                        _deficit[p] += (uint32_t)_weight[p] * ZILINK_OUTBOX_QUANTUM;
+                        bool waiting = false; // a record needs more credit than this round gave
+                        q.drain([&](const ZiLinkRingBuffer::Record &r)
+                                {
+                                        if (waiting || _exhausted)
+                                        {
+                                                return false;
+                                        }
+                                        const size_t length = r.length - STAMP_BYTES;
+                                        if (length > _deficit[p])
+                                        {
+                                                waiting = true;
+                                                return false;
+                                        }
+                                        if (spent > 0 && (spent >= _budgetBytes || zilinkMicros() - start >= _budgetUs))
+                                        {
+                                                _exhausted = true;
+                                                return false;
+                                        }
+                                        const ZiLinkRingBuffer::Record record = {r.channel, r.key, r.data + STAMP_BYTES, length};
+                                        if (!send(record))
+                                        {
+                                                return false;
+                                        }
+                                        uint32_t stamp;
+                                        memcpy(&stamp, r.data, STAMP_BYTES);
+                                        _stats[p].sent++;
+                                        _stats[p].waitUs.record(zilinkMicros() - stamp);
+                                        _deficit[p] -= length;
+                                        spent += length ? length : 1;
+                                        again = true;
+                                        return true;
+                                });
+                        if (waiting)
+                        {
+                                // Credit grows every round, so the record goes out eventually
+                                again = true;
+                        }
+                        else
+                        {
+                                // Sent everything it could: unused credit is not saved up
+                                _deficit[p] = 0;
+                        }
+                }
+        }
+        if (_exhausted)
+        {
+                _budgetStops++;
+        }
+}
+
+#endif
@@ -0,0 +1,309 @@
+#include "ZiLinkRingBuffer.h"
+
+#include <new>
+#include <string.h>
+#include "ZiLinkClock.h"
+
+ZiLinkRingBuffer::ZiLinkRingBuffer(size_t capacityBytes, OverflowPolicy policy) : _policy(policy)
+{
+  resize(capacityBytes);
+}
+
+ZiLinkRingBuffer::~ZiLinkRingBuffer()
+{
+  delete[] _buf;
+}
+
+bool ZiLinkRingBuffer::resize(size_t capacityBytes)
+{
+  delete[] _buf;
+  _buf = nullptr;
+  _cap = 0;
+  if (capacityBytes > 0)
+  {
+    _buf = new (std::nothrow) uint8_t[capacityBytes];
+    if (_buf)
+    {
+      _cap = capacityBytes;
+    }
+  }
+  clear();
+  return _cap == capacityBytes;
+}
+
+void ZiLinkRingBuffer::setPolicy(OverflowPolicy policy, uint32_t blockTimeoutMs)
+{
+  _policy = policy;
+  _blockTimeoutMs = blockTimeoutMs;
+}
+
+void ZiLinkRingBuffer::setWaitHook(void (*hook)(void *ctx), void *ctx)
+{
+  _waitHook = hook;
+  _waitCtx = ctx;
+}
+
+void ZiLinkRingBuffer::clear()
+{
+  _head = _tail = _used = _records = 0;
+  memset(_perChannel, 0, sizeof(_perChannel));
+}
+
+uint16_t ZiLinkRingBuffer::keyOf(const char *s)
+{
+  uint32_t h = 2166136261u;
+  while (s && *s)
+  {
+    h ^= (uint8_t)*s++;
+    h *= 16777619u;
+  }
+  uint16_t k = (uint16_t)(h ^ (h >> 16));
+  return k ? k : 1;
+}
+
+void ZiLinkRingBuffer::readHeader(size_t offset, Header &h) const
+{
+  const uint8_t *p = _buf + offset;
+  h.length = (uint16_t)(p[0] | (p[1] << 8));
+  h.key = (uint16_t)(p[2] | (p[3] << 8));
+  h.channel = p[4];
+  h.flags = p[5];
+}
+
+void ZiLinkRingBuffer::writeHeader(size_t offset, const Header &h)
+{
+  uint8_t *p = _buf + offset;
+  p[0] = (uint8_t)h.length;
+  p[1] = (uint8_t)(h.length >> 8);
+  p[2] = (uint8_t)h.key;
+  p[3] = (uint8_t)(h.key >> 8);
+  p[4] = h.channel;
+  p[5] = h.flags;
+}
+
+void ZiLinkRingBuffer::kill(size_t offset)
+{
+  Header h;
+  readHeader(offset, h);
+  if (h.flags & (FLAG_PAD | FLAG_DEAD))
+  {
+    return;
+  }
+  _buf[offset + 5] = h.flags | FLAG_DEAD;
+  _records--;
+  if (h.channel < MAX_CHANNELS)
+  {
+    _perChannel[h.channel]--;
+  }
+}
+
+void ZiLinkRingBuffer::trimHead()
+{
+  // Release padding and tombstones at the front so their bytes can be reused
+  while (_used > 0)
+  {
+    if (_cap - _head < HEADER_SIZE)
+    {
+      _used -= _cap - _head;
+      _head = 0;
+      continue;
+    }
+    Header h;
+    readHeader(_head, h);
+    if (!(h.flags & (FLAG_PAD | FLAG_DEAD)))
+    {
+      break;
+    }
+    const size_t total = HEADER_SIZE + h.length;
+    _used -= total;
+    _head += total;
+    if (_head == _cap)
+    {
+      _head = 0;
+    }
+  }
+  if (_used == 0)
+  {
+    // Restart at the beginning to maximise contiguous space
+    _head = _tail = 0;
+  }
+}
+
+bool ZiLinkRingBuffer::front(Record &out)
+{
+  trimHead();
+  if (_records == 0)
+  {
+    return false;
+  }
+  Header h;
+  readHeader(_head, h);
+  out.channel = h.channel;
+  out.key = h.key;
+  out.data = (const char *)_buf + _head + HEADER_SIZE;
+  out.length = h.length;
+  return true;
+}
+
+void ZiLinkRingBuffer::pop()
+{
+  trimHead();
+  if (_records == 0)
+  {
+    return;
+  }
+  kill(_head);
+  trimHead();
+}
+
+void ZiLinkRingBuffer::dropOldest()
+{
+  pop();
+  _stats.dropped++;
+}
+
+bool ZiLinkRingBuffer::reserve(size_t total, size_t &offset)
+{
+  if (_used == 0)
+  {
+    _head = _tail = 0;
+  }
+  if (_used > 0 && _tail <= _head)
+  {
+    // Free space is the gap between tail and head
+    if (_head - _tail < total)
+    {
+      return false;
+    }
+    offset = _tail;
+    return true;
+  }
+  // Free space is [tail, cap) followed by [0, head)
+  if (_cap - _tail >= total)
+  {
+    offset = _tail;
+    return true;
+  }
+  if (_head < total)
+  {
+    return false;
+  }
+  // Pad out the end of the arena and wrap
+  const size_t pad = _cap - _tail;
+  if (pad >= HEADER_SIZE)
+  {
+    Header h = {(uint16_t)(pad - HEADER_SIZE), 0, 0, FLAG_PAD};
+    writeHeader(_tail, h);
+  }
+  _used += pad;
+  _tail = 0;
+  offset = 0;
+  return true;
+}
+
+bool ZiLinkRingBuffer::makeRoom(size_t total)
+{
+  // reserve() commits padding, so probe with a side-effect free check first
+  for (;;)
+  {
+    const bool wrapped = _used > 0 && _tail <= _head;
+    const size_t contiguous = wrapped ? _head - _tail : (_cap - _tail >= total ? _cap - _tail : _head);
+    if (_used == 0 || contiguous >= total)
+    {
+      return true;
+    }
+    if (_records == 0)
+    {
+      // Only padding/tombstones left
+      trimHead();
+      continue;
+    }
+    if (_policy != DropOldest && _policy != CoalesceByKey)
+    {
+      return false;
+    }
+    dropOldest();
+  }
+}
+
+void ZiLinkRingBuffer::coalesce(uint8_t channel, uint16_t key)
+{
+  if (channel >= MAX_CHANNELS || _perChannel[channel] == 0)
+  {
+    return;
+  }
+  const size_t before = _records;
+  drain([&](const Record &r)
+        { return r.channel == channel && r.key == key; });
+  _stats.coalesced += (uint32_t)(before - _records);
+}
+
+bool ZiLinkRingBuffer::push(uint8_t channel, uint16_t key, const char *data, size_t length)
+{
+  return push(channel, key, nullptr, 0, data, length);
+}
+
+bool ZiLinkRingBuffer::push(uint8_t channel, uint16_t key, const void *prefix, size_t prefixLength, const char *data,
+                            size_t dataLength)
+{
+  const size_t length = prefixLength + dataLength;
+  const size_t total = HEADER_SIZE + length;
+  if (_cap == 0 || length > MAX_RECORD || total > _cap)
+  {
+    _stats.dropped++;
+    return false;
+  }
+  if (_policy == CoalesceByKey && key != 0)
+  {
+    coalesce(channel, key);
+  }
+
+  if (!makeRoom(total) && _policy == BlockWithTimeout)
+  {
+    const uint32_t start = zilinkMillis();
+    do
+    {
+      if (_waitHook)
+      {
+        _waitHook(_waitCtx);
+      }
+      else
+      {
+        zilinkYield();
+      }
+      trimHead();
+    } while (!makeRoom(total) && (uint32_t)(zilinkMillis() - start) < _blockTimeoutMs);
+  }
+
+  size_t offset;
+  if (!makeRoom(total) || !reserve(total, offset))
+  {
+    _stats.dropped++;
+    return false;
+  }
+
+  Header h = {(uint16_t)length, key, channel, 0};
+  writeHeader(offset, h);
+  if (prefixLength)
+  {
+    memcpy(_buf + offset + HEADER_SIZE, prefix, prefixLength);
+  }
+  memcpy(_buf + offset + HEADER_SIZE + prefixLength, data, dataLength);
+  _tail = offset + total;
+  if (_tail == _cap)
+  {
+    _tail = 0;
+  }
+  _used += total;
+  _records++;
+  if (channel < MAX_CHANNELS)
+  {
+    _perChannel[channel]++;
+  }
+  _stats.enqueued++;
+  if (_used > _stats.highWaterBytes)
+  {
+    _stats.highWaterBytes = _used;
+  }
+  return true;
+}
@@ -0,0 +1,153 @@
+#ifndef ZILINK_RING_BUFFER_H
+#define ZILINK_RING_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Byte-budgeted FIFO of length-prefixed records in one contiguous arena.
+// The arena is allocated once (constructor or resize()); pushing and
+// popping never touch the heap. A record is never split across the end of
+// the arena, so every payload can be handed to a transport as one pointer.
+//
+// Each record carries a small channel id (< MAX_CHANNELS) so several
+// transports can share one budget, and an optional 16-bit key used by the
+// CoalesceByKey policy to keep only the latest value per key.
+class ZiLinkRingBuffer
+{
+public:
+        enum OverflowPolicy
+        {
+                DropOldest,       // evict the oldest records until the new one fits
+                DropNewest,       // reject the new record
+                BlockWithTimeout, // run the wait hook until space frees up, then drop newest
+                CoalesceByKey     // a keyed record replaces queued ones with the same key, then drop oldest
+        };
+
+        struct Stats
+        {
+                uint32_t enqueued = 0;
+                uint32_t dropped = 0;
+                uint32_t coalesced = 0;
+                size_t highWaterBytes = 0;
+        };
+
+        struct Record
+        {
+                uint8_t channel;
+                uint16_t key;
+                const char *data;
+                size_t length;
+        };
+
+        static const uint8_t MAX_CHANNELS = 8;
+        static const size_t HEADER_SIZE = 6;
+        static const size_t MAX_RECORD = 0xFFFF;
+
+        explicit ZiLinkRingBuffer(size_t capacityBytes = 0, OverflowPolicy policy = DropOldest);
+        ~ZiLinkRingBuffer();
+        ZiLinkRingBuffer(const ZiLinkRingBuffer &) = delete;
+        ZiLinkRingBuffer &operator=(const ZiLinkRingBuffer &) = delete;
+
+        // Reallocates the arena; queued records are discarded
+        bool resize(size_t capacityBytes);
+        void setPolicy(OverflowPolicy policy, uint32_t blockTimeoutMs = 0);
+        // Invoked repeatedly while a BlockWithTimeout push waits for space
+        void setWaitHook(void (*hook)(void *ctx), void *ctx);
+
+        bool push(uint8_t channel, uint16_t key, const char *data, size_t length);
+        // The record is `prefix` followed by `data` (e.g. a timestamp in front of a frame)
+        bool push(uint8_t channel, uint16_t key, const void *prefix, size_t prefixLength, const char *data,
+                  size_t length);
+        bool front(Record &out);
+        void pop();
+        void clear();
+
+        // Visits live records oldest-first. `fn(const Record &)` returns true
+        // when it consumed the record. Stops after `maxConsumed` records.
+        template <typename Fn>
+        size_t drain(Fn fn, size_t maxConsumed = (size_t)-1);
+
+        bool empty() const { return _records == 0; }
+        size_t records() const { return _records; }
+        size_t pending(uint8_t channel) const { return channel < MAX_CHANNELS ? _perChannel[channel] : 0; }
+        size_t usedBytes() const { return _used; }
+        size_t capacity() const { return _cap; }
+        const Stats &stats() const { return _stats; }
+
+        // FNV-1a folded to 16 bits; never returns 0 (0 means "no key")
+        static uint16_t keyOf(const char *s);
+
+private:
+        static const uint8_t FLAG_PAD = 0x01;
+        static const uint8_t FLAG_DEAD = 0x02;
+
+        struct Header
+        {
+                uint16_t length;
+                uint16_t key;
+                uint8_t channel;
+                uint8_t flags;
+        };
+
+        bool reserve(size_t total, size_t &offset);
+        bool makeRoom(size_t total);
+        void coalesce(uint8_t channel, uint16_t key);
+        void readHeader(size_t offset, Header &h) const;
+        void writeHeader(size_t offset, const Header &h);
+        void kill(size_t offset);
+        void trimHead();
+        void dropOldest();
+
+        uint8_t *_buf = nullptr;
+        size_t _cap = 0;
+        size_t _head = 0;
+        size_t _tail = 0;
+        size_t _used = 0;
+        size_t _records = 0;
+        size_t _perChannel[MAX_CHANNELS] = {};
+        OverflowPolicy _policy;
+        uint32_t _blockTimeoutMs = 0;
+        void (*_waitHook)(void *) = nullptr;
+        void *_waitCtx = nullptr;
+        Stats _stats;
+};
+
+template <typename Fn>
+size_t ZiLinkRingBuffer::drain(Fn fn, size_t maxConsumed)
+{
+        size_t consumed = 0;
+        size_t pos = _head;
+        size_t remaining = _used;
+        while (remaining > 0 && consumed < maxConsumed)
+        {
+                if (_cap - pos < HEADER_SIZE)
+                {
+                        // Implicit padding too short for a header
+                        remaining -= _cap - pos;
+                        pos = 0;
+                        continue;
+                }
+                Header h;
+                readHeader(pos, h);
+                const size_t total = HEADER_SIZE + h.length;
+                if (!(h.flags & (FLAG_PAD | FLAG_DEAD)))
+                {
+                        Record r = {h.channel, h.key, (const char *)_buf + pos + HEADER_SIZE, h.length};
+                        if (fn(r))
+                        {
+                                kill(pos);
+                                consumed++;
+                        }
+                }
+                remaining -= total;
+                pos += total;
+                if (pos == _cap)
+                {
+                        pos = 0;
+                }
+        }
+        trimHead();
+        return consumed;
+}
+
+#endif
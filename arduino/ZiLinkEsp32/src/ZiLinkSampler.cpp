@@ -0,0 +1,82 @@
+#include "ZiLinkSampler.h"
+
+bool ZiLinkSampler::add(const char *name, uint32_t periodUs, uint32_t windowMs, ReadFn read, uint8_t decimals,
+                        uint32_t nowUs)
+{
+  const uint64_t windowUs = (uint64_t)windowMs * 1000;
+  if (_count >= ZILINK_MAX_SAMPLED || !read || periodUs == 0 || windowUs < periodUs || windowUs > INT32_MAX)
+  {
+    return false;
+  }
+  Slot &s = _slots[_count++];
+  s.sensor.name = name;
+  s.sensor.decimals = decimals;
+  s.read = read;
+  s.periodUs = periodUs;
+  s.windowUs = (uint32_t)windowUs;
+  s.nextUs = nowUs;
+  s.windowEndUs = nowUs + s.windowUs;
+  s.n = 0;
+  return true;
+}
+
+uint32_t ZiLinkSampler::nextDueUs() const
+{
+  uint32_t due = 0;
+  for (uint8_t i = 0; i < _count; i++)
+  {
+    const Slot &s = _slots[i];
+    const uint32_t at = reached(s.nextUs, s.windowEndUs) ? s.windowEndUs : s.nextUs;
+    if (i == 0 || (int32_t)(at - due) < 0)
+    {
+      due = at;
+    }
+  }
+  return due;
+}
+
+void ZiLinkSampler::sample(Slot &s, uint32_t nowUs)
+{
+  const float v = s.read();
+  _stats.lateUs.record(nowUs - s.nextUs);
+  _stats.samples++;
+  s.nextUs += s.periodUs;
+  if (s.n == 0)
+  {
+    s.min = s.max = v;
+    s.sum = 0;
+    s.carry = 0;
+  }
+  else if (v < s.min)
+  {
+    s.min = v;
+  }
+  else if (v > s.max)
+  {
+    s.max = v;
+  }
+  // Kahan summation: the low bits lost in sum + v are carried into the next add
+  const float y = v - s.carry;
+  const float t = s.sum + y;
+  s.carry = (t - s.sum) - y;
+  s.sum = t;
+  s.last = v;
+  s.n++;
+}
+
+bool ZiLinkSampler::close(Slot &s, Window &out)
+{
+  s.windowEndUs += s.windowUs;
+  if (s.n == 0)
+  {
+    return false;
+  }
+  out.min = s.min;
+  out.max = s.max;
+  out.mean = s.sum / s.n;
+  out.last = s.last;
+  out.count = s.n;
+  s.n = 0;
+  _stats.windows++;
+  return true;
+}
@@ -0,0 +1,134 @@
+#ifndef ZILINK_SAMPLER_H
+#define ZILINK_SAMPLER_H
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include "ZiLinkStats.h"
+
+#ifndef ZILINK_MAX_SAMPLED
+#define ZILINK_MAX_SAMPLED 8
+#endif
+
+// Fixed-rate sampling with windowed aggregation. Each sensor has a read
+// function, a sample period and a window length. service() takes every
+// sample that is due and folds it into the sensor's current window
+// (min/max/mean/last/count). When a window ends, it is handed over as one
+// reading. Uplink volume therefore depends on the window, not the sample
+// rate.
+//
+// Samples follow a fixed grid (start + n * period), so timing errors do not
+// accumulate. A sample taken late still belongs to the window of its grid
+// slot. If service() falls behind by whole periods, only one sample is
+// taken and the skipped slots are counted as missed. Windows follow their
+// own grid too.
+//
+// Fixed memory, no allocation after add(). Times are micros(), so a
+// window must be shorter than 35 minutes. Rates are bounded by how often
+// service() runs; lateness is in stats().
+class ZiLinkSampler
+{
+public:
+        typedef std::function<float()> ReadFn;
+
+        struct Window
+        {
+                float min;
+                float max;
+                float mean;
+                float last;
+                uint32_t count;
+        };
+
+        struct Sensor
+        {
+                const char *name; // kept by pointer
+                uint8_t decimals;
+        };
+
+        struct Stats
+        {
+                uint32_t samples = 0;
+                uint32_t missed = 0;  // grid slots skipped because service() was late
+                uint32_t windows = 0; // emitted (empty windows are skipped)
+                ZiLinkHistogram lateUs; // how long after its slot each sample was read
+        };
+
+        // periodUs > 0, one period <= windowMs < 35 min; false when out of
+        // range or the table is full
+        bool add(const char *name, uint32_t periodUs, uint32_t windowMs, ReadFn read, uint8_t decimals = 2,
+                 uint32_t nowUs = 0);
+        // Drops every sensor
+        void clear() { _count = 0; }
+        uint8_t count() const { return _count; }
+        // Earliest pending sample or window end; lets a caller sleep until then
+        uint32_t nextDueUs() const;
+
+        // Takes the due samples and calls `emit(const Sensor &, const Window &)`
+        // for every window that ended
+        template <typename Emit>
+        void service(uint32_t nowUs, Emit emit);
+
+        const Stats &stats() const { return _stats; }
+
+private:
+        struct Slot
+        {
+                Sensor sensor;
+                ReadFn read;
+                uint32_t periodUs;
+                uint32_t windowUs;
+                uint32_t nextUs;      // grid slot of the next sample
+                uint32_t windowEndUs; // samples before this go in the current window
+                float min;
+                float max;
+                float sum;
+                float carry; // Kahan compensation, so long windows keep their mean
+                float last;
+                uint32_t n;
+        };
+
+        static bool reached(uint32_t nowUs, uint32_t atUs) { return (int32_t)(nowUs - atUs) >= 0; }
+        void sample(Slot &s, uint32_t nowUs);
+        bool close(Slot &s, Window &out);
+
+        Slot _slots[ZILINK_MAX_SAMPLED];
+        uint8_t _count = 0;
+        Stats _stats;
+};
+
+template <typename Emit>
+void ZiLinkSampler::service(uint32_t nowUs, Emit emit)
+{
+        for (uint8_t i = 0; i < _count; i++)
+        {
+                Slot &s = _slots[i];
+                for (;;)
+                {
+                        if (reached(nowUs, s.nextUs))
+                        {
+                                // Whole periods behind: sample the latest slot, count the rest as missed
+                                const uint32_t behind = (nowUs - s.nextUs) / s.periodUs;
+                                s.nextUs += behind * s.periodUs;
+                                _stats.missed += behind;
+                                if (!reached(s.nextUs, s.windowEndUs))
+                                {
+                                        sample(s, nowUs);
+                                        continue;
+                                }
+                        }
+                        if (!reached(nowUs, s.windowEndUs))
+                        {
+                                break;
+                        }
+                        // Every slot of the window has been sampled or skipped
+                        Window w;
+                        if (close(s, w))
+                        {
+                                emit(s.sensor, w);
+                        }
+                }
+        }
+}
+
+#endif
@@ -0,0 +1,165 @@
+#include "ZiLinkSpscRing.h"
+
+#include <new>
+#include <string.h>
+
+ZiLinkSpscRing::ZiLinkSpscRing(size_t capacityBytes)
+{
+  resize(capacityBytes);
+}
+
+ZiLinkSpscRing::~ZiLinkSpscRing()
+{
+  delete[] _buf;
+}
+
+bool ZiLinkSpscRing::resize(size_t capacityBytes)
+{
+  delete[] _buf;
+  _buf = nullptr;
+  _cap = 0;
+  // Records are 4-byte aligned, so a wrap marker always fits at the end
+  capacityBytes &= ~(size_t)3;
+  if (capacityBytes > 0)
+  {
+    _buf = new (std::nothrow) uint8_t[capacityBytes];
+    if (_buf)
+    {
+      _cap = capacityBytes;
+    }
+  }
+  _head.store(0, std::memory_order_relaxed);
+  _tail.store(0, std::memory_order_relaxed);
+  _reservedLength = 0;
+  return _cap == capacityBytes && _cap > 0;
+}
+
+void ZiLinkSpscRing::writeHeader(size_t offset, uint16_t length, uint8_t tag)
+{
+  uint8_t *h = _buf + offset;
+  memcpy(h, &length, sizeof(length));
+  h[2] = tag;
+  h[3] = 0;
+}
+
+uint8_t *ZiLinkSpscRing::reserve(size_t length)
+{
+  const size_t total = align(HEADER_SIZE + length);
+  if (_cap == 0 || length > MAX_RECORD)
+  {
+    _dropped.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  const size_t head = _head.load(std::memory_order_relaxed);
+  const size_t tail = _tail.load(std::memory_order_acquire);
+  // The writer never catches up with the reader: head == tail means empty
+  if (head >= tail)
+  {
+    if (head + total < _cap || (head + total == _cap && tail != 0))
+    {
+      _reserved = head;
+      _wrapPending = false;
+    }
+    else if (total < tail)
+    {
+      // Not enough room before the end: continue at the start
+      _reserved = 0;
+      _wrapPending = true;
+    }
+    else
+    {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+  }
+  else if (head + total < tail)
+  {
+    _reserved = head;
+    _wrapPending = false;
+  }
+  else
+  {
+    _dropped.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  _reservedLength = length;
+  return _buf + _reserved + HEADER_SIZE;
+}
+
+void ZiLinkSpscRing::commit(uint8_t tag, size_t length)
+{
+  if (length > _reservedLength)
+  {
+    length = _reservedLength;
+  }
+  if (_wrapPending)
+  {
+    writeHeader(_head.load(std::memory_order_relaxed), WRAP, 0);
+  }
+  writeHeader(_reserved, (uint16_t)length, tag);
+  size_t next = _reserved + align(HEADER_SIZE + length);
+  if (next == _cap)
+  {
+    next = 0;
+  }
+  _reservedLength = 0;
+  _pushed.fetch_add(1, std::memory_order_relaxed);
+  // Publish the record before the index
+  _head.store(next, std::memory_order_release);
+}
+
+bool ZiLinkSpscRing::push(uint8_t tag, const void *data, size_t length)
+{
+  uint8_t *p = reserve(length);
+  if (!p)
+  {
+    return false;
+  }
+  memcpy(p, data, length);
+  commit(tag, length);
+  return true;
+}
+
+bool ZiLinkSpscRing::front(uint8_t &tag, const uint8_t *&data, size_t &length)
+{
+  size_t tail = _tail.load(std::memory_order_relaxed);
+  const size_t head = _head.load(std::memory_order_acquire);
+  if (tail == head)
+  {
+    return false;
+  }
+  uint16_t n;
+  memcpy(&n, _buf + tail, sizeof(n));
+  if (n == WRAP)
+  {
+    tail = 0;
+    _tail.store(0, std::memory_order_release);
+    if (tail == head)
+    {
+      return false;
+    }
+    memcpy(&n, _buf, sizeof(n));
+  }
+  tag = _buf[tail + 2];
+  data = _buf + tail + HEADER_SIZE;
+  length = n;
+  return true;
+}
+
+void ZiLinkSpscRing::pop()
+{
+  uint8_t tag;
+  const uint8_t *data;
+  size_t length;
+  if (!front(tag, data, length))
+  {
+    return;
+  }
+  size_t next = (size_t)(data - _buf) + align(length);
+  if (next == _cap)
+  {
+    next = 0;
+  }
+  // Hand the bytes back to the producer only once we are done reading them
+  _tail.store(next, std::memory_order_release);
+}
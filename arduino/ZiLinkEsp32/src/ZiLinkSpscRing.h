@@ -0,0 +1,63 @@
+#ifndef ZILINK_SPSC_RING_H
+#define ZILINK_SPSC_RING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Lock-free single-producer/single-consumer FIFO of tagged, variable-length
+// records in one arena. The producer writes a record in place (reserve(),
+// then commit()) and the consumer reads it in place (front(), then pop()),
+// so a record is copied once. Records never wrap, so each payload is one
+// contiguous block, and a record of up to half the capacity always fits
+// once the ring has drained. Neither side blocks: reserve() fails when the
+// record does not fit, and the failure is counted.
+class ZiLinkSpscRing
+{
+public:
+        static const size_t HEADER_SIZE = 4;
+        static const size_t MAX_RECORD = 0xFFFE;
+
+        explicit ZiLinkSpscRing(size_t capacityBytes = 0);
+        ~ZiLinkSpscRing();
+        ZiLinkSpscRing(const ZiLinkSpscRing &) = delete;
+        ZiLinkSpscRing &operator=(const ZiLinkSpscRing &) = delete;
+
+        // Not safe while either side is active; queued records are discarded
+        bool resize(size_t capacityBytes);
+
+        // Producer side. reserve() returns room for `length` payload bytes or
+        // nullptr; commit() publishes the first `length` of them.
+        uint8_t *reserve(size_t length);
+        void commit(uint8_t tag, size_t length);
+        bool push(uint8_t tag, const void *data, size_t length);
+
+        // Consumer side. The payload stays valid until pop().
+        bool front(uint8_t &tag, const uint8_t *&data, size_t &length);
+        void pop();
+
+        bool empty() const { return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire); }
+        size_t capacity() const { return _cap; }
+        uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+        uint32_t pushed() const { return _pushed.load(std::memory_order_relaxed); }
+
+private:
+        static const uint16_t WRAP = 0xFFFF;
+
+        static size_t align(size_t n) { return (n + 3) & ~(size_t)3; }
+        void writeHeader(size_t offset, uint16_t length, uint8_t tag);
+
+        uint8_t *_buf = nullptr;
+        size_t _cap = 0;
+        // Offsets in [0, _cap): _head written by the producer, _tail by the consumer
+        std::atomic<size_t> _head{0};
+        std::atomic<size_t> _tail{0};
+        // Producer-only: where the reserved record starts (after a wrap marker, 0)
+        size_t _reserved = 0;
+        size_t _reservedLength = 0;
+        bool _wrapPending = false;
+        std::atomic<uint32_t> _dropped{0};
+        std::atomic<uint32_t> _pushed{0};
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include "ZiLinkStats.h"
+
+#ifdef ESP32
+#include <esp_system.h>
+#endif
+
+uint8_t ZiLinkHistogram::bucketOf(uint32_t value)
+{
+  const uint32_t sub = 1u << SUB_BITS;
+  if (value < sub)
+  {
+    return (uint8_t)value;
+  }
+  uint8_t msb = 31;
+  while (!(value & (1u << msb)))
+  {
+    msb--;
+  }
+  // The SUB_BITS bits below the leading one pick the bucket within the octave
+  const uint32_t bucket = sub + (msb - SUB_BITS) * sub + ((value >> (msb - SUB_BITS)) & (sub - 1));
+  return bucket < BUCKETS ? (uint8_t)bucket : BUCKETS - 1;
+}
+
+uint32_t ZiLinkHistogram::upperBound(uint8_t i)
+{
+  const uint32_t sub = 1u << SUB_BITS;
+  if (i >= BUCKETS - 1)
+  {
+    return UINT32_MAX;
+  }
+  if (i < 2 * sub)
+  {
+    return i;
+  }
+  const uint8_t shift = (i - sub) / sub;
+  const uint32_t lower = (sub + i % sub) << shift;
+  return lower + (1u << shift) - 1;
+}
+
+void ZiLinkHistogram::record(uint32_t value)
+{
+  _buckets[bucketOf(value)]++;
+  _count++;
+  _sum += value;
+  if (value > _max)
+  {
+    _max = value;
+  }
+}
+
+void ZiLinkHistogram::reset()
+{
+  for (uint8_t i = 0; i < BUCKETS; i++)
+  {
+    _buckets[i] = 0;
+  }
+  _count = 0;
+  _max = 0;
+  _sum = 0;
+}
+
+uint32_t ZiLinkHistogram::percentile(uint8_t pct) const
+{
+  if (_count == 0)
+  {
+    return 0;
+  }
+  // Rank of the sample, rounded up so p100 is the last one
+  const uint64_t rank = ((uint64_t)_count * (pct > 100 ? 100 : pct) + 99) / 100;
+  uint64_t seen = 0;
+  for (uint8_t i = 0; i < BUCKETS; i++)
+  {
+    seen += _buckets[i];
+    if (seen >= rank && seen > 0)
+    {
+      const uint32_t bound = upperBound(i);
+      return bound < _max ? bound : _max;
+    }
+  }
+  return _max;
+}
+
+uint32_t zilinkHeapFree()
+{
+#ifdef ESP32
+  return esp_get_free_heap_size();
+#else
+  return 0;
+#endif
+}
+
+uint32_t zilinkHeapMinFree()
+{
+#ifdef ESP32
+  return esp_get_minimum_free_heap_size();
+#else
+  return 0;
+#endif
+}
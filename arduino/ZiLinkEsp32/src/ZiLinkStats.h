@@ -0,0 +1,95 @@
+#ifndef ZILINK_STATS_H
+#define ZILINK_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Histograms resolve values below 2^ZILINK_HISTOGRAM_OCTAVES (16.7 s in
+// us by default); larger ones share the last bucket
+#ifndef ZILINK_HISTOGRAM_OCTAVES
+#define ZILINK_HISTOGRAM_OCTAVES 24
+#endif
+
+// Log-linear histogram of uint32 samples (durations in us, delays in ms):
+// every power of two is split into 4 buckets, so a bucket is at most 25%
+// wide and values below 8 are exact. 92 buckets, 384 bytes, fixed.
+// record() is a handful of instructions, no allocation and no locking; it
+// is meant to stay on in production. It has one writer; a reader on
+// another core may see a slightly stale copy.
+class ZiLinkHistogram
+{
+public:
+        static const uint8_t SUB_BITS = 2;
+        static const uint8_t BUCKETS = (1 << SUB_BITS) * (ZILINK_HISTOGRAM_OCTAVES - SUB_BITS + 1);
+
+        void record(uint32_t value);
+        void reset();
+
+        uint32_t count() const { return _count; }
+        uint32_t maximum() const { return _max; }
+        uint32_t mean() const { return _count ? (uint32_t)(_sum / _count) : 0; }
+        uint32_t bucket(uint8_t i) const { return i < BUCKETS ? _buckets[i] : 0; }
+        // Upper bound of the bucket holding the pct-th percentile (0..100);
+        // never more than maximum()
+        uint32_t percentile(uint8_t pct) const;
+
+        static uint8_t bucketOf(uint32_t value);
+        // Largest value counted in bucket i
+        static uint32_t upperBound(uint8_t i);
+
+private:
+        uint32_t _buckets[BUCKETS] = {};
+        uint32_t _count = 0;
+        uint32_t _max = 0;
+        uint64_t _sum = 0;
+};
+
+// Counters for one transport, updated by whoever owns it (loop() or the
+// network task).
+struct ZiLinkTransportStats
+{
+        uint32_t framesSent = 0;
+        uint32_t bytesSent = 0; // payload bytes; wraps at 4 GiB
+        uint32_t sendFailures = 0;
+        uint32_t connects = 0;
+        uint32_t disconnects = 0;
+        uint32_t authLatencyMs = 0; // connected -> authenticated, last connection
+        uint32_t maxAuthLatencyMs = 0;
+        uint32_t connectMs = 0;   // attempt started -> connected (DNS, TCP, TLS, upgrade), last connection
+        uint32_t readyMs = 0;     // attempt started -> authenticated, last connection
+        uint32_t coldReadyMs = 0; // the same for the first connection since boot
+        ZiLinkHistogram sendUs; // duration of every send call, failed ones included
+
+        uint32_t reconnects() const { return connects > 1 ? connects - 1 : 0; }
+
+        void sent(size_t bytes, uint32_t us)
+        {
+                framesSent++;
+                bytesSent += (uint32_t)bytes;
+                sendUs.record(us);
+        }
+        void failed(uint32_t us)
+        {
+                sendFailures++;
+                sendUs.record(us);
+        }
+        void authenticated(uint32_t ms)
+        {
+                authLatencyMs = ms;
+                if (ms > maxAuthLatencyMs)
+                {
+                        maxAuthLatencyMs = ms;
+                }
+                readyMs = connectMs + ms;
+                if (connects <= 1)
+                {
+                        coldReadyMs = readyMs;
+                }
+        }
+};
+
+// Free heap now and its low-water mark since boot (0 on the host)
+uint32_t zilinkHeapFree();
+uint32_t zilinkHeapMinFree();
+
+#endif
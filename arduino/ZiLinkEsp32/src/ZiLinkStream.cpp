@@ -0,0 +1,142 @@
+#include "ZiLinkStream.h"
+
+#include <new>
+#include <string.h>
+
+bool ZiLinkStream::begin(uint8_t id, const char *name, Format format, uint32_t sampleRate, uint16_t blockSamples,
+                         uint16_t chunkBytes)
+{
+  _active.store(false, std::memory_order_release);
+  _format = format;
+  // A chunk's header goes over the end of the chunk before it, so a chunk must cover at least that much
+  if (chunkBytes < HEADER_BYTES + LEAD || blockSamples == 0)
+  {
+    return false;
+  }
+  const size_t bytes = LEAD + (size_t)blockSamples * sampleBytes();
+  for (Block &b : _blocks)
+  {
+    b.data.reset(new (std::nothrow) uint8_t[bytes]);
+    if (!b.data)
+    {
+      _blocks[0].data.reset();
+      return false;
+    }
+    b.samples = 0;
+    b.gap = false;
+    b.state.store(Free, std::memory_order_relaxed);
+  }
+  _id = id;
+  _name = name;
+  _rate = sampleRate;
+  _blockSamples = blockSamples;
+  _chunkSamples = (chunkBytes - HEADER_BYTES) / sampleBytes();
+  _fill = 0;
+  _index = 0;
+  _gap = false;
+  _send = 0;
+  _sent = 0;
+  _seq = 0;
+  _until = 0;
+  _lost = false;
+  _stalled = false;
+  _stats = Stats();
+  _active.store(true, std::memory_order_release);
+  return true;
+}
+
+size_t ZiLinkStream::write(const int16_t *samples, size_t count)
+{
+  return _format == Int16 ? put(samples, count) : 0;
+}
+
+size_t ZiLinkStream::write(const float *samples, size_t count)
+{
+  return _format == Float32 ? put(samples, count) : 0;
+}
+
+size_t ZiLinkStream::put(const void *samples, size_t count)
+{
+  if (!active())
+  {
+    return 0;
+  }
+  const uint8_t size = sampleBytes();
+  const uint8_t *from = static_cast<const uint8_t *>(samples);
+  size_t taken = 0;
+  while (taken < count)
+  {
+    Block &b = _blocks[_fill];
+    if (b.state.load(std::memory_order_acquire) != Free)
+    {
+      // Both blocks wait for the sender: drop, keep the sample index moving
+      const size_t rest = count - taken;
+      _stats.dropped += rest;
+      _index += rest;
+      _gap = true;
+      break;
+    }
+    if (b.samples == 0)
+    {
+      b.index = _index;
+      b.gap = _gap;
+      _gap = false;
+    }
+    size_t n = _blockSamples - b.samples;
+    if (n > count - taken)
+    {
+      n = count - taken;
+    }
+    // Little-endian on the ESP32, so samples go in as they are
+    memcpy(samplesOf(b) + (size_t)b.samples * size, from + taken * size, n * size);
+    b.samples += n;
+    _index += n;
+    taken += n;
+    if (b.samples == _blockSamples)
+    {
+      flush();
+    }
+  }
+  _stats.samples += taken;
+  return taken;
+}
+
+size_t ZiLinkStream::space() const
+{
+  const Block &current = _blocks[_fill];
+  if (!active() || current.state.load(std::memory_order_acquire) != Free)
+  {
+    return 0;
+  }
+  const bool other = _blocks[_fill ^ 1].state.load(std::memory_order_acquire) == Free;
+  return _blockSamples - current.samples + (other ? _blockSamples : 0);
+}
+
+void ZiLinkStream::flush()
+{
+  Block &b = _blocks[_fill];
+  if (b.samples == 0 || b.state.load(std::memory_order_relaxed) != Free)
+  {
+    return;
+  }
+  _stats.blocks++;
+  b.state.store(Ready, std::memory_order_release);
+  _fill ^= 1;
+}
+
+void ZiLinkStream::grant(uint32_t until)
+{
+  // Credit only grows; a stale grant arriving late changes nothing
+  if ((int32_t)(until - _until) > 0)
+  {
+    _until = until;
+  }
+}
+
+void ZiLinkStream::release(Block &b)
+{
+  b.samples = 0;
+  _sent = 0;
+  b.state.store(Free, std::memory_order_release);
+  _send ^= 1;
+}
@@ -0,0 +1,208 @@
+#ifndef ZILINK_STREAM_H
+#define ZILINK_STREAM_H
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+// Spare bytes in front of every chunk for the transport's frame header
+// (WebSocketsClient needs WEBSOCKETS_MAX_HEADER_SIZE, 14)
+#ifndef ZILINK_STREAM_HEADROOM
+#define ZILINK_STREAM_HEADROOM 16
+#endif
+
+// Largest chunk on the wire, header included
+#ifndef ZILINK_STREAM_CHUNK_BYTES
+#define ZILINK_STREAM_CHUNK_BYTES 1024
+#endif
+
+// High-rate sample stream (audio, vibration) sent as binary chunks.
+//
+// The producer writes samples into one of two blocks while the sender
+// drains the other, so neither waits for the other. When both blocks are
+// full, write() takes nothing: the samples are dropped and counted, and the
+// next chunk carries the gap flag. The producer can check space() first to
+// back off instead.
+//
+// Chunks are cut in place: each chunk's header is written over the tail of
+// the chunk before it, which has already been sent. No copy, no
+// allocation after begin(). Chunk layout (little-endian):
+//
+//   0      MARKER (0xC1, never used by MessagePack)
+//   1      stream id
+//   2      sample format
+//   3      flags (FLAG_GAP: samples were dropped just before this chunk)
+//   4..7   chunk sequence number
+//   8..11  index of the first sample since begin()
+//   12..   samples
+//
+// Flow control is credit-based: the receiver grants chunks by sequence
+// number ("send up to, not including, `until`"), and the sender stops when
+// the credit runs out. The producer and the sender may run on different
+// tasks; grant()/revoke() belong to the sender side.
+class ZiLinkStream
+{
+public:
+        enum Format : uint8_t
+        {
+                Int16 = 1,
+                Float32 = 2
+        };
+
+        static const uint8_t MARKER = 0xC1;
+        static const uint8_t FLAG_GAP = 0x01;
+        static const size_t HEADER_BYTES = 12;
+
+        struct Stats
+        {
+                uint32_t samples = 0;      // accepted by write()
+                uint32_t dropped = 0;      // refused (both blocks full) or lost with a failed send
+                uint32_t blocks = 0;       // handed to the sender
+                uint32_t chunks = 0;       // sent
+                uint32_t bytes = 0;        // chunk bytes sent, headers included
+                uint32_t creditStalls = 0; // times the credit ran out with chunks waiting
+                uint32_t failed = 0;       // sends the transport refused
+        };
+
+        ZiLinkStream() {}
+        ZiLinkStream(const ZiLinkStream &) = delete;
+        ZiLinkStream &operator=(const ZiLinkStream &) = delete;
+
+        // Allocates both blocks of blockSamples. chunkBytes includes the
+        // header and must be at least 40. Not safe while the stream is in use.
+        bool begin(uint8_t id, const char *name, Format format, uint32_t sampleRate, uint16_t blockSamples,
+                   uint16_t chunkBytes = ZILINK_STREAM_CHUNK_BYTES);
+        bool active() const { return _active.load(std::memory_order_acquire); }
+
+        uint8_t id() const { return _id; }
+        const char *name() const { return _name; }
+        Format format() const { return _format; }
+        const char *formatName() const { return _format == Int16 ? "int16" : "float32"; }
+        uint32_t sampleRate() const { return _rate; }
+        uint16_t chunkSamples() const { return _chunkSamples; }
+
+        // Producer side. Returns how many samples were taken; the rest were
+        // dropped. The overload must match the format.
+        size_t write(const int16_t *samples, size_t count);
+        size_t write(const float *samples, size_t count);
+        // Samples write() can take right now
+        size_t space() const;
+        // Hands over a partly filled block, e.g. before the producer pauses
+        void flush();
+
+        // Sender side. Cumulative credit: chunks with seq < until may go.
+        void grant(uint32_t until);
+        // No credit until the receiver grants more, e.g. after reconnecting
+        void revoke() { _until = _seq; }
+        uint32_t seq() const { return _seq; }
+        uint32_t credit() const { return (int32_t)(_until - _seq) > 0 ? _until - _seq : 0; }
+        bool pending() const { return _blocks[_send].state.load(std::memory_order_acquire) == Ready; }
+
+        // Sends up to maxChunks while there is credit. `send(uint8_t *chunk,
+        // size_t length)` may write ZILINK_STREAM_HEADROOM bytes in front of
+        // `chunk` and clobber the chunk itself. If it fails, the rest of that
+        // block is dropped. Returns the chunks sent.
+        template <typename Send>
+        uint16_t service(Send send, uint16_t maxChunks);
+
+        const Stats &stats() const { return _stats; }
+
+private:
+        enum State : uint8_t
+        {
+                Free,  // producer's
+                Ready  // sender's
+        };
+
+        struct Block
+        {
+                std::unique_ptr<uint8_t[]> data; // headroom + header, then the samples
+                uint32_t index = 0;              // of the first sample
+                uint16_t samples = 0;
+                bool gap = false;
+                std::atomic<uint8_t> state{Free};
+        };
+
+        static const size_t LEAD = ZILINK_STREAM_HEADROOM + HEADER_BYTES;
+
+        size_t put(const void *samples, size_t count);
+        uint8_t *samplesOf(Block &b) { return b.data.get() + LEAD; }
+        uint8_t sampleBytes() const { return _format == Int16 ? 2 : 4; }
+        void release(Block &b);
+
+        uint8_t _id = 0;
+        const char *_name = "";
+        Format _format = Int16;
+        uint32_t _rate = 0;
+        uint16_t _blockSamples = 0;
+        uint16_t _chunkSamples = 0;
+        std::atomic<bool> _active{false};
+        Block _blocks[2];
+
+        // Producer
+        uint8_t _fill = 0;
+        uint32_t _index = 0;
+        bool _gap = false;
+
+        // Sender
+        uint8_t _send = 0;
+        uint16_t _sent = 0; // samples of the current block already sent
+        uint32_t _seq = 0;
+        uint32_t _until = 0;
+        bool _lost = false; // a failed send dropped samples; flag the next chunk
+        bool _stalled = false;
+
+        Stats _stats;
+};
+
+template <typename Send>
+uint16_t ZiLinkStream::service(Send send, uint16_t maxChunks)
+{
+        uint16_t chunks = 0;
+        while (chunks < maxChunks && pending())
+        {
+                if (!credit())
+                {
+                        _stats.creditStalls += !_stalled;
+                        _stalled = true;
+                        break;
+                }
+                Block &b = _blocks[_send];
+                const uint16_t n = b.samples - _sent < _chunkSamples ? b.samples - _sent : _chunkSamples;
+                uint8_t *chunk = samplesOf(b) + (size_t)_sent * sampleBytes() - HEADER_BYTES;
+                const uint32_t index = b.index + _sent;
+                chunk[0] = MARKER;
+                chunk[1] = _id;
+                chunk[2] = _format;
+                chunk[3] = (_sent == 0 && b.gap) || _lost ? FLAG_GAP : 0;
+                for (int i = 0; i < 4; i++)
+                {
+                        chunk[4 + i] = (uint8_t)(_seq >> (8 * i));
+                        chunk[8 + i] = (uint8_t)(index >> (8 * i));
+                }
+                const size_t length = HEADER_BYTES + (size_t)n * sampleBytes();
+                if (!send(chunk, length))
+                {
+                        _stats.failed++;
+                        _stats.dropped += b.samples - _sent;
+                        _lost = true;
+                        release(b);
+                        break;
+                }
+                _seq++;
+                _lost = false;
+                _stalled = false;
+                chunks++;
+                _stats.chunks++;
+                _stats.bytes += length;
+                _sent += n;
+                if (_sent == b.samples)
+                {
+                        release(b);
+                }
+        }
+        return chunks;
+}
+
+#endif
@@ -0,0 +1,151 @@
+#include "ZiLinkTcpConnect.h"
+
+#include <errno.h>
+#include <string.h>
+
+#if defined(ESP32)
+#include <lwip/sockets.h>
+#include <lwip/netdb.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+ZiLinkTcpConnect::Status ZiLinkTcpConnect::fail(int error)
+{
+  cancel();
+  _error = error ? error : ECONNREFUSED;
+  _status = Failed;
+  return _status;
+}
+
+bool ZiLinkTcpConnect::start(uint32_t ipv4, uint16_t port, uint32_t timeoutMs, uint32_t nowMs)
+{
+  cancel();
+  _error = 0;
+  _startMs = nowMs;
+  _timeoutMs = timeoutMs;
+
+  _fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (_fd < 0)
+  {
+    fail(errno);
+    return false;
+  }
+  fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL, 0) | O_NONBLOCK);
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = ipv4;
+  if (connect(_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+  {
+    _status = Connected;
+    return true;
+  }
+  if (errno != EINPROGRESS)
+  {
+    fail(errno);
+    return false;
+  }
+  _status = InProgress;
+  return true;
+}
+
+ZiLinkTcpConnect::Status ZiLinkTcpConnect::poll(uint32_t nowMs)
+{
+  if (_status != InProgress)
+  {
+    return _status;
+  }
+  fd_set writable;
+  FD_ZERO(&writable);
+  FD_SET(_fd, &writable);
+  struct timeval tv = {0, 0};
+  const int ready = select(_fd + 1, nullptr, &writable, nullptr, &tv);
+  if (ready < 0)
+  {
+    return fail(errno);
+  }
+  if (ready == 0)
+  {
+    if ((uint32_t)(nowMs - _startMs) >= _timeoutMs)
+    {
+      return fail(ETIMEDOUT);
+    }
+    return _status;
+  }
+  int soError = 0;
+  socklen_t len = sizeof(soError);
+  if (getsockopt(_fd, SOL_SOCKET, SO_ERROR, &soError, &len) < 0 || soError != 0)
+  {
+    return fail(soError ? soError : errno);
+  }
+  _status = Connected;
+  return _status;
+}
+
+int ZiLinkTcpConnect::release()
+{
+  if (_status != Connected)
+  {
+    return -1;
+  }
+  // Back to the blocking mode WiFiClient expects
+  fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL, 0) & ~O_NONBLOCK);
+  int one = 1;
+  setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  setsockopt(_fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+  const int fd = _fd;
+  _fd = -1;
+  _status = Idle;
+  return fd;
+}
+
+void ZiLinkTcpConnect::cancel()
+{
+  if (_fd >= 0)
+  {
+    close(_fd);
+    _fd = -1;
+  }
+  _status = Idle;
+}
+
+bool ZiLinkTcpConnect::parse(const char *host, uint32_t &ipv4)
+{
+  struct in_addr addr;
+  if (inet_pton(AF_INET, host, &addr) != 1)
+  {
+    return false;
+  }
+  ipv4 = addr.s_addr;
+  return true;
+}
+
+bool ZiLinkTcpConnect::resolve(const char *host, uint32_t &ipv4)
+{
+  if (parse(host, ipv4))
+  {
+    return true;
+  }
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *res = nullptr;
+  if (getaddrinfo(host, nullptr, &hints, &res) != 0 || !res)
+  {
+    return false;
+  }
+  ipv4 = ((struct sockaddr_in *)res->ai_addr)->sin_addr.s_addr;
+  freeaddrinfo(res);
+  return true;
+}
@@ -0,0 +1,54 @@
+#ifndef ZILINK_TCP_CONNECT_H
+#define ZILINK_TCP_CONNECT_H
+
+#include <stdint.h>
+
+// Non-blocking TCP connect over BSD sockets (lwIP on ESP32, POSIX on the
+// host). start() returns at once and poll() checks progress with a zero
+// select() timeout, so a broker that is down or unreachable never stalls
+// the caller. The connected socket is handed over in blocking mode, ready
+// to wrap in a WiFiClient.
+class ZiLinkTcpConnect
+{
+public:
+        enum Status
+        {
+                Idle,
+                InProgress,
+                Connected,
+                Failed
+        };
+
+        ZiLinkTcpConnect() = default;
+        ~ZiLinkTcpConnect() { cancel(); }
+        ZiLinkTcpConnect(const ZiLinkTcpConnect &) = delete;
+        ZiLinkTcpConnect &operator=(const ZiLinkTcpConnect &) = delete;
+
+        // `ipv4` in network byte order
+        bool start(uint32_t ipv4, uint16_t port, uint32_t timeoutMs, uint32_t nowMs);
+        Status poll(uint32_t nowMs);
+        // Gives up ownership of the connected socket (-1 unless Connected)
+        int release();
+        void cancel();
+
+        Status status() const { return _status; }
+        // errno of the last failure (ETIMEDOUT when timeoutMs expired)
+        int error() const { return _error; }
+
+        // Dotted quads are parsed without a lookup; names go through the
+        // system resolver, which blocks until it answers or times out
+        static bool resolve(const char *host, uint32_t &ipv4);
+        // Dotted quads only; false for a name
+        static bool parse(const char *host, uint32_t &ipv4);
+
+private:
+        Status fail(int error);
+
+        int _fd = -1;
+        Status _status = Idle;
+        int _error = 0;
+        uint32_t _startMs = 0;
+        uint32_t _timeoutMs = 0;
+};
+
+#endif
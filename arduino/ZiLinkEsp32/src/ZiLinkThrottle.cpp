@@ -0,0 +1,82 @@
+#include "ZiLinkThrottle.h"
+
+void ZiLinkThrottle::set(float rate, uint16_t burst, uint32_t credit, uint32_t ttlMs, uint32_t nowMs)
+{
+  _stats.updates++;
+  if (!(rate > 0) && credit == 0)
+  {
+    lift();
+    return;
+  }
+  const bool renewal = active(nowMs);
+  refill(nowMs);
+  _rate = rate > 0 ? rate : 0;
+  _rateMilli = rate > 0 ? (uint32_t)(rate * 1000 + 0.5f) : 0;
+  if (burst == 0)
+  {
+    burst = rate >= 1 ? (uint16_t)(rate > 65535 ? 65535 : rate) : 1;
+  }
+  _cap = (uint64_t)burst * UNIT;
+  // A fresh limit starts with a full bucket; a renewal keeps what is left
+  if (!renewal)
+  {
+    _tokens = _cap;
+    _waiting = false;
+  }
+  else if (_tokens > _cap)
+  {
+    _tokens = _cap;
+  }
+  _tokens += (uint64_t)credit * UNIT;
+  _lastMs = nowMs;
+  _expiresMs = nowMs + (ttlMs ? ttlMs : ZILINK_THROTTLE_TTL_MS);
+  _limited = true;
+}
+
+bool ZiLinkThrottle::limited(uint32_t nowMs)
+{
+  if (_limited && !active(nowMs))
+  {
+    // Not renewed in time: the server stopped asking
+    _limited = false;
+  }
+  return _limited;
+}
+
+void ZiLinkThrottle::refill(uint32_t nowMs)
+{
+  const uint32_t elapsed = nowMs - _lastMs;
+  _lastMs = nowMs;
+  if (_tokens >= _cap || !_rateMilli)
+  {
+    return;
+  }
+  const uint64_t earned = (uint64_t)elapsed * _rateMilli;
+  _tokens = _cap - _tokens > earned ? _tokens + earned : _cap;
+}
+
+bool ZiLinkThrottle::ready(uint32_t nowMs)
+{
+  if (!limited(nowMs))
+  {
+    return true;
+  }
+  refill(nowMs);
+  return _tokens >= UNIT;
+}
+
+bool ZiLinkThrottle::take(uint32_t nowMs)
+{
+  if (!ready(nowMs))
+  {
+    _stats.waits += !_waiting;
+    _waiting = true;
+    return false;
+  }
+  if (_limited)
+  {
+    _tokens -= UNIT;
+  }
+  _waiting = false;
+  return true;
+}
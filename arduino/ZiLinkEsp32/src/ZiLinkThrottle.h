@@ -0,0 +1,73 @@
+#ifndef ZILINK_THROTTLE_H
+#define ZILINK_THROTTLE_H
+
+#include <stdint.h>
+
+// How long a throttle holds when the server does not say; the server
+// renews it while it is overloaded, so a lost lift cannot pin a device
+#ifndef ZILINK_THROTTLE_TTL_MS
+#define ZILINK_THROTTLE_TTL_MS 30000
+#endif
+
+// Upload rate granted by the server ({"type":"throttle"}): a token bucket
+// of `burst` frames refilled at `rate` frames per second, plus one-off
+// credit the server may add on top. Every frame that leaves the device
+// (reading, batch, component update, queued or replayed record) takes a
+// token; while none is left the caller holds the frame back.
+//
+// Unlimited until the first set(), after lift(), and once `ttl` has passed
+// without a renewal. Fixed memory, no allocation.
+class ZiLinkThrottle
+{
+public:
+        struct Stats
+        {
+                uint32_t updates = 0;   // throttle messages applied
+                uint32_t waits = 0;     // times a frame found the bucket empty (once per wait)
+                uint32_t coalesced = 0; // readings merged into a pending one instead of sent (counted by the caller)
+        };
+
+        // rate in frames per second; rate 0 without credit lifts the limit.
+        // burst 0 means one second's worth (at least 1). ttlMs 0 means
+        // ZILINK_THROTTLE_TTL_MS.
+        void set(float rate, uint16_t burst, uint32_t credit, uint32_t ttlMs, uint32_t nowMs);
+        void lift() { _limited = false; }
+
+        bool limited(uint32_t nowMs);
+        // Takes a token for one frame; always true while unlimited
+        bool take(uint32_t nowMs);
+        // A token is there, without taking it
+        bool ready(uint32_t nowMs);
+        // Returns the token of a frame that did not go out after all
+        void refund()
+        {
+                if (_limited)
+                {
+                        _tokens += UNIT;
+                }
+        }
+        // Frames per second granted, 0 while unlimited
+        float rate(uint32_t nowMs) const { return active(nowMs) ? _rate : 0; }
+
+        Stats &stats() { return _stats; }
+        const Stats &stats() const { return _stats; }
+
+private:
+        // One frame in bucket units; rate * 1000 units arrive per ms
+        static const uint64_t UNIT = 1000000;
+
+        bool active(uint32_t nowMs) const { return _limited && (int32_t)(nowMs - _expiresMs) < 0; }
+        void refill(uint32_t nowMs);
+
+        bool _limited = false;
+        bool _waiting = false;
+        float _rate = 0;
+        uint32_t _rateMilli = 0; // frames per 1000 s
+        uint64_t _cap = 0;
+        uint64_t _tokens = 0;
+        uint32_t _lastMs = 0;
+        uint32_t _expiresMs = 0;
+        Stats _stats;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "ZiLinkTransport.h"
+
+#include "ZiLinkClock.h"
+
+void ZiLinkTransportHealth::record(bool ok, uint32_t us)
+{
+  if (_samples == 0)
+  {
+    _latencyUs = us;
+  }
+  else
+  {
+    _latencyUs = (uint32_t)(((uint64_t)_latencyUs * 7 + us) / 8);
+  }
+  _failures = _failures - _failures / 8 + (ok ? 0 : 1024 / 8);
+  if (_samples < UINT32_MAX)
+  {
+    _samples++;
+  }
+}
+
+void ZiLinkTransportHealth::reset()
+{
+  _samples = 0;
+  _latencyUs = 0;
+  _failures = 0;
+}
+
+uint32_t ZiLinkTransportHealth::score(uint32_t expectedUs, size_t backlog) const
+{
+  const uint64_t score = (uint64_t)(_samples ? _latencyUs : expectedUs) +
+                         (uint64_t)_failures * ZILINK_TRANSPORT_FAILURE_US / 1024 + (uint64_t)backlog * ZILINK_TRANSPORT_BACKLOG_US;
+  return score > UINT32_MAX ? UINT32_MAX : (uint32_t)score;
+}
+
+bool ZiLinkTransport::timed(bool ok, uint32_t startUs)
+{
+  health.record(ok, zilinkMicros() - startUs);
+  return ok;
+}
+
+bool ZiLinkTransportRouter::add(ZiLinkTransport *transport)
+{
+  if (!transport || _count >= ZILINK_MAX_TRANSPORTS)
+  {
+    return false;
+  }
+  _transports[_count++] = transport;
+  return true;
+}
+
+void ZiLinkTransportRouter::setHysteresis(uint8_t percent, uint32_t minDwellMs)
+{
+  _hysteresisPercent = percent > 100 ? 100 : percent;
+  _minDwellMs = minDwellMs;
+}
+
+ZiLinkTransport *ZiLinkTransportRouter::select(uint32_t nowMs)
+{
+  int8_t best = -1;
+  uint32_t bestScore = UINT32_MAX;
+  uint32_t currentScore = UINT32_MAX;
+  bool currentReady = false;
+  for (uint8_t i = 0; i < _count; i++)
+  {
+    ZiLinkTransport *t = _transports[i];
+    const uint8_t bit = (uint8_t)(1u << i);
+    if (!t->ready())
+    {
+      _ready &= ~bit;
+      continue;
+    }
+    if (!(_ready & bit))
+    {
+      // A new connection starts with a clean record
+      t->health.reset();
+      _ready |= bit;
+    }
+    const uint32_t score = t->health.score(t->expectedUs(), t->backlog());
+    if (i == _current)
+    {
+      currentScore = score;
+      currentReady = true;
+    }
+    if (best < 0 || score < bestScore)
+    {
+      best = (int8_t)i;
+      bestScore = score;
+    }
+  }
+  if (best < 0)
+  {
+    return nullptr;
+  }
+  for (int8_t i = 0; currentReady && i < _current; i++)
+  {
+    if ((_ready & (1u << i)) && nowMs - _usedMs[i] >= ZILINK_TRANSPORT_PROBE_MS)
+    {
+      // Probe: one frame on a preferred transport to measure it afresh
+      _transports[i]->health.reset();
+      _usedMs[i] = nowMs;
+      return _transports[i];
+    }
+  }
+  if (best != _current)
+  {
+    const bool better = (uint64_t)bestScore * 100 < (uint64_t)currentScore * (100 - _hysteresisPercent);
+    if (!currentReady || (better && nowMs - _sinceMs >= _minDwellMs))
+    {
+      if (_current >= 0)
+      {
+        _switches++;
+      }
+      _current = best;
+      _sinceMs = nowMs;
+    }
+  }
+  _usedMs[_current] = nowMs;
+  return _transports[_current];
+}
@@ -0,0 +1,120 @@
+#ifndef ZILINK_TRANSPORT_H
+#define ZILINK_TRANSPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef ZILINK_MAX_TRANSPORTS
+#define ZILINK_MAX_TRANSPORTS 4
+#endif
+
+// Score added by a transport whose every send fails (us)
+#ifndef ZILINK_TRANSPORT_FAILURE_US
+#define ZILINK_TRANSPORT_FAILURE_US 200000
+#endif
+
+// Score added per frame waiting for a transport (us)
+#ifndef ZILINK_TRANSPORT_BACKLOG_US
+#define ZILINK_TRANSPORT_BACKLOG_US 5000
+#endif
+
+// How often a preferred transport that is not in use gets a frame to
+// measure it again (ms)
+#ifndef ZILINK_TRANSPORT_PROBE_MS
+#define ZILINK_TRANSPORT_PROBE_MS 10000
+#endif
+
+// Recent behaviour of one transport: send-call duration and failure rate,
+// both exponentially weighted (1/8 per sample), so a few slow or failed
+// sends move the score and a recovered link earns it back as quickly.
+class ZiLinkTransportHealth
+{
+public:
+        void record(bool ok, uint32_t us);
+        void reset();
+
+        uint32_t samples() const { return _samples; }
+        uint32_t latencyUs() const { return _latencyUs; }
+        // Failed fraction of recent sends, 0..1024
+        uint16_t failureRate() const { return _failures; }
+        // Lower is better: latency (expectedUs until measured) plus the
+        // failure and backlog penalties
+        uint32_t score(uint32_t expectedUs, size_t backlog) const;
+
+private:
+        uint32_t _samples = 0;
+        uint32_t _latencyUs = 0;
+        uint16_t _failures = 0;
+};
+
+// A link that can carry component frames (one JSON object each) to the
+// server. The library registers its WebSocket, MQTT and HTTP clients; a
+// sketch can add its own (e.g. ESP-NOW to a gateway).
+class ZiLinkTransport
+{
+public:
+        virtual ~ZiLinkTransport() {}
+
+        // Short name for stats ("ws", "mqtt", "http")
+        virtual const char *name() const = 0;
+        // Connected (and authenticated) so that send() may succeed
+        virtual bool ready() = 0;
+        // Sends one frame; true once the link accepted it. `data` must be
+        // left untouched: a failed frame is queued and may go out on
+        // another transport. Record the outcome in `health` (see timed()).
+        virtual bool send(const char *data, size_t length) = 0;
+        // Frames already waiting for this link, when it knows
+        virtual size_t backlog() { return 0; }
+        // Send duration assumed until the first one is measured (us)
+        virtual uint32_t expectedUs() const { return 10000; }
+
+        ZiLinkTransportHealth health;
+
+protected:
+        // For send(): `return timed(link.write(...), startUs);`
+        bool timed(bool ok, uint32_t startUs);
+};
+
+// Picks the transport for each component frame: the ready one with the
+// lowest health score. Hysteresis keeps it from flapping: another ready
+// transport takes over only when it scores `hysteresisPercent` better and
+// the current one has been in use for `minDwellMs`. When the current one
+// is no longer ready the best ready one takes over at once. A transport
+// that becomes ready again starts with a clean record.
+//
+// Only the transport in use is measured, so every ZILINK_TRANSPORT_PROBE_MS
+// a ready transport registered before it (preferred) carries one frame
+// with its stale record cleared; if it has recovered, the usual hysteresis
+// brings traffic back. Registration order also breaks ties.
+//
+// Not thread-safe; called from whichever context owns the transports.
+class ZiLinkTransportRouter
+{
+public:
+        bool add(ZiLinkTransport *transport);
+        void setHysteresis(uint8_t percent, uint32_t minDwellMs);
+
+        // Transport to use now; nullptr when none is ready
+        ZiLinkTransport *select(uint32_t nowMs);
+
+        ZiLinkTransport *current() const { return _current < 0 ? nullptr : _transports[_current]; }
+        uint8_t count() const { return _count; }
+        ZiLinkTransport *at(uint8_t i) const { return i < _count ? _transports[i] : nullptr; }
+        // Changes of transport, failovers included
+        uint32_t switches() const { return _switches; }
+
+private:
+        static_assert(ZILINK_MAX_TRANSPORTS <= 8, "ready flags are one byte");
+
+        ZiLinkTransport *_transports[ZILINK_MAX_TRANSPORTS] = {};
+        uint8_t _count = 0;
+        uint8_t _ready = 0; // bit i: transport i was ready on the last select()
+        uint32_t _usedMs[ZILINK_MAX_TRANSPORTS] = {}; // last select() that returned it
+        int8_t _current = -1;
+        uint8_t _hysteresisPercent = 25;
+        uint32_t _minDwellMs = 2000;
+        uint32_t _sinceMs = 0;
+        uint32_t _switches = 0;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef ZILINK_WIDGETS_H
+#define ZILINK_WIDGETS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ZiLinkComponentTable.h"
+
+// Compile-time widget schema, as the Designer's code generator writes it:
+//
+//   constexpr ZiLinkWidget WIDGETS[] = {
+//           {"fan", ZiLinkWidget::Slider},
+//           {"door", ZiLinkWidget::Button},
+//   };
+//   static_assert(zilinkWidgetsValid(WIDGETS), "...");
+//   constexpr ZiLinkSliderRef FAN = zilinkWidget<ZiLinkWidget::Slider>(WIDGETS, "fan");
+//
+//   zilink.setWidgets(WIDGETS);   // setup()
+//   zilink.updateWidget(FAN, 42); // takes an int32_t; a ZiLinkButtonRef takes a bool
+//
+// A ref is the widget's index in the schema, looked up while compiling: an
+// id that is not in the schema, or has another type, does not build. On the
+// wire the device announces the schema once per session and then sends the
+// index instead of the id and type (see ZiLinkEsp32::setWidgets()).
+struct ZiLinkWidget
+{
+        enum Type : uint8_t
+        {
+                Button,
+                Slider,
+                Toggle,
+                Progress
+        };
+
+        const char *id;
+        Type type;
+
+        // Component type on the wire
+        static constexpr const char *typeName(Type type)
+        {
+                return type == Button ? "button" : type == Slider ? "slider" : type == Toggle ? "toggle" : "progress";
+        }
+        static constexpr bool isBool(Type type) { return type == Button || type == Toggle; }
+};
+
+template <bool IsBool>
+struct ZiLinkWidgetValue
+{
+        typedef int32_t type;
+};
+
+template <>
+struct ZiLinkWidgetValue<true>
+{
+        typedef bool type;
+};
+
+template <ZiLinkWidget::Type T>
+struct ZiLinkWidgetRef
+{
+        typedef typename ZiLinkWidgetValue<ZiLinkWidget::isBool(T)>::type Value;
+        uint8_t index;
+};
+
+typedef ZiLinkWidgetRef<ZiLinkWidget::Button> ZiLinkButtonRef;
+typedef ZiLinkWidgetRef<ZiLinkWidget::Slider> ZiLinkSliderRef;
+typedef ZiLinkWidgetRef<ZiLinkWidget::Toggle> ZiLinkToggleRef;
+typedef ZiLinkWidgetRef<ZiLinkWidget::Progress> ZiLinkProgressRef;
+
+// Single-return recursion, so this also builds as C++11
+namespace zilink_widgets
+{
+        constexpr bool equal(const char *a, const char *b)
+        {
+                return *a == *b && (*a == '\0' || equal(a + 1, b + 1));
+        }
+
+        constexpr size_t length(const char *s)
+        {
+                return *s ? 1 + length(s + 1) : 0;
+        }
+
+        template <size_t N>
+        constexpr size_t find(const ZiLinkWidget (&widgets)[N], const char *id, size_t from)
+        {
+                return from == N ? N : equal(widgets[from].id, id) ? from : find(widgets, id, from + 1);
+        }
+
+        template <size_t N>
+        constexpr bool valid(const ZiLinkWidget (&widgets)[N], size_t from)
+        {
+                return from == N || (length(widgets[from].id) < ZILINK_COMPONENT_ID_LEN &&
+                                     find(widgets, widgets[from].id, 0) == from && valid(widgets, from + 1));
+        }
+
+        template <ZiLinkWidget::Type T, size_t N>
+        constexpr ZiLinkWidgetRef<T> ref(const ZiLinkWidget (&widgets)[N], size_t index)
+        {
+                // A throw in a constant expression fails the build
+                return index < N && widgets[index].type == T ? ZiLinkWidgetRef<T>{(uint8_t)index}
+                                                             : throw "no widget with this id and type";
+        }
+}
+
+// Ids unique and short enough for the component table, and no more widgets
+// than it tracks
+template <size_t N>
+constexpr bool zilinkWidgetsValid(const ZiLinkWidget (&widgets)[N])
+{
+        return N <= ZILINK_MAX_COMPONENTS && N <= 255 && zilink_widgets::valid(widgets, 0);
+}
+
+template <ZiLinkWidget::Type T, size_t N>
+constexpr ZiLinkWidgetRef<T> zilinkWidget(const ZiLinkWidget (&widgets)[N], const char *id)
+{
+        return zilink_widgets::ref<T>(widgets, zilink_widgets::find(widgets, id, 0));
+}
+
+#endif
@@ -0,0 +1,67 @@
+#include "ZiLinkWs.h"
+
+#include "ZiLinkInbound.h"
+
+void ZiLinkWs::begin()
+{
+  if (_config.port == 443)
+  {
+    if (_config.caCert)
+    {
+      _ws.beginSslWithCA(_config.host, _config.port, _config.path, _config.caCert);
+    }
+    else
+    {
+      _ws.beginSSL(_config.host, _config.port, _config.path, _config.fingerprint ? _config.fingerprint : "");
+    }
+  }
+  else
+  {
+    _ws.begin(_config.host, _config.port, _config.path);
+  }
+  // Same keep-alive as ZiLinkEsp32: ping every 5 s, pong within 3 s, 2 misses
+  _ws.enableHeartbeat(5000, 3000, 2);
+  _ws.onEvent([this](WStype_t type, uint8_t *payload, size_t length)
+              {
+    switch (type) {
+      case WStype_CONNECTED:
+      {
+        ZiLinkFrame<> auth;
+        auth.raw("{\"type\":\"auth\",\"data\":{\"token\":").str(_token);
+        auth.raw(",\"clientType\":\"device\",\"deviceId\":").str(_deviceId).raw("}}");
+        _ws.sendTXT(auth.c_str(), auth.length());
+        break;
+      }
+      case WStype_DISCONNECTED:
+        _authenticated = false;
+        break;
+      case WStype_TEXT:
+        received((char *)payload, length);
+        break;
+      default:
+        break;
+    } });
+  _ws.setReconnectInterval(5000);
+}
+
+void ZiLinkWs::received(char *payload, size_t length)
+{
+  ZiLinkInbound inbound;
+  switch (inbound.parse(payload, length))
+  {
+  case ZiLinkInbound::AuthSuccess:
+    _authenticated = true;
+    break;
+  case ZiLinkInbound::Command:
+    if (_onCommand)
+    {
+      zilinkCommand(inbound.command(), _onCommand);
+    }
+    break;
+  case ZiLinkInbound::Error:
+    Serial.printf("[%s] WS error: %s\n", _deviceId, inbound.error());
+    break;
+  default:
+    break;
+  }
+}
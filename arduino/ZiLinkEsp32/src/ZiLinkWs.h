@@ -0,0 +1,66 @@
+#ifndef ZILINK_WS_H
+#define ZILINK_WS_H
+
+#include <WebSocketsClient.h>
+#include "ZiLink.h"
+
+// WebSocket transport for ZiLink<...>: authenticates on connect, then
+// sends readings as device_data and component frames as they are (JSON
+// only). Status has no WebSocket message, so it falls through to the next
+// transport in the list. Port 443 uses TLS.
+class ZiLinkWs
+{
+public:
+        struct Config
+        {
+                Config(const char *host, uint16_t port, const char *path = "/ws") : host(host), port(port), path(path) {}
+                const char *host;
+                uint16_t port;
+                const char *path;
+                // Port 443: pinned CA (PEM) or SHA-256 certificate fingerprint, see ZiLinkEsp32::setTlsCaCert()
+                const char *caCert = nullptr;
+                const char *fingerprint = nullptr;
+        };
+
+        ZiLinkWs(const char *deviceId, const char *token, const Config &config)
+            : _deviceId(deviceId), _token(token), _config(config)
+        {
+        }
+
+        void begin();
+        void loop(uint32_t) { _ws.loop(); }
+        bool ready() const { return _authenticated; }
+        bool send(ZiLinkKind kind, const char *data, size_t length)
+        {
+                ZiLinkFrame<> frame;
+                if (kind == ZiLinkData)
+                {
+                        frame.raw("{\"type\":\"device_data\",\"data\":{\"sensorData\":").raw(data, length).raw("}}");
+                }
+                else if (kind == ZiLinkComponent)
+                {
+                        frame.raw(data, length);
+                }
+                if (!frame.ok() || frame.length() == 0)
+                {
+                        return false;
+                }
+                // The client writes its header into the frame's headroom: no copy
+                static_assert(ZILINK_FRAME_HEADROOM >= WEBSOCKETS_MAX_HEADER_SIZE, "frame headroom too small");
+                return _ws.sendTXT(frame.base() + frame.headroom() - WEBSOCKETS_MAX_HEADER_SIZE, frame.length(), true);
+        }
+        void setCommandHandler(ZiLinkCommandFn fn) { _onCommand = fn; }
+        WebSocketsClient &client() { return _ws; }
+
+private:
+        void received(char *payload, size_t length);
+
+        const char *_deviceId;
+        const char *_token;
+        Config _config;
+        bool _authenticated = false;
+        WebSocketsClient _ws;
+        ZiLinkCommandFn _onCommand = nullptr;
+};
+
+#endif
@@ -38,6 +38,44 @@ const CodeGenerator = ({ shapes, devices, defaultDeviceId, compact = false }) =>
 			}
 		});
 
+		// Control widgets become the sketch's compile-time widget schema (ZiLinkWidgets.h):
+		// short ids derived from the labels, since shape ids are UUIDs
+		const schemaTypes = {
+			button: "Button",
+			toggle: "Toggle",
+			switch: "Toggle",
+			slider: "Slider",
+			knob: "Slider",
+			progress: "Progress",
+		};
+		const widgets = [];
+		const widgetIds = new Set();
+		shapes.forEach((shape) => {
+			const type = schemaTypes[shape.widgetKind];
+			if (!shape.deviceId || !type) {
+				return;
+			}
+			const base =
+				(shape.label || shape.widgetKind)
+					.toLowerCase()
+					.replace(/[^a-z0-9]+/g, "_")
+					.replace(/^_+|_+$/g, "")
+					.slice(0, 20) || shape.widgetKind;
+			let id = base;
+			for (let n = 2; widgetIds.has(id); n++) {
+				id = `${base}_${n}`;
+			}
+			widgetIds.add(id);
+			const initial =
+				type === "Toggle"
+					? String(Boolean(shape.toggled ?? shape.switched))
+					: type === "Button"
+						? "false"
+						: String(Math.round(Number((type === "Slider" ? shape.currentValue : shape.minValue) ?? 0) || 0));
+			widgets.push({ id, type, ref: `W_${id.toUpperCase()}`, initial });
+		});
+		const buttonRefs = widgets.filter((w) => w.type === "Button").map((w) => w.ref);
+
 		// Generate code for each device
 		let code = `/*
  * ZiLink ESP32 Code Generated from Designer
@@ -124,6 +162,24 @@ const char* deviceToken = "YOUR_DEVICE_TOKEN";  // Get this from your device reg
 			}
 		});
 
+		if (buttonRefs.length > 0 && !usedPins.has("BUTTON_PIN")) {
+			code += `#define BUTTON_PIN 0
+#define LED_PIN 5
+`;
+		}
+
+		if (widgets.length > 0) {
+			code += `
+// Dashboard widgets: announced to the server once per session, then
+// updated by index. A ref that does not match its widget's type fails to compile.
+constexpr ZiLinkWidget WIDGETS[] = {
+${widgets.map((w) => `  {"${w.id}", ZiLinkWidget::${w.type}},`).join("\n")}
+};
+static_assert(zilinkWidgetsValid(WIDGETS), "widget ids must be unique and shorter than ZILINK_COMPONENT_ID_LEN");
+${widgets.map((w) => `constexpr ZiLink${w.type}Ref ${w.ref} = zilinkWidget<ZiLinkWidget::${w.type}>(WIDGETS, "${w.id}");`).join("\n")}
+`;
+		}
+
 		// Initialize sensors
 		code += `
 // Initialize sensors
@@ -233,7 +289,13 @@ void setup() {
   Serial.println(WiFi.localIP());
   
   // Initialize ZiLink with WebSocket Secure connection
-  zilink.setupWebSocket(serverHost, serverPort, "/ws", deviceId, deviceToken, true);  // true for secure WSS
+`;
+		if (widgets.length > 0) {
+			code += `  zilink.setWidgets(WIDGETS);
+${widgets.map((w) => `  zilink.updateWidget(${w.ref}, ${w.initial});`).join("\n")}
+`;
+		}
+		code += `  zilink.setupWebSocket(serverHost, serverPort, "/ws", deviceId, deviceToken);  // port 443 uses WSS
   Serial.println("ZiLink initialized!");
   
   // Send initial device info
@@ -329,7 +391,7 @@ void updateSensors() {
     if (reading != currentButtonState) {
       currentButtonState = reading;
       sensorData.buttonPressed = (currentButtonState == LOW);
-      if (sensorData.buttonPressed) {
+${buttonRefs.map((ref) => `      zilink.updateWidget(${ref}, sensorData.buttonPressed);\n`).join("")}      if (sensorData.buttonPressed) {
         Serial.println("Button pressed!");
         digitalWrite(LED_PIN, HIGH);
       } else {
@@ -484,7 +546,7 @@ void handleCommands() {
       } else if (action == "toggle") {
         bool state = doc["state"];
         digitalWrite(LED_PIN, state ? HIGH : LOW);
-        Serial.println("Button toggled to: " + String(state));
+${buttonRefs.map((ref) => `        zilink.updateWidget(${ref}, state);\n`).join("")}        Serial.println("Button toggled to: " + String(state));
       }
     }
   }
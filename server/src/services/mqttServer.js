@@ -34,6 +34,11 @@ class MQTTServer {
 				const deviceId = topicParts[2];
 				const messageType = topicParts[3];
 
+				if (messageType === "stats") {
+					const { data } = JSON.parse(packet.payload.toString());
+					wsManager.broadcastDeviceStats(deviceId, data);
+					return;
+				}
 				if (messageType !== "data") return;
 
 				const payload = JSON.parse(packet.payload.toString());
@@ -1,12 +1,25 @@
+import { monitorEventLoopDelay } from "node:perf_hooks";
 import WebSocket, { WebSocketServer } from "ws";
 import jwt from "jsonwebtoken";
 import { v4 as uuidv4 } from "uuid";
 import Device from "../models/Device.js";
+import { decode, encodeCommand, frameToMessage } from "../utils/msgpack.js";
+import { isStreamChunk, parseStreamChunk, StreamCredit, streamFormatOf } from "../utils/stream.js";
+import { LoadGovernor } from "../utils/throttle.js";
+
+// Stream chunks a device may have in flight per stream (see ZiLinkStream)
+const STREAM_CREDIT_CHUNKS = Number(process.env.STREAM_CREDIT_CHUNKS) || 8;
+// Credit is held back while a web client has this much unsent, so a slow viewer slows the device, not the server
+const STREAM_MAX_BUFFERED_BYTES = 1 << 20;
+// Device frames per second this server takes before it throttles the fleet (see LoadGovernor); 0 turns throttling off
+const THROTTLE_CAPACITY = Number(process.env.THROTTLE_CAPACITY ?? 2000);
+const THROTTLE_INTERVAL_MS = 1000;
 
 class WebSocketManager {
 	constructor() {
 		this.clients = new Map(); // Map of userId -> WebSocket connections
 		this.deviceConnections = new Map(); // Map of deviceId -> WebSocket connections
+		this.governor = new LoadGovernor({ capacity: THROTTLE_CAPACITY });
 	}
 
 	initWebSocketServer(server) {
@@ -26,15 +39,7 @@ class WebSocketManager {
 			console.log(`🔌 New WebSocket connection: ${connectionId}`);
 
 			// Handle incoming messages
-			ws.on("message", async (data) => {
-				try {
-					const message = JSON.parse(data.toString());
-					await this.handleMessage(ws, message);
-				} catch (error) {
-					console.error("❌ WebSocket message error:", error);
-					this.sendError(ws, "Invalid message format");
-				}
-			});
+			ws.on("message", (data, isBinary) => this.handleFrame(ws, data, isBinary));
 
 			// Handle connection close
 			ws.on("close", () => {
@@ -59,18 +64,58 @@ class WebSocketManager {
 			});
 		});
 
+		if (THROTTLE_CAPACITY > 0) {
+			this.startGovernor();
+		}
+
 		console.log("🔌 WebSocket server initialized");
 		return this.wss;
 	}
 
+	async handleFrame(ws, data, isBinary) {
+		try {
+			// Waveform chunks skip the message path; they are the bulk of a streaming device's traffic
+			if (isBinary && isStreamChunk(data)) {
+				return this.handleStreamChunk(ws, data);
+			}
+			// Stream chunks have their own credit; everything else a device sends counts against its throttle.
+			// A gateway's frames carry its sub-devices' messages and are charged to the gateway.
+			if (ws.clientType === "device") {
+				this.governor.record(ws.deviceId);
+			}
+			// Devices that negotiated MessagePack send binary frames
+			const message = isBinary ? frameToMessage(decode(data)) : JSON.parse(data.toString());
+			await this.handleMessage(ws, message);
+		} catch (error) {
+			console.error("❌ WebSocket message error:", error);
+			this.sendError(ws, "Invalid message format");
+		}
+	}
+
 	async handleMessage(ws, message) {
 		const { type, data } = message;
 
+		// Latency tracing: echo before any processing so the device measures the path, not the database.
+		// Component helpers put the trace at the top level like the rest of their fields.
+		const trace = data?.trace ?? message.trace;
+		if (ws.clientType === "device" && Array.isArray(trace)) {
+			this.sendMessage(ws, { type: "trace_ack", data: { trace, at: Date.now() % 2 ** 32 } });
+		}
+
 		switch (type) {
 			case "auth":
 				await this.handleAuth(ws, data);
 				break;
 
+			case "gateway_auth":
+				await this.handleGatewayAuth(ws, data);
+				break;
+
+			// A message from a sub-device on one of this gateway's channels
+			case "gw":
+				await this.handleGatewayFrame(ws, data);
+				break;
+
 			case "device_register":
 				await this.handleDeviceRegister(ws, data);
 				break;
@@ -79,6 +124,43 @@ class WebSocketManager {
 				await this.handleDeviceData(ws, data);
 				break;
 
+			case "component":
+				await this.handleComponentUpdate(ws, data);
+				break;
+
+			case "component_snapshot":
+				await this.handleComponentUpdate(ws, data?.components);
+				break;
+
+			case "component_schema":
+				this.handleComponentSchema(ws, data?.components);
+				break;
+
+			// Update of a widget by its index in this session's component_schema
+			case "c":
+				await this.handleComponentUpdate(ws, this.widgetUpdate(ws, message));
+				break;
+
+			// Component helpers on the device send { type, id, value } at the top level
+			case "button":
+			case "slider":
+			case "toggle":
+			case "progress":
+				await this.handleComponentUpdate(ws, message);
+				break;
+
+			case "device_stats":
+				this.handleDeviceStats(ws, data);
+				break;
+
+			case "command_response":
+				this.handleCommandResponse(ws, data);
+				break;
+
+			case "stream_open":
+				this.handleStreamOpen(ws, data);
+				break;
+
 			case "device_command":
 				await this.handleDeviceCommand(ws, data);
 				break;
@@ -99,7 +181,7 @@ class WebSocketManager {
 
 	async handleAuth(ws, data) {
 		try {
-			const { token, clientType, deviceId: claimedDeviceId } = data; // clientType: 'web' | 'device'
+			const { token, clientType, deviceId: claimedDeviceId, encoding } = data; // clientType: 'web' | 'device'
 
 			if (!token) {
 				return this.sendError(ws, "Authentication token required");
@@ -113,22 +195,15 @@ class WebSocketManager {
 			ws.authenticated = true;
 
 			if (clientType === "device") {
-				let finalDeviceId = decoded.deviceId;
-				// Allow user token + explicit deviceId if it belongs to the user
-				if (!finalDeviceId && claimedDeviceId) {
-					const device = await Device.findOne({ deviceId: claimedDeviceId, owner: decoded.userId });
-					if (!device) {
-						return this.sendError(ws, "Invalid device or not owned by user");
-					}
-					finalDeviceId = claimedDeviceId;
-				}
-
-				if (!finalDeviceId) {
-					return this.sendError(ws, "Device ID required for device client");
+				const resolved = await this.resolveDeviceId(decoded, claimedDeviceId);
+				if (resolved.error) {
+					return this.sendError(ws, resolved.error);
 				}
 
-				ws.deviceId = finalDeviceId;
-				this.deviceConnections.set(finalDeviceId, ws);
+				ws.deviceId = resolved.deviceId;
+				// Opt-in binary telemetry; confirmed in auth_success so older firmware keeps JSON
+				ws.encoding = encoding === "msgpack" ? "msgpack" : "json";
+				this.deviceConnections.set(ws.deviceId, ws);
 			} else {
 				// Web client
 				if (!this.clients.has(decoded.userId)) {
@@ -143,6 +218,7 @@ class WebSocketManager {
 					userId: decoded.userId,
 					clientType: ws.clientType,
 					deviceId: ws.deviceId,
+					encoding: ws.encoding,
 					message: "Authentication successful",
 				},
 			});
@@ -154,6 +230,102 @@ class WebSocketManager {
 		}
 	}
 
+	// Device id of a verified token: its own, or a device of the token's user it names
+	async resolveDeviceId(decoded, claimedDeviceId) {
+		if (decoded.deviceId) {
+			return { deviceId: decoded.deviceId };
+		}
+		// Allow user token + explicit deviceId if it belongs to the user
+		if (claimedDeviceId) {
+			const device = await Device.findOne({ deviceId: claimedDeviceId, owner: decoded.userId });
+			if (!device) {
+				return { error: "Invalid device or not owned by user" };
+			}
+			return { deviceId: claimedDeviceId };
+		}
+		return { error: "Device ID required for device client" };
+	}
+
+	// Sub-devices behind a gateway (ZiLinkGateway): each [channel, deviceId, token] is authenticated like a
+	// device of its own and gets a channel socket that sends through the gateway's connection
+	async handleGatewayAuth(ws, data) {
+		if (ws.clientType !== "device" || !ws.authenticated) {
+			return this.sendError(ws, "Only authenticated devices can be gateways");
+		}
+		const devices = Array.isArray(data?.devices) ? data.devices : [];
+		const accepted = [];
+		const rejected = [];
+		ws.channels ??= new Map();
+		for (const entry of devices) {
+			const [channel, claimedDeviceId, token] = Array.isArray(entry) ? entry : [];
+			if (!Number.isInteger(channel) || channel < 1 || channel > 255) {
+				continue;
+			}
+			try {
+				const decoded = jwt.verify(token, process.env.JWT_SECRET);
+				const resolved = await this.resolveDeviceId(decoded, claimedDeviceId);
+				// A gateway only carries devices of its own user
+				if (resolved.error || decoded.userId !== ws.userId || resolved.deviceId === ws.deviceId) {
+					rejected.push(channel);
+					continue;
+				}
+				const previous = ws.channels.get(channel);
+				if (previous) {
+					this.removeConnection(previous);
+				}
+				const socket = this.channelSocket(ws, channel, resolved.deviceId);
+				ws.channels.set(channel, socket);
+				this.deviceConnections.set(socket.deviceId, socket);
+				accepted.push(channel);
+				console.log(`✅ Gateway ${ws.deviceId} channel ${channel}: ${socket.deviceId}`);
+			} catch (error) {
+				rejected.push(channel);
+			}
+		}
+		this.sendMessage(ws, { type: "gateway_auth_result", data: { accepted, rejected } });
+	}
+
+	// Stands in for a sub-device's WebSocket: what the server sends it goes to the gateway as
+	// {"type":"gw","data":{"ch":N,"msg":"<message as JSON text>"}}
+	channelSocket(gateway, channel, deviceId) {
+		return {
+			clientType: "device",
+			authenticated: true,
+			userId: gateway.userId,
+			deviceId,
+			// JSON both ways; the gateway may still use MessagePack for its own frames
+			encoding: "json",
+			gateway,
+			channel,
+			get readyState() {
+				return gateway.readyState;
+			},
+			get bufferedAmount() {
+				return gateway.bufferedAmount;
+			},
+			send(text) {
+				gateway.send(JSON.stringify({ type: "gw", data: { ch: channel, msg: text } }));
+			},
+		};
+	}
+
+	async handleGatewayFrame(ws, data) {
+		const socket = ws.channels?.get(data?.ch);
+		if (!socket) {
+			return this.sendError(ws, `Unknown gateway channel: ${data?.ch}`);
+		}
+		const message = data.msg;
+		if (!message || typeof message.type !== "string") {
+			return this.sendError(socket, "Invalid message format");
+		}
+		// A sub-device has no session or channels of its own
+		if (message.type === "auth" || message.type === "gateway_auth" || message.type === "gw") {
+			return this.sendError(socket, `Not allowed on a gateway channel: ${message.type}`);
+		}
+		// Already counted against the gateway, which is the one the throttle can slow down
+		await this.handleMessage(socket, message);
+	}
+
 	async handleDeviceRegister(ws, data) {
 		if (ws.clientType !== "device") {
 			return this.sendError(ws, "Only devices can register");
@@ -188,6 +360,10 @@ class WebSocketManager {
 			return this.sendError(ws, "Only devices can send data");
 		}
 
+		if (Array.isArray(data?.batch)) {
+			return this.handleDeviceBatch(ws, data.batch);
+		}
+
 		const { sensorData } = data;
 
 		console.log(`📊 Device data received from ${ws.deviceId}:`, sensorData);
@@ -199,15 +375,7 @@ class WebSocketManager {
 
 			const device = await Device.findOne({ deviceId: ws.deviceId });
 			if (device) {
-				const deviceData = new DeviceData({
-					device: device._id,
-					deviceId: ws.deviceId,
-					sensors: sensorData || [],
-					metadata: {
-						source: "websocket",
-						protocol: "WebSocket",
-					},
-				});
+				const deviceData = new DeviceData(this.deviceDataRecord(ws, device, sensorData));
 
 				await deviceData.save();
 
@@ -217,6 +385,12 @@ class WebSocketManager {
 					lastSeen: new Date(),
 				});
 			}
+
+			// Frames replayed from a device's durable log carry a sequence number;
+			// acknowledging it lets the device truncate its log
+			if (Number.isInteger(data.seq)) {
+				this.sendMessage(ws, { type: "ack", data: { seq: data.seq } });
+			}
 		} catch (error) {
 			console.error("❌ Error saving device data:", error);
 		}
@@ -232,6 +406,244 @@ class WebSocketManager {
 		});
 	}
 
+	// Batched device_data frame: { batch: [sensorData, sensorData, ...] }
+	// One stored reading; batched and single readings share the shape
+	deviceDataRecord(ws, device, sensorData) {
+		return {
+			device: device._id,
+			deviceId: ws.deviceId,
+			sensors: sensorData || [],
+			metadata: {
+				source: "websocket",
+				protocol: "WebSocket",
+			},
+		};
+	}
+
+	async handleDeviceBatch(ws, batch) {
+		if (batch.length === 0) return;
+
+		console.log(`📊 Device batch received from ${ws.deviceId}: ${batch.length} readings`);
+
+		const timestamp = new Date();
+		try {
+			const Device = (await import("../models/Device.js")).default;
+			const DeviceData = (await import("../models/DeviceData.js")).default;
+
+			const device = await Device.findOne({ deviceId: ws.deviceId });
+			if (device) {
+				// One round-trip for the whole batch instead of one save per reading
+				await DeviceData.insertMany(batch.map((sensorData) => this.deviceDataRecord(ws, device, sensorData)));
+
+				await device.updateStatus({
+					isOnline: true,
+					lastSeen: timestamp,
+				});
+			}
+		} catch (error) {
+			console.error("❌ Error saving device batch:", error);
+		}
+
+		this.broadcastToWebClients({
+			type: "device_batch_data",
+			data: {
+				deviceId: ws.deviceId,
+				batchData: batch.map((sensorData) => ({ sensorData, timestamp: timestamp.toISOString() })),
+				count: batch.length,
+			},
+		});
+	}
+
+	// Component state pushed by a device; mirrors POST /devices/:id/components.
+	// A list (the snapshot sent after reconnecting) is stored with one save.
+	async handleComponentUpdate(ws, data) {
+		if (ws.clientType !== "device") {
+			return this.sendError(ws, "Only devices can update components");
+		}
+
+		const updates = (Array.isArray(data) ? data : [data]).filter((c) => c?.type && c?.id);
+		if (updates.length === 0) {
+			return this.sendError(ws, "Component type and id are required");
+		}
+
+		try {
+			const device = await Device.findOne({ deviceId: ws.deviceId });
+			if (device) {
+				if (!device.components) {
+					device.components = [];
+				}
+				const updatedAt = new Date();
+				for (const { id, type, value } of updates) {
+					const existing = device.components.find((c) => c.id === id);
+					if (existing) {
+						existing.type = type;
+						existing.value = value;
+						existing.updatedAt = updatedAt;
+					} else {
+						device.components.push({ id, type, value, updatedAt });
+					}
+				}
+				await device.save();
+			}
+		} catch (error) {
+			console.error("❌ Error saving component update:", error);
+		}
+
+		for (const { id, type, value } of updates) {
+			this.broadcastToWebClients({
+				type: "device_component_update",
+				data: { deviceId: ws.deviceId, component: { id, type, value } },
+			});
+		}
+	}
+
+	// A device's compile-time widget list as [[id, type], ...]; later updates name a widget by its position.
+	// Kept per connection: the device announces it again after reconnecting.
+	handleComponentSchema(ws, components) {
+		if (ws.clientType !== "device") {
+			return this.sendError(ws, "Only devices can announce components");
+		}
+		if (!Array.isArray(components)) {
+			return this.sendError(ws, "Component schema must be a list");
+		}
+		ws.componentSchema = components.map((c) => (Array.isArray(c) ? { id: c[0], type: c[1] } : {}));
+	}
+
+	// {i, v} -> {id, type, value}; null for an index the schema does not have, which the update rejects
+	widgetUpdate(ws, { i, v }) {
+		const widget = Number.isInteger(i) ? ws.componentSchema?.[i] : undefined;
+		return widget?.id ? { id: widget.id, type: widget.type, value: v } : null;
+	}
+
+	// Periodic runtime counters from the device library (setStatsReport); relayed live, not stored
+	handleDeviceStats(ws, data) {
+		if (ws.clientType !== "device") {
+			return this.sendError(ws, "Only devices can send stats");
+		}
+		this.broadcastDeviceStats(ws.deviceId, data);
+	}
+
+	// A device's answer to a command (sendCommandResponse); relayed live, not stored
+	handleCommandResponse(ws, data) {
+		if (ws.clientType !== "device") {
+			return this.sendError(ws, "Only devices can respond to commands");
+		}
+		this.broadcastToWebClients({
+			type: "command_response",
+			data: { deviceId: ws.deviceId, response: data, timestamp: new Date().toISOString() },
+		});
+	}
+
+	broadcastDeviceStats(deviceId, stats) {
+		this.broadcastToWebClients({
+			type: "device_stats",
+			data: { deviceId, stats, timestamp: new Date().toISOString() },
+		});
+	}
+
+	// A device announces a waveform stream (again after every reconnect) and waits for credit before sending chunks
+	handleStreamOpen(ws, data) {
+		if (ws.clientType !== "device") {
+			return this.sendError(ws, "Only devices can open streams");
+		}
+		const { id, name, format, rate, chunk, seq } = data ?? {};
+		if (!Number.isInteger(id) || !streamFormatOf(format)) {
+			return this.sendError(ws, "Stream id and format are required");
+		}
+		if (!ws.streams) {
+			ws.streams = new Map();
+		}
+		const stream = { id, name, format, rate, chunk, credit: new StreamCredit(seq ?? 0, STREAM_CREDIT_CHUNKS), index: null, missing: 0 };
+		ws.streams.set(id, stream);
+		this.broadcastToWebClients({
+			type: "device_stream_open",
+			data: { deviceId: ws.deviceId, stream: { id, name, format, rate } },
+		});
+		this.sendStreamCredit(ws, stream, stream.credit.until);
+	}
+
+	handleStreamChunk(ws, buffer) {
+		const stream = ws.clientType === "device" ? ws.streams?.get(buffer[1]) : undefined;
+		if (!stream) {
+			return this.sendError(ws, "Chunk for a stream that is not open");
+		}
+		const chunk = parseStreamChunk(buffer);
+		if (!stream.credit.consume(chunk.seq)) {
+			return this.sendError(ws, "Stream chunk beyond granted credit");
+		}
+		// Samples the device dropped (or lost with a failed send) show up as a jump in the sample index
+		if (stream.index !== null && chunk.index !== stream.index) {
+			stream.missing += (chunk.index - stream.index) >>> 0;
+		}
+		stream.index = (chunk.index + chunk.samples.length) >>> 0;
+
+		this.broadcastToWebClients({
+			type: "device_stream",
+			data: {
+				deviceId: ws.deviceId,
+				id: stream.id,
+				name: stream.name,
+				rate: stream.rate,
+				seq: chunk.seq,
+				index: chunk.index,
+				gap: chunk.gap,
+				samples: chunk.samples,
+			},
+		});
+
+		const until = stream.credit.topUp();
+		if (until !== null) {
+			this.sendStreamCredit(ws, stream, until);
+		}
+	}
+
+	sendStreamCredit(ws, stream, until) {
+		if (this.webBufferedAmount() > STREAM_MAX_BUFFERED_BYTES) {
+			clearTimeout(stream.creditTimer);
+			stream.creditTimer = setTimeout(() => this.sendStreamCredit(ws, stream, until), 20);
+			return;
+		}
+		this.sendMessage(ws, { type: "stream_credit", data: { id: stream.id, until } });
+	}
+
+	// Once per interval: event-loop lag and per-device frame rates decide each device's ceiling
+	startGovernor() {
+		this.loopDelay = monitorEventLoopDelay({ resolution: 10 });
+		this.loopDelay.enable();
+		this.governorTimer = setInterval(() => this.regulate(), THROTTLE_INTERVAL_MS);
+		this.governorTimer.unref();
+		this.wss.on("close", () => {
+			clearInterval(this.governorTimer);
+			this.loopDelay.disable();
+		});
+	}
+
+	regulate() {
+		const lagMs = this.loopDelay.percentile(99) / 1e6;
+		this.loopDelay.reset();
+		const wasThrottling = this.governor.throttling;
+		for (const { id, data } of this.governor.tick(lagMs)) {
+			this.broadcastToDevice(id, { type: "throttle", data });
+		}
+		if (this.governor.throttling !== wasThrottling) {
+			console.log(
+				this.governor.throttling
+					? `🚦 Throttling devices: ${Math.round(this.governor.budget)} frames/s (lag ${Math.round(lagMs)} ms)`
+					: "🚦 Device throttle lifted",
+			);
+		}
+	}
+
+	webBufferedAmount() {
+		let most = 0;
+		this.clients.forEach((connections) => {
+			connections.forEach((client) => {
+				most = Math.max(most, client.bufferedAmount ?? 0);
+			});
+		});
+		return most;
+	}
+
 	async handleDeviceCommand(ws, data) {
 		if (ws.clientType !== "web") {
 			return this.sendError(ws, "Only web clients can send commands");
@@ -245,13 +657,7 @@ class WebSocketManager {
 		}
 
 		// Send command to device
-		this.sendMessage(deviceWs, {
-			type: "command",
-			data: {
-				command,
-				timestamp: new Date().toISOString(),
-			},
-		});
+		this.sendCommand(deviceWs, command);
 
 		// Confirm to web client
 		this.sendMessage(ws, {
@@ -296,6 +702,23 @@ class WebSocketManager {
 		}
 	}
 
+	sendCommand(deviceWs, command) {
+		if (deviceWs.readyState !== WebSocket.OPEN) {
+			return;
+		}
+		if (deviceWs.encoding === "msgpack") {
+			deviceWs.send(encodeCommand(command));
+			return;
+		}
+		this.sendMessage(deviceWs, {
+			type: "command",
+			data: {
+				command,
+				timestamp: new Date().toISOString(),
+			},
+		});
+	}
+
 	sendError(ws, error) {
 		this.sendMessage(ws, {
 			type: "error",
@@ -324,8 +747,13 @@ class WebSocketManager {
 	}
 
 	removeConnection(ws) {
+		// A gateway takes its sub-devices with it
+		ws.channels?.forEach((socket) => this.removeConnection(socket));
+		ws.channels?.clear();
 		if (ws.clientType === "device" && ws.deviceId) {
 			this.deviceConnections.delete(ws.deviceId);
+			this.governor.forget(ws.deviceId);
+			ws.streams?.forEach((stream) => clearTimeout(stream.creditTimer));
 
 			// Notify web clients that device is offline
 			this.broadcastToWebClients({
@@ -0,0 +1,291 @@
+// Minimal MessagePack codec for the binary device protocol.
+// Ext type 1 carries little-endian float32 samples and decodes to a number array.
+
+export const EXT_FLOAT32_ARRAY = 1;
+
+// Binary frames are arrays whose first element is the frame kind
+export const FrameKind = {
+	DEVICE_DATA: 1,
+	COMPONENT: 2,
+	COMMAND: 3,
+	BATCH: 4,
+	COMPONENT_SNAPSHOT: 5,
+	COMPONENT_SCHEMA: 6,
+	WIDGET: 7,
+	GATEWAY: 8,
+};
+
+// float32 holds ~7 significant digits; trim the binary noise (23.45 -> 23.450000762939453)
+const roundFloat32 = (v) => (Number.isFinite(v) ? Number.parseFloat(v.toPrecision(7)) : null);
+
+// A 64-bit integer that a Number cannot hold exactly is refused rather than rounded
+const safe = (big) => {
+	if (big > BigInt(Number.MAX_SAFE_INTEGER) || big < BigInt(Number.MIN_SAFE_INTEGER)) {
+		throw new RangeError(`MessagePack integer ${big} is outside the safe integer range`);
+	}
+	return Number(big);
+};
+
+export function decode(buffer) {
+	const buf = Buffer.isBuffer(buffer) ? buffer : Buffer.from(buffer);
+	let pos = 0;
+
+	const need = (n) => {
+		if (pos + n > buf.length) {
+			throw new RangeError("Truncated MessagePack data");
+		}
+	};
+	const uint = (bytes) => {
+		need(bytes);
+		let v;
+		if (bytes === 1) v = buf.readUInt8(pos);
+		else if (bytes === 2) v = buf.readUInt16BE(pos);
+		else if (bytes === 4) v = buf.readUInt32BE(pos);
+		else v = safe(buf.readBigUInt64BE(pos));
+		pos += bytes;
+		return v;
+	};
+	const int = (bytes) => {
+		need(bytes);
+		let v;
+		if (bytes === 1) v = buf.readInt8(pos);
+		else if (bytes === 2) v = buf.readInt16BE(pos);
+		else if (bytes === 4) v = buf.readInt32BE(pos);
+		else v = safe(buf.readBigInt64BE(pos));
+		pos += bytes;
+		return v;
+	};
+	const str = (n) => {
+		need(n);
+		const s = buf.toString("utf8", pos, pos + n);
+		pos += n;
+		return s;
+	};
+	const array = (n, depth) => {
+		const out = new Array(n);
+		for (let i = 0; i < n; i++) out[i] = value(depth + 1);
+		return out;
+	};
+	const map = (n, depth) => {
+		const out = {};
+		for (let i = 0; i < n; i++) {
+			const key = value(depth + 1);
+			out[key] = value(depth + 1);
+		}
+		return out;
+	};
+	const ext = (n) => {
+		need(n + 1);
+		const type = buf.readInt8(pos);
+		pos += 1;
+		const start = pos;
+		pos += n;
+		if (type === EXT_FLOAT32_ARRAY && n % 4 === 0) {
+			const out = new Array(n / 4);
+			for (let i = 0; i < out.length; i++) out[i] = roundFloat32(buf.readFloatLE(start + i * 4));
+			return out;
+		}
+		return { type, data: buf.subarray(start, pos) };
+	};
+
+	const value = (depth) => {
+		if (depth > 32) {
+			throw new RangeError("MessagePack nesting too deep");
+		}
+		need(1);
+		const t = buf[pos++];
+		if (t <= 0x7f) return t;
+		if (t <= 0x8f) return map(t & 0x0f, depth);
+		if (t <= 0x9f) return array(t & 0x0f, depth);
+		if (t <= 0xbf) return str(t & 0x1f);
+		if (t >= 0xe0) return t - 0x100;
+		switch (t) {
+			case 0xc0:
+				return null;
+			case 0xc2:
+				return false;
+			case 0xc3:
+				return true;
+			case 0xc4:
+			case 0xc5:
+			case 0xc6: {
+				const n = uint(1 << (t - 0xc4));
+				need(n);
+				pos += n;
+				return buf.subarray(pos - n, pos);
+			}
+			case 0xc7:
+			case 0xc8:
+			case 0xc9:
+				return ext(uint(1 << (t - 0xc7)));
+			case 0xca: {
+				need(4);
+				const v = buf.readFloatBE(pos);
+				pos += 4;
+				return roundFloat32(v);
+			}
+			case 0xcb: {
+				need(8);
+				const v = buf.readDoubleBE(pos);
+				pos += 8;
+				return v;
+			}
+			case 0xcc:
+			case 0xcd:
+			case 0xce:
+			case 0xcf:
+				return uint(1 << (t - 0xcc));
+			case 0xd0:
+			case 0xd1:
+			case 0xd2:
+			case 0xd3:
+				return int(1 << (t - 0xd0));
+			case 0xd4:
+			case 0xd5:
+			case 0xd6:
+			case 0xd7:
+			case 0xd8:
+				return ext(1 << (t - 0xd4));
+			case 0xd9:
+			case 0xda:
+			case 0xdb:
+				return str(uint(1 << (t - 0xd9)));
+			case 0xdc:
+			case 0xdd:
+				return array(uint(t === 0xdc ? 2 : 4), depth);
+			case 0xde:
+			case 0xdf:
+				return map(uint(t === 0xde ? 2 : 4), depth);
+			default:
+				throw new RangeError(`Invalid MessagePack tag 0x${t.toString(16)}`);
+		}
+	};
+
+	const result = value(0);
+	if (pos !== buf.length) {
+		throw new RangeError("Trailing bytes after MessagePack value");
+	}
+	return result;
+}
+
+export function encode(value) {
+	const chunks = [];
+	const header = (tag, n, bytes) => {
+		const b = Buffer.alloc(1 + bytes);
+		b[0] = tag;
+		if (bytes === 1) b.writeUInt8(n, 1);
+		else if (bytes === 2) b.writeUInt16BE(n, 1);
+		else if (bytes === 4) b.writeUInt32BE(n, 1);
+		chunks.push(b);
+	};
+	const sized = (n, fixTag, fixMax, tags) => {
+		if (n <= fixMax) chunks.push(Buffer.from([fixTag | n]));
+		else if (tags[0] && n <= 0xff) header(tags[0], n, 1);
+		else if (n <= 0xffff) header(tags[1], n, 2);
+		else header(tags[2], n, 4);
+	};
+
+	const write = (v) => {
+		if (v === null || v === undefined) {
+			chunks.push(Buffer.from([0xc0]));
+		} else if (typeof v === "boolean") {
+			chunks.push(Buffer.from([v ? 0xc3 : 0xc2]));
+		} else if (typeof v === "number") {
+			if (Number.isInteger(v) && v >= -0x80000000 && v <= 0xffffffff) {
+				if (v >= 0) {
+					if (v < 0x80) chunks.push(Buffer.from([v]));
+					else if (v <= 0xff) header(0xcc, v, 1);
+					else if (v <= 0xffff) header(0xcd, v, 2);
+					else header(0xce, v, 4);
+				} else if (v >= -32) {
+					chunks.push(Buffer.from([v & 0xff]));
+				} else {
+					const b = Buffer.alloc(5);
+					b[0] = 0xd2;
+					b.writeInt32BE(v, 1);
+					chunks.push(b);
+				}
+			} else {
+				const b = Buffer.alloc(9);
+				b[0] = 0xcb;
+				b.writeDoubleBE(v, 1);
+				chunks.push(b);
+			}
+		} else if (typeof v === "string") {
+			const bytes = Buffer.from(v, "utf8");
+			sized(bytes.length, 0xa0, 31, [0xd9, 0xda, 0xdb]);
+			chunks.push(bytes);
+		} else if (Array.isArray(v)) {
+			sized(v.length, 0x90, 15, [0, 0xdc, 0xdd]);
+			v.forEach(write);
+		} else if (Buffer.isBuffer(v)) {
+			if (v.length <= 0xff) header(0xc4, v.length, 1);
+			else if (v.length <= 0xffff) header(0xc5, v.length, 2);
+			else header(0xc6, v.length, 4);
+			chunks.push(v);
+		} else if (v instanceof Date) {
+			write(v.toISOString());
+		} else if (typeof v === "object") {
+			const entries = Object.entries(v).filter(([, item]) => item !== undefined);
+			sized(entries.length, 0x80, 15, [0, 0xde, 0xdf]);
+			for (const [key, item] of entries) {
+				write(key);
+				write(item);
+			}
+		} else {
+			throw new TypeError(`Cannot encode ${typeof v} as MessagePack`);
+		}
+	};
+
+	write(value);
+	return Buffer.concat(chunks);
+}
+
+// Latency tracing: [n, deviceMs] as the last element of a frame
+const withTrace = (data, trace) => (Array.isArray(trace) ? { ...data, trace } : data);
+
+// Maps a binary device frame onto the equivalent JSON message
+export function frameToMessage(frame) {
+	if (!Array.isArray(frame) || !Number.isInteger(frame[0])) {
+		throw new TypeError("Binary frame must be an array starting with its kind");
+	}
+	const [kind, ...rest] = frame;
+	switch (kind) {
+		case FrameKind.DEVICE_DATA: {
+			// seq is nil when the frame is only traced
+			const [sensorData, seq, trace] = rest;
+			return { type: "device_data", data: withTrace(seq == null ? { sensorData } : { sensorData, seq }, trace) };
+		}
+		case FrameKind.COMPONENT: {
+			const [type, id, value, trace] = rest;
+			return { type: "component", data: withTrace({ type, id, value }, trace) };
+		}
+		case FrameKind.COMPONENT_SNAPSHOT: {
+			const list = Array.isArray(rest[0]) ? rest[0] : [];
+			const components = list.filter(Array.isArray).map(([type, id, value]) => ({ type, id, value }));
+			return { type: "component_snapshot", data: { components } };
+		}
+		case FrameKind.COMPONENT_SCHEMA: {
+			const list = Array.isArray(rest[0]) ? rest[0] : [];
+			return { type: "component_schema", data: { components: list.filter(Array.isArray) } };
+		}
+		case FrameKind.WIDGET: {
+			// Top-level fields, like the JSON form {"type":"c","i":0,"v":42}
+			const [i, v, trace] = rest;
+			return Array.isArray(trace) ? { type: "c", i, v, trace } : { type: "c", i, v };
+		}
+		case FrameKind.GATEWAY: {
+			// The sub-device's JSON message, transcoded like the rest of the frame
+			const [ch, msg] = rest;
+			return { type: "gw", data: { ch, msg } };
+		}
+		case FrameKind.BATCH:
+			return { type: "device_data", data: withTrace({ batch: Array.isArray(rest[0]) ? rest[0] : [] }, rest[1]) };
+		default:
+			throw new TypeError(`Unknown binary frame kind: ${kind}`);
+	}
+}
+
+export function encodeCommand(command) {
+	return encode([FrameKind.COMMAND, command]);
+}
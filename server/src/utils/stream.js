@@ -0,0 +1,76 @@
+// Waveform stream chunks from the device library (ZiLinkStream). They are binary WebSocket frames that start with
+// 0xC1, a byte MessagePack never uses, so they share the binary channel with MessagePack frames. Little-endian:
+//   0 marker, 1 stream id, 2 format, 3 flags, 4..7 chunk sequence number, 8..11 index of the first sample, samples
+
+export const STREAM_MARKER = 0xc1;
+export const STREAM_HEADER_BYTES = 12;
+// Samples were dropped on the device just before this chunk
+export const STREAM_FLAG_GAP = 0x01;
+
+export const StreamFormat = {
+	INT16: 1,
+	FLOAT32: 2,
+};
+
+const FORMAT_NAMES = { int16: StreamFormat.INT16, float32: StreamFormat.FLOAT32 };
+
+export const streamFormatOf = (name) => FORMAT_NAMES[name];
+
+export const isStreamChunk = (buffer) => buffer.length >= STREAM_HEADER_BYTES && buffer[0] === STREAM_MARKER;
+
+// float32 holds ~7 significant digits; trim the binary noise like the MessagePack decoder does
+const roundFloat32 = (v) => (Number.isFinite(v) ? Number.parseFloat(v.toPrecision(7)) : null);
+
+export function parseStreamChunk(buffer) {
+	const buf = Buffer.isBuffer(buffer) ? buffer : Buffer.from(buffer);
+	if (!isStreamChunk(buf)) {
+		throw new RangeError("Not a stream chunk");
+	}
+	const format = buf[2];
+	const size = format === StreamFormat.INT16 ? 2 : format === StreamFormat.FLOAT32 ? 4 : 0;
+	const bytes = buf.length - STREAM_HEADER_BYTES;
+	if (size === 0 || bytes % size !== 0) {
+		throw new RangeError("Malformed stream chunk");
+	}
+	const samples = new Array(bytes / size);
+	for (let i = 0; i < samples.length; i++) {
+		const at = STREAM_HEADER_BYTES + i * size;
+		samples[i] = size === 2 ? buf.readInt16LE(at) : roundFloat32(buf.readFloatLE(at));
+	}
+	return {
+		id: buf[1],
+		format,
+		gap: (buf[3] & STREAM_FLAG_GAP) !== 0,
+		seq: buf.readUInt32LE(4),
+		index: buf.readUInt32LE(8),
+		samples,
+	};
+}
+
+// Credit-based flow control for one stream. The device may send chunks whose sequence number is below `until`.
+// Credit is topped up as chunks are consumed, once half of the window is used.
+export class StreamCredit {
+	constructor(seq, window) {
+		this.window = window;
+		this.next = seq >>> 0;
+		this.until = (this.next + window) >>> 0;
+	}
+
+	// False when the chunk is beyond the granted credit (the device ignored flow control)
+	consume(seq) {
+		if (((seq - this.until) | 0) >= 0) {
+			return false;
+		}
+		this.next = (seq + 1) >>> 0;
+		return true;
+	}
+
+	// New `until` to send, or null while more than half of the window is left
+	topUp() {
+		if (((this.until - this.next) | 0) > this.window / 2) {
+			return null;
+		}
+		this.until = (this.next + this.window) >>> 0;
+		return this.until;
+	}
+}
@@ -0,0 +1,125 @@
+// Fleet-wide upload governor for the device library's throttle message (ZiLinkThrottle). The server counts the
+// frames each device sends and, once per tick, compares the total and its own event-loop lag against a budget:
+//   - lag above lagHighMs that is still growing halves the budget (from what the fleet actually sent); lag that is
+//     already falling is left to drain, so one overload does not halve the budget over and over
+//   - a total above capacity caps the budget at capacity
+//   - lag below lagLowMs adds a tenth of capacity per tick, up to capacity; the limit lifts once the budget is back
+//     at capacity and no device is using its whole ceiling (throttled devices hide their real demand)
+// The budget is shared max-min fair: every device gets the same ceiling, the level at which the devices below it
+// plus the ceiling for the rest add up to the budget, so quiet devices are not slowed by loud ones.
+// A device is told only when its ceiling moves by more than a tenth, and renewed before its ttl lapses.
+
+const DEFAULTS = {
+	capacity: 2000, // device frames per second the server takes without lagging
+	lagHighMs: 100,
+	lagLowMs: 30,
+	minRate: 0.2, // frames per second no device goes below
+	ttlMs: 10000, // a throttle lapses on the device unless renewed within this
+	headroom: 1.25, // throttled devices may grow this much per tick, so freed budget is found
+};
+
+export class LoadGovernor {
+	constructor(options = {}) {
+		this.options = { ...DEFAULTS, ...options };
+		this.budget = Infinity; // frames per second for the fleet; Infinity while nobody is throttled
+		this.devices = new Map(); // id -> { count, rate, sent, sentAt }
+		this.lastTick = null;
+		this.lastLagMs = 0;
+	}
+
+	get throttling() {
+		return Number.isFinite(this.budget);
+	}
+
+	// One frame from a device
+	record(id) {
+		const device = this.devices.get(id);
+		if (device) {
+			device.count++;
+		} else {
+			this.devices.set(id, { count: 1, rate: 0, sent: 0, sentAt: 0 });
+		}
+	}
+
+	forget(id) {
+		this.devices.delete(id);
+	}
+
+	// Measures the last interval and returns the throttle messages to send: [{ id, data: { rate, burst, ttl } }],
+	// rate 0 lifting a throttle
+	tick(lagMs, now = Date.now()) {
+		const seconds = this.lastTick === null ? 1 : Math.max((now - this.lastTick) / 1000, 0.001);
+		this.lastTick = now;
+		let total = 0;
+		let constrained = false;
+		this.devices.forEach((device) => {
+			device.rate = device.count / seconds;
+			device.count = 0;
+			total += device.rate;
+			constrained ||= device.sent > 0 && device.rate >= device.sent * 0.9;
+		});
+		this.adjustBudget(total, lagMs, constrained);
+		this.lastLagMs = lagMs;
+		return this.throttling ? this.allocate(now) : this.lift();
+	}
+
+	adjustBudget(total, lagMs, constrained) {
+		const { capacity, lagHighMs, lagLowMs } = this.options;
+		if (lagMs > lagHighMs) {
+			if (!this.throttling || lagMs >= this.lastLagMs) {
+				this.budget = Math.max(Math.min(this.budget, total) / 2, this.options.minRate * this.devices.size);
+			}
+		} else if (total > capacity) {
+			this.budget = Math.min(this.budget, capacity);
+		} else if (this.throttling && lagMs < lagLowMs) {
+			if (this.budget >= capacity && !constrained) {
+				this.budget = Infinity;
+			} else {
+				this.budget = Math.min(this.budget + capacity / 10, capacity);
+			}
+		}
+	}
+
+	// Max-min fair ceiling: the level L with sum(min(demand, L)) = budget
+	level() {
+		const demands = [];
+		this.devices.forEach((device) => demands.push(device.rate * this.options.headroom));
+		demands.sort((a, b) => a - b);
+		let left = this.budget;
+		for (let i = 0; i < demands.length; i++) {
+			const share = left / (demands.length - i);
+			if (demands[i] > share) {
+				return share;
+			}
+			left -= demands[i];
+		}
+		// Everyone fits: spread what is left on top of the largest demand
+		return (demands.at(-1) ?? 0) + left / Math.max(demands.length, 1);
+	}
+
+	allocate(now) {
+		const { minRate, ttlMs } = this.options;
+		const rate = Math.max(this.level(), minRate);
+		const updates = [];
+		this.devices.forEach((device, id) => {
+			const moved = !device.sent || Math.abs(rate - device.sent) > device.sent / 10;
+			if (moved || now - device.sentAt >= ttlMs / 2) {
+				device.sent = rate;
+				device.sentAt = now;
+				updates.push({ id, data: { rate: Math.round(rate * 100) / 100, burst: Math.max(1, Math.ceil(rate)), ttl: ttlMs } });
+			}
+		});
+		return updates;
+	}
+
+	lift() {
+		const updates = [];
+		this.devices.forEach((device, id) => {
+			if (device.sent) {
+				device.sent = 0;
+				updates.push({ id, data: { rate: 0 } });
+			}
+		});
+		return updates;
+	}
+}
@@ -0,0 +1,100 @@
+import test from "node:test";
+import assert from "node:assert/strict";
+import { decode, encode, encodeCommand, frameToMessage } from "../src/utils/msgpack.js";
+
+test("device data frame produced by the firmware decodes to the JSON message", () => {
+	// [1, {"temperature":23.45,"humidity":41,"label":"a\"b","list":[1,-2,3.5]}, 77] as encoded by ZiLinkMsgPack
+	const frame = Buffer.from(
+		"930184ab74656d7065726174757265ca41bb999aa868756d696469747929a56c6162656ca3612262a46c6973749301feca406000004d",
+		"hex",
+	);
+	assert.deepEqual(frameToMessage(decode(frame)), {
+		type: "device_data",
+		data: { sensorData: { temperature: 23.45, humidity: 41, label: 'a"b', list: [1, -2, 3.5] }, seq: 77 },
+	});
+});
+
+test("float32 sample arrays decode from the extension type", () => {
+	const samples = new Float32Array([0.1, -2.5, 9.81]);
+	const frame = Buffer.concat([Buffer.from([0x92, 0x01, 0x81, 0xa4, ...Buffer.from("wave"), 0xc7, 12, 0x01]), Buffer.from(samples.buffer)]);
+	assert.deepEqual(frameToMessage(decode(frame)), { type: "device_data", data: { sensorData: { wave: [0.1, -2.5, 9.81] } } });
+});
+
+test("encode and decode round-trip", () => {
+	const value = { a: [0, 127, 128, -1, -33, 70000, -70000, 1.5, null, true, false], s: "x".repeat(40), n: { ok: "é" } };
+	assert.deepEqual(decode(encode(value)), value);
+	assert.deepEqual(decode(encodeCommand("toggle")), [3, "toggle"]);
+});
+
+test("truncated frames are rejected", () => {
+	const frame = encode([1, { temperature: 21.5 }]);
+	assert.throws(() => decode(frame.subarray(0, frame.length - 1)), RangeError);
+	assert.throws(() => frameToMessage(decode(encode({ type: "device_data" }))), TypeError);
+});
+
+test("component snapshot frames map to a component list", () => {
+	const frame = encode([5, [["slider", "fan", 3], ["toggle", "lamp", true]]]);
+	assert.deepEqual(frameToMessage(decode(frame)), {
+		type: "component_snapshot",
+		data: {
+			components: [
+				{ type: "slider", id: "fan", value: 3 },
+				{ type: "toggle", id: "lamp", value: true },
+			],
+		},
+	});
+});
+
+test("component schema and indexed widget frames map to their JSON messages", () => {
+	assert.deepEqual(frameToMessage(decode(encode([6, [["fan", "slider"], ["lamp", "toggle"]]]))), {
+		type: "component_schema",
+		data: { components: [["fan", "slider"], ["lamp", "toggle"]] },
+	});
+	const frame = encode([7, 1, true]);
+	assert.equal(frame.length, 4);
+	assert.deepEqual(frameToMessage(decode(frame)), { type: "c", i: 1, v: true });
+	assert.deepEqual(frameToMessage(decode(encode([7, 0, 42, [8, 1001]]))), { type: "c", i: 0, v: 42, trace: [8, 1001] });
+});
+
+test("traced frames keep their trace", () => {
+	assert.deepEqual(frameToMessage(decode(encode([1, { t: 1 }, null, [7, 1000]]))), {
+		type: "device_data",
+		data: { sensorData: { t: 1 }, trace: [7, 1000] },
+	});
+	assert.deepEqual(frameToMessage(decode(encode([2, "slider", "fan", 3, [8, 1001]]))), {
+		type: "component",
+		data: { type: "slider", id: "fan", value: 3, trace: [8, 1001] },
+	});
+	assert.deepEqual(frameToMessage(decode(encode([4, [{ t: 1 }], [9, 1002]]))).data, { batch: [{ t: 1 }], trace: [9, 1002] });
+});
+
+test("gateway frames carry the sub-device message transcoded in place", () => {
+	const frame = encode([8, 3, { type: "device_data", data: { sensorData: { t: 21.5 } } }]);
+	assert.deepEqual(frameToMessage(decode(frame)), {
+		type: "gw",
+		data: { ch: 3, msg: { type: "device_data", data: { sensorData: { t: 21.5 } } } },
+	});
+});
+
+test("float64 and 64-bit integers decode without rounding", () => {
+	// [1, {"lat":37.7749295,"at":1700000000.25,"n":1700000000123}] as the firmware transcodes it
+	const frame = Buffer.concat([
+		Buffer.from([0x92, 0x01, 0x83, 0xa3, ...Buffer.from("lat"), 0xcb]),
+		Buffer.from(new Float64Array([37.7749295]).buffer).reverse(),
+		Buffer.from([0xa2, ...Buffer.from("at"), 0xcb]),
+		Buffer.from(new Float64Array([1700000000.25]).buffer).reverse(),
+		Buffer.from([0xa1, ...Buffer.from("n"), 0xcf, 0, 0, 0x01, 0x8b, 0xcf, 0xe5, 0x68, 0x7b]),
+	]);
+	assert.deepEqual(frameToMessage(decode(frame)).data.sensorData, { lat: 37.7749295, at: 1700000000.25, n: 1700000000123 });
+});
+
+test("64-bit integers beyond 2^53 are refused, not rounded", () => {
+	// [1, {"n":12345678901234567890}] and [1, {"n":-9007199254740993}]
+	const big = Buffer.from([0x92, 0x01, 0x81, 0xa1, 0x6e, 0xcf, 0xab, 0x54, 0xa9, 0x8c, 0xeb, 0x1f, 0x0a, 0xd2]);
+	assert.throws(() => decode(big), RangeError);
+	const negative = Buffer.from([0x92, 0x01, 0x81, 0xa1, 0x6e, 0xd3, 0xff, 0xdf, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff]);
+	assert.throws(() => decode(negative), RangeError);
+	// The largest exact value still decodes
+	const max = Buffer.from([0x92, 0x01, 0x81, 0xa1, 0x6e, 0xcf, 0x00, 0x1f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff]);
+	assert.equal(decode(max)[1].n, Number.MAX_SAFE_INTEGER);
+});
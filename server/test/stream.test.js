@@ -0,0 +1,46 @@
+import test from "node:test";
+import assert from "node:assert/strict";
+import { StreamCredit, isStreamChunk, parseStreamChunk, STREAM_MARKER } from "../src/utils/stream.js";
+
+const chunk = (id, format, flags, seq, index, payload) => {
+	const header = Buffer.alloc(12);
+	header[0] = STREAM_MARKER;
+	header[1] = id;
+	header[2] = format;
+	header[3] = flags;
+	header.writeUInt32LE(seq, 4);
+	header.writeUInt32LE(index, 8);
+	return Buffer.concat([header, Buffer.from(payload.buffer)]);
+};
+
+test("int16 chunk as written by the firmware", () => {
+	const frame = chunk(1, 1, 0, 7, 3584, new Int16Array([0, -1, 32767, -32768]));
+	assert.equal(isStreamChunk(frame), true);
+	assert.deepEqual(parseStreamChunk(frame), { id: 1, format: 1, gap: false, seq: 7, index: 3584, samples: [0, -1, 32767, -32768] });
+});
+
+test("float32 chunk with the gap flag", () => {
+	const frame = chunk(2, 2, 1, 0xffffffff, 12, new Float32Array([0.1, -9.81]));
+	const parsed = parseStreamChunk(frame);
+	assert.equal(parsed.gap, true);
+	assert.equal(parsed.seq, 0xffffffff);
+	assert.deepEqual(parsed.samples, [0.1, -9.81]);
+});
+
+test("MessagePack frames and malformed chunks are not stream chunks", () => {
+	assert.equal(isStreamChunk(Buffer.from([0x92, 0x01, 0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0])), false);
+	assert.throws(() => parseStreamChunk(Buffer.concat([chunk(1, 1, 0, 0, 0, new Int16Array(0)), Buffer.from([1])])));
+	assert.throws(() => parseStreamChunk(chunk(1, 9, 0, 0, 0, new Int16Array(2))));
+});
+
+test("credit is topped up once half the window is used and survives wrap-around", () => {
+	const credit = new StreamCredit(0xfffffffe, 8);
+	assert.equal(credit.until, 6);
+	for (let i = 0; i < 3; i++) {
+		assert.equal(credit.consume((0xfffffffe + i) >>> 0), true);
+		assert.equal(credit.topUp(), null);
+	}
+	assert.equal(credit.consume(1), true);
+	assert.equal(credit.topUp(), 10);
+	assert.equal(credit.consume(10), false);
+});
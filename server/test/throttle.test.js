@@ -0,0 +1,130 @@
+import test from "node:test";
+import assert from "node:assert/strict";
+import { LoadGovernor } from "../src/utils/throttle.js";
+
+const send = (governor, id, frames) => {
+	for (let i = 0; i < frames; i++) {
+		governor.record(id);
+	}
+};
+
+test("no throttle while the server keeps up", () => {
+	const governor = new LoadGovernor({ capacity: 100 });
+	for (let t = 1; t <= 5; t++) {
+		send(governor, "a", 40);
+		send(governor, "b", 40);
+		assert.deepEqual(governor.tick(5, t * 1000), []);
+	}
+	assert.equal(governor.throttling, false);
+});
+
+test("a total above capacity throttles every device to a fair share", () => {
+	const governor = new LoadGovernor({ capacity: 100, ttlMs: 10000 });
+	governor.tick(0, 0);
+	send(governor, "quiet", 10);
+	send(governor, "loud", 150);
+	send(governor, "louder", 300);
+	const updates = governor.tick(0, 1000);
+	assert.equal(governor.budget, 100);
+	// 12.5 for the quiet one (with headroom), the rest split between the loud ones
+	const rate = (100 - 12.5) / 2;
+	assert.deepEqual(
+		updates.map((u) => u.id).sort(),
+		["loud", "louder", "quiet"],
+	);
+	for (const u of updates) {
+		assert.equal(u.data.rate, Math.round(rate * 100) / 100);
+		assert.equal(u.data.burst, Math.ceil(rate));
+		assert.equal(u.data.ttl, 10000);
+	}
+});
+
+test("lag halves the budget from what the fleet sent", () => {
+	const governor = new LoadGovernor({ capacity: 1000 });
+	governor.tick(0, 0);
+	send(governor, "a", 300);
+	send(governor, "b", 300);
+	const updates = governor.tick(250, 1000);
+	assert.equal(governor.budget, 300);
+	assert.equal(updates.length, 2);
+	assert.equal(updates[0].data.rate, 150);
+});
+
+test("renewals before the ttl, no resend for small moves, lift when recovered", () => {
+	const governor = new LoadGovernor({ capacity: 100, ttlMs: 4000 });
+	governor.tick(0, 0);
+	send(governor, "a", 200);
+	assert.equal(governor.tick(0, 1000).length, 1);
+	// Throttled device sends what it was granted: nothing to tell it
+	send(governor, "a", 99);
+	assert.deepEqual(governor.tick(40, 2000), []);
+	// Half the ttl later it is renewed
+	send(governor, "a", 99);
+	assert.equal(governor.tick(40, 3000).length, 1);
+	// Lag gone: the budget grows back to capacity, then the limit lifts
+	send(governor, "a", 50);
+	const lifted = governor.tick(5, 4000);
+	assert.equal(governor.throttling, false);
+	assert.deepEqual(lifted, [{ id: "a", data: { rate: 0 } }]);
+	send(governor, "a", 50);
+	assert.deepEqual(governor.tick(5, 5000), []);
+});
+
+test("forgotten devices get no updates", () => {
+	const governor = new LoadGovernor({ capacity: 10 });
+	governor.tick(0, 0);
+	send(governor, "a", 20);
+	send(governor, "b", 20);
+	governor.forget("b");
+	assert.deepEqual(
+		governor.tick(0, 1000).map((u) => u.id),
+		["a"],
+	);
+});
+
+// A fleet whose demand exceeds what the server can process: the server's backlog (and so its lag) grows while it
+// is offered more than capacity. Devices obey the throttle (coalescing the rest) until it lapses.
+test("the fleet converges below capacity and recovers when demand drops", () => {
+	const capacity = 1000;
+	const governor = new LoadGovernor({ capacity: 1200, ttlMs: 5000 });
+	const devices = Array.from({ length: 50 }, (_, i) => ({ id: `d${i}`, demand: 10 + (i % 10) * 8, rate: 0, until: 0 }));
+	// Twice what the server can process
+	assert.ok(devices.reduce((sum, d) => sum + d.demand, 0) > 2 * capacity);
+	let backlog = 0;
+	const history = [];
+	for (let t = 0; t < 120; t++) {
+		const now = t * 1000;
+		if (t === 80) {
+			devices.forEach((d) => (d.demand = 5));
+		}
+		let offered = 0;
+		for (const d of devices) {
+			const limited = d.rate > 0 && now < d.until;
+			const frames = Math.floor(limited ? Math.min(d.demand, d.rate) : d.demand);
+			send(governor, d.id, frames);
+			offered += frames;
+		}
+		backlog = Math.max(0, backlog + offered - capacity);
+		const lagMs = (backlog / capacity) * 1000;
+		for (const { id, data } of governor.tick(lagMs, now)) {
+			const d = devices.find((x) => x.id === id);
+			d.rate = data.rate;
+			d.until = now + (data.ttl ?? 0);
+		}
+		history.push({ offered, lagMs });
+	}
+	const settled = history.slice(40, 80);
+	// Once settled, the backlog never exceeds a few ticks of probing above capacity
+	assert.ok(Math.max(...settled.map((h) => h.lagMs)) < 250, "lag stays bounded once settled");
+	assert.ok(settled.reduce((sum, h) => sum + h.offered, 0) / settled.length <= capacity, "offered load within capacity");
+	// A device below the fair share was never slowed
+	const quiet = new LoadGovernor({ capacity: 100 });
+	quiet.tick(0, 0);
+	send(quiet, "quiet", 5);
+	send(quiet, "loud", 500);
+	const level = quiet.tick(0, 1000)[0].data.rate;
+	assert.ok(level > 5 * 1.25);
+	// Demand dropped at t = 80: the throttle lifts
+	assert.equal(governor.throttling, false);
+	assert.ok(history.at(-1).lagMs < 1);
+});
@@ -0,0 +1,344 @@
+import test, { mock } from "node:test";
+import assert from "node:assert/strict";
+import WebSocket from "ws";
+import jwt from "jsonwebtoken";
+
+process.env.NODE_ENV = "test";
+process.env.JWT_SECRET = "test-secret";
+
+const { default: Device } = await import("../src/models/Device.js");
+const { default: DeviceData } = await import("../src/models/DeviceData.js");
+const { wsManager } = await import("../src/services/websocket.js");
+
+const makeDeviceSocket = (deviceId) => ({
+	clientType: "device",
+	deviceId,
+	readyState: WebSocket.OPEN,
+	sent: [],
+	send(raw) {
+		this.sent.push(JSON.parse(raw));
+	},
+});
+
+test("device_data batch is stored in one insert and broadcast once", async () => {
+	const deviceId = "dev-batch";
+	const fakeDevice = {
+		_id: "obj1",
+		deviceId,
+		updateStatus: async function (status) {
+			this.status = status;
+		},
+	};
+
+	mock.method(Device, "findOne", async () => fakeDevice);
+	const insertMany = mock.method(DeviceData, "insertMany", async (docs) => docs);
+	const broadcast = mock.method(wsManager, "broadcastToWebClients", () => {});
+
+	const ws = makeDeviceSocket(deviceId);
+	await wsManager.handleMessage(ws, {
+		type: "device_data",
+		data: { batch: [{ temperature: 21.5 }, { temperature: 21.7 }, { temperature: 21.9 }] },
+	});
+
+	assert.equal(insertMany.mock.callCount(), 1);
+	const docs = insertMany.mock.calls[0].arguments[0];
+	assert.equal(docs.length, 3);
+	assert.deepEqual(docs[2], {
+		device: "obj1",
+		deviceId,
+		sensors: { temperature: 21.9 },
+		metadata: { source: "websocket", protocol: "WebSocket" },
+	});
+	assert.equal(fakeDevice.status.isOnline, true);
+
+	assert.equal(broadcast.mock.callCount(), 1);
+	const message = broadcast.mock.calls[0].arguments[0];
+	assert.equal(message.type, "device_batch_data");
+	assert.equal(message.data.count, 3);
+	assert.equal(ws.sent.length, 0);
+
+	mock.restoreAll();
+});
+
+test("device_data with seq is acknowledged after it is stored", async () => {
+	const deviceId = "dev-seq";
+	const fakeDevice = { _id: "obj2", deviceId, updateStatus: async () => {} };
+
+	mock.method(Device, "findOne", async () => fakeDevice);
+	const save = mock.method(DeviceData.prototype, "save", async function () {
+		return this;
+	});
+	mock.method(wsManager, "broadcastToWebClients", () => {});
+
+	const ws = makeDeviceSocket(deviceId);
+	await wsManager.handleMessage(ws, {
+		type: "device_data",
+		data: { seq: 42, sensorData: [{ type: "temperature", value: 21.5, unit: "C" }] },
+	});
+
+	assert.equal(save.mock.callCount(), 1);
+	assert.deepEqual(ws.sent, [{ type: "ack", data: { seq: 42 } }]);
+
+	mock.restoreAll();
+});
+
+test("component updates from a device are stored and broadcast", async () => {
+	const deviceId = "dev-component";
+	const fakeDevice = { deviceId, components: [{ id: "fan", type: "slider", value: 10 }], save: async () => {} };
+
+	mock.method(Device, "findOne", async () => fakeDevice);
+	const broadcast = mock.method(wsManager, "broadcastToWebClients", () => {});
+
+	const ws = makeDeviceSocket(deviceId);
+	await wsManager.handleMessage(ws, { type: "component", data: { type: "slider", id: "fan", value: 42 } });
+	await wsManager.handleMessage(ws, { type: "toggle", id: "lamp", value: true });
+
+	assert.equal(fakeDevice.components.length, 2);
+	assert.equal(fakeDevice.components[0].value, 42);
+	assert.equal(fakeDevice.components[1].type, "toggle");
+	assert.deepEqual(broadcast.mock.calls[0].arguments[0], {
+		type: "device_component_update",
+		data: { deviceId, component: { id: "fan", type: "slider", value: 42 } },
+	});
+	assert.equal(ws.sent.length, 0);
+
+	mock.restoreAll();
+});
+
+test("widget updates by index resolve through the session's component schema", async () => {
+	const deviceId = "dev-widgets";
+	const fakeDevice = { deviceId, components: [], save: async () => {} };
+
+	mock.method(Device, "findOne", async () => fakeDevice);
+	const broadcast = mock.method(wsManager, "broadcastToWebClients", () => {});
+
+	const ws = makeDeviceSocket(deviceId);
+	await wsManager.handleMessage(ws, { type: "c", i: 0, v: 1 });
+	assert.equal(ws.sent[0].type, "error");
+
+	await wsManager.handleMessage(ws, {
+		type: "component_schema",
+		data: { components: [["fan", "slider"], ["lamp", "toggle"]] },
+	});
+	await wsManager.handleMessage(ws, { type: "c", i: 1, v: true });
+	await wsManager.handleMessage(ws, { type: "c", i: 0, v: 42 });
+	await wsManager.handleMessage(ws, { type: "c", i: 2, v: 7 });
+
+	assert.deepEqual(
+		fakeDevice.components.map((c) => [c.id, c.type, c.value]),
+		[
+			["lamp", "toggle", true],
+			["fan", "slider", 42],
+		],
+	);
+	assert.deepEqual(broadcast.mock.calls[1].arguments[0], {
+		type: "device_component_update",
+		data: { deviceId, component: { id: "fan", type: "slider", value: 42 } },
+	});
+	// Before the schema and out of range
+	assert.deepEqual(
+		ws.sent.map((m) => m.type),
+		["error", "error"],
+	);
+
+	mock.restoreAll();
+});
+
+test("commands are sent as binary frames to devices that negotiated msgpack", () => {
+	const frames = [];
+	const deviceWs = { readyState: WebSocket.OPEN, encoding: "msgpack", send: (raw) => frames.push(raw) };
+
+	wsManager.sendCommand(deviceWs, "toggle");
+
+	assert.equal(frames.length, 1);
+	assert.ok(Buffer.isBuffer(frames[0]));
+	assert.equal(frames[0].toString("hex"), "9203a6746f67676c65");
+});
+
+test("a component snapshot is stored with one save", async () => {
+	const deviceId = "dev-snapshot";
+	const fakeDevice = { deviceId, components: [], save: async () => {} };
+
+	mock.method(Device, "findOne", async () => fakeDevice);
+	const save = mock.method(fakeDevice, "save", async () => {});
+	const broadcast = mock.method(wsManager, "broadcastToWebClients", () => {});
+
+	const ws = makeDeviceSocket(deviceId);
+	await wsManager.handleMessage(ws, {
+		type: "component_snapshot",
+		data: {
+			components: [
+				{ type: "slider", id: "fan", value: 3 },
+				{ type: "toggle", id: "lamp", value: false },
+			],
+		},
+	});
+
+	assert.equal(save.mock.callCount(), 1);
+	assert.deepEqual(
+		fakeDevice.components.map((c) => [c.id, c.value]),
+		[
+			["fan", 3],
+			["lamp", false],
+		],
+	);
+	assert.equal(broadcast.mock.callCount(), 2);
+
+	mock.restoreAll();
+});
+
+test("device_stats is relayed to web clients without a reply", async () => {
+	const broadcast = mock.method(wsManager, "broadcastToWebClients", () => {});
+
+	const ws = makeDeviceSocket("dev-stats");
+	const stats = { up: 60000, heap: [180000, 150000], ws: [10, 900, 0, 1, 120, 63, 255, 300] };
+	await wsManager.handleMessage(ws, { type: "device_stats", data: stats });
+
+	assert.equal(broadcast.mock.callCount(), 1);
+	const message = broadcast.mock.calls[0].arguments[0];
+	assert.equal(message.type, "device_stats");
+	assert.equal(message.data.deviceId, "dev-stats");
+	assert.deepEqual(message.data.stats, stats);
+	assert.equal(ws.sent.length, 0);
+
+	mock.restoreAll();
+});
+
+test("command_response is relayed to web clients without a reply", async () => {
+	const broadcast = mock.method(wsManager, "broadcastToWebClients", () => {});
+
+	const ws = makeDeviceSocket("dev-respond");
+	await wsManager.handleMessage(ws, { type: "command_response", data: { id: "led", ok: true } });
+
+	assert.equal(broadcast.mock.callCount(), 1);
+	const message = broadcast.mock.calls[0].arguments[0];
+	assert.equal(message.type, "command_response");
+	assert.equal(message.data.deviceId, "dev-respond");
+	assert.deepEqual(message.data.response, { id: "led", ok: true });
+	assert.equal(ws.sent.length, 0);
+
+	mock.restoreAll();
+});
+
+test("traced device frames are echoed before they are processed", async () => {
+	mock.method(Device, "findOne", async () => null);
+	mock.method(wsManager, "broadcastToWebClients", () => {});
+
+	const ws = makeDeviceSocket("dev-trace");
+	await wsManager.handleMessage(ws, { type: "device_data", data: { sensorData: { t: 1 }, trace: [5, 123456] } });
+	await wsManager.handleMessage(ws, { type: "slider", id: "fan", value: 2, trace: [6, 123460] });
+
+	assert.deepEqual(
+		ws.sent.map((m) => [m.type, m.data.trace]),
+		[
+			["trace_ack", [5, 123456]],
+			["trace_ack", [6, 123460]],
+		],
+	);
+	assert.ok(Number.isInteger(ws.sent[0].data.at) && ws.sent[0].data.at < 2 ** 32);
+
+	mock.restoreAll();
+});
+
+test("a stream gets credit on open, chunks are relayed and credit is topped up", async () => {
+	const broadcast = mock.method(wsManager, "broadcastToWebClients", () => {});
+
+	const ws = makeDeviceSocket("dev-stream");
+	await wsManager.handleMessage(ws, {
+		type: "stream_open",
+		data: { id: 1, name: "mic", format: "int16", rate: 16000, chunk: 506, seq: 100 },
+	});
+	assert.deepEqual(ws.sent, [{ type: "stream_credit", data: { id: 1, until: 108 } }]);
+
+	const chunk = (seq, index) => {
+		const frame = Buffer.alloc(16);
+		frame.set([0xc1, 1, 1, 0]);
+		frame.writeUInt32LE(seq, 4);
+		frame.writeUInt32LE(index, 8);
+		frame.writeInt16LE(-5, 12);
+		frame.writeInt16LE(7, 14);
+		return frame;
+	};
+	for (let seq = 100; seq < 104; seq++) {
+		wsManager.handleStreamChunk(ws, chunk(seq, (seq - 100) * 2));
+	}
+	// Half of the window used: topped up to 104 + 8
+	assert.deepEqual(ws.sent.at(-1), { type: "stream_credit", data: { id: 1, until: 112 } });
+
+	// A jump in the sample index is counted as missing samples
+	wsManager.handleStreamChunk(ws, chunk(104, 20));
+	assert.equal(ws.streams.get(1).missing, 12);
+
+	const relayed = broadcast.mock.calls.at(-1).arguments[0];
+	assert.equal(relayed.type, "device_stream");
+	assert.deepEqual(relayed.data.samples, [-5, 7]);
+	assert.equal(relayed.data.index, 20);
+
+	// Chunks beyond the credit are refused
+	wsManager.handleStreamChunk(ws, chunk(112, 22));
+	assert.equal(ws.sent.at(-1).type, "error");
+
+	mock.restoreAll();
+});
+
+test("a gateway authenticates its sub-devices in one message and relays for them by channel", async () => {
+	const broadcast = mock.method(wsManager, "broadcastToWebClients", () => {});
+	const sign = (claims) => jwt.sign(claims, process.env.JWT_SECRET);
+
+	const gateway = { ...makeDeviceSocket("gw-1"), userId: "u1", authenticated: true };
+	await wsManager.handleMessage(gateway, {
+		type: "gateway_auth",
+		data: {
+			devices: [
+				[1, "sub-a", sign({ userId: "u1", deviceId: "sub-a" })],
+				[2, "sub-b", sign({ userId: "u2", deviceId: "sub-b" })],
+				[3, "sub-c", "not-a-token"],
+			],
+		},
+	});
+	assert.deepEqual(gateway.sent.at(-1), { type: "gateway_auth_result", data: { accepted: [1], rejected: [2, 3] } });
+	assert.equal(wsManager.deviceConnections.get("sub-a").gateway, gateway);
+
+	// A sub-device's message is handled as its own, replies go back on its channel
+	await wsManager.handleMessage(gateway, { type: "gw", data: { ch: 1, msg: { type: "command_response", data: { ok: true } } } });
+	assert.equal(broadcast.mock.calls.at(-1).arguments[0].data.deviceId, "sub-a");
+	wsManager.sendCommand(wsManager.deviceConnections.get("sub-a"), "led_on");
+	const routed = gateway.sent.at(-1);
+	assert.equal(routed.type, "gw");
+	assert.equal(routed.data.ch, 1);
+	assert.equal(JSON.parse(routed.data.msg).data.command, "led_on");
+
+	// No nested sessions, no unknown channels
+	await wsManager.handleMessage(gateway, { type: "gw", data: { ch: 1, msg: { type: "auth", data: {} } } });
+	assert.equal(JSON.parse(gateway.sent.at(-1).data.msg).type, "error");
+	await wsManager.handleMessage(gateway, { type: "gw", data: { ch: 2, msg: { type: "device_stats", data: {} } } });
+	assert.equal(gateway.sent.at(-1).type, "error");
+
+	// The sub-devices go offline with the gateway
+	wsManager.removeConnection(gateway);
+	assert.equal(wsManager.deviceConnections.has("sub-a"), false);
+	assert.equal(wsManager.deviceConnections.has("gw-1"), false);
+
+	mock.restoreAll();
+});
+
+test("a gateway frame is counted once, against the gateway", async () => {
+	const sign = (claims) => jwt.sign(claims, process.env.JWT_SECRET);
+	const gateway = { ...makeDeviceSocket("gw-2"), userId: "u1", authenticated: true };
+	await wsManager.handleMessage(gateway, {
+		type: "gateway_auth",
+		data: { devices: [[1, "sub-d", sign({ userId: "u1", deviceId: "sub-d" })]] },
+	});
+	mock.method(wsManager, "broadcastToWebClients", () => {});
+	const record = mock.method(wsManager.governor, "record", () => {});
+
+	const frame = { type: "gw", data: { ch: 1, msg: { type: "command_response", data: { ok: true } } } };
+	await wsManager.handleFrame(gateway, Buffer.from(JSON.stringify(frame)), false);
+	assert.deepEqual(
+		record.mock.calls.map((call) => call.arguments[0]),
+		["gw-2"],
+	);
+
+	wsManager.removeConnection(gateway);
+	mock.restoreAll();
+});